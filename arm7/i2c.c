@@ -171,19 +171,12 @@ void i2c1_op(i2c_package * package)
 //			"i2c I2C1STAT is: %i.",
 		//			I2C1STAT);
 
+		i2c1_reject_count++;
 		if (global_data.err_reporting_i2c)
 		{
-			debug_message_buffer_sprintf("*****Restarted I2C1*** I2C1STAT=%i",I2C1STAT);
+			debug_event(DEBUG_EVENT_I2C_RESTART, "I2C%u buffer full, restarted, I2CSTAT 0x%02X, %u packages rejected",
+					1, I2C1STAT, i2c1_reject_count);
 			//END HACK
-
-			if (i2c1_reject_count++ % 256 == 0)
-			{
-				debug_message_buffer_sprintf(
-						"i2c1 buffer full. Rejected package. Total: %i",
-						i2c1_reject_count);
-
-
-			}
 		}
 		return;
 	}
@@ -220,20 +213,12 @@ static void I2C1_ISR(void)
 		//  sprintf((char*)buffer, package_buffer1[i2c_package_buffer1_current_idx].slave_address) ;
 		//message_send_debug(COMM_1, buffer);
 		//		debug_message_buffer("i2c error limit reached");
+		i2c1_permanent_error_count++;
 		if (global_data.err_reporting_i2c)
 		{
-			debug_message_buffer_sprintf("i2c1 error limit reached. Dest: %i",
-
-					package_buffer1[i2c_package_buffer1_current_idx].slave_address);
-
-
-			if (i2c1_permanent_error_count++ % 256 == 0)
-			{
-				debug_message_buffer_sprintf(
-						"i2c1 error limit reached. Total: %i errors.",
-						i2c1_permanent_error_count);
-
-			}
+			debug_event(DEBUG_EVENT_I2C_ERROR_LIMIT, "I2C%u error limit reached, dest 0x%02X, %u total",
+					1, package_buffer1[i2c_package_buffer1_current_idx].slave_address,
+					i2c1_permanent_error_count);
 		}
 
 		package_buffer1[i2c_package_buffer1_current_idx].i2c_error_code
@@ -247,8 +232,8 @@ static void I2C1_ISR(void)
 					&(package_buffer1[i2c_package_buffer1_current_idx])); // call package handler
 		}
 
-		i2c_package_buffer1_insert_idx = (i2c_package_buffer1_insert_idx + 1)
-				% I2C_PACKAGE_BUFFER_SIZE; // increment package insertion pointer
+		i2c_package_buffer1_current_idx = (i2c_package_buffer1_current_idx + 1)
+				% I2C_PACKAGE_BUFFER_SIZE; // drop the failed package, continue with the next one
 		error_counter1 = 0;
 		if (i2c_package_buffer1_current_idx == i2c_package_buffer1_insert_idx)
 		{ // no unhandled packages
@@ -268,8 +253,8 @@ static void I2C1_ISR(void)
 			I2C1CONCLR = 1 << SIC; // clear I2C interrupt flag
 		}
 	}
-	if (i2c1_busy == 1)
-	{ //Return if Package error
+	else if (i2c1_busy == 1)
+	{ // the error limit branch above already moved on to the next package
 		//message_debug_send(MAVLINK_COMM_1, 30, I2C1STAT);
 		switch (I2C1STAT)
 		{ // check current I2C1 state
@@ -313,6 +298,12 @@ static void I2C1_ISR(void)
 			// it the last byte has been transmitted, check if there are unhandled packages in the package buffer
 			else
 			{
+				if (package_buffer1[i2c_package_buffer1_current_idx].i2c_done_handler
+						!= NULL)
+				{ // check if there is a package handler registered, write packages report their completion too
+					package_buffer1[i2c_package_buffer1_current_idx].i2c_done_handler(
+							&(package_buffer1[i2c_package_buffer1_current_idx])); // call package handler
+				}
 				i2c_package_buffer1_current_idx
 						= (i2c_package_buffer1_current_idx + 1)
 								% I2C_PACKAGE_BUFFER_SIZE; // increment pointer to package in processing
@@ -345,9 +336,8 @@ static void I2C1_ISR(void)
 			//debug_message_buffer("I2C error: slave address not acknowledged (write)\n");
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer_sprintf(
-					"I2C1 error: slave addr not ack (write). Dest: %i",
-					package_buffer1[i2c_package_buffer1_current_idx].slave_address);
+			debug_event(DEBUG_EVENT_I2C_ADDR_NACK_WRITE, "I2C%u slave address not acknowledged (write), dest 0x%02X",
+					1, package_buffer1[i2c_package_buffer1_current_idx].slave_address);
 					}
 
 			//message_send_debug(COMM_1, buffer);
@@ -361,9 +351,8 @@ static void I2C1_ISR(void)
 			//		debug_message_buffer("I2C error: data not acknowledged\n");
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer_sprintf(
-					"I2C1 error: data not acknowledged. Dest: %i",
-					package_buffer1[i2c_package_buffer1_current_idx].slave_address);
+			debug_event(DEBUG_EVENT_I2C_DATA_NACK, "I2C%u data not acknowledged, dest 0x%02X",
+					1, package_buffer1[i2c_package_buffer1_current_idx].slave_address);
 					}
 
 			//message_send_debug(COMM_1, buffer);
@@ -376,9 +365,8 @@ static void I2C1_ISR(void)
 			//		debug_message_buffer("I2C error: arbitration lost\n");
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer_sprintf(
-					"I2C1 error: arbitration lost. Dest: %i",
-					package_buffer1[i2c_package_buffer1_current_idx].slave_address);
+			debug_event(DEBUG_EVENT_I2C_ARBITRATION_LOST, "I2C%u arbitration lost, dest 0x%02X",
+					1, package_buffer1[i2c_package_buffer1_current_idx].slave_address);
 					}
 
 			//message_send_debug(COMM_1, buffer);
@@ -444,8 +432,8 @@ static void I2C1_ISR(void)
 			error_counter1++;
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer(
-					"I2C1 error: slave address not acknowledged (read)\n");
+			debug_event(DEBUG_EVENT_I2C_ADDR_NACK_READ, "I2C%u slave address not acknowledged (read), dest 0x%02X",
+					1, package_buffer1[i2c_package_buffer1_current_idx].slave_address);
 					}
 			//message_send_debug(COMM_1, buffer);
 			I2C1CONCLR = 1 << SIC;
@@ -457,8 +445,8 @@ static void I2C1_ISR(void)
 			error_counter1++;
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer_sprintf("I2C1 error: undefined I2C state: %i",I2C1STAT);
-			debug_message_buffer_sprintf("I2C1 error: prior state: %X",i2c1stat_prior_state);
+			debug_event(DEBUG_EVENT_I2C_UNDEFINED_STATE, "I2C%u undefined state 0x%02X, prior state 0x%02X",
+					1, I2C1STAT, i2c1stat_prior_state);
 					}
 			//		message_send_debug(COMM_1, buffer);
 			I2C1CONCLR = 1 << SIC;
@@ -519,17 +507,12 @@ void i2c0_op(i2c_package * package)
 		//			"i2c I2C0STAT is: %i.",
 		//			I2C1STAT);
 
+				i2c0_reject_count++;
 				if (global_data.err_reporting_i2c)
 						{
-				debug_message_buffer_sprintf("*****Restarted I2C0*** I2C0STAT=%i",I2C0STAT);
+				debug_event(DEBUG_EVENT_I2C_RESTART, "I2C%u buffer full, restarted, I2CSTAT 0x%02X, %u packages rejected",
+						0, I2C0STAT, i2c0_reject_count);
 		//END HACK
-
-		if (i2c0_reject_count++ % 256 == 0)
-		{
-			debug_message_buffer_sprintf(
-					"i2c0 buffer full. Rejected package. Total: %i",
-					i2c0_reject_count);
-		}
 						}
 		return;
 	}
@@ -573,8 +556,8 @@ static void I2C0_ISR(void)
 		{
 			if (i2c0_permanent_error_count++ % 256 == 0)
 			{
-				debug_message_buffer_sprintf(
-						"i2c0 error limit reached. Total: %i errors.",
+				debug_event(DEBUG_EVENT_I2C_ERROR_LIMIT, "I2C%u error limit reached, dest 0x%02X, %u total",
+						0, package_buffer0[i2c_package_buffer0_current_idx].slave_address,
 						i2c0_permanent_error_count);
 			}
 		}
@@ -590,8 +573,8 @@ static void I2C0_ISR(void)
 					&(package_buffer0[i2c_package_buffer0_current_idx])); // call package handler
 		}
 
-		i2c_package_buffer0_insert_idx = (i2c_package_buffer0_insert_idx + 1)
-				% I2C_PACKAGE_BUFFER_SIZE; // increment package insertion pointer
+		i2c_package_buffer0_current_idx = (i2c_package_buffer0_current_idx + 1)
+				% I2C_PACKAGE_BUFFER_SIZE; // drop the failed package, continue with the next one
 		error_counter0 = 0;
 		if (i2c_package_buffer0_current_idx == i2c_package_buffer0_insert_idx)
 		{ // no unhandled packages
@@ -611,8 +594,8 @@ static void I2C0_ISR(void)
 			I2C0CONCLR = 1 << SIC; // clear I2C interrupt flag
 		}
 	}
-	if (i2c0_busy == 1)
-	{ //Return if Package error
+	else if (i2c0_busy == 1)
+	{ // the error limit branch above already moved on to the next package
 		//message_debug_send(MAVLINK_COMM_1, 30, I2C0STAT);
 		switch (I2C0STAT)
 		{ // check current I2C0 state
@@ -652,6 +635,12 @@ static void I2C0_ISR(void)
 			// it the last byte has been transmitted, check if there are unhandled packages in the package buffer
 			else
 			{
+				if (package_buffer0[i2c_package_buffer0_current_idx].i2c_done_handler
+						!= NULL)
+				{ // check if there is a package handler registered, write packages report their completion too
+					package_buffer0[i2c_package_buffer0_current_idx].i2c_done_handler(
+							&(package_buffer0[i2c_package_buffer0_current_idx])); // call package handler
+				}
 				i2c_package_buffer0_current_idx
 						= (i2c_package_buffer0_current_idx + 1)
 								% I2C_PACKAGE_BUFFER_SIZE; // increment pointer to package in processing
@@ -683,9 +672,8 @@ static void I2C0_ISR(void)
 			//debug_message_buffer("I2C error: slave address not acknowledged (write)\n");
 			if (global_data.err_reporting_i2c)
 					{
-			if (error_counter0 % 200 == 0) debug_message_buffer_sprintf(
-					"I2C0 error: slave address not acknowledged (write) (200 times). Dest: %i",
-					package_buffer0[i2c_package_buffer0_current_idx].slave_address);
+			if (error_counter0 % 200 == 0) debug_event(DEBUG_EVENT_I2C_ADDR_NACK_WRITE, "I2C%u slave address not acknowledged (write), dest 0x%02X",
+					0, package_buffer0[i2c_package_buffer0_current_idx].slave_address);
 					}
 
 			//message_send_debug(COMM_1, buffer);
@@ -698,9 +686,8 @@ static void I2C0_ISR(void)
 			//		debug_message_buffer("I2C error: data not acknowledged\n");
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer_sprintf(
-					"I2C0 error: data not acknowledged. Dest: %i",
-					package_buffer0[i2c_package_buffer0_current_idx].slave_address);
+			debug_event(DEBUG_EVENT_I2C_DATA_NACK, "I2C%u data not acknowledged, dest 0x%02X",
+					0, package_buffer0[i2c_package_buffer0_current_idx].slave_address);
 					}
 
 			//message_send_debug(COMM_1, buffer);
@@ -710,9 +697,8 @@ static void I2C0_ISR(void)
 			I2C0CONSET = 1 << STA; // restart I2C state machine with current package
 			error_counter0++;
 			//		debug_message_buffer("I2C error: arbitration lost\n");
-			debug_message_buffer_sprintf(
-					"I2C0 error: arbitration lost. Dest: %i",
-					package_buffer0[i2c_package_buffer0_current_idx].slave_address);
+			debug_event(DEBUG_EVENT_I2C_ARBITRATION_LOST, "I2C%u arbitration lost, dest 0x%02X",
+					0, package_buffer0[i2c_package_buffer0_current_idx].slave_address);
 
 			//message_send_debug(COMM_1, buffer);
 			I2C0CONCLR = 1 << SIC;
@@ -773,8 +759,8 @@ static void I2C0_ISR(void)
 			error_counter0++;
 			if (global_data.err_reporting_i2c)
 					{
-			debug_message_buffer(
-					"I2C0 error: slave address not acknowledged (read)\n");
+			debug_event(DEBUG_EVENT_I2C_ADDR_NACK_READ, "I2C%u slave address not acknowledged (read), dest 0x%02X",
+					0, package_buffer0[i2c_package_buffer0_current_idx].slave_address);
 					}
 			//message_send_debug(COMM_1, buffer);
 			I2C0CONCLR = 1 << SIC;
@@ -786,8 +772,8 @@ static void I2C0_ISR(void)
 			error_counter0++;
 			if (global_data.err_reporting_i2c)
 					{
-			if (error_counter0 % 200 == 0) debug_message_buffer_sprintf("I2C0 error: undefined I2C state: %i",I2C0STAT);
-			if (error_counter0 % 200 == 0) debug_message_buffer_sprintf("I2C0 error: prior state: %X",i2c0stat_prior_state);
+			if (error_counter0 % 200 == 0) debug_event(DEBUG_EVENT_I2C_UNDEFINED_STATE, "I2C%u undefined state 0x%02X, prior state 0x%02X",
+					0, I2C0STAT, i2c0stat_prior_state);
 					}
 			//		message_send_debug(COMM_1, buffer);
 			I2C0CONCLR = 1 << SIC;
@@ -35,6 +35,7 @@ This file is part of the PIXHAWK project
 #include "conf.h"
 #include "i2c.h"
 #include "debug.h"
+#include "sys_time.h"
 
 #include "comm.h"
 #include "led.h"
@@ -43,7 +44,12 @@ This file is part of the PIXHAWK project
 #if (FEATURE_EEPROM==FEATURE_EEPROM_ENABLED)
 
 uint8_t data_buffer[MAX_I2C_PACKAGE_SIZE];
-uint8_t data_ready = 0;
+volatile uint8_t data_ready = 0;
+static uint8_t data_error = 0;
+static volatile uint8_t write_done = 1;			///< I2C transfer of the last write finished
+static volatile uint8_t write_cycle_done = 1;	///< EEPROM acknowledged its address after the write
+static volatile uint8_t write_poll = 0;			///< Address poll on the bus
+static uint64_t write_poll_time = 0;
 
 /**
  * @brief Temporarily saves read results within the EEPROM driver
@@ -56,13 +62,29 @@ uint8_t data_ready = 0;
  */
 static void eeprom_save_data_after_read(i2c_package *package);
 
+/** @brief Called by the I2C subsystem once the write transfer has finished */
+static void eeprom_write_done(i2c_package *package)
+{
+	write_done = 1;
+}
+
+/** @brief Called by the I2C subsystem once the address poll has finished */
+static void eeprom_write_poll_done(i2c_package *package)
+{
+	// The EEPROM does not acknowledge its address during the write cycle
+	if (package->i2c_error_code != I2C_CODE_ERROR)
+	{
+		write_cycle_done = 1;
+	}
+	write_poll = 0;
+}
 
 void eeprom_write(uint16_t address, uint8_t length, uint8_t * data)
 {
 	uint8_t copy_counter;
 	
 	// check that byte array is not longer than 64 bytes (max. page write length)
-	if(length>64) {
+	if(length>EEPROM_PAGE_SIZE) {
 		//uint8_t buffer[200];	// string buffer for debug messages
 		//sprintf((char *)buffer, "EEPROM error: Maximum page write size is 64 bytes\n");
 		//message_send_debug(COMM_0, buffer);
@@ -78,7 +100,7 @@ void eeprom_write(uint16_t address, uint8_t length, uint8_t * data)
 	package.slave_address = EEPROM_I2C_SLAVE_ADDRESS;	// I2C slave address of EEPROM
 	package.bus_number = EEPROM_I2C_BUS_NUMBER;			// number of the I2C bus, that the EEPROM is connected to
 	package.write_read = 0;								// no repeated start condition
-	package.i2c_done_handler = NULL;					// nothing to be done at I2C completion
+	package.i2c_done_handler = (void*)&eeprom_write_done;	// the write cycle starts at I2C completion
 
 	// copy user data to I2C package
 	for(copy_counter=0; copy_counter<length; copy_counter++)
@@ -86,9 +108,45 @@ void eeprom_write(uint16_t address, uint8_t length, uint8_t * data)
 		package.data[copy_counter+2] = data[copy_counter];
 	}
 
+	write_done = 0;
+	write_cycle_done = 0;
 	i2c_op(&package);	// start I2C write operation
 }
 
+uint8_t eeprom_write_ready(void)
+{
+	if (write_cycle_done)
+	{
+		return 1;
+	}
+	if (!write_done)
+	{
+		return 0;
+	}
+
+	// A poll the I2C subsystem rejected never calls back, start a new one
+	if (write_poll && sys_time_clock_get_time_usec() - write_poll_time
+			< EEPROM_POLL_TIMEOUT)
+	{
+		return 0;
+	}
+
+	// Poll with a one byte read of the current address, it changes nothing
+	i2c_package package;
+	package.length = 1;									// one data byte
+	package.direction = I2C_READ;						// I2C read operation
+	package.slave_address = EEPROM_I2C_SLAVE_ADDRESS;	// I2C slave address of EEPROM
+	package.bus_number = EEPROM_I2C_BUS_NUMBER;			// number of the I2C bus, that the EEPROM is connected to
+	package.write_read = 0;								// no repeated start condition
+	package.i2c_done_handler = (void*)&eeprom_write_poll_done;	// called with I2C_CODE_ERROR if the address is not acknowledged
+	package.i2c_error_code = I2C_CODE_NOT_KNOWN;
+
+	write_poll = 1;
+	write_poll_time = sys_time_clock_get_time_usec();
+	i2c_op(&package);
+	return 0;
+}
+
 
 void eeprom_start_read(uint16_t address, uint8_t length)
 {
@@ -119,7 +177,9 @@ void eeprom_start_read(uint16_t address, uint8_t length)
 	package_read.bus_number = EEPROM_I2C_BUS_NUMBER;				// number of the I2C bus, that the EEPROM is connected to
 	package_read.write_read = 1;									// repeated start condition at start
 	package_read.i2c_done_handler = (void*)&eeprom_save_data_after_read;	// eeprom_save_data_after_read() is called at I2C completion
+	package_read.i2c_error_code = I2C_CODE_NOT_KNOWN;				// set to I2C_CODE_ERROR by the I2C subsystem if the read fails
 
+	data_ready = 0;
 	i2c_write_read(&package_write, &package_read);  // start data read operation
 
 }
@@ -135,10 +195,16 @@ void eeprom_save_data_after_read(i2c_package *package)
 	}
 
 	// set data ready to the number of valid bytes in the data buffer
+	data_error = (package->i2c_error_code == I2C_CODE_ERROR);
 	data_ready = package->length;
 }
 
-void eeprom_read_data(uint8_t * data)
+uint8_t eeprom_read_ready(void)
+{
+	return data_ready != 0;
+}
+
+uint8_t eeprom_read_data(uint8_t * data)
 {
 	uint8_t copy_counter;
 
@@ -153,6 +219,7 @@ void eeprom_read_data(uint8_t * data)
 
 	// reset data_ready
 	data_ready = 0;
+	return !data_error;
 }
 
 static int8_t eeprom_available=-1;
@@ -188,7 +255,7 @@ void eeprom_check_start()
 
 void eeprom_check_handler(i2c_package *package)
 {
-	debug_message_buffer("YAAAAY!!! eeprom_check_handler executed");
+	debug_event(DEBUG_EVENT_EEPROM_CHECK, "EEPROM check done, error code %u", package->i2c_error_code);
 	if(package->i2c_error_code== I2C_CODE_ERROR)
 	{
 		eeprom_available=0;
@@ -211,4 +278,9 @@ int8_t eeprom_check_ok(){
 	}
 	return eeprom_available;
 }
+
+uint8_t eeprom_check_done(void)
+{
+	return eeprom_available != -1;
+}
 #endif
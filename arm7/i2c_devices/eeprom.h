@@ -38,6 +38,14 @@ This file is part of the PIXHAWK project
 
 
 #if (FEATURE_EEPROM==FEATURE_EEPROM_ENABLED)
+
+#define EEPROM_PAGE_SIZE 64		///< Page of the 24FC256, a write must not cross a page boundary
+#define EEPROM_POLL_TIMEOUT 10000	///< Address poll without answer is restarted after this, in usecs
+
+#if (MAX_I2C_PACKAGE_SIZE < EEPROM_PAGE_SIZE + 2)
+#error "MAX_I2C_PACKAGE_SIZE has to hold an EEPROM page and its address"
+#endif
+
 /**
  * @brief Write data to specific address in EEPROM
  *
@@ -74,8 +82,30 @@ void eeprom_start_read(uint16_t address, uint8_t length);
  * returns when all the data read from the EEPROM is in the byte array "data".
  *
  * @param data		pointer to the byte array, that the data read from the EEPROM is written to
+ * @return 1 if the read succeeded, 0 if the I2C transfer failed
  */
-void eeprom_read_data(uint8_t * data);
+uint8_t eeprom_read_data(uint8_t * data);
+
+/**
+ * @brief 1 once the read started by "eeprom_start_read()" has finished
+ *
+ * While the EEPROM is busy with a write cycle it does not acknowledge its
+ * address. The I2C subsystem gives up on a package after
+ * I2C_PERMANENT_ERROR_LIMIT errors, only start a read once
+ * "eeprom_write_ready()" returns 1.
+ */
+uint8_t eeprom_read_ready(void);
+
+/**
+ * @brief 1 once the write of "eeprom_write()" is done
+ *
+ * After the I2C transfer every call puts an address poll on the bus
+ * unless one is pending. The EEPROM acknowledges its address again once
+ * the write cycle is over, typically after less than the 5 ms maximum.
+ * Poll this from the main loop. A poll during the write cycle counts as
+ * an I2C error of the bus.
+ */
+uint8_t eeprom_write_ready(void);
 
 
 //check if we have an eeprom
@@ -85,6 +115,9 @@ void eeprom_check_handler(i2c_package *package);
 
 int8_t eeprom_check_ok(void);
 
+/** @brief 1 once the I2C transfer of eeprom_check_start() has finished */
+uint8_t eeprom_check_done(void);
+
 #endif
 
 #endif /* EEPROM_H_ */
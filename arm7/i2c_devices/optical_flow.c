@@ -87,7 +87,7 @@ void optical_flow_read_handler(i2c_package *package)
 	}
 	else
 	{
-		debug_message_buffer("optical_flow i2c Error");
+		debug_event(DEBUG_EVENT_OPTICAL_FLOW_I2C_ERROR, "optical_flow i2c error");
 		optical_flow_valid = 0;
 	}
 }
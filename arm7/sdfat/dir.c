@@ -53,6 +53,66 @@ U8 dirbuf[BYTE_PER_SEC];   //buffer for directory sectors
  U16 FirstDirCluster=0;
 #endif
 
+//###########################################################
+/*!\brief Read a directory sector
+ * \param		sector	Sector number of the directory
+ * \return 		Pointer to the sector, valid until the next directory or FAT access
+ */
+U8 *ReadDirSector(U32 sector)
+//###########################################################
+{
+#ifdef USE_FATBUFFER
+ return GetCachedSector(sector);
+#else
+ ReadSector(sector,dirbuf);
+ return dirbuf;
+#endif
+}
+
+#ifdef DOS_WRITE
+//###########################################################
+/*!\brief Write a directory sector changed after ReadDirSector()
+ * \param		sector	Sector number of the directory
+ * \param		buf	Pointer you got from ReadDirSector()
+ * \return 		Nothing
+ *
+ With USE_FATBUFFER the sector is only written on FlushSectorCache().
+ */
+void WriteDirSector(U32 sector, U8 *buf)
+//###########################################################
+{
+#ifdef USE_FATBUFFER
+ SetCachedSectorDirty(buf);
+#else
+ WriteSector(sector,buf);
+#endif
+}
+#endif //DOS_WRITE
+
+#ifdef DOS_WRITE
+//###########################################################
+/*!\brief Split the system UNIX time into seconds of the day and days since 1980
+ * \param		days	days since 1.1.1980
+ * \return 		seconds since midnight
+ *
+ * Times before 1980 (clock not synchronized yet) give 1.1.1980 00:00.
+ */
+static U32 DOSSeconds(U32 *days)
+//###########################################################
+{
+ U32 seconds = sys_time_clock_get_unix_time() / 1000000;
+
+ if(seconds < 315532800UL) // 1.1.1980
+  {
+   *days = 0;
+   return 0;
+  }
+ seconds -= 315532800UL;
+ *days = seconds / 86400UL;
+ return seconds % 86400UL;
+}
+#endif //DOS_WRITE
+
 #ifdef DOS_WRITE
 //###########################################################
 /*!\brief Make DOS time from system time
@@ -78,8 +138,14 @@ U16 DOSTime(void)
 // time |= (U16)local_time.RTC_Min << 5;
 // time |= (U16)local_time.RTC_Sec / 2;
 
-	// FIXME SDCARD
- return sys_time_clock_get_unix_time();
+ U32 days;
+ U32 seconds = DOSSeconds(&days);
+ U16 time;
+
+ time  = (U16)(seconds / 3600) << 11;       // hours
+ time |= (U16)((seconds / 60) % 60) << 5;   // minutes
+ time |= (U16)(seconds % 60) / 2;           // seconds
+ return time;
 }
 #endif //DOS_WRITE
 
@@ -111,9 +177,24 @@ U16 DOSDate(void)
 // date |= (U16)local_time.RTC_Mon << 5;
 // date |= (U16)local_time.RTC_Mday;
 
-	// FIXME SDCARD
-	uint16_t date = sys_time_clock_get_unix_time();
-
+// Civil date from the day number, years start on 1st of March so the
+// leap day is the last day of a year (H. Hinnant's days_from_civil inverse)
+ U32 days;
+ DOSSeconds(&days);
+ U32 z = days + 3652 + 719468;               // days since 1.3.0000
+ U32 era = z / 146097;
+ U32 doe = z - era * 146097;                 // day of the 400 year era
+ U32 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+ U32 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+ U32 mp = (5 * doy + 2) / 153;               // month, 0 = March
+ U16 day = doy - (153 * mp + 2) / 5 + 1;
+ U16 month = mp < 10 ? mp + 3 : mp - 9;
+ U16 year = yoe + era * 400 + (month <= 2);
+ U16 date;
+
+ date  = (U16)(year - 1980) << 9;  // years since 1980
+ date |= month << 5;
+ date |= day;
  return date;
 }
 #endif //DOS_WRITE
@@ -191,15 +272,16 @@ U8 SearchDirSector(FileID fileid, U32 sector)
 //###########################################################
 {
  U16 count;
+ U8 *buf;
  struct FileDesc *fdesc;
 
  fdesc=&FileDescriptors[(U16)fileid];
 
- ReadSector(sector,dirbuf); //read one directory sector.
+ buf=ReadDirSector(sector); //read one directory sector.
  count=0;
  do
   {
-   if(dirbuf[count]==0 || dirbuf[count]==0xE5)
+   if(buf[count]==0 || buf[count]==0xE5)
     {
      fdesc->FileDirSector=sector;     //keep some values in mind
      fdesc->FileDirOffset=count/32;
@@ -233,6 +315,9 @@ void ZeroCluster(U32 startsector)
 
  do
   {
+#ifdef USE_FATBUFFER
+   DropCachedSector(sector); //maybe the cluster was a directory before
+#endif
    WriteSector(sector++,dirbuf);
    j--;
   }while(j);
@@ -295,8 +380,7 @@ U8 Mkdir(char *name)
    UpdateFileEntry(fileid);
 
 #ifdef USE_FATBUFFER
-     WriteSector(FATCurrentSector,fatbuf); // write the FAT buffer
-     FATStatus=0;
+     FlushSectorCache(); // write FAT and directory sectors
 #endif
   }
  else
@@ -457,11 +541,12 @@ U8 UpdateFileEntry(FileID fileid)
 {
  struct DirEntry *di;
  struct FileDesc *fdesc;
+ U8 *buf;
 
  fdesc=&FileDescriptors[(U16)fileid];
 
- ReadSector(fdesc->FileDirSector,dirbuf);
- di=(struct DirEntry *)&dirbuf[fdesc->FileDirOffset * 32];
+ buf=ReadDirSector(fdesc->FileDirSector);
+ di=(struct DirEntry *)&buf[fdesc->FileDirOffset * 32];
 
  strncpy(di->DIR_Name,fdesc->FileName,11);
 
@@ -483,7 +568,7 @@ U8 UpdateFileEntry(FileID fileid)
  di->DIR_FstClusLO=(U16)(fdesc->FileFirstCluster);  //first cluster low word
  di->DIR_FileSize=fdesc->FileSize;
 
- WriteSector(fdesc->FileDirSector,dirbuf);
+ WriteDirSector(fdesc->FileDirSector,buf);
  return F_OK;
 }
 #endif //DOS_WRITE
@@ -522,7 +607,9 @@ U8 ScanOneDirectorySector(FileID fileid,U32 sector)
 //#####################################################################
 {
  U8 by;
+ U8 attr;
  U16 count;
+ U8 *buf;
  struct DirEntry *di;
  struct DirEntryBuffer *dib;
  U8 match;
@@ -534,23 +621,23 @@ U8 ScanOneDirectorySector(FileID fileid,U32 sector)
  if(fileid>=0) fdesc=&FileDescriptors[(U16)fileid];
  else fdesc=NULL;
 
- by=ReadSector(sector,dirbuf); //read one directory sector.
+ buf=ReadDirSector(sector); //read one directory sector.
  count=0;
  do
   {
    match=NO_MATCH;
-   di=(struct DirEntry *)(&dirbuf[count]);
+   di=(struct DirEntry *)(&buf[count]);
 
-   //make a second pointer to dirbuf for easier access to long filename entrys
+   //make a second pointer to buf for easier access to long filename entrys
    dib=(struct DirEntryBuffer *)di;
 
    if(di->DIR_Name[0]==0) return END_DIR; //end of directory
 
    if((unsigned char)di->DIR_Name[0]!=0xE5) // Deleted entry ?
     {
-     di->DIR_Attr&=0x3F;            //smash upper two bits
+     attr=di->DIR_Attr & 0x3F;      //smash upper two bits, not in the sector buffer
 
-     if(di->DIR_Attr==ATTR_LONG_NAME) //is this a long name entry ?
+     if(attr==ATTR_LONG_NAME) //is this a long name entry ?
       {
 #ifdef USE_FINDFILE
 #ifdef USE_FINDLONG
@@ -619,7 +706,7 @@ U8 ScanOneDirectorySector(FileID fileid,U32 sector)
          //match==FULL_MATCH if name found
         }
 
-       if(di->DIR_Attr & ATTR_VOLUME_ID) //is this a volume label ?
+       if(attr & ATTR_VOLUME_ID) //is this a volume label ?
         {           //nothing to do here. volume id not supported
         }
        else //FILE/DIR/FIND operation
@@ -664,7 +751,7 @@ U8 ScanOneDirectorySector(FileID fileid,U32 sector)
 //             strncpy(ffblk.ff_name,di->DIR_Name,8);   //copy filename
 //             strncpy(&ffblk.ff_name[9],&di->DIR_Name[8],3);//copy fileextension
 
-             if(di->DIR_Attr & ATTR_DIRECTORY)
+             if(attr & ATTR_DIRECTORY)
               {
                ffblk.ff_attr=ATTR_DIRECTORY;      //file attribute
                ffblk.ff_fsize=0; 		  //not a file, clear filesize
@@ -696,7 +783,7 @@ U8 ScanOneDirectorySector(FileID fileid,U32 sector)
            if(match==FULL_MATCH)
             {
 
-             if(di->DIR_Attr & ATTR_DIRECTORY) //this is a directory
+             if(attr & ATTR_DIRECTORY) //this is a directory
               {
 
 #ifdef USE_FAT32
@@ -89,9 +89,9 @@ U8 Remove83(char *name)
 //###########################################################
 {
 #ifdef USE_FAT32
- U32 tmp,tmp1;
+ U32 tmp,tmp1,count;
 #else
- U16 tmp,tmp1;
+ U16 tmp,tmp1,count;
 #endif
  struct FileDesc *fdesc;
 
@@ -124,27 +124,23 @@ U8 Remove83(char *name)
 #endif
 
      tmp=fdesc->FileFirstCluster;
+     count=maxcluster; // no chain is longer, a damaged FAT may have a loop
 
      // free clusters in FAT cluster chain (make zero)
-     do
+     // a chain of a damaged FAT may end in a free or reserved cluster,
+     // freeing cluster 0 would make the walk endless
+     while(tmp>=2 && tmp<maxcluster && count)
       {
        tmp1=GetNextClusterNumber(tmp); // save next cluster number
        WriteClusterNumber(tmp,0);      // free cluster
        tmp=tmp1;                       // restore next cluster number
-      }while(tmp<endofclusterchain);
+       count--;
+      }
 
 #ifdef STRICT_FILESYSTEM_CHECKING
     }
 #endif
 
-#ifdef USE_FATBUFFER
-   if(FATStatus>0)
-    {
-     WriteSector(FATCurrentSector,fatbuf); // write the FAT buffer
-     FATStatus=0;
-    }
-#endif
-
    fdesc->FileName[0]=0xE5;   //mark file as deleted. does not affect long filename entrys !
    fdesc->FileSize=0;         //make filesize 0
    fdesc->FileFirstCluster=0; //delete first cluster
@@ -152,6 +148,10 @@ U8 Remove83(char *name)
 
    UpdateFileEntry(fileid);
 
+#ifdef USE_FATBUFFER
+   FlushSectorCache(); // write FAT and directory sectors
+#endif
+
   fdesc->FileFlag=0; // Close this filedescriptor
 
  return F_OK;
@@ -672,17 +672,13 @@ void Fflush(FileID fileid)
  if(fdesc->FileFlag==F_WRITE)
   {
 
-#ifdef USE_FATBUFFER
-   if(FATStatus>0)
-    {
-     WriteSector(FATCurrentSector,fatbuf); // write the FAT buffer
-     FATStatus=0;
-    }
-#endif
-
    FlushWriteBuffer(fileid);
    //update file entry filesize and date/time
    UpdateFileEntry(fileid);
+
+#ifdef USE_FATBUFFER
+   FlushSectorCache(); // write FAT and directory sectors
+#endif
   }
 }
 #endif //DOS_WRITE
@@ -903,6 +899,10 @@ U8 Rename(char *OldName, char *NewName)
    MakeDirEntryName(NewName,fileid); //Split into name and extension
    UpdateFileEntry(fileid);
 
+#ifdef USE_FATBUFFER
+   FlushSectorCache(); // write the directory sector
+#endif
+
    fdesc->FileFlag=0; // Close filedescriptor
    return F_OK;
   }
@@ -935,5 +935,89 @@ void FlushWriteBuffer(FileID fileid)
 }
 #endif
 
+#ifdef DOS_WRITE
+//###########################################################
+/*!\brief Give a new file a contiguous run of clusters
+ * \param		clusters	Number of clusters wanted
+ * \param		fileid	A fileid you got from Fopen() for a new file
+ * \return 		Number of clusters of the file, 0 if it failed
+ *
+ The longest free run up to clusters is used, so on a fragmented
+ drive the file may get less. The file size is set to the allocated
+ size, the old data in the clusters is not cleared.
+
+ The sectors of the file follow each other from
+ GetFirstSectorOfCluster(FileFirstCluster) on. They can be written
+ with WriteSectors() without any FAT access while the file grows.
+*/
+U32 Fpreallocate(U32 clusters, FileID fileid)
+//###########################################################
+{
+ struct FileDesc *fdesc;
+ U32 cluster, start, length, beststart, bestlength, eoc;
+
+ if(fileid<0 || fileid>=MAX_OPEN_FILE) return 0; //invalid filehandle
+
+ fdesc=&FileDescriptors[(U16)fileid];
+
+ if(fdesc->FileFlag!=F_WRITE) return 0; //file is closed or open for reading only !
+ if(fdesc->FileSize!=0) return 0; //only for new files
+
+ // Search the longest free run, stop as soon as it is long enough
+ start=0;
+ length=0;
+ beststart=0;
+ bestlength=0;
+ for(cluster=2; cluster<maxcluster && bestlength<clusters; cluster++)
+  {
+   if(GetNextClusterNumber(cluster)==0)
+    {
+     if(length==0) start=cluster;
+     length++;
+     if(length>bestlength)
+      {
+       beststart=start;
+       bestlength=length;
+      }
+    }
+   else length=0;
+  }
+
+ if(bestlength==0) return 0; //disk full
+
+ eoc=0;
+#ifdef USE_FAT12
+ if(FATtype==FAT12) eoc=0xFFF;
+#endif
+#ifdef USE_FAT16
+ if(FATtype==FAT16) eoc=0xFFFF;
+#endif
+#ifdef USE_FAT32
+ if(FATtype==FAT32) eoc=0x0FFFFFFF;
+#endif
+
+ // Chain the run, then free the cluster Fopen() gave the file
+ for(cluster=beststart; cluster<beststart+bestlength-1; cluster++)
+  {
+   WriteClusterNumber(cluster,cluster+1);
+  }
+ WriteClusterNumber(cluster,eoc);
+ WriteClusterNumber(fdesc->FileFirstCluster,0);
+
+ fdesc->FileFirstCluster=beststart;
+ fdesc->FileCurrentCluster=beststart;
+ fdesc->FileFirstClusterSector=GetFirstSectorOfCluster(beststart);
+ fdesc->FileClusterSectorOffset=0;
+ fdesc->FileClusterCount=0;
+ fdesc->FilePosition=0;
+ fdesc->FileSize=bestlength * BytesPerCluster;
+ fdesc->FileWriteBufferDirty=0;
+
+ Fflush(fileid); //write FAT sectors and file entry
+
+ return bestlength;
+}
+#endif //DOS_WRITE
+
 //@}
 
@@ -20,7 +20,7 @@
 
 #include "typedefs.h"
 
-#define MAX_OPEN_FILE    5
+#define MAX_OPEN_FILE    1 // only the flight log, see sd_log.c
 // every 1 declared open file takes 558 Bytes for FAT12/16/32
 // every 1 declared open file takes 554 Bytes for FAT12/16 only
 
@@ -81,8 +81,10 @@
 #define USE_FAT16	//define this if you want to use FAT16
 #define USE_FAT32	//define this if you want to use FAT32
 
-#define USE_FATBUFFER	//define this if you want to use a FAT buffer
-                        //needs 517 Bytes of RAM !
+#define USE_FATBUFFER	//define this if you want to cache FAT and directory sectors
+                        //needs SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS * 524 Bytes of RAM !
+#define SECTOR_CACHE_SETS	2	//power of two, consecutive FAT sectors go to different sets
+#define SECTOR_CACHE_WAYS	2	//sectors per set, replaced least recently used first
 
 #define USE_FINDFILE	//define this if you want to use Findfirst(); Findnext();
 #define USE_FINDLONG    //define this if you want to get long filenames
@@ -118,6 +120,7 @@ extern U8 Rename(char *OldName, char *NewName);
 
 extern U8 Fseek(S32 offset, U8 mode, FileID fileid);
 extern void FlushWriteBuffer(FileID fileid);
+extern U32 Fpreallocate(U32 clusters, FileID fileid);
 
 extern U32 Filelength(FileID fileid);
 extern FileID findfreefiledsc(void); // return -1 if too many open files
@@ -195,6 +198,8 @@ extern U8 SearchDirSector(FileID fileid, U32 sector);
 
 extern void MakeDirEntryName(char *inname, FileID fileid);
 extern void ZeroCluster(U32 startsector);
+extern U8 *ReadDirSector(U32 sector);
+extern void WriteDirSector(U32 sector, U8 *buf);
 
 extern U8 dirbuf[];   //buffer for directory sectors
 
@@ -35,8 +35,10 @@
 //#undef USE_FAT16	//undefine this if you don't want to use FAT16
 //#undef USE_FAT32	//undefine this if you don't want to use FAT32
 
-//#undef USE_FATBUFFER	//undefine this if you don't want to use a FAT buffer
-                        //needs 517 Bytes of RAM ! 
+//#undef USE_FATBUFFER	//undefine this if you don't want to cache FAT and directory sectors
+                        //needs SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS * 524 Bytes of RAM !
+//#undef SECTOR_CACHE_SETS	//change the cache size here
+//#define SECTOR_CACHE_SETS	4
 
 //#undef USE_FINDFILE     //undefine this if you don't want to use Findfirst(), Findnext()
 //#undef USE_FINDLONG     //undefine this if you don't want to get long filenames
@@ -54,6 +54,8 @@
 U32 FirstDataSector=0; 
 U32 FirstRootSector=0; 
 U32 FATFirstSector=0;  
+U32 FATSectors=0;    // sectors of one FAT
+U8 FATCopies=0;      // number of FATs, the FAT sectors are written to all
 U8 FATtype=0;        
 
 #ifdef USE_FAT32
@@ -66,13 +68,25 @@ U8 FATtype=0;
 #endif
 
 #ifdef USE_FATBUFFER
- U8 fatbuf[BYTE_PER_SEC];   //buffer for FAT sectors
- U32 FATCurrentSector=0;
-
- #ifdef DOS_WRITE
-  U8 FATStatus=0; // only for FAT write buffering
+ #if (SECTOR_CACHE_SETS & (SECTOR_CACHE_SETS-1)) != 0
+  #error "SECTOR_CACHE_SETS has to be a power of two"
  #endif
 
+ struct SectorCacheLine {
+                 U32 sector;
+                 U32 lastuse; // SectorCacheTime of the last access, 0 if empty
+                 U8 dirty;
+                };
+
+ U8 sectorcache[SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS][BYTE_PER_SEC];   //cached FAT and directory sectors
+ struct SectorCacheLine sectorcacheline[SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS];
+ U32 SectorCacheTime=0;   // LRU clock
+
+ U32 SectorCacheHits=0;   // sector found in cache
+ U32 SectorCacheMisses=0; // sector read from the card
+ U32 SectorCacheWrites=0; // dirty sectors written to the card
+
+ U8 *fatbuf=NULL;   //cached FAT sector of the last UpdateFATBuffer()
 #endif
 
 U8 secPerCluster=0;
@@ -89,25 +103,151 @@ U8 RootDirSectors=0;   // never saw more then 32 sectors
 
 #ifdef USE_FATBUFFER
 //############################################################
-/*!\brief Decide if we have to write a used fat sector or read a new fat sector
- * \param		newsector Actual sector number
- * \return 		Nothing
+/*!\brief Get a FAT or directory sector from the sector cache
+ * \param		sector	Sector number
+ * \return 		Pointer to the cached sector
+ *
+ The cache has SECTOR_CACHE_SETS sets of SECTOR_CACHE_WAYS sectors, a
+ sector can only be kept in set (sector & (SECTOR_CACHE_SETS-1)). On a
+ miss the least recently used sector of the set is replaced, it is
+ written first if it was changed. The pointer is valid until the next
+ call, call SetCachedSectorDirty() after changing the sector.
  */
-void UpdateFATBuffer(U32 newsector)
+U8 *GetCachedSector(U32 sector)
 //############################################################
 {
- if(newsector!=FATCurrentSector) // do we need to update the FAT buffer ?
+ struct SectorCacheLine *line;
+ U16 first, i, victim;
+
+ first=(U16)(sector & (SECTOR_CACHE_SETS-1)) * SECTOR_CACHE_WAYS;
+ victim=first;
+
+ for(i=first; i<first+SECTOR_CACHE_WAYS; i++)
   {
-#ifdef DOS_WRITE
-   if(FATStatus>0)
+   line=&sectorcacheline[i];
+   if(line->lastuse!=0 && line->sector==sector)
     {
-     WriteSector(FATCurrentSector,fatbuf); // write the old FAT buffer
-     FATStatus=0; // flag FAT buffer is save
-    } 
+     SectorCacheHits++;
+     line->lastuse=++SectorCacheTime;
+     return sectorcache[i];
+    }
+   if(line->lastuse < sectorcacheline[victim].lastuse) victim=i;
+  }
+
+ SectorCacheMisses++;
+ line=&sectorcacheline[victim];
+#ifdef DOS_WRITE
+ if(line->lastuse!=0 && line->dirty)
+  {
+   WriteFATSector(line->sector,sectorcache[victim]); // write back the replaced sector
+   SectorCacheWrites++;
+  }
+ line->dirty=0;
 #endif
-   ReadSector(newsector,fatbuf); //read FAT sector
-   FATCurrentSector=newsector;
-  } 
+
+ if(ReadSector(sector,sectorcache[victim])==0)
+  {
+   line->sector=sector;
+   line->lastuse=++SectorCacheTime;
+  }
+ else line->lastuse=0; // read failed, keep nothing
+
+ return sectorcache[victim];
+}
+
+#ifdef DOS_WRITE
+//############################################################
+/*!\brief Mark a sector from GetCachedSector() as changed
+ * \param		buf	Pointer you got from GetCachedSector()
+ * \return 		Nothing
+ *
+ The sector is written when it is replaced or by FlushSectorCache().
+ */
+void SetCachedSectorDirty(U8 *buf)
+//############################################################
+{
+ sectorcacheline[(U16)((buf - sectorcache[0]) / BYTE_PER_SEC)].dirty=1;
+}
+
+//############################################################
+/*!\brief Write all changed sectors of the cache
+ * \return 		Nothing
+ *
+ Sectors are written in ascending order, so FAT sectors are on the
+ card before the directory entries pointing to their cluster chains.
+ */
+void FlushSectorCache(void)
+//############################################################
+{
+ U16 i, next;
+
+ do
+  {
+   next=SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS;
+   for(i=0; i<SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS; i++)
+    {
+     if(sectorcacheline[i].lastuse!=0 && sectorcacheline[i].dirty)
+      {
+       if(next==SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS
+          || sectorcacheline[i].sector < sectorcacheline[next].sector) next=i;
+      }
+    }
+
+   if(next<SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS)
+    {
+     WriteFATSector(sectorcacheline[next].sector,sectorcache[next]);
+     SectorCacheWrites++;
+     sectorcacheline[next].dirty=0;
+    }
+  }while(next<SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS);
+}
+
+//############################################################
+/*!\brief Remove a sector from the cache without writing it
+ * \param		sector	Sector number
+ * \return 		Nothing
+ *
+ Call this before a cached sector is written without the cache.
+ */
+void DropCachedSector(U32 sector)
+//############################################################
+{
+ U16 first, i;
+
+ first=(U16)(sector & (SECTOR_CACHE_SETS-1)) * SECTOR_CACHE_WAYS;
+ for(i=first; i<first+SECTOR_CACHE_WAYS; i++)
+  {
+   if(sectorcacheline[i].sector==sector) sectorcacheline[i].lastuse=0;
+  }
+}
+#endif //DOS_WRITE
+
+//############################################################
+/*!\brief Forget all cached sectors, changed sectors are lost
+ * \return 		Nothing
+ */
+void ResetSectorCache(void)
+//############################################################
+{
+ U16 i;
+
+ for(i=0; i<SECTOR_CACHE_SETS * SECTOR_CACHE_WAYS; i++)
+  {
+   sectorcacheline[i].lastuse=0;
+   sectorcacheline[i].dirty=0;
+  }
+ fatbuf=NULL;
+}
+
+//############################################################
+/*!\brief Get the FAT sector into fatbuf
+ * \param		newsector Actual sector number
+ * \return 		Nothing
+ */
+void UpdateFATBuffer(U32 newsector)
+//############################################################
+{
+ fatbuf=GetCachedSector(newsector);
 }
 #endif
 
@@ -347,6 +487,29 @@ void UpdateFATBuffer(U32 newsector)
 #endif //DOS_WRITE
 
 #ifdef DOS_WRITE
+//############################################################
+/*!\brief Write a sector, sectors of the first FAT go to every FAT
+ * \param		sector	Sector number
+ * \param		buf	Sector data
+ * \return 		Nothing
+ *
+ Only the first FAT is read. The other copies get the same sectors, so a
+ checker like fsck.fat does not find differing FATs. Other sectors are
+ written once.
+ */
+void WriteFATSector(U32 sector, U8 *buf)
+//############################################################
+{
+ U8 i;
+
+ WriteSector(sector,buf);
+
+ if(sector>=FATFirstSector && sector<FATFirstSector+FATSectors)
+  {
+   for(i=1; i<FATCopies; i++) WriteSector(sector + i*FATSectors,buf);
+  }
+}
+
 //############################################################
 /*!\brief Insert a new cluster number into cluster chain
  * \param		cluster	Actual cluster number
@@ -420,11 +583,11 @@ void UpdateFATBuffer(U32 newsector)
        else *p=lo;
         
 #ifdef USE_FATBUFFER
-       FATStatus=1; // we have made an entry, so write before next FAT sector read
+       SetCachedSectorDirty(fatbuf); // we have made an entry, write it before the sector leaves the cache
        UpdateFATBuffer(sector+1); //read FAT sector
        p=&fatbuf[0]; //second part of cluster number
 #else //#ifdef USE_FATBUFFER
-       WriteSector(sector,dirbuf);
+       WriteFATSector(sector,dirbuf);
        ReadSector(sector+1,dirbuf ); //read next FAT sector
        p=&dirbuf[0]; //second part of cluster number
 #endif //#ifdef USE_FATBUFFER
@@ -437,9 +600,9 @@ void UpdateFATBuffer(U32 newsector)
         }
 
 #ifdef USE_FATBUFFER
-       FATStatus=1; // we have made an entry, so write before next FAT sector read
+       SetCachedSectorDirty(fatbuf); // we have made an entry, write it before the sector leaves the cache
 #else //#ifdef USE_FATBUFFER
-       WriteSector(sector+1,dirbuf);
+       WriteFATSector(sector+1,dirbuf);
 #endif //#ifdef USE_FATBUFFER
       }
      else
@@ -464,9 +627,9 @@ void UpdateFATBuffer(U32 newsector)
         } 
 
 #ifdef USE_FATBUFFER
-       FATStatus=1; // we have made an entry, so write before next FAT sector read
+       SetCachedSectorDirty(fatbuf); // we have made an entry, write it before the sector leaves the cache
 #else //#ifdef USE_FATBUFFER
-       WriteSector(sector,dirbuf);
+       WriteFATSector(sector,dirbuf);
 #endif //#ifdef USE_FATBUFFER
       } 
 
@@ -495,9 +658,9 @@ void UpdateFATBuffer(U32 newsector)
      *p   = (U8)(number >> 8);
 
 #ifdef USE_FATBUFFER
-     FATStatus=1; // we have made an entry, so write before next FAT sector read
+     SetCachedSectorDirty(fatbuf); // we have made an entry, write it before the sector leaves the cache
 #else //#ifdef USE_FATBUFFER
-     WriteSector(sector, dirbuf);
+     WriteFATSector(sector, dirbuf);
 #endif //#ifdef USE_FATBUFFER
 
     }// if(FATtype==FAT16)
@@ -530,9 +693,9 @@ void UpdateFATBuffer(U32 newsector)
      *p   = (U8)(number >> 24);
 
 #ifdef USE_FATBUFFER
-     FATStatus=1; // we have made an entry, so write before next FAT sector read
+     SetCachedSectorDirty(fatbuf); // we have made an entry, write it before the sector leaves the cache
 #else //#ifdef USE_FATBUFFER
-     WriteSector(sector, dirbuf);
+     WriteFATSector(sector, dirbuf);
 #endif //#ifdef USE_FATBUFFER
 
     }// if(FATtype==FAT32) 
@@ -576,6 +739,10 @@ U8 GetDriveInformation(void)
  struct BootSec *boot;
  struct FileDesc *fdesc;
  
+#ifdef USE_FATBUFFER
+ ResetSectorCache(); //maybe another card
+#endif
+
  by=IdentifyMedia(); //LaufwerksInformationen holen
  if(by==0)
   {
@@ -652,6 +819,8 @@ U8 GetDriveInformation(void)
    else TotSec = boot->BPB_TotSec32;
    
    FATFirstSector= bootSecOffset + boot->BPB_RsvdSecCnt;
+   FATSectors = FATSz;
+   FATCopies = boot->BPB_NumFATs;
    FirstRootSector = FATFirstSector + (boot->BPB_NumFATs * FATSz);
 
 //Number of data sectors
@@ -738,16 +907,6 @@ U8 GetDriveInformation(void)
  printf("maxcluster %u\n",maxcluster);
 #endif
 
-#endif
-
-#ifdef USE_FATBUFFER
- FATCurrentSector=FATFirstSector;
- ReadSector(FATCurrentSector,fatbuf); //read first FAT sector
-
- #ifdef DOS_WRITE
-  FATStatus=0; // nothing to write til here
- #endif
-
 #endif
 
  return F_OK;
@@ -205,6 +205,12 @@ struct DirEntryBuffer {
 //Prototypes
 extern U8 GetDriveInformation(void);
 extern void UpdateFATBuffer(U32 newsector);
+extern U8 *GetCachedSector(U32 sector);
+extern void SetCachedSectorDirty(U8 *buf);
+extern void FlushSectorCache(void);
+extern void DropCachedSector(U32 sector);
+extern void WriteFATSector(U32 sector, U8 *buf);
+extern void ResetSectorCache(void);
 
 #ifdef USE_FAT32
  extern U32 GetFirstSectorOfCluster(U32 n);
@@ -237,13 +243,17 @@ extern U8 secPerCluster;
  extern U16 BytesPerCluster;
 #endif
 
-extern U8 fatbuf[];   //buffer for FAT sectors
+extern U8 *fatbuf;   //cached FAT sector
 
 //extern U32 FATHits;	// count FAT write cycles. you don't really need this ;)
+extern U32 SectorCacheHits;   // sector found in cache
+extern U32 SectorCacheMisses; // sector read from the card
+extern U32 SectorCacheWrites; // dirty sectors written to the card
+
 extern U32 FATFirstSector;
-extern U32 FATCurrentSector;
+extern U32 FATSectors;
+extern U8 FATCopies;
 extern U8 FATtype;
-extern U8 FATStatus; // only for FAT write buffering
 
 extern U32 FirstRootSector;
 extern U32 FirstDataSector; 
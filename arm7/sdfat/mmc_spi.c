@@ -65,6 +65,7 @@
 #ifdef MMC_CARD_SPI
 
 unsigned char card_capacity; // Standard for MMC/SD or High for SDHC
+unsigned char card_type; // MMC, SD or SDHC card
 U32 maxsect; // last sector on drive
 unsigned char spi_back_byte; // gives back a byte after each SPI_WAIT();
 
@@ -105,6 +106,13 @@ unsigned char MMCCommand(unsigned char command, unsigned long adress)
 	SPI_WRITE(0x95); // Checksum for CMD0 GO_IDLE_STATE and dummy checksum for other commands
 	SPI_WAIT();
 
+	if (command == MMC_STOP_TRANSMISSION)
+	{
+		// Skip the stuff byte, it may still be data of a multi block read
+		SPI_WRITE(DUMMY_WRITE);
+		SPI_WAIT();
+	}
+
 	timeout = 255;
 
 	//wait for response
@@ -128,6 +136,84 @@ unsigned char MMCCommand(unsigned char command, unsigned long adress)
 	return spi_back_byte;
 }
 
+//######################################################
+/*!\brief Shift in one data block
+ * \param		buf	Buffer for BYTE_PER_SEC bytes
+ * \return 		Nothing
+ *
+ * The SSP module has 8 byte FIFOs. Up to 8 bytes are kept in
+ * flight, so the SPI clock runs without gaps between the bytes.
+ */
+static void MMCReceiveBlock(unsigned char *buf)
+//######################################################
+{
+#ifdef USE_SPI1
+	U16 sent = 0;
+	U16 received = 0;
+
+	while (received < BYTE_PER_SEC)
+	{
+		if (sent < BYTE_PER_SEC && (U16)(sent - received) < 8)
+		{
+			SPI_DATA_REGISTER = DUMMY_WRITE;
+			sent++;
+		}
+		if (SPI_STATUS_REGISTER & (1 << RNE))
+		{
+			buf[received++] = SPI_DATA_REGISTER;
+		}
+	}
+#else
+	U16 i = BYTE_PER_SEC;
+
+	while (i)
+	{
+		SPI_WRITE(DUMMY_WRITE);
+		i--;
+		SPI_WAIT();
+		*buf++ = spi_back_byte;
+	}
+#endif
+}
+
+#ifdef DOS_WRITE
+//######################################################
+/*!\brief Shift out one data block, see MMCReceiveBlock()
+ * \param		buf	BYTE_PER_SEC bytes
+ * \return 		Nothing
+ */
+static void MMCSendBlock(unsigned char *buf)
+//######################################################
+{
+#ifdef USE_SPI1
+	U16 sent = 0;
+	U16 received = 0;
+
+	while (received < BYTE_PER_SEC)
+	{
+		if (sent < BYTE_PER_SEC && (U16)(sent - received) < 8)
+		{
+			SPI_DATA_REGISTER = buf[sent++];
+		}
+		if (SPI_STATUS_REGISTER & (1 << RNE))
+		{
+			spi_back_byte = SPI_DATA_REGISTER;
+			received++;
+		}
+	}
+#else
+	U16 i = BYTE_PER_SEC;
+
+	while (i)
+	{
+		SPI_WRITE(*buf++);
+		i--;
+		SPI_WAIT_NO_BACK();
+	}
+#endif
+}
+#endif //DOS_WRITE
+
 //######################################################
 /*!\brief Read a sector from MMC/SD
  * \param		sector	Actual sector number
@@ -137,7 +223,9 @@ unsigned char MMCCommand(unsigned char command, unsigned long adress)
 unsigned char MMCReadSector(unsigned long sector, unsigned char *buf)
 //######################################################
 {
+#ifdef STANDARD_SPI_READ
 	U32 i;
+#endif
 
 	unsigned char by;
 	unsigned long startadr;
@@ -209,32 +297,10 @@ unsigned char MMCReadSector(unsigned long sector, unsigned char *buf)
 
 	//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 #ifdef FAST_SPI_READ
-	// The following code looks very strange !
-	// The idea is not to stop the cpu while SPI module transfers data.
-	// You have some cpu cycles until transmission has finished !
-	// You can use this time to do something like storing your last data
-	// or get your next data out of memory, doing some loop overhead.....
-	// Don't wait for end of transmission until you have done something better ;)
-
-	SPI_WRITE(DUMMY_WRITE); // shift in first byte
-	SPI_WAIT(); // we have to wait for the first byte, but ONLY for the first byte
-	by = spi_back_byte; // get first byte, but store later !
-
-	SPI_WRITE(DUMMY_WRITE); // start shift in next byte
-
-	i = BYTE_PER_SEC - 1;
-	while (i) //execute the loop while transmission is running in background
-	{
-		*buf++ = by; // store last byte in buffer while SPI module shifts in new data
-		i--;
-		SPI_WAIT(); // wait for next byte
-		by = spi_back_byte; // get next byte, but store later !
-		SPI_WRITE(DUMMY_WRITE); // start shift in next byte
-		// do the for() loop overhead at this point while SPI module shifts in new data
-	}
+	// Don't wait for each byte, the SSP FIFO keeps the SPI clock running
+	MMCReceiveBlock(buf);
 
-	// last SPI_WRITE(DUMMY_WRITE); is shifting in crc part1 at this point
-	*buf = by; // store last byte in buffer while SPI module shifts in crc part1
+	SPI_WRITE(DUMMY_WRITE); // shift in crc part1
 	SPI_WAIT();
 	SPI_WRITE(DUMMY_WRITE); // shift in crc part2
 	SPI_WAIT();
@@ -261,7 +327,9 @@ unsigned char MMCReadSector(unsigned long sector, unsigned char *buf)
 unsigned char MMCWriteSector(unsigned long sector, unsigned char *buf)
 //######################################################
 {
+#ifdef STANDARD_SPI_WRITE
 	U32 i;
+#endif
 
 	unsigned char by;
 	unsigned long startadr;
@@ -312,24 +380,9 @@ unsigned char MMCWriteSector(unsigned long sector, unsigned char *buf)
 	//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 #ifdef FAST_SPI_WRITE
 	SPI_WRITE(START_BLOCK_TOKEN); // start block token for next sector
+	SPI_WAIT();
 
-	i = BYTE_PER_SEC;
-	while (i) // execute the loop while transmission is running in background
-	{
-		// do the loop overhead at this point while SPI module shifts out new data
-		by = *buf++; // get next data from memory while SPI module shifts out new data
-		i--;
-#ifdef USE_SPI0
-		SPI_WAIT_NO_BACK(); // wait for end of transmission
-#endif
-
-#ifdef USE_SPI1
-		SPI_WAIT(); // wait for end of transmission
-#endif
-		SPI_WRITE(by); // start shift out next byte
-	}
-
-	SPI_WAIT(); // wait til last byte is written to MMC
+	MMCSendBlock(buf);
 #endif //FAST_SPI_WRITE
 	//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -365,6 +418,186 @@ unsigned char MMCWriteSector(unsigned long sector, unsigned char *buf)
 	return 0;
 }
 #endif //DOS_WRITE
+
+//######################################################
+/*!\brief Read consecutive sectors from MMC/SD with one command (CMD18)
+ * \param		sector	First sector number
+ * \param		buf	Buffer for count * BYTE_PER_SEC bytes
+ * \param		count	Number of sectors
+ * \return 		0 if successfull
+ */
+unsigned char MMCReadSectors(unsigned long sector, unsigned char *buf, U16 count)
+//######################################################
+{
+	unsigned char by;
+	unsigned char result;
+	unsigned long startadr;
+	unsigned char tmpSPSR;
+	U16 timeout;
+
+	if (sector >= maxsect || count > maxsect - sector)
+		return 1; //sectornumber too big
+	if (count == 0)
+		return 0;
+
+	tmpSPSR = SPI_SPEED_REGISTER; // Store last setting
+	SPI_SPEED_REGISTER = SPI_PRESCALER; // Switch to high speed
+
+	startadr = sector; // this is the blockadress for SDHC
+	if (card_capacity == STANDARD_CAPACITY)
+		startadr *= BYTE_PER_SEC; // SD/MMC This will work only up to 4GB
+
+	result = MMCCommand(MMC_READ_MULTI_BLOCK, startadr);
+	if (result != 0)
+	{
+		MMC_CS_ON();
+		SPI_SPEED_REGISTER = tmpSPSR; // Restore old setting
+		return 1;
+	}
+
+	while (count)
+	{
+		// The card sends 0xFF until the block is read from flash
+		timeout = 0xFFFF;
+		do
+		{
+			SPI_WRITE(DUMMY_WRITE);
+			SPI_WAIT();
+			by = spi_back_byte;
+			timeout--;
+		} while (by == DUMMY_WRITE && timeout);
+
+		if (by != START_BLOCK_TOKEN)
+		{
+			result = 1; // error token or no response
+			break;
+		}
+
+		MMCReceiveBlock(buf);
+		buf += BYTE_PER_SEC;
+
+		SPI_WRITE(DUMMY_WRITE); // shift in crc part1
+		SPI_WAIT();
+		SPI_WRITE(DUMMY_WRITE); // shift in crc part2
+		SPI_WAIT();
+		count--;
+	}
+
+	// Stop the card streaming further blocks, also after an error
+	MMCCommand(MMC_STOP_TRANSMISSION, 0);
+	do
+	{
+		SPI_WRITE(DUMMY_WRITE);
+		SPI_WAIT();
+	} while (spi_back_byte == 0x00); // wait til busy is gone
+
+	MMC_CS_ON();
+
+	SPI_SPEED_REGISTER = tmpSPSR; // Restore old setting
+
+	return result;
+}
+
+#ifdef DOS_WRITE
+//######################################################
+/*!\brief Write consecutive sectors to MMC/SD with one command (CMD25)
+ * \param		sector	First sector number
+ * \param		buf	count * BYTE_PER_SEC bytes
+ * \param		count	Number of sectors
+ * \return 		0 if successfull
+ *
+ * SD cards get the number of sectors with ACMD23 first, so they can
+ * erase them in advance. This makes long writes a lot faster on most
+ * cards. MMC cards don't know ACMD23.
+ */
+unsigned char MMCWriteSectors(unsigned long sector, unsigned char *buf, U16 count)
+//######################################################
+{
+	unsigned char result;
+	unsigned long startadr;
+	unsigned char tmpSPSR;
+
+	if (sector >= maxsect || count > maxsect - sector)
+		return 1; //sectornumber too big
+	if (count == 0)
+		return 0;
+
+	tmpSPSR = SPI_SPEED_REGISTER; // Store last speed setting
+	SPI_SPEED_REGISTER = SPI_PRESCALER; // Switch to high speed
+
+	startadr = sector; // this is the blockadress for SDHC
+	if (card_capacity == STANDARD_CAPACITY)
+		startadr *= BYTE_PER_SEC; // SD/MMC This will work only up to 4GB
+
+	if (card_type != MMC_CARD)
+	{
+		// Pre-erase is only a hint, go on without it if the card refuses
+		MMCCommand(SD_CMD55, 0);
+		MMCCommand(SD_ACMD23, count);
+	}
+
+	result = MMCCommand(MMC_WRITE_MULTI_BLOCK, startadr);
+	if (result != 0)
+	{
+		MMC_CS_ON();
+		SPI_SPEED_REGISTER = tmpSPSR; // Restore old speed setting
+		return 1;
+	}
+
+	while (count)
+	{
+		SPI_WRITE(START_MULTI_BLOCK_TOKEN); // start block token for next sector
+		SPI_WAIT();
+
+		MMCSendBlock(buf);
+		buf += BYTE_PER_SEC;
+
+		SPI_WRITE(DUMMY_WRITE); // 16 bit crc follows data
+		SPI_WAIT();
+		SPI_WRITE(DUMMY_WRITE);
+		SPI_WAIT();
+
+		SPI_WRITE(DUMMY_WRITE); // read response
+		SPI_WAIT();
+		if ((spi_back_byte & 0x1F) != 0x05) // data block accepted ?
+		{
+#ifdef MMC_DEBUG_COMMANDS
+			printf("\nWrite error at sector %lu !\n",sector);
+#endif
+			result = 1;
+		}
+
+		do
+		{
+			SPI_WRITE(DUMMY_WRITE);
+			SPI_WAIT();
+		} while (spi_back_byte == 0x00); // wait til busy is gone
+
+		if (result != 0)
+			break;
+		sector++;
+		count--;
+	}
+
+	// The stop token is needed after an error too. The card starts
+	// busy one byte after it.
+	SPI_WRITE(STOP_TRAN_TOKEN);
+	SPI_WAIT();
+	SPI_WRITE(DUMMY_WRITE);
+	SPI_WAIT();
+	do
+	{
+		SPI_WRITE(DUMMY_WRITE);
+		SPI_WAIT();
+	} while (spi_back_byte == 0x00); // wait til busy is gone
+
+	MMC_CS_ON();
+
+	SPI_SPEED_REGISTER = tmpSPSR; // Restore old speed setting
+
+	return result;
+}
+#endif //DOS_WRITE
 //######################################################
 /*!\brief Initialise io pin settings for MMC/SD
  * \return 		Nothing
@@ -409,7 +642,7 @@ void MMC_IO_Init(void)
 unsigned char MMCIdentify(void)
 //######################################################
 {
-	U8 by, card_type;
+	U8 by;
 	U16 i;
 	U16 c_size_mult;
 	U32 c_size; // now has 22 bits
@@ -151,9 +151,12 @@
 #define SD_CMD55		(U8)(0x40 + 55)
 #define SD_CMD58		(U8)(0x40 + 58)
 #define SD_ACMD41		(U8)(0x40 + 41)
+#define SD_ACMD23		(U8)(0x40 + 23) // SET_WR_BLK_ERASE_COUNT, pre-erase for the next CMD25
 
 #define DUMMY_WRITE		(unsigned char)(0xFF)
 #define START_BLOCK_TOKEN	(unsigned char)(0xFE)
+#define START_MULTI_BLOCK_TOKEN	(unsigned char)(0xFC) // data blocks of CMD25
+#define STOP_TRAN_TOKEN		(unsigned char)(0xFD) // ends CMD25
 
 #ifndef BYTE_PER_SEC
  #define BYTE_PER_SEC (U16) 512
@@ -190,16 +193,22 @@
 //prototypes
 extern unsigned char spi_back_byte; // gives back a byte after each SPI_WAIT();
 extern U32 maxsect;           // last sector on drive
+extern unsigned char card_capacity; // STANDARD_CAPACITY: byte addresses, HIGH_CAPACITY: sector addresses
+extern unsigned char card_type; // MMC_CARD, SD_CARD or SDHC_CARD after MMCIdentify()
 
 extern unsigned char MMCCommand(unsigned char command, unsigned long adress);
 extern unsigned char MMCReadSector(unsigned long sector, unsigned char *buf);
 extern unsigned char MMCWriteSector(unsigned long sector, unsigned char *buf);
+extern unsigned char MMCReadSectors(unsigned long sector, unsigned char *buf, U16 count);
+extern unsigned char MMCWriteSectors(unsigned long sector, unsigned char *buf, U16 count);
 extern unsigned char MMCIdentify(void);
 extern void MMC_IO_Init(void);
 extern void GetResponse(U8 *buf, U8 numbytes);
 
 #define ReadSector(a,b) 	MMCReadSector((a),(b))
 #define WriteSector(a,b) 	MMCWriteSector((a),(b))
+#define ReadSectors(a,b,c) 	MMCReadSectors((a),(b),(c))
+#define WriteSectors(a,b,c) 	MMCWriteSectors((a),(b),(c))
 #define IdentifyMedia()		MMCIdentify()
 
 #define mmc_read_sector(a,b)    MMCReadSector((a),(b))
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdint.h>
 //-----------------------------------------------------------------------------
 
 #define BIT(x) (1 << (x)) // Bitwert definieren
@@ -130,11 +131,12 @@ typedef signed short tS16;
 typedef unsigned short U16; // Wertebereich: 0..65535
 typedef unsigned short tU16;
 
-typedef signed long S32; // Wertebereich: -2147483648..2147483647
-typedef signed long tS32;
-typedef unsigned long U32; // Wertebereich: 0..4294967295
-typedef unsigned long tU32;
-typedef unsigned long DWORD;
+// 32 bit also on a 64 bit host, see tools/sdfat-host
+typedef int32_t S32; // Wertebereich: -2147483648..2147483647
+typedef int32_t tS32;
+typedef uint32_t U32; // Wertebereich: 0..4294967295
+typedef uint32_t tU32;
+typedef uint32_t DWORD;
 
 typedef signed long long S64;
 typedef signed long long tS64;
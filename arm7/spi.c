@@ -70,16 +70,19 @@ void spi_transmit(spi_package* package) {
 	int temp;
 	unsigned cpsr;
 
+	cpsr = disableIRQ(); // disable global interrupts
+	SpiDisableRti(); // disable RTI interrupts, the ISR may queue packages too
+	restoreIRQ(cpsr); // restore global interrupts
+
 	temp = (spi_package_buffer_insert_idx + 1) % SPI_PACKAGE_BUFFER_SIZE; // calculate the next queue position
 
 	if (temp == spi_package_buffer_extract_idx) { // check if there is free space in the send queue
+		cpsr = disableIRQ(); // disable global interrupts
+		SpiEnableRti(); // enable RTI interrupts
+		restoreIRQ(cpsr); // restore global interrupts
 		return; // no room
 	}
 
-	cpsr = disableIRQ(); // disable global interrupts
-	SpiDisableRti(); // disable RTI interrupts
-	restoreIRQ(cpsr); // restore global interrupts
-
 	spi_package_buffer[spi_package_buffer_insert_idx] = *package; // add data to queue
 	spi_package_buffer_insert_idx = temp; // increase insert pointer
 
@@ -134,7 +137,7 @@ static inline void spi_transmit_single_package(spi_package* package){
 }
 
 int spi_number_of_packages_in_buffer(void){
-	return((spi_package_buffer_insert_idx-spi_package_buffer_extract_idx) % SPI_PACKAGE_BUFFER_SIZE);
+	return((spi_package_buffer_insert_idx-spi_package_buffer_extract_idx+SPI_PACKAGE_BUFFER_SIZE) % SPI_PACKAGE_BUFFER_SIZE);
 }
 
 int spi_running(void){
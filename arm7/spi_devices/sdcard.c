@@ -0,0 +1,492 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Non-blocking SD card sector writes on the shared SPI bus
+ *
+ *   Write sequence (CMD24): command with the R1 response, then the data
+ *   stream 0xFF 0xFE (start token), 512 data bytes and 2 CRC bytes, sent as
+ *   258 16 bit frames, then the data response token and busy (0x00) until
+ *   the card has programmed the sector. The card is deselected between
+ *   the packages, which SD cards allow as they only shift while selected.
+ *   After the deselect SD cards keep driving MISO until the next clock,
+ *   so every package is followed by one 0xFF byte with the card
+ *   deselected before a sensor package can read MISO.
+ *
+ *   Several sectors are written with CMD25, SD cards get their number
+ *   with ACMD23 (CMD55 first) before. Every block has the start token
+ *   0xFC and is followed by busy, the stop token 0xFD ends the write and
+ *   is followed by busy again.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include "sdcard.h"
+#include "armVIC.h"
+#include "LPC21xx.h"
+#include "conf.h"
+#include "spi.h"
+#include "sys_time.h"
+#include "mmc_spi.h"
+
+/** Frames of the data stream: 0xFF and the start token, the sector, 2 CRC bytes */
+#define SDCARD_DATA_FRAMES ((SDCARD_SECTOR_SIZE + 4) / 2)
+/** Frames of one response poll */
+#define SDCARD_POLL_FRAMES 8
+/** Time after which sdcard_update() sends no further package with polled SPI, in usecs */
+#define SDCARD_UPDATE_TIME 100
+
+static volatile uint8_t sdcard_state;
+static volatile uint8_t sdcard_pending;   ///< A package is queued, its release byte is not out yet
+static volatile uint8_t sdcard_failed;
+static volatile uint8_t sdcard_stopping;  ///< The stop token is sent, busy ends the write
+static volatile uint8_t sdcard_polls;
+static volatile uint16_t sdcard_frame;    ///< Next frame of the data stream
+static volatile uint8_t sdcard_block;     ///< Block being sent
+static volatile uint8_t sdcard_written;   ///< Blocks accepted and programmed
+static volatile uint64_t sdcard_busy_start;
+static const uint8_t* sdcard_bufs[SDCARD_MAX_BLOCKS];
+static uint8_t sdcard_blocks;
+static uint8_t sdcard_command;
+static uint32_t sdcard_argument;
+static uint32_t sdcard_address;
+
+static spi_package sdcard_package;
+static spi_package sdcard_release_package; ///< One byte with the card deselected, it releases MISO
+
+static uint16_t sdcard_saved_cr0;
+static uint16_t sdcard_saved_cr1;
+static uint16_t sdcard_saved_cpsr;
+
+static void sdcard_select(void);
+static void sdcard_unselect(void);
+static void sdcard_on_spi_int(void);
+static void sdcard_on_release(void);
+
+void sdcard_init(void)
+{
+	IO0DIR |= 1 << SDCARD_SPI_SS_PIN; /* pin is output  */
+	MMC_CS_ON(); /* pin idles high */
+
+	sdcard_release_package.data[0] = DUMMY_WRITE;
+	sdcard_release_package.length = 1;
+	sdcard_release_package.bit_mode = SPI_8_BIT_MODE;
+	sdcard_release_package.slave_select = sdcard_unselect;
+	sdcard_release_package.slave_unselect = sdcard_unselect;
+	sdcard_release_package.spi_interrupt_handler = sdcard_on_release;
+}
+
+void sdcard_bus_lock(void)
+{
+	while (spi_running());
+	sdcard_saved_cr0 = SSPCR0;
+	sdcard_saved_cr1 = SSPCR1;
+	sdcard_saved_cpsr = SSPCPSR;
+}
+
+void sdcard_bus_unlock(void)
+{
+	MMC_CS_ON();
+	SSPCR0 = sdcard_saved_cr0;
+	SSPCR1 = sdcard_saved_cr1;
+	SSPCPSR = sdcard_saved_cpsr;
+	// The sdfat functions leave the card driving MISO
+	spi_transmit(&sdcard_release_package);
+}
+
+static void sdcard_select(void)
+{
+	MMC_CS_OFF();
+}
+
+static void sdcard_unselect(void)
+{
+	MMC_CS_ON();
+}
+
+/**
+ * @brief Queue the package the current state needs and the release byte
+ *
+ * spi_transmit() drops a package if the queue is full, the state would
+ * then wait for an interrupt that never comes. The room is checked with
+ * the interrupts off, which also keeps sensor packages of interrupt
+ * handlers out until both packages are in.
+ * @return 0 if the queue had no room, sdcard_update() tries again
+ */
+static uint8_t sdcard_queue(void)
+{
+#ifndef SPI_USE_POLLING
+	unsigned cpsr = disableIRQ();
+	if (spi_number_of_packages_in_buffer() >= SPI_PACKAGE_BUFFER_SIZE - 2)
+	{
+		restoreIRQ(cpsr);
+		return 0;
+	}
+#endif
+
+	sdcard_package.bit_mode = SPI_8_BIT_MODE;
+	sdcard_package.length = SDCARD_POLL_FRAMES;
+
+	if (sdcard_state == SDCARD_COMMAND)
+	{
+		sdcard_package.data[0] = DUMMY_WRITE;
+		sdcard_package.data[1] = sdcard_command;
+		sdcard_package.data[2] = (sdcard_argument >> 24) & 0xFF;
+		sdcard_package.data[3] = (sdcard_argument >> 16) & 0xFF;
+		sdcard_package.data[4] = (sdcard_argument >> 8) & 0xFF;
+		sdcard_package.data[5] = sdcard_argument & 0xFF;
+		// Dummy CRC, then the first byte of the response
+		sdcard_package.data[6] = DUMMY_WRITE;
+		sdcard_package.data[7] = DUMMY_WRITE;
+	}
+	else if (sdcard_state == SDCARD_DATA)
+	{
+		const uint8_t* buf = sdcard_bufs[sdcard_block];
+		uint16_t frame = sdcard_frame;
+		sdcard_package.bit_mode = SPI_16_BIT_MODE;
+		sdcard_package.length = 0;
+		while (sdcard_package.length < 8 && frame < SDCARD_DATA_FRAMES)
+		{
+			uint16_t value;
+			if (frame == 0)
+			{
+				value = (DUMMY_WRITE << 8) | ((sdcard_blocks > 1) ? START_MULTI_BLOCK_TOKEN : START_BLOCK_TOKEN);
+			}
+			else if (frame == SDCARD_DATA_FRAMES - 1)
+			{
+				// CRC, ignored in SPI mode
+				value = 0xFFFF;
+			}
+			else
+			{
+				const uint8_t* p = &buf[(frame - 1) * 2];
+				value = (p[0] << 8) | p[1];
+			}
+			sdcard_package.data[sdcard_package.length++] = value;
+			frame++;
+		}
+	}
+	else
+	{
+		for (uint8_t i = 0; i < SDCARD_POLL_FRAMES; i++)
+		{
+			sdcard_package.data[i] = DUMMY_WRITE;
+		}
+		if (sdcard_state == SDCARD_STOP)
+		{
+			sdcard_package.data[0] = STOP_TRAN_TOKEN;
+		}
+	}
+
+	// Set first, the interrupt handler of the release byte clears it
+	sdcard_pending = 1;
+	spi_transmit(&sdcard_package);
+	spi_transmit(&sdcard_release_package);
+#ifndef SPI_USE_POLLING
+	restoreIRQ(cpsr);
+#endif
+	return 1;
+}
+
+static void sdcard_done(uint8_t failed)
+{
+	sdcard_failed = failed;
+	sdcard_state = SDCARD_IDLE;
+}
+
+static void sdcard_start_command(uint8_t command, uint32_t argument)
+{
+	sdcard_command = command;
+	sdcard_argument = argument;
+	sdcard_state = SDCARD_COMMAND;
+}
+
+/** @brief First byte of a poll that is not 0xFF, or -1 */
+static int8_t sdcard_find_response(const uint8_t* rx, uint8_t length)
+{
+	for (uint8_t i = 0; i < length; i++)
+	{
+		if (rx[i] != DUMMY_WRITE)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+static void sdcard_command_response(uint8_t r1)
+{
+	if (sdcard_command == SD_CMD55)
+	{
+		if (r1 == 0)
+		{
+			sdcard_start_command(SD_ACMD23, sdcard_blocks);
+		}
+		else
+		{
+			sdcard_start_command(MMC_WRITE_MULTI_BLOCK, sdcard_address);
+		}
+	}
+	else if (sdcard_command == SD_ACMD23)
+	{
+		// The pre-erase is only a hint, the write goes on without it
+		sdcard_start_command(MMC_WRITE_MULTI_BLOCK, sdcard_address);
+	}
+	else if (r1 == 0)
+	{
+		sdcard_block = 0;
+		sdcard_frame = 0;
+		sdcard_state = SDCARD_DATA;
+	}
+	else
+	{
+		sdcard_done(1);
+	}
+}
+
+/** @brief A block is programmed or the stop token is done */
+static void sdcard_block_done(void)
+{
+	if (sdcard_stopping)
+	{
+		sdcard_done(sdcard_failed);
+	}
+	else if (++sdcard_written < sdcard_blocks)
+	{
+		sdcard_block++;
+		sdcard_frame = 0;
+		sdcard_state = SDCARD_DATA;
+	}
+	else if (sdcard_blocks > 1)
+	{
+		sdcard_state = SDCARD_STOP;
+	}
+	else
+	{
+		sdcard_done(0);
+	}
+}
+
+static void sdcard_on_spi_int(void)
+{
+	uint8_t rx[8];
+	uint8_t length = sdcard_package.length;
+	int8_t i;
+
+	// Empty the receive FIFO, in 16 bit mode only the length matters
+	for (uint8_t k = 0; k < length; k++)
+	{
+		rx[k] = SSPDR;
+	}
+
+	switch (sdcard_state)
+	{
+	case SDCARD_COMMAND:
+		if (rx[7] == DUMMY_WRITE)
+		{
+			sdcard_polls = 0;
+			sdcard_state = SDCARD_RESPONSE;
+		}
+		else
+		{
+			sdcard_command_response(rx[7]);
+		}
+		break;
+	case SDCARD_RESPONSE:
+		i = sdcard_find_response(rx, length);
+		if (i >= 0)
+		{
+			sdcard_command_response(rx[i]);
+		}
+		else if (++sdcard_polls >= SDCARD_MAX_POLLS)
+		{
+			sdcard_done(1);
+		}
+		break;
+	case SDCARD_DATA:
+		sdcard_frame += length;
+		if (sdcard_frame >= SDCARD_DATA_FRAMES)
+		{
+			sdcard_polls = 0;
+			sdcard_state = SDCARD_DATA_RESPONSE;
+		}
+		break;
+	case SDCARD_DATA_RESPONSE:
+		i = sdcard_find_response(rx, length);
+		if (i >= 0 && (rx[i] & 0x1F) != 0x05)
+		{
+			// Data rejected (CRC or write error), a multiple block
+			// write still needs the stop token
+			sdcard_failed = 1;
+			if (sdcard_blocks > 1)
+			{
+				sdcard_state = SDCARD_STOP;
+			}
+			else
+			{
+				sdcard_done(1);
+			}
+		}
+		else if (i >= 0)
+		{
+			sdcard_busy_start = 0;
+			sdcard_state = SDCARD_BUSY;
+			if (i < length - 1 && rx[length - 1] == DUMMY_WRITE)
+			{
+				// Already programmed
+				sdcard_block_done();
+			}
+		}
+		else if (++sdcard_polls >= SDCARD_MAX_POLLS)
+		{
+			sdcard_done(1);
+		}
+		break;
+	case SDCARD_BUSY:
+		if (rx[length - 1] == DUMMY_WRITE)
+		{
+			sdcard_block_done();
+		}
+		break;
+	case SDCARD_STOP:
+		// Busy starts one byte after the stop token
+		sdcard_stopping = 1;
+		sdcard_busy_start = 0;
+		sdcard_state = SDCARD_BUSY;
+		if (rx[length - 1] == DUMMY_WRITE)
+		{
+			sdcard_block_done();
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/** @brief The release byte is out, the next package of the write may follow */
+static void sdcard_on_release(void)
+{
+	(void) SSPDR;
+	sdcard_pending = 0;
+
+#ifndef SPI_USE_POLLING
+	// Go on right away unless another device waits for the bus, then
+	// sdcard_update() goes on. Busy is only polled from sdcard_update().
+	if (sdcard_state != SDCARD_IDLE && sdcard_state != SDCARD_BUSY
+			&& spi_number_of_packages_in_buffer() == 0)
+	{
+		sdcard_queue();
+	}
+#endif
+}
+
+uint8_t sdcard_write_start(uint32_t sector, const uint8_t* const* bufs, uint8_t count)
+{
+	if (sdcard_state != SDCARD_IDLE || count == 0 || count > SDCARD_MAX_BLOCKS)
+	{
+		return 0;
+	}
+
+	// Byte address for standard capacity cards, sector number for SDHC
+	sdcard_address = (card_capacity == HIGH_CAPACITY) ? sector : sector * SDCARD_SECTOR_SIZE;
+	for (uint8_t i = 0; i < count; i++)
+	{
+		sdcard_bufs[i] = bufs[i];
+	}
+	sdcard_blocks = count;
+	sdcard_written = 0;
+	sdcard_failed = 0;
+	sdcard_stopping = 0;
+	sdcard_package.slave_select = sdcard_select;
+	sdcard_package.slave_unselect = sdcard_unselect;
+	sdcard_package.spi_interrupt_handler = sdcard_on_spi_int;
+
+	if (count == 1)
+	{
+		sdcard_start_command(MMC_WRITE_BLOCK, sdcard_address);
+	}
+	else if (card_type != MMC_CARD)
+	{
+		// ACMD23 first, SD cards erase the blocks in advance
+		sdcard_start_command(SD_CMD55, 0);
+	}
+	else
+	{
+		sdcard_start_command(MMC_WRITE_MULTI_BLOCK, sdcard_address);
+	}
+	return 1;
+}
+
+uint8_t sdcard_busy(void)
+{
+	return sdcard_state != SDCARD_IDLE;
+}
+
+uint8_t sdcard_write_failed(void)
+{
+	return sdcard_failed;
+}
+
+uint8_t sdcard_blocks_written(void)
+{
+	return sdcard_written;
+}
+
+void sdcard_update(void)
+{
+	if (sdcard_state == SDCARD_IDLE || sdcard_pending)
+	{
+		return;
+	}
+
+	uint64_t now = sys_time_clock_get_time_usec();
+	if (sdcard_state == SDCARD_BUSY)
+	{
+		if (sdcard_busy_start == 0)
+		{
+			sdcard_busy_start = now;
+		}
+		else if (now - sdcard_busy_start > SDCARD_WRITE_TIMEOUT)
+		{
+			sdcard_done(1);
+			return;
+		}
+	}
+
+#ifdef SPI_USE_POLLING
+	// Every package is sent right away, keep the bus for a bounded time
+	uint64_t end = now + SDCARD_UPDATE_TIME;
+	do
+	{
+		sdcard_queue();
+	} while (sdcard_state != SDCARD_IDLE && sdcard_state != SDCARD_BUSY
+			&& sys_time_clock_get_time_usec() < end);
+#else
+	// Leave room in the queue for the sensors
+	if (spi_number_of_packages_in_buffer() < SPI_PACKAGE_BUFFER_SIZE - 3)
+	{
+		sdcard_queue();
+	}
+#endif
+}
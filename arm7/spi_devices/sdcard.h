@@ -0,0 +1,119 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Non-blocking SD card sector writes on the shared SPI bus
+ *
+ *   A sector write is cut into spi_packages of at most 8 frames, each
+ *   followed by one byte with the card deselected so the card releases
+ *   MISO. With the interrupt driven SPI they are queued one after the
+ *   other from the SPI interrupt and sensor packages queued in the
+ *   meantime go out in between, so the card holds the bus for one package
+ *   and its release byte at a time (17 bytes, 73 us at the 1.875 MHz the
+ *   sensor packages set). With SPI_USE_POLLING sdcard_update() sends
+ *   packages until 100 usecs have passed, a call takes up to about 180
+ *   usecs in tools/host-tests/sdcard-test. These figures and the MISO
+ *   release come from the host model only, they still have to be
+ *   confirmed on the board (scope on the chip select, MISO and the sensor
+ *   readings during a log).
+ *
+ *   The card has to be identified with the blocking sdfat functions
+ *   (MMCIdentify()) first, see sdcard_bus_lock().
+ *
+ *   @author Lorenz Meier
+ */
+
+#ifndef SDCARD_H_
+#define SDCARD_H_
+
+#include "inttypes.h"
+
+/** Sector size, the only one SD cards support in SPI mode */
+#define SDCARD_SECTOR_SIZE 512
+/** Response polls before a command or data transfer is given up */
+#define SDCARD_MAX_POLLS 8
+/** Time the card may stay busy programming a sector, in usecs */
+#define SDCARD_WRITE_TIMEOUT 500000
+/** Sectors of one write */
+#define SDCARD_MAX_BLOCKS 8
+
+enum
+{
+	SDCARD_IDLE = 0,
+	SDCARD_COMMAND,
+	SDCARD_RESPONSE,
+	SDCARD_DATA,
+	SDCARD_DATA_RESPONSE,
+	SDCARD_BUSY,
+	SDCARD_STOP
+} sdcard_state_id;
+
+/** @brief Configure the chip select pin, the card stays deselected */
+void sdcard_init(void);
+
+/**
+ * @brief Take the SPI bus for the blocking sdfat functions
+ *
+ * Waits until the SPI queue is empty and saves the SSP setup, which the
+ * sdfat functions change. Only call this outside of the main loop slots
+ * that queue sensor packages, e.g. during init.
+ */
+void sdcard_bus_lock(void);
+
+/** @brief Restore the SSP setup for the interrupt driven sensor transfers */
+void sdcard_bus_unlock(void);
+
+/**
+ * @brief Start writing consecutive sectors
+ *
+ * One sector is written with CMD24, more with one CMD25 and ACMD23
+ * pre-erase.
+ *
+ * @param sector first sector number on the card
+ * @param bufs count buffers of SDCARD_SECTOR_SIZE bytes, must stay unchanged until the write is done
+ * @param count sectors, 1 to SDCARD_MAX_BLOCKS
+ * @return 0 if a write is still running
+ */
+uint8_t sdcard_write_start(uint32_t sector, const uint8_t* const* bufs, uint8_t count);
+
+/** @brief 1 while a write is running */
+uint8_t sdcard_busy(void);
+
+/** @brief 1 if the last write failed, valid once sdcard_busy() returned 0 */
+uint8_t sdcard_write_failed(void);
+
+/** @brief Sectors of the last write the card took, also if it failed later */
+uint8_t sdcard_blocks_written(void);
+
+/**
+ * @brief Poll the card while it programs the sector, call from the main loop
+ *
+ * The card is polled with one package per call while it programs the
+ * sector, so the bus is not blocked by the programming time. Also queues
+ * a package again which the SPI interrupt did not queue because other
+ * devices were waiting, or sends the next packages with SPI_USE_POLLING.
+ */
+void sdcard_update(void);
+
+#endif /* SDCARD_H_ */
@@ -38,6 +38,7 @@
 #include "i2c_devices/bmp085.h"
 #include "inttypes.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 #define START_TIMEOUT 0xFFFF;
 
@@ -50,9 +51,24 @@ void timer0_init( void );
 
 uint8_t periodic_state;
 uint32_t number_of_timer_overflow=0;
-int64_t m_clock_offset=0;
 int64_t loop_start_time=0;
 
+/*
+ * The UNIX offset is modelled as offset + skew * (t - ref) and tracked
+ * with a second order loop: each measurement corrects the offset by
+ * SYNC_KP and the skew by SYNC_KI of the prediction error. With
+ * SYNC_KI = SYNC_KP^2 / 4 the loop is critically damped.
+ */
+#define SYNC_KP 0.2f
+#define SYNC_KI 0.01f
+
+static sys_time_sync_t m_sync;
+
+static int64_t sys_time_clock_offset_at(uint64_t local_time)
+{
+	return m_sync.offset + (int64_t)(m_sync.skew * (float)(int64_t)(local_time - m_sync.ref));
+}
+
 void TIMER0_ISR ( void )  {
   ISR_ENTRY();
   //uint8_t buffer[200];	// string buffer for debug messages
@@ -176,7 +192,7 @@ void sys_time_clock_init(void)
 	/* enable match 3 interrupt */
 	T0MCR |= TMCR_MR3_I;
 	T0MR3 = 0;
-	m_clock_offset = 0;
+	m_sync = (sys_time_sync_t){ 0 };
 	number_of_timer_overflow = 0;
 	loop_start_time=0;
 }
@@ -188,22 +204,92 @@ uint64_t sys_time_clock_get_time_usec(void)
 
 void sys_time_clock_set_unix_offset(int64_t offset)
 {
-	m_clock_offset = offset;
+	m_sync.offset = offset;
+	m_sync.ref = sys_time_clock_get_time_usec();
+	m_sync.skew = 0;
+	m_sync.synced = 1;
 }
 
 int64_t sys_time_clock_get_unix_offset(void)
 {
-	return m_clock_offset;
+	return sys_time_clock_offset_at(sys_time_clock_get_time_usec());
+}
+
+void sys_time_clock_sync_update(uint64_t local_time, int64_t offset, uint32_t rtt)
+{
+	if (rtt == 0)
+	{
+		// One-way timestamps carry the unknown link delay, only use them to start
+		if (!m_sync.synced)
+		{
+			m_sync.offset = offset;
+			m_sync.ref = local_time;
+			m_sync.synced = 1;
+			m_sync.steps++;
+		}
+		return;
+	}
+
+	// Queued or retransmitted exchanges are asymmetric, skip them
+	if (m_sync.rtt_min == 0 || rtt < m_sync.rtt_min)
+	{
+		m_sync.rtt_min = rtt;
+	}
+	if (rtt > 2 * m_sync.rtt_min + SYS_TIME_SYNC_RTT_MARGIN)
+	{
+		m_sync.rejected++;
+		// Let the minimum follow a link that got slower for good
+		m_sync.rtt_min += m_sync.rtt_min / 16 + 1;
+		return;
+	}
+
+	int64_t predicted = sys_time_clock_offset_at(local_time);
+	int64_t error = offset - predicted;
+	uint64_t dt = local_time - m_sync.ref;
+
+	if (!m_sync.synced || llabs(error) > SYS_TIME_SYNC_STEP || dt == 0)
+	{
+		m_sync.offset = offset;
+		m_sync.steps++;
+		error = 0;
+	}
+	else
+	{
+		m_sync.offset = predicted + (int64_t)(SYNC_KP * (float)error);
+		m_sync.skew += SYNC_KI * (float)error / (float)dt;
+		if (m_sync.skew > SYS_TIME_SYNC_SKEW_MAX)
+		{
+			m_sync.skew = SYS_TIME_SYNC_SKEW_MAX;
+		}
+		else if (m_sync.skew < -SYS_TIME_SYNC_SKEW_MAX)
+		{
+			m_sync.skew = -SYS_TIME_SYNC_SKEW_MAX;
+		}
+	}
+
+	m_sync.ref = local_time;
+	m_sync.error = (int32_t) error;
+	m_sync.rtt = rtt;
+	m_sync.last_sync = local_time / 1000;
+	m_sync.accepted++;
+	m_sync.synced = 1;
+}
+
+const sys_time_sync_t* sys_time_clock_get_sync(void)
+{
+	return &m_sync;
 }
 
 uint64_t sys_time_clock_get_unix_time(void)
 {
-	return sys_time_clock_get_time_usec() + m_clock_offset;
+	uint64_t now = sys_time_clock_get_time_usec();
+	return now + sys_time_clock_offset_at(now);
 }
 
 uint64_t sys_time_clock_to_local_time(uint64_t unix_time)
 {
-	return unix_time - m_clock_offset;
+	// The skew term changes by far less than a usec within the offset itself
+	return unix_time - sys_time_clock_offset_at(unix_time - m_sync.offset);
 }
 
 uint64_t sys_time_clock_set_loop_start_time(void)
@@ -214,11 +300,11 @@ uint64_t sys_time_clock_set_loop_start_time(void)
 
 uint64_t sys_time_clock_get_unix_loop_start_time(void)
 {
-	return loop_start_time + m_clock_offset;
+	return loop_start_time + sys_time_clock_offset_at(loop_start_time);
 }
 
 uint32_t sys_time_clock_get_loop_start_time_boot_ms(void)
 {
-	return (loop_start_time + m_clock_offset)/1000;
+	return (loop_start_time + sys_time_clock_offset_at(loop_start_time))/1000;
 }
 
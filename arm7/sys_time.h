@@ -58,12 +58,48 @@ void sys_time_clock_init(void);
 /** @brief Get the local onboard time (since powering on) */
 uint64_t sys_time_clock_get_time_usec(void);
 
-/** @brief Set the offset of the local onboard time to the UNIX epoch in usecs */
+/** @brief Clock synchronization state and quality */
+typedef struct
+{
+	int64_t offset;          ///< UNIX offset in usecs at local time ref
+	uint64_t ref;            ///< Local time the offset was estimated at
+	float skew;              ///< Remote clock rate minus local clock rate, usec/usec
+	int32_t error;           ///< Last offset measurement minus prediction in usecs
+	uint32_t rtt;            ///< Round trip time of the last accepted exchange in usecs
+	uint32_t rtt_min;        ///< Smallest recent round trip time in usecs
+	uint32_t last_sync;      ///< Local time of the last accepted exchange in msecs
+	uint16_t accepted;       ///< Exchanges used by the filter
+	uint16_t rejected;       ///< Exchanges dropped because of a long round trip
+	uint16_t steps;          ///< Offset jumps instead of filter updates
+	uint8_t synced;          ///< 1 once a UNIX offset is known
+} sys_time_sync_t;
+
+/** Two-way exchanges with a round trip above 2 * rtt_min + this are rejected */
+#define SYS_TIME_SYNC_RTT_MARGIN 2000
+/** Offset errors above this are stepped instead of filtered */
+#define SYS_TIME_SYNC_STEP 20000
+/** Largest accepted clock skew (500 ppm) */
+#define SYS_TIME_SYNC_SKEW_MAX 500e-6f
+
+/** @brief Set the offset of the local onboard time to the UNIX epoch in usecs, resets the skew */
 void sys_time_clock_set_unix_offset(int64_t offset);
 
-/** @brief Get the current UNIX time offset in usecs */
+/** @brief Get the current UNIX time offset in usecs, skew corrected */
 int64_t sys_time_clock_get_unix_offset(void);
 
+/**
+ * @brief Feed one offset measurement into the clock synchronization
+ *
+ * @param local_time local time the measurement refers to
+ * @param offset measured remote UNIX time minus local time in usecs
+ * @param rtt round trip time of a two-way exchange in usecs, 0 for a
+ *        one-way timestamp, which is only used until the first sync
+ */
+void sys_time_clock_sync_update(uint64_t local_time, int64_t offset, uint32_t rtt);
+
+/** @brief Get the synchronization state and quality metrics */
+const sys_time_sync_t* sys_time_clock_get_sync(void);
+
 /** @brief Get the current UNIX time in usecs */
 uint64_t sys_time_clock_get_unix_time(void);
 
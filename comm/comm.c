@@ -60,7 +60,20 @@ void comm_send_ch(mavlink_channel_t chan, uint8_t ch)
 
 
 
-uint8_t comm_check_free_space (mavlink_channel_t chan, uint8_t len)
+uint8_t comm_ch_is_mavlink(mavlink_channel_t chan)
+{
+	if (chan == MAVLINK_COMM_0)
+	{
+		return global_data.state.uart0mode == UART_MODE_MAVLINK;
+	}
+	if (chan == MAVLINK_COMM_1)
+	{
+		return global_data.state.uart1mode == UART_MODE_MAVLINK;
+	}
+	return 0;
+}
+
+uint8_t comm_check_free_space (mavlink_channel_t chan, uint16_t len)
 {
     if (chan == MAVLINK_COMM_0)
     {
@@ -8,6 +8,9 @@ extern "C" {
 #include "conf.h"
 #include "mavlink_types.h"
 
+/** Channels with a UART behind them, MAVLINK_COMM_0 is UART0 and MAVLINK_COMM_1 is UART1 */
+#define COMM_NUM_CHANNELS 2
+
 // MAVLink Protocol settings
 mavlink_system_t mavlink_system;
 /*
@@ -60,7 +63,18 @@ extern uint8_t comm_get_ch( mavlink_channel_t chan );
  * @param chan The channel write to
  * @return 1 if space is available, 0 else
  */
-extern uint8_t comm_check_free_space ( mavlink_channel_t chan, uint8_t len );
+extern uint8_t comm_check_free_space ( mavlink_channel_t chan, uint16_t len );
+
+/**
+ * @brief Check if a channel currently carries MAVLink
+ *
+ * A UART in GPS, log or byte forward mode is not a MAVLink link, bytes
+ * sent to it with comm_send_ch() are discarded.
+ *
+ * @param chan The channel to check
+ * @return 1 if the channel is in MAVLink mode, 0 else
+ */
+extern uint8_t comm_ch_is_mavlink ( mavlink_channel_t chan );
 
 //@}}
 
@@ -345,7 +345,7 @@
 #define I2C_READ					1
 
 #define I2C_PACKAGE_BUFFER_SIZE		16
-#define MAX_I2C_PACKAGE_SIZE		32
+#define MAX_I2C_PACKAGE_SIZE		66	///< 64 byte EEPROM page and its 2 address bytes
 #define LPC_I2C_ADR					0x20
 #define I2C_PERMANENT_ERROR_LIMIT	1
 
@@ -13,6 +13,7 @@ extern mavlink_system_t mavlink_system;
 #include "debug.h"
 
 #include "transformation.h"
+#include "quaternion.h"
 #include "i2c_motor_mikrokopter.h"
 #include "pid.h"
 #include "radio_control.h"
@@ -61,18 +62,8 @@ inline void control_quadrotor_attitude()
 	//Calculate setpoints
 
 	//	Control Yaw POSTION before mixing speed!!!
-	//TODO Check signs and -+180 degree
-	float yaw_e = global_data.attitude.z - global_data.yaw_pos_setpoint;
-
-	// don't turn around the wrong side (only works if yaw angle is between +- 180 degree)
-	if (yaw_e > 3.14)
-	{
-		yaw_e -= 2 * 3.14;
-	}
-	if (yaw_e < -3.14)
-	{
-		yaw_e += 2 * 3.14;
-	}
+	// Taken from the attitude matrix, always in +-180 degree so we never turn around the wrong side
+	float yaw_e = dcm_yaw_error(&global_data.attitude_dcm, global_data.yaw_pos_setpoint);
 
 	float yaw_pos_corr = pid_calculate(&yaw_pos_controller,
 			0, yaw_e, global_data.yaw_lowpass,
@@ -98,8 +89,8 @@ inline void control_quadrotor_attitude()
 	}
 
 	//transform attitude setpoint from positioncontroller from navi to body frame on xy_plane
-	navi2body_xy_plane(&global_data.attitude_setpoint_pos,
-			global_data.attitude.z, &global_data.attitude_setpoint_pos_body); //yaw angle= global_data.attitude.z
+	dcm_navi2body_xy_plane(&global_data.attitude_dcm,
+			&global_data.attitude_setpoint_pos, &global_data.attitude_setpoint_pos_body); //yaw of the attitude
 
 	//now everything is in body frame
 	global_data.attitude_setpoint.x
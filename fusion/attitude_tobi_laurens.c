@@ -20,6 +20,7 @@
 #include "conf.h"
 #include "altitude_speed.h"
 #include "transformation.h"
+#include "quaternion.h"
 #include "gps_transformations.h"
 #include "pixhawk/mavlink.h"
 
@@ -29,6 +30,11 @@
 //#define ACCELERATION_HOLD 1.0f
 #define TIME_STEP (1.0f / 200.0f)
 
+// The integrated quaternion is pulled towards the filter attitude every
+// ATTITUDE_Q_CORRECTION_TICKS ticks, a time constant of about 0.25 s
+#define ATTITUDE_Q_CORRECTION_TICKS 10
+#define ATTITUDE_Q_CORRECTION_GAIN 0.2f
+
 kalman_t attitude_tobi_laurens_kal;
 
 void vect_norm(float_vect3 *vect)
@@ -202,6 +208,9 @@ void attitude_tobi_laurens_init(void)
 	kalman_init(&attitude_tobi_laurens_kal, 12, 9, kal_a, kal_c,
 			kal_gain_start, kal_gain, kal_x_apriori, kal_x_aposteriori, 1000);
 
+	// The quaternion is integrated from here on, start level and north
+	quat_identity(&global_data.attitude_q);
+	quat_to_dcm(&global_data.attitude_q, &global_data.attitude_dcm);
 }
 
 void attitude_tobi_laurens(void)
@@ -493,6 +502,20 @@ void attitude_tobi_laurens(void)
 		global_data.attitude.z = global_data.attitude.z*0.9f+0.1f*atan2f(y_n_b.x, x_n_b.x);
 	}
 
+	// Integrate the bias free rates every tick, the gravity and magnetic
+	// vector attitude above only removes the drift at a lower rate
+	quat_integrate(&global_data.attitude_q, &kal_w, TIME_STEP);
+	static uint8_t attitude_q_ticks = 0;
+	if (++attitude_q_ticks >= ATTITUDE_Q_CORRECTION_TICKS)
+	{
+		float_quat q_filter;
+		quat_from_euler(&global_data.attitude, &q_filter);
+		quat_nlerp(&global_data.attitude_q, &q_filter, ATTITUDE_Q_CORRECTION_GAIN);
+		attitude_q_ticks = 0;
+	}
+	// Publish the attitude once per tick, consumers rotate with the matrix
+	quat_to_dcm(&global_data.attitude_q, &global_data.attitude_dcm);
+
 	//save rates
 	global_data.attitude_rate.x = kal_w.x;
 	global_data.attitude_rate.y = kal_w.y;
@@ -32,81 +32,44 @@ void kalman_predict(kalman_t *kalman)
 
 void kalman_correct(kalman_t *kalman, m_elem measurement_a[], m_elem mask_a[])
 {
-	//create matrices from inputs
-	matrix_t measurement =
-			matrix_create(kalman->measurements, 1, measurement_a);
-	matrix_t mask = matrix_create(kalman->measurements, 1, mask_a);
-
-	//create temporary matrices
-	m_elem gain_start_part_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS] =
-	{ };
-	matrix_t gain_start_part = matrix_create(kalman->states,
-			kalman->measurements, gain_start_part_a);
-
-	m_elem gain_part_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS] =
-	{ };
-	matrix_t gain_part = matrix_create(kalman->states, kalman->measurements,
-			gain_part_a);
-
-	m_elem gain_sum_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS] =
-	{ };
-	matrix_t gain_sum = matrix_create(kalman->states, kalman->measurements,
-			gain_sum_a);
-
-	m_elem error_a[KALMAN_MAX_MEASUREMENTS * 1] =
-	{ };
-	matrix_t error = matrix_create(kalman->measurements, 1, error_a);
-
-	m_elem measurement_estimate_a[KALMAN_MAX_MEASUREMENTS * 1] =
-	{ };
-	matrix_t measurement_estimate = matrix_create(kalman->measurements, 1,
-			measurement_estimate_a);
-
-	m_elem x_update_a[KALMAN_MAX_STATES * 1] =
-	{ };
-	matrix_t x_update = matrix_create(kalman->states, 1, x_update_a);
-
-
-
 	//x(:,i+1)=xapriori+(gainfactor*[M_50(:,1) M(:,2)]+(1-gainfactor)*M_start)*(z-C*xapriori);
 
-
-	//est=C*xapriori;
-	matrix_mult(kalman->c, kalman->x_apriori, measurement_estimate);
-	//error=(z-C*xapriori) = measurement-estimate
-	matrix_sub(measurement, measurement_estimate, error);
-	matrix_mult_element(error, mask, error);
-
 	kalman->gainfactor = kalman->gainfactor * (1.0f - 1.0f
 			/ kalman->gainfactorsteps) + 1.0f * 1.0f / kalman->gainfactorsteps;
 
-
-
-	matrix_mult_scalar(kalman->gainfactor, kalman->gain, gain_part);
-
-	matrix_mult_scalar(1.0f - kalman->gainfactor, kalman->gain_start,
-			gain_start_part);
-
-	matrix_add(gain_start_part, gain_part, gain_sum);
-
-	//gain*(z-C*xapriori)
-	matrix_mult(gain_sum, error, x_update);
-
-	//xaposteriori = xapriori + update
-
-	matrix_add(kalman->x_apriori, x_update, kalman->x_aposteriori);
-
-
-//	static int i=0;
-//	if(i++==4){
-//		i=0;
-//	float_vect3 out_kal;
-//	out_kal.x = M(gain_sum,0,1);
-////	out_kal_z.x = z_measurement[1];
-//	out_kal.y = M(gain_sum,1,1);
-//	out_kal.z = M(gain_sum,2,1);
-//	debug_vect("out_kal", out_kal);
-//	}
+	//error=(z-C*xapriori)*mask, only for the measurements present
+	uint8_t active[KALMAN_MAX_MEASUREMENTS];
+	m_elem error[KALMAN_MAX_MEASUREMENTS];
+	int count = 0;
+	for (int k = 0; k < kalman->measurements; k++)
+	{
+		if (mask_a[k] == 0)
+		{
+			continue;
+		}
+		m_elem estimate = 0;
+		for (int j = 0; j < kalman->states; j++)
+		{
+			estimate += M(kalman->c, k, j) * M(kalman->x_apriori, j, 0);
+		}
+		active[count] = k;
+		error[count] = (measurement_a[k] - estimate) * mask_a[k];
+		count++;
+	}
+
+	//xaposteriori = xapriori + gain*error, one gain column per measurement present.
+	//Rows with mask 0 add exact zeros in the dense product, so the result is the same.
+	for (int i = 0; i < kalman->states; i++)
+	{
+		m_elem update = 0;
+		for (int n = 0; n < count; n++)
+		{
+			int k = active[n];
+			update += ((1.0f - kalman->gainfactor) * M(kalman->gain_start, i, k)
+					+ kalman->gainfactor * M(kalman->gain, i, k)) * error[n];
+		}
+		M(kalman->x_aposteriori, i, 0) = M(kalman->x_apriori, i, 0) + update;
+	}
 }
 
 m_elem kalman_get_state(kalman_t *kalman, int state)
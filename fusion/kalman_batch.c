@@ -0,0 +1,221 @@
+/*
+ * kalman_batch.c
+ *
+ * The correction keeps the order of kalman_correct(): all errors are
+ * computed against the apriori state before any state is changed.
+ */
+
+#include "kalman_batch.h"
+
+void kalman_batch_init(kalman_batch_t *kalman, int states, int measurements,
+		int gainfactorsteps)
+{
+	kalman->states = states;
+	kalman->measurements = measurements;
+	kalman->gainfactorsteps = gainfactorsteps;
+	kalman->gainfactor = 0;
+
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		for (int i = 0; i < KALMAN_BATCH_MAX_STATES; i++)
+		{
+			kalman->x[axis][i] = 0;
+		}
+		for (int i = 0; i < KALMAN_BATCH_MAX_MEASUREMENTS; i++)
+		{
+			kalman->variance[axis][i] = 0;
+		}
+	}
+}
+
+void kalman_batch_set_variance(kalman_batch_t *kalman, int axis,
+		int measurement, m_elem variance)
+{
+	kalman->variance[axis][measurement] = variance;
+}
+
+m_elem kalman_batch_weight(const kalman_batch_t *kalman, int axis,
+		int measurement, m_elem variance)
+{
+	m_elem nominal = kalman->variance[axis][measurement];
+	if (nominal <= 0 || variance <= nominal)
+	{
+		return 1;
+	}
+	return nominal / variance;
+}
+
+void kalman_batch_init_axis(kalman_batch_t *kalman, int axis, const m_elem a[],
+		const m_elem c[], const m_elem gain_start[], const m_elem gain[],
+		const m_elem x[])
+{
+	int n = kalman->states;
+	int m = kalman->measurements;
+
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			kalman->a[axis][i][j] = a[i * n + j];
+		}
+		for (int j = 0; j < m; j++)
+		{
+			kalman->gain_start[axis][i][j] = gain_start[i * m + j];
+			kalman->gain[axis][i][j] = gain[i * m + j];
+		}
+		kalman->x[axis][i] = x[i];
+	}
+	for (int i = 0; i < m; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			kalman->c[axis][i][j] = c[i * n + j];
+		}
+	}
+}
+
+void kalman_batch_predict(kalman_batch_t *kalman)
+{
+	int n = kalman->states;
+
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		m_elem x_old[KALMAN_BATCH_MAX_STATES];
+		for (int i = 0; i < n; i++)
+		{
+			x_old[i] = kalman->x[axis][i];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			m_elem sum = 0;
+			for (int j = 0; j < n; j++)
+			{
+				sum += kalman->a[axis][i][j] * x_old[j];
+			}
+			kalman->x[axis][i] = sum;
+		}
+	}
+}
+
+/** @brief Masked errors and the mixed gain, shared by the correct functions */
+static void kalman_batch_update(kalman_batch_t *kalman, int axis,
+		m_elem measurement[KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem x[KALMAN_BATCH_MAX_STATES], m_elem dx[KALMAN_BATCH_MAX_STATES])
+{
+	int n = kalman->states;
+	m_elem error[KALMAN_BATCH_MAX_MEASUREMENTS];
+
+	for (int i = 0; i < n; i++)
+	{
+		dx[i] = 0;
+	}
+	for (int k = 0; k < kalman->measurements; k++)
+	{
+		if (mask[k] == 0)
+		{
+			error[k] = 0;
+			continue;
+		}
+		m_elem estimate = 0;
+		for (int j = 0; j < n; j++)
+		{
+			estimate += kalman->c[axis][k][j] * x[j];
+		}
+		error[k] = (measurement[k] - estimate) * mask[k];
+	}
+	for (int k = 0; k < kalman->measurements; k++)
+	{
+		if (error[k] == 0)
+		{
+			continue;
+		}
+		for (int i = 0; i < n; i++)
+		{
+			dx[i] += (kalman->gainfactor * kalman->gain[axis][i][k]
+					+ (1.0f - kalman->gainfactor) * kalman->gain_start[axis][i][k]) * error[k];
+		}
+	}
+}
+
+void kalman_batch_gain_step(kalman_batch_t *kalman)
+{
+	// One gain schedule step per tick, as each axis did in kalman_correct()
+	kalman->gainfactor = kalman->gainfactor * (1.0f - 1.0f
+			/ kalman->gainfactorsteps) + 1.0f * 1.0f / kalman->gainfactorsteps;
+}
+
+void kalman_batch_correct(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS])
+{
+	kalman_batch_gain_step(kalman);
+
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		m_elem dx[KALMAN_BATCH_MAX_STATES];
+		kalman_batch_update(kalman, axis, measurement[axis], mask[axis],
+				kalman->x[axis], dx);
+		for (int i = 0; i < kalman->states; i++)
+		{
+			kalman->x[axis][i] += dx[i];
+		}
+	}
+}
+
+void kalman_batch_correct_scalar(kalman_batch_t *kalman, int axis,
+		int measurement, m_elem value, m_elem variance)
+{
+	int n = kalman->states;
+	m_elem error = value;
+
+	for (int j = 0; j < n; j++)
+	{
+		error -= kalman->c[axis][measurement][j] * kalman->x[axis][j];
+	}
+	error *= kalman_batch_weight(kalman, axis, measurement, variance);
+	for (int i = 0; i < n; i++)
+	{
+		kalman->x[axis][i] += (kalman->gainfactor
+				* kalman->gain[axis][i][measurement] + (1.0f
+				- kalman->gainfactor) * kalman->gain_start[axis][i][measurement])
+				* error;
+	}
+}
+
+void kalman_batch_correction(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem x_past[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES],
+		m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES])
+{
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		kalman_batch_update(kalman, axis, measurement[axis], mask[axis],
+				x_past[axis], dx[axis]);
+	}
+}
+
+void kalman_batch_propagate(kalman_batch_t *kalman,
+		m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES])
+{
+	int n = kalman->states;
+
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		m_elem dx_old[KALMAN_BATCH_MAX_STATES];
+		for (int i = 0; i < n; i++)
+		{
+			dx_old[i] = dx[axis][i];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			m_elem sum = 0;
+			for (int j = 0; j < n; j++)
+			{
+				sum += kalman->a[axis][i][j] * dx_old[j];
+			}
+			dx[axis][i] = sum;
+		}
+	}
+}
@@ -0,0 +1,114 @@
+/*
+ * kalman_batch.h
+ *
+ * Fixed gain Kalman filter for the x, y and z axis at once. The per axis
+ * filters have the same structure, so all axes are kept in one struct of
+ * arrays and updated in one loop instead of three kalman_t calls.
+ */
+
+#ifndef KALMAN_BATCH_H_
+#define KALMAN_BATCH_H_
+
+#include "inttypes.h"
+#include "matrix.h"
+
+#define KALMAN_BATCH_AXES 3
+#define KALMAN_BATCH_MAX_STATES 4
+#define KALMAN_BATCH_MAX_MEASUREMENTS 2
+
+typedef struct
+{
+	int states;
+	int measurements;
+	m_elem a[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES][KALMAN_BATCH_MAX_STATES];
+	m_elem c[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS][KALMAN_BATCH_MAX_STATES];
+	m_elem gain_start[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES][KALMAN_BATCH_MAX_MEASUREMENTS];
+	m_elem gain[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES][KALMAN_BATCH_MAX_MEASUREMENTS];
+	m_elem x[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES]; ///< apriori after predict, aposteriori after correct
+	m_elem variance[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS]; ///< the gains were computed for, 0 if not set
+	float gainfactor;
+	int gainfactorsteps;
+} kalman_batch_t;
+
+void kalman_batch_init(kalman_batch_t *kalman, int states, int measurements,
+		int gainfactorsteps);
+
+/**
+ * @brief Set the model of one axis
+ *
+ * The arrays are row major as for kalman_init() and are copied.
+ */
+void kalman_batch_init_axis(kalman_batch_t *kalman, int axis, const m_elem a[],
+		const m_elem c[], const m_elem gain_start[], const m_elem gain[],
+		const m_elem x[]);
+
+/**
+ * @brief Set the measurement variance the gains of one axis were computed for
+ */
+void kalman_batch_set_variance(kalman_batch_t *kalman, int axis,
+		int measurement, m_elem variance);
+
+/**
+ * @brief Weight of a measurement with the given variance
+ *
+ * The gains are fixed, a measurement noisier than the one they were
+ * computed for is weighted down by nominal / variance. With a larger
+ * variance the optimal gain falls about as 1 / variance. Never above 1,
+ * and 1 if either variance is not set.
+ */
+m_elem kalman_batch_weight(const kalman_batch_t *kalman, int axis,
+		int measurement, m_elem variance);
+
+void kalman_batch_predict(kalman_batch_t *kalman);
+
+/**
+ * @brief Correct all axes
+ *
+ * Same result as kalman_correct() per axis. Measurements with mask 0
+ * are skipped.
+ */
+void kalman_batch_correct(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS]);
+
+/**
+ * @brief Advance the gain schedule by one tick
+ *
+ * Called by kalman_batch_correct(), filters using
+ * kalman_batch_correct_scalar() call it once per tick.
+ */
+void kalman_batch_gain_step(kalman_batch_t *kalman);
+
+/**
+ * @brief Apply one measurement of one axis
+ *
+ * Measurements of a tick are applied one after the other, each against
+ * the state the previous one left. Equal to kalman_batch_correct() when
+ * only one measurement of the axis is present and its variance is the
+ * nominal one or 0.
+ */
+void kalman_batch_correct_scalar(kalman_batch_t *kalman, int axis,
+		int measurement, m_elem value, m_elem variance);
+
+static inline m_elem kalman_batch_get_state(kalman_batch_t *kalman, int axis, int state)
+{
+	return kalman->x[axis][state];
+}
+
+/**
+ * @brief State correction a measurement of a past state causes
+ *
+ * dx = gain * mask * (measurement - C * x_past) per axis with the current
+ * gain, the gain schedule is not advanced.
+ */
+void kalman_batch_correction(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem x_past[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES],
+		m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES]);
+
+/** @brief Propagate a state correction by one time step, dx = A * dx */
+void kalman_batch_propagate(kalman_batch_t *kalman,
+		m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES]);
+
+#endif /* KALMAN_BATCH_H_ */
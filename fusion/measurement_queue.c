@@ -0,0 +1,59 @@
+/*
+ * measurement_queue.c
+ *
+ * Producers and consumer both run in the main loop, the ring needs no
+ * locking.
+ */
+
+#include "measurement_queue.h"
+
+static measurement_t measurement_queue[MEASUREMENT_QUEUE_COUNT];
+static uint8_t measurement_queue_read = 0;
+static uint8_t measurement_queue_write = 0;
+uint32_t measurement_queue_drop_count = 0;
+
+void measurement_queue_init(void)
+{
+	measurement_queue_read = 0;
+	measurement_queue_write = 0;
+	measurement_queue_drop_count = 0;
+}
+
+void measurement_queue_push(uint8_t type, uint64_t time, float x, float y,
+		float z, uint8_t axes, float variance)
+{
+	if ((uint8_t) (measurement_queue_write - measurement_queue_read)
+			>= MEASUREMENT_QUEUE_COUNT)
+	{
+		measurement_queue_read++;
+		measurement_queue_drop_count++;
+	}
+
+	measurement_t* measurement = &measurement_queue[measurement_queue_write
+			% MEASUREMENT_QUEUE_COUNT];
+	measurement->time = time;
+	measurement->value.x = x;
+	measurement->value.y = y;
+	measurement->value.z = z;
+	measurement->type = type;
+	measurement->axes = axes;
+	measurement->variance = variance;
+	measurement_queue_write++;
+}
+
+uint8_t measurement_queue_pop(measurement_t* measurement)
+{
+	if (measurement_queue_read == measurement_queue_write)
+	{
+		return 0;
+	}
+	*measurement = measurement_queue[measurement_queue_read
+			% MEASUREMENT_QUEUE_COUNT];
+	measurement_queue_read++;
+	return 1;
+}
+
+void measurement_queue_flush(void)
+{
+	measurement_queue_read = measurement_queue_write;
+}
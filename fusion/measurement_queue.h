@@ -0,0 +1,75 @@
+/*
+ * measurement_queue.h
+ *
+ * Timestamped measurements from the sensor drivers and the communication
+ * handlers. The active position estimator drains the queue every fusion
+ * tick and applies what arrived, so sources do not set new_data flags
+ * and filters do not poll them.
+ *
+ * Each measurement carries the variance of its source. The filters run
+ * with fixed gains computed for a nominal variance and use it to weight
+ * noisier measurements down, see kalman_batch_weight().
+ */
+
+#ifndef MEASUREMENT_QUEUE_H_
+#define MEASUREMENT_QUEUE_H_
+
+#include "inttypes.h"
+#include "mav_vect.h"
+
+#define MEASUREMENT_QUEUE_COUNT 16    ///< Must be a power of 2
+
+enum MEASUREMENT_TYPE
+{
+	MEASUREMENT_VICON_POSITION = 1,   ///< Vicon position, local frame
+	MEASUREMENT_VISION_POSITION,      ///< Vision position, local frame, delayed
+	MEASUREMENT_GPS_POSITION,         ///< GPS position relative to the local origin, x and y
+	MEASUREMENT_PRESSURE_ALTITUDE     ///< Barometric altitude as z (down)
+};
+
+/* Noise of the sources, variance per axis */
+#define MEASUREMENT_VICON_VARIANCE 1e-6f      ///< m^2
+#define MEASUREMENT_VISION_VARIANCE 4e-4f     ///< m^2
+#define MEASUREMENT_GPS_VARIANCE 9.0f         ///< m^2
+#define MEASUREMENT_PRESSURE_VARIANCE 0.25f   ///< m^2, BMP085
+
+#define MEASUREMENT_AXIS_X 0x01
+#define MEASUREMENT_AXIS_Y 0x02
+#define MEASUREMENT_AXIS_Z 0x04
+#define MEASUREMENT_AXIS_XYZ (MEASUREMENT_AXIS_X | MEASUREMENT_AXIS_Y | MEASUREMENT_AXIS_Z)
+
+typedef struct
+{
+	uint64_t time;                    ///< Local capture time in usecs
+	float_vect3 value;
+	uint8_t type;                     ///< MEASUREMENT_TYPE
+	uint8_t axes;                     ///< MEASUREMENT_AXIS_* bits valid in value
+	float variance;                   ///< Per axis, in unit of value squared
+} measurement_t;
+
+extern uint32_t measurement_queue_drop_count;
+
+void measurement_queue_init(void);
+
+/**
+ * @brief Queue a measurement, the oldest one is dropped if full
+ */
+void measurement_queue_push(uint8_t type, uint64_t time, float x, float y,
+		float z, uint8_t axes, float variance);
+
+/**
+ * @brief Take the oldest measurement
+ * @return 0 if the queue is empty
+ */
+uint8_t measurement_queue_pop(measurement_t* measurement);
+
+/** @brief Drop the measurements no estimator took this tick */
+void measurement_queue_flush(void);
+
+static inline float measurement_axis(const measurement_t* measurement, uint8_t axis)
+{
+	return axis == 0 ? measurement->value.x
+			: (axis == 1 ? measurement->value.y : measurement->value.z);
+}
+
+#endif /* MEASUREMENT_QUEUE_H_ */
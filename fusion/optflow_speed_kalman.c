@@ -9,12 +9,15 @@
 #include "optflow_speed_kalman.h"
 #include "global_data.h"
 #include "kalman.h"
+#include "kalman_batch.h"
+#include "state_history.h"
 #include "altitude_speed.h"
 
 #include "debug.h"
 #include "sensors.h"
 #include "math.h"
 #include "transformation.h"
+#include "quaternion.h"
 //#include "outdoor_position_kalman.h"
 
 //#define VELOCITY_HOLD 0.999f
@@ -32,7 +35,15 @@
 
 float ax, bx, cx;
 float ay, by, cy;
-float vx, vy, pvx, pvy;
+float pvx, pvy;
+
+/*
+ * Velocity estimate, one state per axis, x and y. The gain is computed
+ * every step from pvx and pvy, the batch struct only keeps the state,
+ * model and last gain, so the state history records it with the
+ * position filters.
+ */
+kalman_batch_t optflow_speed_kalman_xy;
 float Qx, Rx;
 float Qy, Ry;
 float scale;
@@ -57,8 +68,17 @@ void optflow_speed_kalman_init(void)
 	cy = 1.0;
 
 	// assumes initial state is 0
-	vx = 0.0;
-	vy = 0.0;
+	m_elem zero = 0;
+	m_elem one = 1;
+	kalman_batch_init(&optflow_speed_kalman_xy, 1, 1, 1);
+	kalman_batch_init_axis(&optflow_speed_kalman_xy, 0, &ax, &cx, &zero, &zero, &zero);
+	kalman_batch_init_axis(&optflow_speed_kalman_xy, 1, &ay, &cy, &zero, &zero, &zero);
+	kalman_batch_init_axis(&optflow_speed_kalman_xy, 2, &one, &zero, &zero, &zero, &zero);
+	// Fully blended in, the gain is always the one of the last step
+	kalman_batch_gain_step(&optflow_speed_kalman_xy);
+	// One step per VEL_KF_TIME_STEP_X, several fusion ticks
+	state_history_register(&optflow_speed_kalman_xy,
+			(uint8_t) (VEL_KF_TIME_STEP_X * 1e6f / STATE_HISTORY_PERIOD + 0.5f));
 
 	// assumes initial error covariance is 0
 	pvx = 0.0;
@@ -255,7 +275,7 @@ void optflow_speed_kalman(void)
 	flowQuad.y = (global_data.optflow.y == global_data.optflow.y) ? global_data.optflow.y + y_comp : 0;
 	flowQuad.z = 0;
 
-	body2navi(&flowQuad, &global_data.attitude, &flowWorld);
+	dcm_body2navi(&global_data.attitude_dcm, &flowQuad, &flowWorld);
 
 	//	turn_xy_plane(&flow, PI, &flowQuadUncorr);
 	//	body2navi(&flowQuadUncorr, &global_data.attitude, &flowWorldUncorr);
@@ -274,7 +294,7 @@ void optflow_speed_kalman(void)
 	// Vx Kalman Filter
 	// prediction
 
-	float vx_ = ax * vx;
+	float vx_ = ax * optflow_speed_kalman_xy.x[0][0];
 	if (global_data.state.fly == FLY_FLYING)
 	{
 		vx_ += bx * (cos(global_data.attitude.z) * global_data.attitude.y + sin(global_data.attitude.z) * global_data.attitude.x);
@@ -290,14 +310,16 @@ void optflow_speed_kalman(void)
 		// update step
 		//float xflow = global_data.optflow.x*global_data.position.z*scale;
 		float xflow = flowWorld.x;//flow_distance * flowWorld.x;
-		vx = vx_ + Kx * (xflow - cx * vx_);
+		optflow_speed_kalman_xy.x[0][0] = vx_ + Kx * (xflow - cx * vx_);
+		optflow_speed_kalman_xy.gain[0][0][0] = Kx;
 		pvx = (1.0 - Kx * cx) * pvx_;
 	}
 	// otherwise take only the prediction
 	else
 	{
 		// Let speed decay to zero if no measurements are available
-		vx = vx_*0.95;
+		optflow_speed_kalman_xy.x[0][0] = vx_*0.95;
+		optflow_speed_kalman_xy.gain[0][0][0] = 0;
 		pvx = pvx_;
 	}
 
@@ -308,7 +330,7 @@ void optflow_speed_kalman(void)
 	//---------------------------------------------------
 	// Vy Kalman Filter
 	// prediction
-	float vy_ = ay * vy;
+	float vy_ = ay * optflow_speed_kalman_xy.x[1][0];
 	if (global_data.state.fly == FLY_FLYING)
 	{
 		vy_ += by * (cos(global_data.attitude.z) * global_data.attitude.y - sin(global_data.attitude.z) * global_data.attitude.x);
@@ -324,14 +346,16 @@ void optflow_speed_kalman(void)
 		// update step
 		//float yflow = global_data.optflow.y*global_data.position.z*scale;
 		float yflow = flowWorld.y;//flow_distance * flowWorld.y;
-		vy = vy_ + Ky * (yflow - cy * vy_);
+		optflow_speed_kalman_xy.x[1][0] = vy_ + Ky * (yflow - cy * vy_);
+		optflow_speed_kalman_xy.gain[1][0][0] = Ky;
 		pvy = (1.0 - Ky * cy) * pvy_;
 	}
 	// otherwise take only the prediction
 	else
 	{
 		// Let speed decay to zero if no measurements are available
-		vy = vy_*0.95;
+		optflow_speed_kalman_xy.x[1][0] = vy_*0.95;
+		optflow_speed_kalman_xy.gain[1][0][0] = 0;
 		pvy = pvy_;
 	}
 
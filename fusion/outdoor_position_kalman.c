@@ -5,23 +5,38 @@
  *      Author: Laurens Mackay
  */
 #include "outdoor_position_kalman.h"
-#include "kalman.h"
+#include "kalman_batch.h"
 
 #include "debug.h"
 #include "sensors.h"
 #include "math.h"
 #include "altitude_speed.h"
 #include "transformation.h"
+#include "quaternion.h"
 #include "gps_transformations.h"
+#include "measurement_queue.h"
+#include "state_history.h"
+#include "sys_time.h"
 
-kalman_t outdoor_position_kalman_x;
-kalman_t outdoor_position_kalman_y;
-kalman_t outdoor_position_kalman_z;
+/*
+ * x, y and z filter
+ *
+ * The gains are the steady state Kalman gains for the GPS, barometer and
+ * accelerometer noise, blended in from gain_start over gainfactorsteps
+ * ticks. The noise of these sensors does not change in flight and the
+ * model is time invariant at the fixed 200 Hz step, so a propagated
+ * covariance would settle to nearly constant gains. Propagating it
+ * onboard would cost three 4x4 matrix products per axis and tick in
+ * soft float. A new sensor or measurement rate needs new gains.
+ */
+kalman_batch_t outdoor_position_kalman_xyz;
 
 static float altitude_local_origin = 0;
 
 void outdoor_position_kalman_init(void)
 {
+	kalman_batch_init(&outdoor_position_kalman_xyz, 4, 2, 1000);
+
 	//X Kalmanfilter
 	//initalize matrices
 #define TIME_STEP_X (1.0f / 200.0f)
@@ -89,23 +104,15 @@ void outdoor_position_kalman_init(void)
 	-0.000311581023720996,	0.999700079925069};
 
 
-	static m_elem kal_x_x_apriori[4*1] =
-	{
-	 0 ,
-	 0 ,
-	 0 ,
-	 0  };
-
-	static m_elem kal_x_x_aposteriori[4*1] =
+	static m_elem kal_x_x[4*1] =
 	{
 	 0 ,
 	 0 ,
 	 0 ,
 	 0 };
 
-	kalman_init(&outdoor_position_kalman_x, 4, 2, kal_x_a, kal_x_c,
-			kal_x_gain_start, kal_x_gain, kal_x_x_apriori, kal_x_x_aposteriori,
-			1000);
+	kalman_batch_init_axis(&outdoor_position_kalman_xyz, 0, kal_x_a, kal_x_c,
+			kal_x_gain_start, kal_x_gain, kal_x_x);
 
 
 
@@ -177,23 +184,15 @@ void outdoor_position_kalman_init(void)
 	-0.000311581023720996,	0.999700079925069};
 
 
-	static m_elem kal_y_x_apriori[4*1] =
-	{
-	 0 ,
-	 0 ,
-	 0 ,
-	 0  };
-
-	static m_elem kal_y_x_aposteriori[4*1] =
+	static m_elem kal_y_x[4*1] =
 	{
 	 0 ,
 	 0 ,
 	 0 ,
 	 0 };
 
-	kalman_init(&outdoor_position_kalman_y, 4, 2, kal_y_a, kal_y_c,
-			kal_y_gain_start, kal_y_gain, kal_y_x_apriori, kal_y_x_aposteriori,
-			1000);
+	kalman_batch_init_axis(&outdoor_position_kalman_xyz, 1, kal_y_a, kal_y_c,
+			kal_y_gain_start, kal_y_gain, kal_y_x);
 
 
 
@@ -227,99 +226,32 @@ void outdoor_position_kalman_init(void)
 	 6.514669086807784e-04, 9.997000796699675e-08 ,
 	 -6.514669086807778e-04, 0.999700079925069  };
 
-	static m_elem kal_z_x_apriori[4*1] =
-	{
-	 0 ,
-	 0 ,
-	 0 ,
-	 -9.81  };
-
-	static m_elem kal_z_x_aposteriori[4*1] =
+	static m_elem kal_z_x[4*1] =
 	{
 	 0 ,
 	 0 ,
 	 0 ,
 	 -9.81 };
 
-	kalman_init(&outdoor_position_kalman_z, 4, 2, kal_z_a, kal_z_c,
-			kal_z_gain_start, kal_z_gain, kal_z_x_apriori, kal_z_x_aposteriori,
-			1000);
+	kalman_batch_init_axis(&outdoor_position_kalman_xyz, 2, kal_z_a, kal_z_c,
+			kal_z_gain_start, kal_z_gain, kal_z_x);
+
+	// Noise the position gains were computed for, GPS in x and y, pressure in z
+	kalman_batch_set_variance(&outdoor_position_kalman_xyz, 0, 0, MEASUREMENT_GPS_VARIANCE);
+	kalman_batch_set_variance(&outdoor_position_kalman_xyz, 1, 0, MEASUREMENT_GPS_VARIANCE);
+	kalman_batch_set_variance(&outdoor_position_kalman_xyz, 2, 0, MEASUREMENT_PRESSURE_VARIANCE);
+
+	// Keep the filter states of the last ticks for delayed GPS fixes
+	state_history_register(&outdoor_position_kalman_xyz, 1);
 }
 
 void outdoor_position_kalman(void)
 {
 	//Transform accelerometer used in all directions
 	float_vect3 acc_nav;
-	body2navi(&global_data.accel_si, &global_data.attitude, &acc_nav);
-
-	//X &Y Kalman Filter
-	kalman_predict(&outdoor_position_kalman_x);
-	kalman_predict(&outdoor_position_kalman_y);
-
-	m_elem x_measurement[2] =
-	{ };
-	m_elem x_mask[2] =
-	{ 0, 1 };//only acceleromenters normaly
-	m_elem y_measurement[2] =
-	{ };
-	m_elem y_mask[2] =
-	{ 0, 1 };//only acceleromenters normaly
-
-//	static int i = 0;
-//	if (i++ == 200)
-//	{
-//		i = 0;
-//		x_measurement[0]=0;
-//		x_mask[0]=1;//simulate GPS position 0  at 1 Hz
-	//	}	static int i = 0;
-	if (global_data.state.gps_ok && global_data.state.gps_new_data)
-	{
-		global_data.state.gps_new_data=0;
-		float_vect3 gps_local;
-		gps_get_local_position(&gps_local);
-		x_measurement[0] = gps_local.x;
-		x_mask[0] = 1;// GPS position at 1 Hz
-		y_measurement[0] = gps_local.y;
-		y_mask[0] = 1;// GPS position at 1 Hz
-	}
-
-
-	x_measurement[1] = acc_nav.x;
-	y_measurement[1] = acc_nav.y;
-
-	//Put measurements into filter
-	kalman_correct(&outdoor_position_kalman_x, x_measurement, x_mask);
-	kalman_correct(&outdoor_position_kalman_y, y_measurement, y_mask);
-
-	//	static int i=2;
-	//	if(i++==4){
-	//		i=0;
-	//debug
-
-//	mavlink_msg_debug_send(global_data.param[PARAM_SEND_DEBUGCHAN], 50,
-//			x_measurement[1]);
-//	float_vect3 out_kal_x;
-//	out_kal_x.x = kalman_get_state(&outdoor_position_kalman_x,0);
-//	out_kal_x.y = kalman_get_state(&outdoor_position_kalman_x,1);
-//	out_kal_x.z = kalman_get_state(&outdoor_position_kalman_x,3);
-//	debug_vect("out_kal_x", out_kal_x);
-
-
-
-
-
-
-
-
-
-	//Altitude Kalman Filter
-	kalman_predict(&outdoor_position_kalman_z);
-
-	m_elem z_measurement[2] =
-	{ };
-	m_elem z_mask[2] =
-	{ 0, 1 };//we normaly only have acceleration an no pressure measurement
+	dcm_body2navi(&global_data.attitude_dcm, &global_data.accel_si, &acc_nav);
 
+	//Altitude
 	//prepare measurement data
 	//measurement #1 pressure => relative altitude
 	static int nopressure = 1;
@@ -335,9 +267,10 @@ void outdoor_position_kalman(void)
 
 		if (global_data.state.pressure_ok)
 		{
+			float altitude = 0;
 			if (altitude_local_origin)
 			{
-				z_measurement[0] = -calc_altitude_pressure(
+				altitude = -calc_altitude_pressure(
 						global_data.pressure_raw) - altitude_local_origin;
 			}
 			else
@@ -345,31 +278,82 @@ void outdoor_position_kalman(void)
 				altitude_set_local_origin();
 			}
 
-			z_mask[0] = 1;//we have a pressure measurement to update
+			//we have a pressure measurement to update
+			measurement_queue_push(MEASUREMENT_PRESSURE_ALTITUDE,
+					sys_time_clock_get_time_usec(), 0, 0, altitude,
+					MEASUREMENT_AXIS_Z, MEASUREMENT_PRESSURE_VARIANCE);
 
 			//debug output
 //						mavlink_msg_debug_send(global_data.param[PARAM_SEND_DEBUGCHAN], 50,
-//								outdoor_position_kalman_z.gainfactor);
+//								outdoor_position_kalman_xyz.gainfactor);
+		}
+	}
+
+	//X, Y & Z Kalman Filter
+	kalman_batch_predict(&outdoor_position_kalman_xyz);
+	kalman_batch_gain_step(&outdoor_position_kalman_xyz);
+
+	//Put measurements into filter, GPS and pressure are measurement 0
+	measurement_t meas;
+	while (measurement_queue_pop(&meas))
+	{
+		if (meas.type != MEASUREMENT_GPS_POSITION
+				&& meas.type != MEASUREMENT_PRESSURE_ALTITUDE)
+		{
+			continue;
+		}
+
+		// Apply it at its capture time if that is still in the state
+		// history, else to the current state
+		int16_t age = state_history_age(meas.time);
+		if (age >= 0)
+		{
+			m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] =
+			{ };
+			m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] =
+			{ };
+			for (uint8_t axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+			{
+				measurement[axis][0] = measurement_axis(&meas, axis);
+				mask[axis][0] = (meas.axes & (1 << axis)) ? kalman_batch_weight(
+						&outdoor_position_kalman_xyz, axis, 0, meas.variance) : 0;
+			}
+			state_history_correct(&outdoor_position_kalman_xyz, measurement, mask, age);
+			continue;
+		}
+		for (uint8_t axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+		{
+			if (meas.axes & (1 << axis))
+			{
+				kalman_batch_correct_scalar(&outdoor_position_kalman_xyz, axis,
+						0, measurement_axis(&meas, axis), meas.variance);
+			}
 		}
 	}
 
-	//measurement #2 acceleration
-	z_measurement[1] = acc_nav.z;
+	//measurement #2 acceleration, every tick
+	kalman_batch_correct_scalar(&outdoor_position_kalman_xyz, 0, 1, acc_nav.x, 0);
+	kalman_batch_correct_scalar(&outdoor_position_kalman_xyz, 1, 1, acc_nav.y, 0);
+	kalman_batch_correct_scalar(&outdoor_position_kalman_xyz, 2, 1, acc_nav.z, 0);
 
-	//Put measurements into filter
-	kalman_correct(&outdoor_position_kalman_z, z_measurement, z_mask);
+	//debug
+//	float_vect3 out_kal_x;
+//	out_kal_x.x = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 0);
+//	out_kal_x.y = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 1);
+//	out_kal_x.z = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 3);
+//	debug_vect("out_kal_x", out_kal_x);
 
 	float_vect3 debug, debugv;
 
 
-	debug.x = kalman_get_state(&outdoor_position_kalman_x, 0);
-	debug.y = kalman_get_state(&outdoor_position_kalman_y, 0);
-	debug.z = kalman_get_state(&outdoor_position_kalman_z, 0);
+	debug.x = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 0);
+	debug.y = kalman_batch_get_state(&outdoor_position_kalman_xyz, 1, 0);
+	debug.z = kalman_batch_get_state(&outdoor_position_kalman_xyz, 2, 0);
 	outdoor_z_position = debug.z;
 
-	debugv.x = kalman_get_state(&outdoor_position_kalman_x, 1);
-	debugv.y = kalman_get_state(&outdoor_position_kalman_y, 1);
-	debugv.z = kalman_get_state(&outdoor_position_kalman_z, 1);
+	debugv.x = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 1);
+	debugv.y = kalman_batch_get_state(&outdoor_position_kalman_xyz, 1, 1);
+	debugv.z = kalman_batch_get_state(&outdoor_position_kalman_xyz, 2, 1);
 
 	static uint8_t i;
 	if (i++ > 20)
@@ -379,13 +363,13 @@ void outdoor_position_kalman(void)
 		debug_vect("outdoot_vel", debugv);
 	}
 	// save outputs
-//	global_data.position.x = kalman_get_state(&outdoor_position_kalman_x,0);
-//	global_data.position.y = kalman_get_state(&outdoor_position_kalman_y,0);
-//	global_data.position.z = kalman_get_state(&outdoor_position_kalman_z,0);
+//	global_data.position.x = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 0);
+//	global_data.position.y = kalman_batch_get_state(&outdoor_position_kalman_xyz, 1, 0);
+//	global_data.position.z = kalman_batch_get_state(&outdoor_position_kalman_xyz, 2, 0);
 //
-//	global_data.velocity.x = kalman_get_state(&outdoor_position_kalman_x,1);
-//	global_data.velocity.y = kalman_get_state(&outdoor_position_kalman_y,1);
-//	global_data.velocity.z = kalman_get_state(&outdoor_position_kalman_z,1);
+//	global_data.velocity.x = kalman_batch_get_state(&outdoor_position_kalman_xyz, 0, 1);
+//	global_data.velocity.y = kalman_batch_get_state(&outdoor_position_kalman_xyz, 1, 1);
+//	global_data.velocity.z = kalman_batch_get_state(&outdoor_position_kalman_xyz, 2, 1);
 
 
 
@@ -0,0 +1,176 @@
+/*
+ * state_history.c
+ *
+ * Entries are written every fusion tick, so the entry of a timestamp is
+ * found with index arithmetic instead of a search.
+ */
+
+#include "state_history.h"
+#include "global_data.h"
+
+typedef struct
+{
+	kalman_batch_t* kalman;
+	uint8_t offset;                   ///< First state of the filter in state_history_t.x
+	uint8_t ticks;                    ///< Fusion ticks per filter step
+} state_history_filter_t;
+
+static state_history_t state_history[STATE_HISTORY_COUNT];
+static state_history_filter_t state_history_filters[STATE_HISTORY_FILTERS];
+static uint8_t state_history_filter_count = 0;
+static uint8_t state_history_states = 0;
+static uint8_t state_history_newest = 0;
+static uint8_t state_history_count = 0;
+
+void state_history_init(void)
+{
+	state_history_filter_count = 0;
+	state_history_states = 0;
+	state_history_newest = 0;
+	state_history_count = 0;
+}
+
+static const state_history_filter_t* state_history_find(const kalman_batch_t *kalman)
+{
+	for (uint8_t i = 0; i < state_history_filter_count; i++)
+	{
+		if (state_history_filters[i].kalman == kalman)
+		{
+			return &state_history_filters[i];
+		}
+	}
+	return 0;
+}
+
+uint8_t state_history_register(kalman_batch_t *kalman, uint8_t ticks)
+{
+	uint8_t n = KALMAN_BATCH_AXES * kalman->states;
+	if (state_history_find(kalman))
+	{
+		return 1;
+	}
+	if (state_history_filter_count >= STATE_HISTORY_FILTERS
+			|| state_history_states + n > STATE_HISTORY_STATES)
+	{
+		return 0;
+	}
+
+	state_history_filter_t* f = &state_history_filters[state_history_filter_count++];
+	f->kalman = kalman;
+	f->offset = state_history_states;
+	f->ticks = ticks ? ticks : 1;
+	state_history_states += n;
+
+	// Older entries have no state of this filter
+	state_history_count = 0;
+	return 1;
+}
+
+void state_history_record(uint64_t time)
+{
+	state_history_newest = (state_history_newest + 1) % STATE_HISTORY_COUNT;
+	if (state_history_count < STATE_HISTORY_COUNT)
+	{
+		state_history_count++;
+	}
+
+	state_history_t* entry = &state_history[state_history_newest];
+	entry->time = (uint32_t) time;
+	entry->ang = global_data.attitude;
+	for (uint8_t i = 0; i < state_history_filter_count; i++)
+	{
+		kalman_batch_t* kalman = state_history_filters[i].kalman;
+		m_elem* x = &entry->x[state_history_filters[i].offset];
+		for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+		{
+			for (int j = 0; j < kalman->states; j++)
+			{
+				*x++ = kalman_batch_get_state(kalman, axis, j);
+			}
+		}
+	}
+}
+
+int16_t state_history_age(uint64_t time)
+{
+	if (state_history_count == 0)
+	{
+		return -1;
+	}
+
+	// Signed, so a time slightly after the newest tick rounds to it
+	int32_t dt = (int32_t) (state_history[state_history_newest].time - (uint32_t) time);
+	if (dt < -STATE_HISTORY_PERIOD / 2)
+	{
+		return -1;
+	}
+
+	int32_t age = (dt + STATE_HISTORY_PERIOD / 2) / STATE_HISTORY_PERIOD;
+	if (age >= state_history_count)
+	{
+		return -1;
+	}
+	return age;
+}
+
+const state_history_t* state_history_get(int16_t age)
+{
+	if (age < 0 || age >= state_history_count)
+	{
+		return 0;
+	}
+	return &state_history[(state_history_newest + STATE_HISTORY_COUNT - age) % STATE_HISTORY_COUNT];
+}
+
+uint8_t state_history_correct(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS], int16_t age)
+{
+	const state_history_filter_t* f = state_history_find(kalman);
+	if (!f || age < 0 || age >= state_history_count)
+	{
+		return 0;
+	}
+
+	int n = kalman->states;
+	m_elem x_past[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES];
+	m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES];
+	uint8_t i = (state_history_newest + STATE_HISTORY_COUNT - age) % STATE_HISTORY_COUNT;
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			x_past[axis][j] = state_history[i].x[f->offset + axis * n + j];
+		}
+	}
+	kalman_batch_correction(kalman, measurement, mask, x_past, dx);
+
+	// Fix the recorded states, so later delayed measurements see the correction
+	for (int16_t k = age; k >= 0; k--)
+	{
+		m_elem* x = &state_history[i].x[f->offset];
+		for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+		{
+			for (int j = 0; j < n; j++)
+			{
+				*x++ += dx[axis][j];
+			}
+		}
+		// The model steps from this entry to the next one once per filter step
+		if (k % f->ticks == 0)
+		{
+			kalman_batch_propagate(kalman, dx);
+		}
+		i = (i + 1) % STATE_HISTORY_COUNT;
+	}
+
+	// The current tick is one step after the newest entry
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			kalman->x[axis][j] += dx[axis][j];
+		}
+	}
+	return 1;
+}
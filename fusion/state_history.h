@@ -0,0 +1,72 @@
+/*
+ * state_history.h
+ *
+ * Ring of the estimator state of the last STATE_HISTORY_COUNT fusion
+ * ticks, shared by all registered position filters. Delayed measurements
+ * (vision, Vicon, GPS) are applied to the state at their capture time
+ * and the correction is propagated to the current state.
+ *
+ * Every entry holds the states of all registered filters packed one
+ * after the other, a filter only takes states * axes values.
+ */
+
+#ifndef STATE_HISTORY_H_
+#define STATE_HISTORY_H_
+
+#include "inttypes.h"
+#include "kalman_batch.h"
+#include "mav_vect.h"
+
+#define STATE_HISTORY_COUNT 40        ///< 200 ms at the 200 Hz fusion rate
+#define STATE_HISTORY_PERIOD 5000     ///< Fusion tick in usecs
+#define STATE_HISTORY_FILTERS 3       ///< Registered filters at most
+#define STATE_HISTORY_STATES 24       ///< Filter states per entry, of all registered filters
+
+typedef struct
+{
+	uint32_t time;                    ///< Local time of the tick in usecs
+	float_vect3 ang;                  ///< global_data.attitude
+	m_elem x[STATE_HISTORY_STATES];   ///< States of the registered filters
+} state_history_t;
+
+/** @brief Forget all entries and registered filters, call before the filters register */
+void state_history_init(void);
+
+/**
+ * @brief Record the state of this filter every tick
+ *
+ * @param kalman the filter, its states and model must be set up
+ * @param ticks fusion ticks per filter step, 1 for a filter run every tick
+ * @return 0 if the filter does not fit into the entries any more
+ */
+uint8_t state_history_register(kalman_batch_t *kalman, uint8_t ticks);
+
+/** @brief Store the state at the end of the fusion tick at local time */
+void state_history_record(uint64_t time);
+
+/**
+ * @brief Number of ticks between local time and the newest entry
+ * @return -1 if the time is not covered by the ring
+ */
+int16_t state_history_age(uint64_t time);
+
+/** @brief Entry age ticks before the newest one, see state_history_age() */
+const state_history_t* state_history_get(int16_t age);
+
+/**
+ * @brief Apply a measurement of the state age ticks ago
+ *
+ * The correction is computed against the recorded state of the filter,
+ * propagated with the filter model through the newer entries and added
+ * to the current state of all axes. Exact as long as no other
+ * measurement arrived in between. For a filter that steps only every few
+ * ticks the model is applied once per step, the capture time is then
+ * matched to within one step.
+ *
+ * @return 0 if the filter is not registered or age is out of range
+ */
+uint8_t state_history_correct(kalman_batch_t *kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS], int16_t age);
+
+#endif /* STATE_HISTORY_H_ */
@@ -5,14 +5,18 @@
  *      Author: Laurens Mackay
  */
 #include "vicon_position_kalman.h"
-#include "kalman.h"
+#include "kalman_batch.h"
 
 #include "debug.h"
 #include "sensors.h"
 #include "math.h"
 #include "altitude_speed.h"
 #include "transformation.h"
+#include "quaternion.h"
 #include "gps_transformations.h"
+#include "state_history.h"
+#include "measurement_queue.h"
+#include "sys_time.h"
 
 //#define ONLY_Z
 
@@ -21,12 +25,13 @@
 #define VELOCITY_HOLD 0.99f
 #define ACCELERATION_HOLD 1.0f
 
-kalman_t vicon_position_kalman_x;
-kalman_t vicon_position_kalman_y;
-kalman_t vicon_position_kalman_z;
+// x, y and z filter
+kalman_batch_t vicon_position_kalman_xyz;
 
 void vicon_position_kalman_init(void)
 {
+	kalman_batch_init(&vicon_position_kalman_xyz, 2, 2, 1000);
+
 #ifndef ONLY_Z
 	//X Kalmanfilter
 	//initalize matrices
@@ -53,19 +58,13 @@ void vicon_position_kalman_init(void)
 			0,	0
 	};
 
-	static m_elem kal_x_x_apriori[2 * 1] =
+	static m_elem kal_x_x[2 * 1] =
 	{
 	 0 ,
 	 0 };
 
-	static m_elem kal_x_x_aposteriori[2 * 1] =
-	{
-	 0 ,
-	 0 };
-
-	kalman_init(&vicon_position_kalman_x, 2, 2, kal_x_a, kal_x_c,
-			kal_x_gain_start, kal_x_gain, kal_x_x_apriori, kal_x_x_aposteriori,
-			1000);
+	kalman_batch_init_axis(&vicon_position_kalman_xyz, 0, kal_x_a, kal_x_c,
+			kal_x_gain_start, kal_x_gain, kal_x_x);
 
 
 
@@ -94,19 +93,13 @@ void vicon_position_kalman_init(void)
 			0.177673118212026,	0.363726574226735,
 			0,	0
 	};
-	static m_elem kal_y_x_apriori[2 * 1] =
+	static m_elem kal_y_x[2 * 1] =
 	{
 	 0 ,
 	 0 };
 
-	static m_elem kal_y_x_aposteriori[2 * 1] =
-	{
-	 0 ,
-	 0 };
-
-	kalman_init(&vicon_position_kalman_y, 2, 2, kal_y_a, kal_y_c,
-			kal_y_gain_start, kal_y_gain, kal_y_x_apriori, kal_y_x_aposteriori,
-			1000);
+	kalman_batch_init_axis(&vicon_position_kalman_xyz, 1, kal_y_a, kal_y_c,
+			kal_y_gain_start, kal_y_gain, kal_y_x);
 
 
 
@@ -147,123 +140,134 @@ void vicon_position_kalman_init(void)
 			0,	0
 	};
 
-	static m_elem kal_z_x_apriori[2 * 1] =
+	static m_elem kal_z_x[2 * 1] =
 	{
 	 0 ,
 	 0 };
 
-	static m_elem kal_z_x_aposteriori[2 * 1] =
+	kalman_batch_init_axis(&vicon_position_kalman_xyz, 2, kal_z_a, kal_z_c,
+			kal_z_gain_start, kal_z_gain, kal_z_x);
+
+	// Noise the gains were computed for, Vicon is measurement 0, vision 1
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
 	{
-	 0 ,
-	 0 };
+		kalman_batch_set_variance(&vicon_position_kalman_xyz, axis, 0, MEASUREMENT_VICON_VARIANCE);
+		kalman_batch_set_variance(&vicon_position_kalman_xyz, axis, 1, MEASUREMENT_VISION_VARIANCE);
+	}
 
-	kalman_init(&vicon_position_kalman_z, 2, 2, kal_z_a, kal_z_c,
-			kal_z_gain_start, kal_z_gain, kal_z_x_apriori, kal_z_x_aposteriori,
-			1000);
+	// Keep the filter states of the last ticks for delayed vision data
+	state_history_register(&vicon_position_kalman_xyz, 1);
 }
 
 void vicon_position_kalman(void)
 {
 	//Transform accelerometer used in all directions
 	float_vect3 acc_nav;
-	body2navi(&global_data.accel_si, &global_data.attitude, &acc_nav);
+	dcm_body2navi(&global_data.attitude_dcm, &global_data.accel_si, &acc_nav);
 
-#ifndef ONLY_Z
-	//X &Y Kalman Filter
-	kalman_predict(&vicon_position_kalman_x);
-	kalman_predict(&vicon_position_kalman_y);
-#endif
-	kalman_predict(&vicon_position_kalman_z);
-
-	m_elem x_measurement[2] =
-	{ };
-	m_elem x_mask[2] =
-	{ 0, 0 };//only acceleromenters normaly
-	m_elem y_measurement[2] =
-	{ };
-	m_elem y_mask[2] =
-	{ 0, 0 };//only acceleromenters normaly
-	m_elem z_measurement[2] =
-	{ };
-	m_elem z_mask[2] =
-	{ 0, 0 };//only acceleromenters normaly
+	//X, Y & Z Kalman Filter
+	kalman_batch_predict(&vicon_position_kalman_xyz);
+	kalman_batch_gain_step(&vicon_position_kalman_xyz);
+
+	// Take the newest Vicon and vision position that arrived since the last tick
+	measurement_t meas, vicon, vision;
+	vicon.type = 0;
+	vision.type = 0;
+	while (measurement_queue_pop(&meas))
+	{
+		if (meas.type == MEASUREMENT_VICON_POSITION)
+		{
+			vicon = meas;
+		}
+		else if (meas.type == MEASUREMENT_VISION_POSITION)
+		{
+			vision = meas;
+		}
+	}
 
 	// Vicon fallback - if vision fails the filter will start using vicon position estimates instead
 	float vision_taken = 0.f;
-	if (global_data.vision_data.new_data || global_data.state.vicon_new_data)
+	measurement_t* use = 0;
+	if (global_data.state.position_estimation_mode == POSITION_ESTIMATION_MODE_VISION_VICON_BACKUP)
 	{
-		if (global_data.state.position_estimation_mode == POSITION_ESTIMATION_MODE_VISION_VICON_BACKUP)
-		{
-			//measure difference:
-			float difference = sqrtf((global_data.vision_data.pos.x	- global_data.vicon_data.x) * (global_data.vision_data.pos.x - global_data.vicon_data.x)
-								   + (global_data.vision_data.pos.y	- global_data.vicon_data.y) * (global_data.vision_data.pos.y - global_data.vicon_data.y)
-								   + (global_data.vision_data.pos.z	- global_data.vicon_data.z) * (global_data.vision_data.pos.z - global_data.vicon_data.z));
+		//measure difference:
+		float difference = sqrtf((global_data.vision_data.pos.x	- global_data.vicon_data.x) * (global_data.vision_data.pos.x - global_data.vicon_data.x)
+							   + (global_data.vision_data.pos.y	- global_data.vicon_data.y) * (global_data.vision_data.pos.y - global_data.vicon_data.y)
+							   + (global_data.vision_data.pos.z	- global_data.vicon_data.z) * (global_data.vision_data.pos.z - global_data.vicon_data.z));
 
-			//use only vision_data if difference to vicon is small or we don't have vicon_data at all
-			if (global_data.state.vision_ok && (difference < global_data.param[PARAM_VICON_TAKEOVER_DISTANCE] || !global_data.state.vicon_ok))
+		//use only vision_data if difference to vicon is small or we don't have vicon_data at all
+		if (global_data.state.vision_ok && (difference < global_data.param[PARAM_VICON_TAKEOVER_DISTANCE] || !global_data.state.vicon_ok))
+		{
+			if (vision.type)
 			{
-				if (global_data.vision_data.new_data)
-				{
-					//vision
-					vision_taken = 1.f;
-					x_measurement[1] = global_data.vision_data.pos.x;
-					x_mask[1] = 1;
-					y_measurement[1] = global_data.vision_data.pos.y;
-					y_mask[1] = 1;
-					z_measurement[1] = global_data.vision_data.pos.z;
-					z_mask[1] = 1;
-				}
-			}
-			else if (global_data.state.vicon_new_data)
-			{ //vicon
-				x_measurement[0] = global_data.vicon_data.x;
-				x_mask[0] = 1;
-				y_measurement[0] = global_data.vicon_data.y;
-				y_mask[0] = 1;
-				z_measurement[0] = global_data.vicon_data.z;
-				z_mask[0] = 1;
+				//vision
+				vision_taken = 1.f;
+				use = &vision;
 			}
 		}
-		else if (global_data.state.position_estimation_mode == POSITION_ESTIMATION_MODE_VICON_ONLY)
-		{
-			if (global_data.state.vicon_new_data)
-			{ //vicon
-				x_measurement[0] = global_data.vicon_data.x;
-				x_mask[0] = 1;
-				y_measurement[0] = global_data.vicon_data.y;
-				y_mask[0] = 1;
-				z_measurement[0] = global_data.vicon_data.z;
-				z_mask[0] = 1;
-			}
+		else if (vicon.type)
+		{ //vicon
+			use = &vicon;
 		}
-
-		// send trigger to filter output delay and status if vision data is used
-		if (global_data.vision_data.new_data)
-		{
-			float vision_delay = (global_data.vision_data.comp_end - global_data.vision_data.time_captured)/1000.f;
-			//debug_vect("IMU", vision_delay);
-			mavlink_msg_debug_vect_send(global_data.param[PARAM_SEND_DEBUGCHAN], "IMU", global_data.vision_data.time_captured, vision_delay, vision_taken, 0.f);
+	}
+	else if (global_data.state.position_estimation_mode == POSITION_ESTIMATION_MODE_VICON_ONLY)
+	{
+		if (vicon.type)
+		{ //vicon
+			use = &vicon;
 		}
+	}
 
-		//data has been used
-		global_data.vision_data.new_data = 0;
-		global_data.state.vicon_new_data = 0;
+	// send trigger to filter output delay and status if vision data is used
+	if (vision.type)
+	{
+		float vision_delay = (global_data.vision_data.comp_end - global_data.vision_data.time_captured)/1000.f;
+		//debug_vect("IMU", vision_delay);
+		mavlink_msg_debug_vect_send(global_data.param[PARAM_SEND_DEBUGCHAN], "IMU", global_data.vision_data.time_captured, vision_delay, vision_taken, 0.f);
 	}
 
-	//Put measurements into filter
+	//Put measurements into filter, vicon is measurement 0, vision 1
+	if (use)
+	{
+		int index = (use == &vision) ? 1 : 0;
 
-#ifndef ONLY_Z
-	kalman_correct(&vicon_position_kalman_x, x_measurement, x_mask);
-	kalman_correct(&vicon_position_kalman_y, y_measurement, y_mask);
-#endif
-	kalman_correct(&vicon_position_kalman_z, z_measurement, z_mask);
+		// Vision arrives after the image processing, apply it at its capture
+		// time if that is still in the state history, else as current
+		int16_t age = index ? state_history_age(use->time) : -1;
+		if (age >= 0)
+		{
+			m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] =
+			{ };
+			m_elem vision_mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] =
+			{ };
+			for (uint8_t axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+			{
+				measurement[axis][1] = measurement_axis(use, axis);
+				vision_mask[axis][1] = (use->axes & (1 << axis)) ? kalman_batch_weight(
+						&vicon_position_kalman_xyz, axis, 1, use->variance) : 0;
+			}
+			state_history_correct(&vicon_position_kalman_xyz, measurement, vision_mask, age);
+		}
+		else
+		{
+			for (uint8_t axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+			{
+				if (use->axes & (1 << axis))
+				{
+					kalman_batch_correct_scalar(&vicon_position_kalman_xyz,
+							axis, index, measurement_axis(use, axis),
+							use->variance);
+				}
+			}
+		}
+	}
 
 #ifndef ONLY_Z
-	global_data.position.x = kalman_get_state(&vicon_position_kalman_x,0);
-	global_data.velocity.x = kalman_get_state(&vicon_position_kalman_x,1);
-	global_data.position.y = kalman_get_state(&vicon_position_kalman_y,0);
-	global_data.velocity.y = kalman_get_state(&vicon_position_kalman_y,1);
+	global_data.position.x = kalman_batch_get_state(&vicon_position_kalman_xyz, 0,0);
+	global_data.velocity.x = kalman_batch_get_state(&vicon_position_kalman_xyz, 0,1);
+	global_data.position.y = kalman_batch_get_state(&vicon_position_kalman_xyz, 1,0);
+	global_data.velocity.y = kalman_batch_get_state(&vicon_position_kalman_xyz, 1,1);
 #endif
-	global_data.position.z = kalman_get_state(&vicon_position_kalman_z,0);
-	global_data.velocity.z = kalman_get_state(&vicon_position_kalman_z,1);
+	global_data.position.z = kalman_batch_get_state(&vicon_position_kalman_xyz, 2,0);
+	global_data.velocity.z = kalman_batch_get_state(&vicon_position_kalman_xyz, 2,1);
 }
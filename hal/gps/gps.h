@@ -33,20 +33,26 @@
 #define GPS_H
 
 #include "stdbool.h"
-//#include "gps_ubx.h"
+#include "gps_ubx.h"
 #include "gps_nmea.h"
 #include "global_data.h"
 
 #define GPS_NB_CHANNELS 16
 
+/* Values of PARAM_GPS_PROTOCOL */
+#define GPS_PROTOCOL_NMEA 0
+#define GPS_PROTOCOL_UBX 1
+
+extern uint8_t gps_protocol; ///< GPS_PROTOCOL_*, set by gps_init()
+
 extern uint8_t gps_mode; /* Receiver status */
 extern uint16_t gps_week;    /* weeks */
 extern uint32_t gps_itow;    /* ms */
 extern int32_t  gps_alt;    /* cm       */
 extern uint16_t gps_gspeed;  /* cm/s     */
-extern int16_t  gps_climb;  /* m/s     */
+extern int16_t  gps_climb;  /* cm/s     */
 extern int16_t  gps_course; /* decideg     */
-extern int32_t gps_utm_east, gps_utm_north; /** cm */
+extern int32_t gps_utm_east, gps_utm_north; /** cm, only set by gps_update_utm() */
 extern uint8_t gps_utm_zone;
 extern int32_t gps_lat, gps_lon; /* 1e7 deg */
 extern uint16_t gps_PDOP;
@@ -70,22 +76,42 @@ static inline uint8_t gps_fix_valid(void)
 
 uint8_t gps_device_mode;
 
-static inline void gps_init(void)
+static inline void gps_configure(void)
 {
-	gps_device_mode = global_data.param[PARAM_GPS_MODE] - (((int32_t)global_data.param[PARAM_GPS_MODE]) / 10);
+	if (gps_protocol == GPS_PROTOCOL_UBX
+			&& global_data.state.uart1mode == UART_MODE_GPS)
+	{
+		gps_ubx_configure();
+	}
 }
 
-static inline void gps_configure(void)
+static inline void gps_init(void)
 {
-
+	gps_device_mode = global_data.param[PARAM_GPS_MODE] - (((int32_t)global_data.param[PARAM_GPS_MODE]) / 10);
+	gps_protocol = global_data.param[PARAM_GPS_PROTOCOL];
+	gps_configure();
 }
 
 /** @brief Read out the contents of a GPS message into the variables */
-extern void gps_msg_parse(void);
+static inline void gps_msg_parse(void)
+{
+	if (gps_protocol == GPS_PROTOCOL_UBX)
+	{
+		parse_ubx_msg();
+	}
+	else
+	{
+		parse_gps_msg();
+	}
+}
 
+/** @brief Parse one byte, returns 1 when gps_msg_parse() has a message */
 static inline uint8_t gps_parse(uint8_t c)
 {
-	//return parse_ubx(c);
+	if (gps_protocol == GPS_PROTOCOL_UBX)
+	{
+		return parse_ubx(c);
+	}
 	return parse_nmea(c);
 }
 
@@ -27,10 +27,10 @@
  *
  * This file is a drop-in replacement for gps_ubx.c
  *
- * TODO: THIS NMEA-PARSER IS NOT WELL TESTED AND INCOMPLETE!!!
  * Status:
- *  Parsing GGA and RMC is complete, GSA and other records are
- *  incomplete.
+ *  Parsing GGA and RMC is complete, GSA only gives the fix mode
+ *  and other records are ignored. Sentences are parsed byte by
+ *  byte into fixed point and only used with a valid checksum.
  */
 
 #include <inttypes.h>
@@ -55,7 +55,7 @@
 #define TRUE 1
 
 #define PI  3.1415926535897932384626433832795029
-#define RadOfDeg(x) (x*PI/180)
+#define RadOfDeg(x) ((x)*PI/180)
 //end workarounds
 
 int32_t gps_lat; // latitude in degrees * 1e-7
@@ -122,14 +122,69 @@ void gps_configure ( void )
 ////////////////////////////////////////////////////////
 //       nmea-parser
 
-
-/**
- * The buffer, we store one nmea-line in
- * for parsing.
+/*
+ * The sentence is parsed while it arrives, one byte per call of
+ * parse_nmea(). Each field is accumulated into an integer with a fixed
+ * number of fraction digits and stored in nmea_fields when the field
+ * ends. Only when the checksum matches, nmea_fields is handed to
+ * parse_gps_msg(), which writes the gps_* variables. No line is buffered
+ * and no floating point is used.
  */
-#define NMEA_MAXLEN 255
-char nmea_msg_buf[NMEA_MAXLEN];
-int nmea_msg_len = 0;
+
+#define NMEA_MAXLEN 100    ///< Longer sentences are dropped, NMEA allows 82 bytes
+#define NMEA_VALUE_MAX 200000000 ///< Larger field values are malformed
+
+/* Sentence types */
+#define NMEA_UNKNOWN 0
+#define NMEA_GGA 1
+#define NMEA_RMC 2
+#define NMEA_GSA 3
+
+/* Field kinds, numbers are given by their fraction digits */
+#define NMEA_NUMBER(frac) (frac)
+#define NMEA_LETTER 0x80   ///< N/S or E/W
+#define NMEA_SKIP 0xFF     ///< Field not used
+
+/* Parser states */
+#define NMEA_WAIT_START 0  ///< Waiting for '$'
+#define NMEA_FIELD 1       ///< In the sentence, between '$' and '*'
+#define NMEA_CHECKSUM_HI 2 ///< First checksum digit after '*'
+#define NMEA_CHECKSUM_LO 3 ///< Second checksum digit
+#define NMEA_LINE_END 4    ///< Valid checksum, waiting for CR or LF
+
+typedef struct
+{
+	int32_t lat;     ///< degrees * 1e7
+	int32_t lon;     ///< degrees * 1e7
+	int32_t alt;     ///< cm
+	uint16_t gspeed; ///< cm/s
+	uint8_t fix;     ///< GGA fix status, 0 = invalid
+	uint8_t numSV;
+	uint8_t mode;    ///< GSA fix mode, 1 = no fix, 2 = 2D, 3 = 3D
+} nmea_fields_t;
+
+static uint8_t nmea_state = NMEA_WAIT_START;
+static uint8_t nmea_type;       ///< Type of the sentence being parsed
+static uint8_t nmea_field;      ///< Index of the current field, 0 is the address
+static uint8_t nmea_len;        ///< Bytes since '$'
+static uint8_t nmea_checksum;   ///< XOR of the bytes between '$' and '*'
+static uint8_t nmea_checksum_received;
+static char nmea_address[5];    ///< Talker and sentence id, e.g. "GPGGA"
+
+static int32_t nmea_value;      ///< Digits of the current field
+static uint8_t nmea_frac;       ///< Fraction digits in nmea_value
+static uint8_t nmea_kind;       ///< Kind of the current field
+static uint8_t nmea_point;      ///< The current field had a '.'
+static uint8_t nmea_negative;   ///< The current field had a '-'
+static uint8_t nmea_digits;     ///< Digits seen in the current field
+static char nmea_char;          ///< Letter of the current field
+
+static nmea_fields_t nmea_fields;     ///< Fields of the sentence being parsed
+static nmea_fields_t nmea_msg_fields; ///< Fields of the last valid sentence
+static uint8_t nmea_msg_type = NMEA_UNKNOWN; ///< Type of nmea_msg_fields
+
+uint16_t gps_nmea_checksum_errors = 0; ///< Sentences dropped for a wrong checksum
+uint16_t gps_nmea_dropped = 0;         ///< Sentences dropped as malformed or too long
 
 int GpsFixValid()
 {
@@ -137,465 +192,370 @@ int GpsFixValid()
 }
 
 /**
- * parse GPGSA-nmea-messages stored in
- * nmea_msg_buf .
+ * @brief Kind of a field. For numbers the fraction digits to keep,
+ * which sets the unit of the value.
  */
-void parse_nmea_GPGSA()
+static uint8_t nmea_field_kind(uint8_t type, uint8_t field)
 {
-	int i = 8; // current position in the message
-	//not used?!? char* endptr; // end of parsed substrings
-
-	// attempt to reject empty packets right away
-	if (nmea_msg_buf[i] == ',' && nmea_msg_buf[i + 1] == ',')
+	switch (type)
 	{
-#ifdef __linux
-		printf("parse_nmea_GPGSA() - skipping empty message\n");
-#endif
-		return;
-	}
-
-	// get auto2D/3D
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: fix
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPGSA() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-
-	// get 2D/3D-fix
-	// set gps_mode=3=3d, 2=2d, 1=no fix or 0
-	gps_mode = atoi(&nmea_msg_buf[i]);
-	if (gps_mode == 1)
-		gps_mode = 0;
-#ifdef __linux
-	printf("parse_nmea_GPGSA() - gps_mode=%i (3=3D)\n", gps_mode);
-#endif
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field:sateline-number-0
-		if (i >= nmea_msg_len)
+	case NMEA_GGA:
+		switch (field)
 		{
-#ifdef __linux
-			printf("parse_nmea_GPGSA() - skipping incomplete message\n");
-#endif
-			return;
+		case 2:
+		case 4:
+			return NMEA_NUMBER(5); // ddmm.mmmmm
+		case 3:
+		case 5:
+			return NMEA_LETTER;
+		case 6:
+		case 7:
+			return NMEA_NUMBER(0);
+		case 9:
+			return NMEA_NUMBER(2); // altitude m -> cm
 		}
-	}
-
-	//not used?!? int satcount = 0;
-
-	// TODO: get sateline-numbers for gps_svinfos
+		break;
+	case NMEA_RMC:
+		if (field == 7)
+			return NMEA_NUMBER(3); // speed in 1/1000 knot
+		break;
+	case NMEA_GSA:
+		if (field == 2)
+			return NMEA_NUMBER(0);
+		break;
+	}
+	return NMEA_SKIP;
 }
 
 /**
- * parse GPRMC NMEA messages stored in
- * nmea_msg_buf. This message contains position
- * and speed information.
+ * @brief Number of fields a sentence needs
+ *
+ * The field after the last one used has to start, so a used field was
+ * not cut short by a '*' that got into the sentence.
  */
-void parse_nmea_GPRMC()
+static uint8_t nmea_fields_needed(uint8_t type)
 {
-	int i = 8; // current position in the message
-	char* endptr; // end of parsed substrings
-
-	// attempt to reject empty packets right away
-	if (nmea_msg_buf[i] == ',' && nmea_msg_buf[i + 1] == ',')
+	switch (type)
 	{
-#ifdef __linux
-		printf("parse_nmea_GPRMC() - skipping empty message\n");
-#endif
-		return;
-	}
-
-	// get time
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: warning
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
+	case NMEA_GGA:
+		return 10;
+	case NMEA_RMC:
+		return 8;
+	case NMEA_GSA:
+		return 3;
+	}
+	return 0;
+}
 
-	// get warning
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: lat
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-	// get lat
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: N/S
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-	// get North/South
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: lon
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-	// get lon
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: E/W
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-	// get eath/west
-	// ignored
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: speed
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
-	// get speed
-	double speed = strtod(&nmea_msg_buf[i], &endptr);
-	gps_gspeed = speed * 1.852 * 100 / (60 * 60);
-#ifdef __linux
-	printf("parse_nmea_GPRMC() - ground-speed=%f knot = %i cm/s\n", speed, gps_gspeed);
-#endif
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: speed
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPRMC() - skipping incomplete message\n");
-#endif
-			return;
-		}
-	}
+/** @brief ddmm.mmmmm * 1e5 to degrees * 1e7 */
+static int32_t nmea_degrees(int32_t ddmm)
+{
+	int32_t degrees = ddmm / 10000000;
+	int32_t minutes = ddmm - degrees * 10000000; // minutes * 1e5
+	// minutes * 1e5 / 60 * 1e2, rounded
+	return degrees * 10000000 + (minutes * 10 + 3) / 6;
+}
 
+/** @brief Start a new field */
+static void nmea_field_start(void)
+{
+	nmea_field++;
+	nmea_value = 0;
+	nmea_frac = 0;
+	nmea_kind = nmea_field_kind(nmea_type, nmea_field);
+	nmea_point = 0;
+	nmea_negative = 0;
+	nmea_digits = 0;
+	nmea_char = 0;
 }
 
 /**
- * parse GPGGA-nmea-messages stored in
- * nmea_msg_buf .
+ * @brief Store the finished field into nmea_fields
+ * @return 0 if the field is malformed
  */
-void parse_nmea_GPGGA()
+static uint8_t nmea_field_end(void)
 {
-	int i = 8; // current position in the message
-	char* endptr; // end of parsed substrings
-	double degrees, minutesfrac;
-
-	// attempt to reject empty packets right away
-	if (nmea_msg_buf[i] == ',' && nmea_msg_buf[i + 1] == ',')
+	if (nmea_field == 0)
 	{
-#ifdef __linux
-		printf("parse_nmea_GPGGA() - skipping empty message\n");
-#endif 
-		return;
-	}
-
-	// get UTC time [hhmmss.sss]
-	// ignored GpsInfo.PosLLA.TimeOfFix.f = strtod(&packet[i], &endptr);
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: latitude
-		if (i >= nmea_msg_len)
+		nmea_type = NMEA_UNKNOWN;
+		// Any talker, e.g. GP or GN
+		if (nmea_len == 6)
 		{
-#ifdef __linux
-			printf("parse_nmea_GPGGA() - skipping incomplete message\n");
-#endif 
-			return;
+			if (nmea_address[2] == 'G' && nmea_address[3] == 'G'
+					&& nmea_address[4] == 'A')
+				nmea_type = NMEA_GGA;
+			else if (nmea_address[2] == 'R' && nmea_address[3] == 'M'
+					&& nmea_address[4] == 'C')
+				nmea_type = NMEA_RMC;
+			else if (nmea_address[2] == 'G' && nmea_address[3] == 'S'
+					&& nmea_address[4] == 'A')
+				nmea_type = NMEA_GSA;
 		}
+		return 1;
 	}
-
-	// get latitude [ddmm.mmmmm]
-	double lat = strtod(&nmea_msg_buf[i], &endptr);
-	// convert to pure degrees [dd.dddd] format
-	minutesfrac = modf(lat / 100, &degrees);
-	lat = degrees + (minutesfrac * 100) / 60;
-	// convert to radians
-	//GpsInfo.PosLLA.lat.f *= (M_PI/180);
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: N/S indicator
-		if (i >= nmea_msg_len)
-		{
-#ifdef __linux
-			printf("parse_nmea_GPGGA() - skipping incomplete message\n");
-#endif 
-			return;
-		}
-	}
-
-	// correct latitute for N/S
-	if (nmea_msg_buf[i] == 'S')
-		lat = -lat;
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: longitude
-		if (i >= nmea_msg_len)
-			return;
-	}
-
-	gps_lat = lat * 1e7; // convert to fixed-point
-#ifdef __linux
-	printf("parse_nmea_GPGGA() - lat=%f gps_lat=%i\n", lat, gps_lat);
-#endif 
-
-	// get longitude [ddmm.mmmmm]
-	double lon = strtod(&nmea_msg_buf[i], &endptr);
-	// convert to pure degrees [dd.dddd] format
-	minutesfrac = modf(lon / 100, &degrees);
-	lon = degrees + (minutesfrac * 100) / 60;
-	// convert to radians
-	//GpsInfo.PosLLA.lon.f *= (M_PI/180);
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: E/W indicator
-		if (i >= nmea_msg_len)
-			return;
-	}
-
-	// correct latitute for E/W
-	if (nmea_msg_buf[i] == 'W')
-		lon = -lon;
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: position fix status
-		if (i >= nmea_msg_len)
-			return;
+	if (nmea_kind == NMEA_SKIP)
+	{
+		return 1;
 	}
-
-	gps_lon = lon * 1e7; // convert to fixed-point
-#ifdef __linux
-	printf("parse_nmea_GPGGA() - lon=%f gps_lon=%i\n", lon, gps_lon);
-#endif 
-
-	latlong_utm_of(RadOfDeg(lat), RadOfDeg(lon), nav_utm_zone0);
-
-	gps_utm_east = latlong_utm_x * 100;
-	gps_utm_north = latlong_utm_y * 100;
-	gps_utm_zone = nav_utm_zone0;
-
-	// position fix status
-	// 0 = Invalid, 1 = Valid SPS, 2 = Valid DGPS, 3 = Valid PPS
-	// check for good position fix
-	if ((nmea_msg_buf[i] != '0') && (nmea_msg_buf[i] != ','))
+	if (nmea_kind == NMEA_LETTER)
 	{
-		gps_pos_available = TRUE;
-#ifdef __linux
-		printf("parse_nmea_GPGGA() - gps_pos_available == true\n");
-#endif 
+		// Empty or a single hemisphere letter
+		if (nmea_char && nmea_char != 'N' && nmea_char != 'S'
+				&& nmea_char != 'E' && nmea_char != 'W')
+			return 0;
 	}
 	else
 	{
-		gps_pos_available = FALSE;
-#ifdef __linux
-		printf("parse_nmea_GPGGA() - gps_pos_available == false\n");
-#endif 
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: satellites used
-		if (i >= nmea_msg_len)
+		// Pad to the fixed point of the field
+		while (nmea_frac < nmea_kind)
 		{
-#ifdef __linux
-			printf("parse_nmea_GPGGA() - skipping incomplete message\n");
-#endif 
-			return;
+			if (nmea_value >= NMEA_VALUE_MAX)
+				return 0;
+			nmea_value *= 10;
+			nmea_frac++;
+		}
+		if (nmea_negative)
+		{
+			nmea_value = -nmea_value;
 		}
 	}
 
-	// get number of satellites used in GPS solution
-	gps_numSV = atoi(&nmea_msg_buf[i]);
-#ifdef __linux
-	printf("parse_nmea_GPGGA() - gps_numSatlitesUsed=%i\n", gps_numSV);
-#endif 
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: HDOP (horizontal dilution of precision)
-		if (i >= nmea_msg_len)
+	switch (nmea_type)
+	{
+	case NMEA_GGA:
+		switch (nmea_field)
 		{
-#ifdef __linux
-			printf("parse_nmea_GPGGA() - skipping incomplete message\n");
-#endif 
-			return;
+		case 2:
+			nmea_fields.lat = nmea_degrees(nmea_value);
+			break;
+		case 3:
+			if (nmea_char == 'S')
+				nmea_fields.lat = -nmea_fields.lat;
+			break;
+		case 4:
+			nmea_fields.lon = nmea_degrees(nmea_value);
+			break;
+		case 5:
+			if (nmea_char == 'W')
+				nmea_fields.lon = -nmea_fields.lon;
+			break;
+		case 6:
+			// 0 = Invalid, 1 = Valid SPS, 2 = Valid DGPS, 3 = Valid PPS
+			nmea_fields.fix = (nmea_digits && nmea_value != 0);
+			break;
+		case 7:
+			nmea_fields.numSV = nmea_value;
+			break;
+		case 9:
+			nmea_fields.alt = nmea_value;
+			break;
 		}
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: altitude
-		if (i >= nmea_msg_len)
+		break;
+	case NMEA_RMC:
+		if (nmea_field == 7)
 		{
-#ifdef __linux
-			printf("parse_nmea_GPGGA() - skipping incomplete message\n");
-#endif 
-			return;
+			// knot = 1852 m/h, 1/1000 knot = 463/9000 cm/s
+			nmea_fields.gspeed = ((int64_t) nmea_value * 463) / 9000;
 		}
+		break;
+	case NMEA_GSA:
+		if (nmea_field == 2)
+		{
+			nmea_fields.mode = nmea_value;
+		}
+		break;
 	}
+	return 1;
+}
 
-	// get altitude (in meters)
-	double alt = strtod(&nmea_msg_buf[i], &endptr);
-	gps_alt = alt * 100; //meter to centimeters !!!
-#ifdef __linux
-	printf("parse_nmea_GPGGA() - gps_alt=%i\n", gps_alt);
-#endif 
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: altitude units, always 'M'
-		if (i >= nmea_msg_len)
-			return;
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: geoid seperation
-		if (i >= nmea_msg_len)
-			return;
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: seperation units
-		if (i >= nmea_msg_len)
-			return;
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: DGPS age
-		if (i >= nmea_msg_len)
-			return;
-	}
-	while (nmea_msg_buf[i++] != ',')
-	{ // next field: DGPS station ID
-		if (i >= nmea_msg_len)
-			return;
-	}
-	//while(nmea_msg_buf[i++] != '*');              // next field: checksum
+static uint8_t nmea_hex(uint8_t c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return 0xFF;
 }
 
 /**
- * parse_ubx() has a complete line.
- * Find out what type of message it is and
- * hand it to the parser for that type.
+ * parse_nmea() has a complete sentence with a valid checksum
+ * in nmea_msg_fields. Write it to the gps variables.
  */
 void parse_gps_msg(void)
 {
-	if (global_data.param[PARAM_GPS_MODE] == 11)
-	{
-		//debug_message_buffer("gps: parse_gps_msg nmea_msg_buf:");
-		static char nmea_msg_buf_tmp[MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN];
-
-		strncpy(nmea_msg_buf_tmp, nmea_msg_buf,
-				MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN);
-		debug_message_buffer(nmea_msg_buf_tmp);
-	}
-	if (nmea_msg_len > 7 && !strncmp(nmea_msg_buf, "GPRMC", 5))
+	switch (nmea_msg_type)
 	{
-		nmea_msg_buf[nmea_msg_len] = 0;
-
+	case NMEA_RMC:
 		if (global_data.param[PARAM_GPS_MODE] == 11)
 		{
 			debug_message_buffer("gps: parsing nmea RMC");
 		}
-#ifdef __linux
-		printf("parse_gps_msg() - parsing RMC gps-message \"%s\"\n",nmea_msg_buf);
-#endif 
-		parse_nmea_GPRMC();
-	}
-	else if (nmea_msg_len > 7 && !strncmp(nmea_msg_buf, "GPGGA", 5))
-	{
-		nmea_msg_buf[nmea_msg_len] = 0;
-
+		gps_gspeed = nmea_msg_fields.gspeed;
+		break;
+	case NMEA_GGA:
 		if (global_data.param[PARAM_GPS_MODE] == 11)
 		{
 			debug_message_buffer("gps: parsing nmea GGA");
 		}
-
-#ifdef __linux
-		printf("parse_gps_msg() - parsing GGA gps-message \"%s\"\n",nmea_msg_buf);
-#endif 
-		parse_nmea_GPGGA();
+		gps_lat = nmea_msg_fields.lat;
+		gps_lon = nmea_msg_fields.lon;
+		gps_pos_available = nmea_msg_fields.fix ? TRUE : FALSE;
+		gps_numSV = nmea_msg_fields.numSV;
+		gps_alt = nmea_msg_fields.alt;
 
 		// Tell the filter that we have a new position.
 		global_data.state.gps_new_data = 1;
-	}
-	else if (nmea_msg_len > 7 && !strncmp(nmea_msg_buf, "GPGSA", 5))
-	{
-		nmea_msg_buf[nmea_msg_len] = 0;
-
+		break;
+	case NMEA_GSA:
 		if (global_data.param[PARAM_GPS_MODE] == 11)
 		{
 			debug_message_buffer("gps: parsing nmea GSA");
 		}
-#ifdef __linux
-		printf("parse_gps_msg() - parsing GSA gps-message \"%s\"\n",nmea_msg_buf);
-#endif 
-		// GPGSA messages contain detailed satellite information
-		parse_nmea_GPGSA();
-	}
-	else
-	{
-		nmea_msg_buf[nmea_msg_len] = 0;
-		//debug_message_buffer("gps: parse_gps_msg ignoring unknown gps-message");
-#ifdef __linux
-		printf("parse_gps_msg() - ignoring unknown gps-message \"%s\" len=%i\n",nmea_msg_buf, nmea_msg_len);
-#endif 
-	}
-
-	// reset message-buffer
-	nmea_msg_len = 0;
+		// set gps_mode=3=3d, 2=2d, 1=no fix or 0
+		gps_mode = nmea_msg_fields.mode;
+		if (gps_mode == 1)
+			gps_mode = 0;
+		// TODO: get sateline-numbers for gps_svinfos
+		break;
+	}
+	nmea_msg_type = NMEA_UNKNOWN;
 }
 
 /**
  * This is the actual parser.
- * It reads one character at a time
- * setting gps_msg_received to TRUE
- * after a full line.
+ * It reads one character at a time and returns 1
+ * at the line end of a GGA, RMC or GSA sentence with a
+ * valid checksum.
  */
 uint8_t parse_nmea(uint8_t c)
 {
-	//reject empty lines
-	if (nmea_msg_len == 0)
+	gps_msg_received = FALSE;
+
+	// Resynchronize on every start of a sentence
+	if (c == '$')
 	{
-		if (c == '\r' || c == '\n' || c == '$')
+		if (nmea_state != NMEA_WAIT_START)
 		{
-			//debug_message_buffer("gps: parse nmea rejected empty line");
-			return 0;//was empty?!?!?
+			gps_nmea_dropped++;
 		}
+		nmea_state = NMEA_FIELD;
+		nmea_type = NMEA_UNKNOWN;
+		nmea_len = 0;
+		nmea_checksum = 0;
+		memset(&nmea_fields, 0, sizeof(nmea_fields));
+		nmea_field = 0xFF;
+		nmea_field_start();
+		return 0;
 	}
 
-	// fill the buffer, unless it's full
-	if (nmea_msg_len < NMEA_MAXLEN - 1)
+	switch (nmea_state)
 	{
-
-		// messages end with a linefeed
-		if (c == '\r' || c == '\n')
+	case NMEA_FIELD:
+		if (c == '*')
 		{
-			gps_msg_received = TRUE;
+			nmea_state = nmea_field_end() ? NMEA_CHECKSUM_HI : NMEA_WAIT_START;
+		}
+		else if (c < ' ' || c > '~' || ++nmea_len > NMEA_MAXLEN)
+		{
+			// Line end without checksum, binary data or runaway line
+			nmea_state = NMEA_WAIT_START;
 		}
 		else
 		{
-			nmea_msg_buf[nmea_msg_len] = c;
-			nmea_msg_len++;
-			gps_msg_received=0;
+			nmea_checksum ^= c;
+			if (c == ',')
+			{
+				if (!nmea_field_end())
+					nmea_state = NMEA_WAIT_START;
+				nmea_field_start();
+			}
+			else if (nmea_field == 0)
+			{
+				if (nmea_len <= sizeof(nmea_address))
+					nmea_address[nmea_len - 1] = c;
+			}
+			else if (nmea_kind == NMEA_LETTER)
+			{
+				if (nmea_char)
+					nmea_state = NMEA_WAIT_START;
+				nmea_char = c;
+			}
+			else if (nmea_kind != NMEA_SKIP)
+			{
+				// The checksum is weak, so reject what cannot be a number
+				if (c >= '0' && c <= '9' && nmea_value < NMEA_VALUE_MAX)
+				{
+					if (!nmea_point || nmea_frac < nmea_kind)
+					{
+						nmea_value = nmea_value * 10 + (c - '0');
+						if (nmea_point)
+							nmea_frac++;
+					}
+					nmea_digits++;
+				}
+				else if (c == '.' && !nmea_point)
+				{
+					nmea_point = 1;
+				}
+				else if (c == '-' && !nmea_negative && !nmea_digits)
+				{
+					nmea_negative = 1;
+				}
+				else
+				{
+					nmea_state = NMEA_WAIT_START;
+				}
+			}
+		}
+		if (nmea_state == NMEA_WAIT_START)
+		{
+			gps_nmea_dropped++;
+		}
+		break;
+	case NMEA_CHECKSUM_HI:
+		nmea_checksum_received = nmea_hex(c) << 4;
+		nmea_state = NMEA_CHECKSUM_LO;
+		if (nmea_hex(c) > 15)
+		{
+			gps_nmea_dropped++;
+			nmea_state = NMEA_WAIT_START;
+		}
+		break;
+	case NMEA_CHECKSUM_LO:
+		nmea_state = NMEA_WAIT_START;
+		if (nmea_hex(c) > 15)
+		{
+			gps_nmea_dropped++;
+		}
+		else if ((nmea_checksum_received | nmea_hex(c)) != nmea_checksum)
+		{
+			gps_nmea_checksum_errors++;
 		}
+		else if (nmea_type != NMEA_UNKNOWN)
+		{
+			nmea_state = NMEA_LINE_END;
+		}
+		break;
+	case NMEA_LINE_END:
+		nmea_state = NMEA_WAIT_START;
+		// A '*' inside the sentence can be followed by a matching
+		// checksum by chance, then the rest of the line follows
+		if ((c != '\r' && c != '\n') || nmea_field < nmea_fields_needed(nmea_type))
+		{
+			gps_nmea_dropped++;
+		}
+		else
+		{
+			nmea_msg_fields = nmea_fields;
+			nmea_msg_type = nmea_type;
+			gps_msg_received = TRUE;
+		}
+		break;
+	default:
+		// Bytes between sentences
+		break;
 	}
-
-	if (nmea_msg_len >= NMEA_MAXLEN - 1)
-		gps_msg_received = true;
 	return gps_msg_received;
 }
@@ -53,7 +53,7 @@
 #define TRUE 1
 
 #define PI  3.1415926535897932384626433832795029
-#define RadOfDeg(x) (x*PI/180)
+#define RadOfDeg(x) ((x)*PI/180)
 //end workarounds
 
 void ubxsend_cfg_rst(uint16_t bbr, uint8_t reset_mode);
@@ -61,45 +61,25 @@ void ubxsend_cfg_rst(uint16_t bbr, uint8_t reset_mode);
 ////////////////////////////////////////////////////////
 //       nmea-parser
 
-
-/**
- * The buffer, we store one nmea-line in
- * for parsing.
- */
+/** Sentences dropped for a wrong checksum */
+extern uint16_t gps_nmea_checksum_errors;
+/** Sentences dropped as malformed or too long */
+extern uint16_t gps_nmea_dropped;
 
 int GpsFixValid(void);
 
 /**
- * parse GPGSA-nmea-messages stored in
- * nmea_msg_buf .
- */
-void parse_nmea_GPGSA(void);
-
-/**
- * parse GPRMC NMEA messages stored in
- * nmea_msg_buf. This message contains position
- * and speed information.
- */
-void parse_nmea_GPRMC(void);
-
-/**
- * parse GPGGA-nmea-messages stored in
- * nmea_msg_buf .
- */
-void parse_nmea_GPGGA(void);
-
-/**
- * parse_ubx() has a complete line.
- * Find out what type of message it is and
- * hand it to the parser for that type.
+ * parse_nmea() has a complete sentence with a
+ * valid checksum. Write its fields to the gps variables.
  */
 void parse_gps_msg(void);
 
 /**
  * This is the actual parser.
- * It reads one character at a time
- * setting gps_msg_received to TRUE
- * after a full line.
+ * It reads one character at a time, parsing the
+ * fields while they arrive, and returns TRUE at the
+ * line end of a GGA, RMC or GSA sentence with a valid
+ * checksum.
  */
 uint8_t parse_nmea(uint8_t c);
 
@@ -0,0 +1,277 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief u-blox UBX binary protocol driver
+ *
+ * @author Lorenz Meier <mavteam@student.ethz.ch>
+ * @author Laurens Mackay <mavteam@student.ethz.ch>
+ */
+
+#include "gps_ubx.h"
+#include "gps.h"
+#include "uart.h"
+#include "sys_time.h"
+
+/* Parser states */
+#define UBX_WAIT_SYNC1 0
+#define UBX_WAIT_SYNC2 1
+#define UBX_GOT_CLASS 2
+#define UBX_GOT_ID 3
+#define UBX_GOT_LEN1 4
+#define UBX_GOT_LEN2 5
+#define UBX_PAYLOAD 6
+#define UBX_CK_A 7
+#define UBX_CK_B 8
+
+#define GPS_UBX_RECONFIGURE_INTERVAL 1000000 ///< Minimum usecs between two configurations
+
+uint8_t gps_protocol = GPS_PROTOCOL_NMEA;
+uint16_t gps_ubx_checksum_errors = 0;
+
+static uint8_t ubx_state = UBX_WAIT_SYNC1;
+static uint8_t ubx_class;
+static uint8_t ubx_id;
+static uint16_t ubx_len;
+static uint16_t ubx_index;
+static uint8_t ubx_ck_a, ubx_ck_b;
+
+/**
+ * Payload of the message being received. Bytes are written here once and
+ * parse_ubx_msg() reads the fields in place, so it has to be called
+ * before the next byte is parsed.
+ */
+static union
+{
+	uint8_t raw[GPS_UBX_MAX_PAYLOAD];
+	ubx_nav_posllh_t posllh;
+	ubx_nav_velned_t velned;
+	ubx_nav_sol_t sol;
+} ubx_payload;
+
+static uint8_t ubx_msg_id = 0;    ///< NAV id of the valid message in ubx_payload, 0 if none
+static ubx_nav_posllh_t ubx_posllh; ///< Position waiting for the NAV-SOL of its epoch
+static uint64_t ubx_configure_time = 0;
+static uint8_t ubx_last_byte = 0; ///< Last byte outside of a message, to spot NMEA
+
+/** @brief Send one UBX message, dropped if the UART buffer is full */
+static void ubx_send(uint8_t class, uint8_t id, const uint8_t* payload,
+		uint16_t len)
+{
+	if (!uart1_check_free_space(len + 8))
+	{
+		return;
+	}
+
+	uint8_t header[4] = { class, id, len & 0xFF, len >> 8 };
+	uint8_t ck_a = 0, ck_b = 0;
+
+	uart1_transmit(UBX_SYNC1);
+	uart1_transmit(UBX_SYNC2);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		ck_a += header[i];
+		ck_b += ck_a;
+		uart1_transmit(header[i]);
+	}
+	for (uint16_t i = 0; i < len; i++)
+	{
+		ck_a += payload[i];
+		ck_b += ck_a;
+		uart1_transmit(payload[i]);
+	}
+	uart1_transmit(ck_a);
+	uart1_transmit(ck_b);
+}
+
+void gps_ubx_configure(void)
+{
+	uint32_t baud = global_data.param[PARAM_UART1_BAUD];
+
+	// Port: 8N1 at the current baud rate, UBX in and out only
+	const uint8_t prt[20] = { GPS_UBX_PORT, 0, 0, 0, 0xD0, 0x08, 0, 0,
+			baud & 0xFF, (baud >> 8) & 0xFF, (baud >> 16) & 0xFF, baud >> 24,
+			0x01, 0x00, 0x01, 0x00, 0, 0, 0, 0 };
+	ubx_send(UBX_CLASS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+
+	// Navigation rate, one solution per measurement, GPS time
+	const uint8_t rate[6] = { GPS_UBX_MEAS_RATE & 0xFF, GPS_UBX_MEAS_RATE >> 8,
+			1, 0, 1, 0 };
+	ubx_send(UBX_CLASS_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+
+	// Every solution on the current port
+	const uint8_t nav[3] = { UBX_NAV_POSLLH, UBX_NAV_SOL, UBX_NAV_VELNED };
+	for (uint8_t i = 0; i < sizeof(nav); i++)
+	{
+		const uint8_t msg[3] = { UBX_CLASS_NAV, nav[i], 1 };
+		ubx_send(UBX_CLASS_CFG, UBX_CFG_MSG, msg, sizeof(msg));
+	}
+
+	ubx_configure_time = sys_time_clock_get_time_usec();
+}
+
+uint8_t parse_ubx(uint8_t c)
+{
+	switch (ubx_state)
+	{
+	case UBX_WAIT_SYNC1:
+		if (c == UBX_SYNC1)
+		{
+			ubx_state = UBX_WAIT_SYNC2;
+		}
+		else if (ubx_last_byte == '$' && c == 'G'
+				&& sys_time_clock_get_time_usec() - ubx_configure_time
+						> GPS_UBX_RECONFIGURE_INTERVAL)
+		{
+			// NMEA output, the receiver lost its configuration
+			gps_ubx_configure();
+		}
+		ubx_last_byte = c;
+		return 0;
+	case UBX_WAIT_SYNC2:
+		if (c == UBX_SYNC2)
+		{
+			ubx_state = UBX_GOT_CLASS;
+			ubx_ck_a = 0;
+			ubx_ck_b = 0;
+		}
+		else if (c != UBX_SYNC1)
+		{
+			ubx_state = UBX_WAIT_SYNC1;
+		}
+		return 0;
+	}
+
+	// Fletcher checksum over class, id, length and payload
+	if (ubx_state < UBX_CK_A)
+	{
+		ubx_ck_a += c;
+		ubx_ck_b += ubx_ck_a;
+	}
+
+	switch (ubx_state)
+	{
+	case UBX_GOT_CLASS:
+		ubx_class = c;
+		ubx_state = UBX_GOT_ID;
+		break;
+	case UBX_GOT_ID:
+		ubx_id = c;
+		ubx_state = UBX_GOT_LEN1;
+		break;
+	case UBX_GOT_LEN1:
+		ubx_len = c;
+		ubx_state = UBX_GOT_LEN2;
+		break;
+	case UBX_GOT_LEN2:
+		ubx_len |= c << 8;
+		ubx_index = 0;
+		ubx_state = (ubx_len > 0) ? UBX_PAYLOAD : UBX_CK_A;
+		break;
+	case UBX_PAYLOAD:
+		// Longer messages are not used, only their checksum is run
+		if (ubx_index < GPS_UBX_MAX_PAYLOAD)
+		{
+			ubx_payload.raw[ubx_index] = c;
+		}
+		if (++ubx_index == ubx_len)
+		{
+			ubx_state = UBX_CK_A;
+		}
+		break;
+	case UBX_CK_A:
+		ubx_state = (c == ubx_ck_a) ? UBX_CK_B : UBX_WAIT_SYNC1;
+		if (ubx_state == UBX_WAIT_SYNC1)
+			gps_ubx_checksum_errors++;
+		break;
+	case UBX_CK_B:
+		ubx_state = UBX_WAIT_SYNC1;
+		if (c != ubx_ck_b)
+		{
+			gps_ubx_checksum_errors++;
+		}
+		else if (ubx_class == UBX_CLASS_NAV && ((ubx_id == UBX_NAV_POSLLH
+				&& ubx_len == sizeof(ubx_nav_posllh_t)) || (ubx_id
+				== UBX_NAV_VELNED && ubx_len == sizeof(ubx_nav_velned_t))
+				|| (ubx_id == UBX_NAV_SOL && ubx_len == sizeof(ubx_nav_sol_t))))
+		{
+			ubx_msg_id = ubx_id;
+			return 1;
+		}
+		break;
+	}
+	return 0;
+}
+
+void parse_ubx_msg(void)
+{
+	switch (ubx_msg_id)
+	{
+	case UBX_NAV_POSLLH:
+		// The receiver sends NAV-SOL with the fix of this epoch next
+		ubx_posllh = ubx_payload.posllh;
+		break;
+	case UBX_NAV_VELNED:
+		gps_gspeed = ubx_payload.velned.gSpeed;
+		gps_climb = -ubx_payload.velned.velD;
+		gps_course = ubx_payload.velned.heading / 10000;
+		break;
+	case UBX_NAV_SOL:
+	{
+		uint8_t fix_ok = (ubx_payload.sol.flags & UBX_NAV_SOL_FLAGS_GPSFIXOK)
+				&& ubx_payload.sol.gpsFix >= 2 && ubx_payload.sol.gpsFix <= 4;
+		gps_mode = fix_ok ? ubx_payload.sol.gpsFix : 0;
+		gps_week = ubx_payload.sol.week;
+		gps_itow = ubx_payload.sol.iTOW;
+		gps_numSV = ubx_payload.sol.numSV;
+		gps_PDOP = ubx_payload.sol.pDOP;
+		gps_Pacc = ubx_payload.sol.pAcc;
+		gps_Sacc = ubx_payload.sol.sAcc;
+
+		if (ubx_posllh.iTOW != ubx_payload.sol.iTOW)
+		{
+			// Position of this epoch lost
+			break;
+		}
+		gps_pos_available = fix_ok;
+		if (fix_ok)
+		{
+			gps_lat = ubx_posllh.lat;
+			gps_lon = ubx_posllh.lon;
+			gps_alt = ubx_posllh.hMSL / 10;
+		}
+		else
+		{
+			// As the NMEA parser without fix, read as signal lost
+			gps_lat = 0;
+			gps_lon = 0;
+		}
+
+		// Tell the filter that we have a new position.
+		global_data.state.gps_new_data = 1;
+		break;
+	}
+	}
+	ubx_msg_id = 0;
+}
@@ -0,0 +1,135 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief u-blox UBX binary protocol driver
+ *
+ * The receiver is configured to send only NAV-POSLLH, NAV-VELNED and
+ * NAV-SOL at GPS_UBX_MEAS_RATE. parse_ubx() frames one byte at a time,
+ * storing the payload straight into an aligned buffer the messages are
+ * read from in place, and parse_ubx_msg() writes them to the same gps_*
+ * variables as the NMEA parser. The position of an epoch is published
+ * with its NAV-SOL, which carries the fix status.
+ *
+ * @author Lorenz Meier <mavteam@student.ethz.ch>
+ * @author Laurens Mackay <mavteam@student.ethz.ch>
+ */
+
+#ifndef GPS_UBX_H_
+#define GPS_UBX_H_
+
+#include <inttypes.h>
+
+#define UBX_SYNC1 0xB5
+#define UBX_SYNC2 0x62
+
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_CFG 0x06
+
+#define UBX_NAV_POSLLH 0x02
+#define UBX_NAV_SOL 0x06
+#define UBX_NAV_VELNED 0x12
+
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+
+#define UBX_NAV_SOL_FLAGS_GPSFIXOK 0x01
+
+#define GPS_UBX_MEAS_RATE 200  ///< Navigation period in ms, 5 Hz. 10 Hz (100) needs 38400 baud or more
+#define GPS_UBX_PORT 1         ///< Receiver port connected to the IMU UART1
+#define GPS_UBX_MAX_PAYLOAD 52 ///< NAV-SOL, the longest message used
+
+/* Payloads, all fields are naturally aligned */
+
+typedef struct
+{
+	uint32_t iTOW;   ///< GPS time of week in ms
+	int32_t lon;     ///< 1e-7 deg
+	int32_t lat;     ///< 1e-7 deg
+	int32_t height;  ///< mm above ellipsoid
+	int32_t hMSL;    ///< mm above mean sea level
+	uint32_t hAcc;   ///< mm
+	uint32_t vAcc;   ///< mm
+} ubx_nav_posllh_t;
+
+typedef struct
+{
+	uint32_t iTOW;
+	int32_t velN;    ///< cm/s
+	int32_t velE;    ///< cm/s
+	int32_t velD;    ///< cm/s
+	uint32_t speed;  ///< 3D speed in cm/s
+	uint32_t gSpeed; ///< Ground speed in cm/s
+	int32_t heading; ///< 1e-5 deg
+	uint32_t sAcc;   ///< cm/s
+	uint32_t cAcc;   ///< 1e-5 deg
+} ubx_nav_velned_t;
+
+typedef struct
+{
+	uint32_t iTOW;
+	int32_t fTOW;
+	int16_t week;
+	uint8_t gpsFix;  ///< 0 no fix, 1 dead reckoning, 2 2D, 3 3D, 4 GPS + DR, 5 time only
+	uint8_t flags;   ///< UBX_NAV_SOL_FLAGS_*
+	int32_t ecefX;
+	int32_t ecefY;
+	int32_t ecefZ;
+	uint32_t pAcc;   ///< cm
+	int32_t ecefVX;
+	int32_t ecefVY;
+	int32_t ecefVZ;
+	uint32_t sAcc;   ///< cm/s
+	uint16_t pDOP;   ///< 0.01
+	uint8_t reserved1;
+	uint8_t numSV;
+	uint32_t reserved2;
+} ubx_nav_sol_t;
+
+/** Messages dropped for a wrong checksum */
+extern uint16_t gps_ubx_checksum_errors;
+
+/**
+ * @brief Set the receiver to UBX output of the NAV messages
+ *
+ * Sent at startup and again when the receiver falls back to NMEA,
+ * e.g. after it lost power.
+ */
+void gps_ubx_configure(void);
+
+/**
+ * This is the actual parser.
+ * It reads one character at a time and returns 1 after
+ * a NAV message with a valid checksum.
+ */
+uint8_t parse_ubx(uint8_t c);
+
+/**
+ * parse_ubx() has a complete message.
+ * Write it to the gps variables.
+ */
+void parse_ubx_msg(void);
+
+#endif /* GPS_UBX_H_ */
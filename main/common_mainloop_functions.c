@@ -622,9 +622,6 @@ void camera_shutter_handling(uint64_t loop_start_time)
 	bool camera_triggered = shutter_loop();
 	if (camera_triggered)
 	{
-		vision_buffer_buffer_camera_triggered(sys_time_clock_get_unix_loop_start_time(), loop_start_time,
-				shutter_get_seq());
-
 		// Emit timestamp of this image
 		mavlink_msg_image_triggered_send(MAVLINK_COMM_0, sys_time_clock_get_unix_loop_start_time(),
 				shutter_get_seq(), global_data.attitude.x,
@@ -28,6 +28,8 @@
 #include "servos.h"
 #include "radio_control.h"
 #include "sensors.h"
+#include "mag_calibration.h"
+#include "calibration.h"
 
 #include "communication.h"
 
@@ -41,6 +43,7 @@
 #include "params.h"
 #include "attitude_observer.h"
 #include "gps.h"
+#include "gps_transformations.h"
 #include "gyros.h"
 #include "buzzer.h"
 
@@ -116,6 +119,7 @@ void main_loop_fixed_wing(void)
 			// Kalman Attitude filter, used on all systems
 			gyro_read();
 			sensors_read_acc();
+			gyro_refine_bias();
 
 			// Read out magnetometer at its default 50 Hz rate
 			static uint8_t mag_count = 0;
@@ -244,6 +248,7 @@ void main_loop_fixed_wing(void)
 			{
 				//Send GPS information
 				float_vect3 gps;
+				gps_update_utm();
 				gps.x = gps_utm_north / 100.0f;//m
 				gps.y = gps_utm_east / 100.0f;//m
 				gps.z = gps_utm_zone;// gps_week;
@@ -272,29 +277,25 @@ void main_loop_fixed_wing(void)
 			}
 
 			communication_send_attitude_position(loop_start_time);
+			debug_event_send();
+
+			mag_calibration_update();
 		}
 		///////////////////////////////////////////////////////////////////////////
 
 
 
 
-		///////////////////////////////////////////////////////////////////////////
-		/// NON-CRITICAL SLOW 200 Hz functions                                     //
-		///////////////////////////////////////////////////////////////////////////
-		else if (us_run_every(5000, COUNTER5, loop_start_time))
-		{
+		else {
+			// All Tasks are fine and we have no starvation
+			last_mainloop_idle = loop_start_time;
+
 			if (global_data.state.status == MAV_STATE_STANDBY)
 			{
-				//Check if parameters should be written or read
+				// Read parameters or write changed ones, one EEPROM transfer at a time
 				param_handler();
 			}
 		}
-		///////////////////////////////////////////////////////////////////////////
-
-		else {
-			// All Tasks are fine and we have no starvation
-			last_mainloop_idle = loop_start_time;
-		}
 
 		// Read out comm at max rate - takes only a few microseconds in worst case
 		communication_receive();
@@ -20,6 +20,7 @@
 // Include globals
 #include "global_data.h"
 #include "sensors.h"
+#include "mag_calibration.h"
 #include "calibration.h"
 
 #include "adc.h"
@@ -67,6 +68,8 @@
 
 #include "mmc_spi.h"
 #include "dos.h"
+#include "sdcard.h"
+#include "sd_log.h"
 #include "fat.h"
 
 // Static variables
@@ -104,8 +107,8 @@ void main_init_generic(void)
 
 	// Lowlevel periphel support init
 	adc_init();
-	// FIXME SDCARD
-//	MMC_IO_Init();
+	// SD card deselected before the other SPI devices are used
+	sdcard_init();
 	spi_init();
 	i2c_init();
 
@@ -125,38 +128,11 @@ void main_init_generic(void)
 	// Try to reach the EEPROM
 	eeprom_check_start();
 
-	// WAIT FOR 2 SECONDS FOR THE USER TO NOT TOUCH THE UNIT
-	while (sys_time_clock_get_time_usec() < 2000000)
+	// The check takes a few ms, the parameters decide about fast boot
+	while (!eeprom_check_done() && sys_time_clock_get_time_usec() < 2000000)
 	{
 	}
 
-	// Do the auto-gyro calibration for 1 second
-	// Get current temperature
-	led_on(LED_RED);
-	gyro_init();
-
-//	uint8_t timeout = 3;
-//	// Check for SD card
-//	while (sys_time_clock_get_time_usec() < 2000000)
-//	{
-//		while (GetDriveInformation() != F_OK && timeout--)
-//		  {
-//		   debug_message_buffer("MMC/SD-Card not found ! retrying..");
-//		  }
-//	}
-//
-//	if (GetDriveInformation() == F_OK)
-//	{
-//		debug_message_buffer("MMC/SD-Card SUCCESS: FOUND");
-//	}
-//	else
-//	{
-//		debug_message_buffer("MMC/SD-Card FAILURE: NOT FOUND");
-//	}
-	//FIXME redo init because of SD driver decreasing speed
-	//spi_init();
-	led_off(LED_RED);
-
 	// Stop trying to reach the EEPROM - if it has not been found by now, assume
 	// there is no EEPROM mounted
 	if (eeprom_check_ok())
@@ -164,11 +140,11 @@ void main_init_generic(void)
 		param_read_all();
 		debug_message_buffer("EEPROM detected - reading parameters from EEPROM");
 
-		for (int i = 0; i < ONBOARD_PARAM_COUNT * 2 + 20; i++)
+		// Every read waits for its transfer, no need to sleep in between
+		uint64_t param_timeout = sys_time_clock_get_time_usec() + 1000000;
+		while (param_read_busy() && sys_time_clock_get_time_usec() < param_timeout)
 		{
 			param_handler();
-			//sleep 1 ms
-			sys_time_wait(1000);
 		}
 	}
 	else
@@ -176,8 +152,31 @@ void main_init_generic(void)
 		debug_message_buffer("NO EEPROM - reading onboard parameters from FLASH");
 	}
 
+	if (global_data.param[PARAM_SYS_FAST_BOOT] == 1)
+	{
+		// Stored gyro bias, refined in the main loop while standing still
+		gyro_fast_boot();
+	}
+	else
+	{
+		// WAIT FOR 2 SECONDS FOR THE USER TO NOT TOUCH THE UNIT
+		while (sys_time_clock_get_time_usec() < 2000000)
+		{
+		}
+
+		// Do the auto-gyro calibration for 1 second
+		// Get current temperature
+		led_on(LED_RED);
+		gyro_init();
+		led_off(LED_RED);
+	}
+
+	// Flight log file on the SD card, uses the blocking FAT functions
+	sd_log_init();
+
 	//Magnet sensor
 	hmc5843_init();
+	mag_calibration_init();
 	acc_init();
 
 	// Comm parameter init
@@ -262,6 +261,9 @@ void main_init_generic(void)
 	mavlink_msg_boot_send(MAVLINK_COMM_1, global_data.param[PARAM_SW_VERSION]);
 
 	debug_message_buffer("System is initialized");
+	// Cold boot to ready, the clock starts in sys_time_clock_init()
+	debug_message_buffer_sprintf("Boot to ready: %u ms",
+			(uint32_t) (sys_time_clock_get_time_usec() / 1000));
 
 	// Calibration stopped
 	led_off(LED_RED);
@@ -322,6 +324,7 @@ void main_loop_generic(void)
 			// Kalman Attitude filter, used on all systems
 			gyro_read();
 			sensors_read_acc();
+			gyro_refine_bias();
 
 			// Read out magnetometer at its default 50 Hz rate
 			static uint8_t mag_count = 0;
@@ -431,6 +434,7 @@ void main_loop_generic(void)
 		else if (us_run_every(1000000, COUNTER9, loop_start_time))
 		{
 			send_system_state();
+			communication_send_time_sync();
 			beep_on_low_voltage();
 		}
 		///////////////////////////////////////////////////////////////////////////
@@ -445,30 +449,25 @@ void main_loop_generic(void)
 		{
 			led_toggle(LED_YELLOW);
 			communication_send_attitude_position(loop_start_time);
+			debug_event_send();
+			mag_calibration_update();
 		}
 		///////////////////////////////////////////////////////////////////////////
 
 
 
 
-		///////////////////////////////////////////////////////////////////////////
-		/// NON-CRITICAL SLOW 200 Hz functions                                     //
-		///////////////////////////////////////////////////////////////////////////
-		else if (us_run_every(5000, COUNTER5, loop_start_time))
+		else
 		{
+			// All Tasks are fine and we have no starvation
+			last_mainloop_idle = loop_start_time;
+
 			if (global_data.state.status == MAV_STATE_STANDBY)
 			{
-				//Check if parameters should be written or read
+				// Read parameters or write changed ones, one EEPROM transfer at a time
 				param_handler();
 			}
 		}
-		///////////////////////////////////////////////////////////////////////////
-
-		else
-		{
-			// All Tasks are fine and we have no starvation
-			last_mainloop_idle = loop_start_time;
-		}
 
 		// Read out comm at max rate - takes only a few microseconds in worst case
 		communication_receive();
@@ -23,6 +23,7 @@
 // Include globals
 #include "global_data.h"
 #include "sensors.h"
+#include "mag_calibration.h"
 #include "calibration.h"
 
 #include "adc.h"
@@ -118,6 +119,7 @@ void main_loop_ground_car(void)
 			// Kalman Attitude filter, used on all systems
 			gyro_read();
 			sensors_read_acc();
+			gyro_refine_bias();
 
 			// Read out magnetometer at its default 50 Hz rate
 			static uint8_t mag_count = 0;
@@ -217,30 +219,25 @@ void main_loop_ground_car(void)
 		{
 			led_toggle(LED_YELLOW);
 			communication_send_attitude_position(loop_start_time);
+			debug_event_send();
+			mag_calibration_update();
 		}
 		///////////////////////////////////////////////////////////////////////////
 
 
 
 
-		///////////////////////////////////////////////////////////////////////////
-		/// NON-CRITICAL SLOW 200 Hz functions                                     //
-		///////////////////////////////////////////////////////////////////////////
-		else if (us_run_every(5000, COUNTER5, loop_start_time))
+		else
 		{
+			// All Tasks are fine and we have no starvation
+			last_mainloop_idle = loop_start_time;
+
 			if (global_data.state.status == MAV_STATE_STANDBY)
 			{
-				//Check if parameters should be written or read
+				// Read parameters or write changed ones, one EEPROM transfer at a time
 				param_handler();
 			}
 		}
-		///////////////////////////////////////////////////////////////////////////
-
-		else
-		{
-			// All Tasks are fine and we have no starvation
-			last_mainloop_idle = loop_start_time;
-		}
 
 		// Read out comm at max rate - takes only a few microseconds in worst case
 		communication_receive();
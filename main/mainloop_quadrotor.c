@@ -23,6 +23,7 @@ extern mavlink_system_t mavlink_system;
 // Include globals
 #include "global_data.h"
 #include "sensors.h"
+#include "mag_calibration.h"
 #include "calibration.h"
 
 #include "adc.h"
@@ -69,8 +70,11 @@ extern mavlink_system_t mavlink_system;
 #include "remote_control.h"
 #include "position_kalman3.h"
 #include "vision_buffer.h"
+#include "state_history.h"
+#include "measurement_queue.h"
 
 #include "debug.h"
+#include "log_stream.h"
 #include "transformation.h"
 #include "eeprom.h"
 #include "params.h"
@@ -80,6 +84,8 @@ extern mavlink_system_t mavlink_system;
 
 #include "mmc_spi.h"
 #include "dos.h"
+#include "sdcard.h"
+#include "sd_log.h"
 #include "fat.h"
 
 #include "attitude_tobi_laurens.h"
@@ -129,8 +135,8 @@ void main_init_generic(void)
 
 	// Lowlevel periphel support init
 	adc_init();
-	// FIXME SDCARD
-//	MMC_IO_Init();
+	// SD card deselected before the other SPI devices are used
+	sdcard_init();
 	spi_init();
 	i2c_init();
 
@@ -150,38 +156,11 @@ void main_init_generic(void)
 	// Try to reach the EEPROM
 	eeprom_check_start();
 
-	// WAIT FOR 2 SECONDS FOR THE USER TO NOT TOUCH THE UNIT
-	while (sys_time_clock_get_time_usec() < 2000000)
+	// The check takes a few ms, the parameters decide about fast boot
+	while (!eeprom_check_done() && sys_time_clock_get_time_usec() < 2000000)
 	{
 	}
 
-	// Do the auto-gyro calibration for 1 second
-	// Get current temperature
-	led_on(LED_RED);
-	gyro_init();
-
-//	uint8_t timeout = 3;
-//	// Check for SD card
-//	while (sys_time_clock_get_time_usec() < 2000000)
-//	{
-//		while (GetDriveInformation() != F_OK && timeout--)
-//		  {
-//		   debug_message_buffer("MMC/SD-Card not found ! retrying..");
-//		  }
-//	}
-//
-//	if (GetDriveInformation() == F_OK)
-//	{
-//		debug_message_buffer("MMC/SD-Card SUCCESS: FOUND");
-//	}
-//	else
-//	{
-//		debug_message_buffer("MMC/SD-Card FAILURE: NOT FOUND");
-//	}
-	//FIXME redo init because of SD driver decreasing speed
-	//spi_init();
-	led_off(LED_RED);
-
 	// Stop trying to reach the EEPROM - if it has not been found by now, assume
 	// there is no EEPROM mounted
 	if (eeprom_check_ok())
@@ -189,11 +168,11 @@ void main_init_generic(void)
 		param_read_all();
 		debug_message_buffer("EEPROM detected - reading parameters from EEPROM");
 
-		for (int i = 0; i < ONBOARD_PARAM_COUNT * 2 + 20; i++)
+		// Every read waits for its transfer, no need to sleep in between
+		uint64_t param_timeout = sys_time_clock_get_time_usec() + 1000000;
+		while (param_read_busy() && sys_time_clock_get_time_usec() < param_timeout)
 		{
 			param_handler();
-			//sleep 1 ms
-			sys_time_wait(1000);
 		}
 	}
 	else
@@ -201,12 +180,35 @@ void main_init_generic(void)
 		debug_message_buffer("NO EEPROM - reading onboard parameters from FLASH");
 	}
 
+	if (global_data.param[PARAM_SYS_FAST_BOOT] == 1)
+	{
+		// Stored gyro bias, refined in the main loop while standing still
+		gyro_fast_boot();
+	}
+	else
+	{
+		// WAIT FOR 2 SECONDS FOR THE USER TO NOT TOUCH THE UNIT
+		while (sys_time_clock_get_time_usec() < 2000000)
+		{
+		}
+
+		// Do the auto-gyro calibration for 1 second
+		// Get current temperature
+		led_on(LED_RED);
+		gyro_init();
+		led_off(LED_RED);
+	}
+
+	// Flight log file on the SD card, uses the blocking FAT functions
+	sd_log_init();
+
 	// Set mavlink system
 	mavlink_system.compid = MAV_COMP_ID_IMU;
 	mavlink_system.sysid = global_data.param[PARAM_SYSTEM_ID];
 
 	//Magnet sensor
 	hmc5843_init();
+	mag_calibration_init();
 	acc_init();
 
 	// Comm parameter init
@@ -261,6 +263,9 @@ void main_init_generic(void)
 	send_system_state();
 
 	debug_message_buffer("System is initialized");
+	// Cold boot to ready, the clock starts in sys_time_clock_init()
+	debug_message_buffer_sprintf("Boot to ready: %u ms",
+			(uint32_t) (sys_time_clock_get_time_usec() / 1000));
 
 	// Calibration stopped
 	led_off(LED_RED);
@@ -304,7 +309,12 @@ void main_loop_quadrotor(void)
 
 	// FIXME XXX Make proper mode switching
 
-//	outdoor_position_kalman_init();
+	// The position filters register with the state history in their init
+	measurement_queue_init();
+	state_history_init();
+
+	// GPS_ONLY mode can be selected at any time, the filter needs its model
+	outdoor_position_kalman_init();
 	//vision_position_kalman_init();
 
 	// Default filters, allow Vision, Vicon and optical flow inputs
@@ -339,6 +349,7 @@ void main_loop_quadrotor(void)
 			// Kalman Attitude filter, used on all systems
 			gyro_read();
 			sensors_read_acc();
+			gyro_refine_bias();
 
 			sensors_pressure_bmp085_read_out();
 
@@ -373,8 +384,17 @@ void main_loop_quadrotor(void)
 				outdoor_position_kalman();
 			}
 
+			// Measurements the active filter does not use are not kept for later ticks
+			measurement_queue_flush();
+
+			// Keep the state of this tick for delayed measurements
+			state_history_record(loop_start_time);
+
 			control_quadrotor_attitude();
 
+			// Full rate binary log, if enabled
+			log_stream_sample();
+
 			//debug counting number of executions
 			count++;
 		}
@@ -577,6 +597,25 @@ void main_loop_quadrotor(void)
 			// Send system state, mode, battery voltage, etc.
 			send_system_state();
 
+			// Send forwarded and dropped bytes per link
+			float_vect3 route;
+			route.x = global_data.comm.route_tx_bytes[MAVLINK_COMM_0];
+			route.y = global_data.comm.route_tx_bytes[MAVLINK_COMM_1];
+			route.z = 0;
+			debug_vect("route tx", route);
+			route.x = global_data.comm.route_drop_bytes[MAVLINK_COMM_0];
+			route.y = global_data.comm.route_drop_bytes[MAVLINK_COMM_1];
+			debug_vect("route drop", route);
+
+			// Synchronize the onboard clock and send the sync quality
+			communication_send_time_sync();
+			const sys_time_sync_t* sync = sys_time_clock_get_sync();
+			float_vect3 clock;
+			clock.x = sync->error;
+			clock.y = sync->rtt;
+			clock.z = sync->skew * 1e6f;
+			debug_vect("clock sync", clock);
+
 			// Send position setpoint offset
 			//debug_vect("pos offs", global_data.position_setpoint_offset);
 
@@ -594,6 +633,7 @@ void main_loop_quadrotor(void)
 			{
 				//Send GPS information
 				float_vect3 gps;
+				gps_update_utm();
 				gps.x = gps_utm_north / 100.0f;//m
 				gps.y = gps_utm_east / 100.0f;//m
 				gps.z = gps_utm_zone;// gps_week;
@@ -650,6 +690,11 @@ void main_loop_quadrotor(void)
 			// Send parameter
 			communication_queued_send();
 
+			// Binary debug events of the interrupts and the main loop
+			debug_event_send();
+
+			mag_calibration_update();
+
 //			//infrared distance
 //			float_vect3 infra;
 //			infra.x = global_data.ground_distance;
@@ -660,24 +705,20 @@ void main_loop_quadrotor(void)
 		///////////////////////////////////////////////////////////////////////////
 
 
-		///////////////////////////////////////////////////////////////////////////
-		/// NON-CRITICAL SLOW 200 Hz functions                                     //
-		///////////////////////////////////////////////////////////////////////////
-		else if (us_run_every(5000, COUNTER5, loop_start_time))
+		else
 		{
+			// All Tasks are fine and we have no starvation
+			last_mainloop_idle = loop_start_time;
+
+			// Write full log sectors, about 150 usecs of SPI transfers at most
+			sd_log_update();
+
 			if (global_data.state.status == MAV_STATE_STANDBY)
 			{
-				//Check if parameters should be written or read
+				// Read parameters or write changed ones, one EEPROM transfer at a time
 				param_handler();
 			}
 		}
-		///////////////////////////////////////////////////////////////////////////
-
-		else
-		{
-			// All Tasks are fine and we have no starvation
-			last_mainloop_idle = loop_start_time;
-		}
 
 		// Read out comm at max rate - takes only a few microseconds in worst case
 		communication_receive();
@@ -3,23 +3,58 @@
  *
  *  Created on: 19.10.2010
  *      Author: Laurens Mackay
+ *
+ * Local positions are north, east and down on the tangent plane at the
+ * origin. The WGS84 radii of curvature at the origin are computed once,
+ * a fix then costs a few float multiplies of its integer offset to the
+ * origin. Up to the second order terms this is the exact tangent plane
+ * position. Within 10 km of the origin the error is below 10 cm up to
+ * 65 deg latitude and below 20 cm at 80 deg.
  */
 #include "gps_transformations.h"
 #include "gps.h"
 #include "debug.h"
 #include "mavlink.h"
+#include "latlong.h"
+
+#define WGS84_A 6378137.0           ///< Semi-major axis in m
+#define WGS84_E2 0.00669437999014   ///< First eccentricity squared
+#define GPS_RAD_PER_UNIT (3.14159265358979323846 / 180 / 1e7) ///< rad per 1e-7 deg
 
 static float_vect3 gps_local_origin;
 static bool gps_local_origin_init = false;
-static float gps_cos_origin_lat = 0;
-const float r_earth = 6378140;
+static int32_t gps_origin_lat, gps_origin_lon; ///< 1e-7 deg
+static int32_t gps_origin_alt;                 ///< cm
+
+/* Tangent plane projection at the origin, per 1e-7 deg of offset */
+static float gps_k_north;       ///< M
+static float gps_k_east;        ///< N * cos(lat)
+static float gps_k_north_east2; ///< N * sin(lat) * cos(lat) / 2, curvature of the parallel
+static float gps_k_east_north;  ///< M * sin(lat), convergence of the meridians
+
+extern uint8_t nav_utm_zone0;
 
 void gps_set_local_origin(void)
 {
+	gps_origin_lat = gps_lat;
+	gps_origin_lon = gps_lon;
+	gps_origin_alt = gps_alt;
 	gps_local_origin.x = gps_lat / 1e7f;
 	gps_local_origin.y = gps_lon / 1e7f;
 	gps_local_origin.z = gps_alt / 100e0f;
-	gps_cos_origin_lat = cos(gps_local_origin.x * 3.1415 / 180);
+
+	// Once per origin, so in double
+	double lat = gps_lat * GPS_RAD_PER_UNIT;
+	double sin_lat = sin(lat);
+	double cos_lat = cos(lat);
+	double w2 = 1 - WGS84_E2 * sin_lat * sin_lat;
+	double n = WGS84_A / sqrt(w2);          // prime vertical radius
+	double m = n * (1 - WGS84_E2) / w2;     // meridian radius
+	gps_k_north = m * GPS_RAD_PER_UNIT;
+	gps_k_east = n * cos_lat * GPS_RAD_PER_UNIT;
+	gps_k_north_east2 = n * sin_lat * cos_lat / 2 * GPS_RAD_PER_UNIT
+			* GPS_RAD_PER_UNIT;
+	gps_k_east_north = m * sin_lat * GPS_RAD_PER_UNIT * GPS_RAD_PER_UNIT;
 
 	gps_local_origin_init = true;
 	gps_send_local_origin();
@@ -30,14 +65,19 @@ void gps_get_local_position(float_vect3 * gps_local_position)
 {
 	if (gps_local_origin_init)
 	{
-		gps_local_position->x = r_earth * tan((gps_lat / 1e7f
-				- gps_local_origin.x) * 3.1415 / 180);
-
-		gps_local_position->y = r_earth * gps_cos_origin_lat * tan((gps_lon
-				/ 1e7f - gps_local_origin.y) * 3.1415 / 180);
-
-		gps_local_position->z = -(gps_alt / 100e0f - gps_local_origin.z);//z down
+		float dlat = gps_lat - gps_origin_lat;
+		// Across the date line the difference exceeds 180 deg
+		int64_t dlon_units = (int64_t) gps_lon - gps_origin_lon;
+		if (dlon_units > 1800000000)
+			dlon_units -= 3600000000LL;
+		else if (dlon_units < -1800000000)
+			dlon_units += 3600000000LL;
+		float dlon = dlon_units;
 
+		gps_local_position->x = gps_k_north * dlat + gps_k_north_east2 * dlon
+				* dlon;
+		gps_local_position->y = (gps_k_east - gps_k_east_north * dlat) * dlon;
+		gps_local_position->z = -(gps_alt - gps_origin_alt) / 100e0f;//z down
 	}
 	else
 	{
@@ -58,6 +98,15 @@ void gps_get_local_velocity(float_vect3 * gps_local_velocity)
 	//don't touch z-velocity.
 }
 
+void gps_update_utm(void)
+{
+	latlong_utm_of(gps_lat * GPS_RAD_PER_UNIT, gps_lon * GPS_RAD_PER_UNIT,
+			nav_utm_zone0);
+	gps_utm_east = latlong_utm_x * 100;
+	gps_utm_north = latlong_utm_y * 100;
+	gps_utm_zone = nav_utm_zone0;
+}
+
 void gps_send_local_origin(void)
 {
 	if (gps_local_origin_init)
@@ -15,6 +15,7 @@
 void gps_set_local_origin(void);
 
 /* @brief Convert the coordinates from gps_* variables in gps.h to gps_local relative in meters
+ * x north, y east and z down on the tangent plane at the origin, z is the altitude difference.
  * @param gps_local_position vector to save relative position in.*/
 void gps_get_local_position(float_vect3 * gps_local_position);
 /* Same for velocity. Only x-y plane.*/
@@ -22,4 +23,7 @@ void gps_get_local_velocity(float_vect3 * gps_local_velocity);
 
 void gps_send_local_origin(void);
 
+/* @brief Set gps_utm_* from gps_lat and gps_lon. Slow, only for display. */
+void gps_update_utm(void);
+
 #endif /* GPS_TRANSFORMATIONS_H_ */
@@ -11,7 +11,7 @@ float latlong_lat, latlong_lon; /* rad */
 //WORKAROUNDS Was not compiling
 
 #define PI  3.1415926535897932384626433832795029
-#define RadOfDeg(x) (x*PI/180)
+#define RadOfDeg(x) ((x)*PI/180)
 //end workarounds
 
 /* Computation for the WGS84 geoid only */
@@ -0,0 +1,256 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Quaternion and rotation matrix attitude
+ *
+ * @author Lorenz Meier <mavteam@student.ethz.ch>
+ * @author Laurens Mackay <mavteam@student.ethz.ch>
+ */
+
+#include "quaternion.h"
+#include <math.h>
+
+void quat_identity(float_quat* q)
+{
+	q->w = 1.0f;
+	q->x = 0.0f;
+	q->y = 0.0f;
+	q->z = 0.0f;
+}
+
+void quat_from_euler(const float_vect3* euler, float_quat* q)
+{
+	float cr = cosf(0.5f * euler->x);
+	float sr = sinf(0.5f * euler->x);
+	float cp = cosf(0.5f * euler->y);
+	float sp = sinf(0.5f * euler->y);
+	float cy = cosf(0.5f * euler->z);
+	float sy = sinf(0.5f * euler->z);
+
+	q->w = cr * cp * cy + sr * sp * sy;
+	q->x = sr * cp * cy - cr * sp * sy;
+	q->y = cr * sp * cy + sr * cp * sy;
+	q->z = cr * cp * sy - sr * sp * cy;
+}
+
+void quat_to_euler(const float_quat* q, float_vect3* euler)
+{
+	float sin_pitch = 2.0f * (q->w * q->y - q->x * q->z);
+	if (sin_pitch > 1.0f)
+	{
+		sin_pitch = 1.0f;
+	}
+	else if (sin_pitch < -1.0f)
+	{
+		sin_pitch = -1.0f;
+	}
+
+	euler->x = atan2f(2.0f * (q->w * q->x + q->y * q->z), 1.0f - 2.0f
+			* (q->x * q->x + q->y * q->y));
+	euler->y = asinf(sin_pitch);
+	euler->z = atan2f(2.0f * (q->w * q->z + q->x * q->y), 1.0f - 2.0f
+			* (q->y * q->y + q->z * q->z));
+}
+
+void quat_to_dcm(const float_quat* q, float_mat3* dcm)
+{
+	float xx = q->x * q->x;
+	float yy = q->y * q->y;
+	float zz = q->z * q->z;
+	float xy = q->x * q->y;
+	float xz = q->x * q->z;
+	float yz = q->y * q->z;
+	float wx = q->w * q->x;
+	float wy = q->w * q->y;
+	float wz = q->w * q->z;
+
+	dcm->m[0][0] = 1.0f - 2.0f * (yy + zz);
+	dcm->m[0][1] = 2.0f * (xy - wz);
+	dcm->m[0][2] = 2.0f * (xz + wy);
+	dcm->m[1][0] = 2.0f * (xy + wz);
+	dcm->m[1][1] = 1.0f - 2.0f * (xx + zz);
+	dcm->m[1][2] = 2.0f * (yz - wx);
+	dcm->m[2][0] = 2.0f * (xz - wy);
+	dcm->m[2][1] = 2.0f * (yz + wx);
+	dcm->m[2][2] = 1.0f - 2.0f * (xx + yy);
+}
+
+void quat_from_dcm(const float_mat3* dcm, float_quat* q)
+{
+	const float (*m)[3] = dcm->m;
+	float trace = m[0][0] + m[1][1] + m[2][2];
+
+	// Take the largest component first, the others are divided by it
+	if (trace > 0.0f)
+	{
+		float s = 2.0f * sqrtf(1.0f + trace);
+		q->w = 0.25f * s;
+		q->x = (m[2][1] - m[1][2]) / s;
+		q->y = (m[0][2] - m[2][0]) / s;
+		q->z = (m[1][0] - m[0][1]) / s;
+	}
+	else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]);
+		q->w = (m[2][1] - m[1][2]) / s;
+		q->x = 0.25f * s;
+		q->y = (m[0][1] + m[1][0]) / s;
+		q->z = (m[0][2] + m[2][0]) / s;
+	}
+	else if (m[1][1] > m[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]);
+		q->w = (m[0][2] - m[2][0]) / s;
+		q->x = (m[0][1] + m[1][0]) / s;
+		q->y = 0.25f * s;
+		q->z = (m[1][2] + m[2][1]) / s;
+	}
+	else
+	{
+		float s = 2.0f * sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]);
+		q->w = (m[1][0] - m[0][1]) / s;
+		q->x = (m[0][2] + m[2][0]) / s;
+		q->y = (m[1][2] + m[2][1]) / s;
+		q->z = 0.25f * s;
+	}
+}
+
+void quat_mult(const float_quat* a, const float_quat* b, float_quat* c)
+{
+	float w = a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z;
+	float x = a->w * b->x + a->x * b->w + a->y * b->z - a->z * b->y;
+	float y = a->w * b->y - a->x * b->z + a->y * b->w + a->z * b->x;
+	float z = a->w * b->z + a->x * b->y - a->y * b->x + a->z * b->w;
+	c->w = w;
+	c->x = x;
+	c->y = y;
+	c->z = z;
+}
+
+void quat_normalize(float_quat* q)
+{
+	float norm = sqrtf(q->w * q->w + q->x * q->x + q->y * q->y + q->z * q->z);
+	if (norm > 0.0f)
+	{
+		q->w /= norm;
+		q->x /= norm;
+		q->y /= norm;
+		q->z /= norm;
+	}
+	else
+	{
+		quat_identity(q);
+	}
+}
+
+void quat_integrate(float_quat* q, const float_vect3* rate, float dt)
+{
+	float hx = 0.5f * dt * rate->x;
+	float hy = 0.5f * dt * rate->y;
+	float hz = 0.5f * dt * rate->z;
+
+	float w = q->w - q->x * hx - q->y * hy - q->z * hz;
+	float x = q->x + q->w * hx + q->y * hz - q->z * hy;
+	float y = q->y + q->w * hy - q->x * hz + q->z * hx;
+	float z = q->z + q->w * hz + q->x * hy - q->y * hx;
+
+	// 1/sqrt(n) ~ (3 - n) / 2 close to n = 1
+	float scale = 0.5f * (3.0f - (w * w + x * x + y * y + z * z));
+	q->w = w * scale;
+	q->x = x * scale;
+	q->y = y * scale;
+	q->z = z * scale;
+}
+
+void quat_nlerp(float_quat* q, const float_quat* target, float t)
+{
+	float dot = q->w * target->w + q->x * target->x + q->y * target->y
+			+ q->z * target->z;
+	float s = (dot < 0.0f) ? -t : t;
+	q->w += s * target->w - t * q->w;
+	q->x += s * target->x - t * q->x;
+	q->y += s * target->y - t * q->y;
+	q->z += s * target->z - t * q->z;
+	quat_normalize(q);
+}
+
+void dcm_body2navi(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result)
+{
+	float x = vector->x, y = vector->y, z = vector->z;
+	result->x = dcm->m[0][0] * x + dcm->m[0][1] * y + dcm->m[0][2] * z;
+	result->y = dcm->m[1][0] * x + dcm->m[1][1] * y + dcm->m[1][2] * z;
+	result->z = dcm->m[2][0] * x + dcm->m[2][1] * y + dcm->m[2][2] * z;
+}
+
+void dcm_navi2body(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result)
+{
+	float x = vector->x, y = vector->y, z = vector->z;
+	result->x = dcm->m[0][0] * x + dcm->m[1][0] * y + dcm->m[2][0] * z;
+	result->y = dcm->m[0][1] * x + dcm->m[1][1] * y + dcm->m[2][1] * z;
+	result->z = dcm->m[0][2] * x + dcm->m[1][2] * y + dcm->m[2][2] * z;
+}
+
+void dcm_yaw(const float_mat3* dcm, float* cos_yaw, float* sin_yaw)
+{
+	// cos(pitch) * (cos(yaw), sin(yaw))
+	float c = dcm->m[0][0];
+	float s = dcm->m[1][0];
+	float norm = c * c + s * s;
+
+	if (norm < 1e-6f)
+	{
+		*cos_yaw = 1.0f;
+		*sin_yaw = 0.0f;
+		return;
+	}
+	norm = 1.0f / sqrtf(norm);
+	*cos_yaw = c * norm;
+	*sin_yaw = s * norm;
+}
+
+void dcm_navi2body_xy_plane(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result)
+{
+	float c, s;
+	dcm_yaw(dcm, &c, &s);
+
+	float x = vector->x, y = vector->y;
+	result->x = c * x + s * y;
+	result->y = -s * x + c * y;
+	result->z = vector->z; //leave direction normal to xy-plane untouched
+}
+
+float dcm_yaw_error(const float_mat3* dcm, float yaw_setpoint)
+{
+	float c, s;
+	dcm_yaw(dcm, &c, &s);
+
+	// Angle of (yaw - setpoint) from its sine and cosine
+	float cs = cosf(yaw_setpoint);
+	float ss = sinf(yaw_setpoint);
+	return atan2f(s * cs - c * ss, c * cs + s * ss);
+}
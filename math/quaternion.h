@@ -0,0 +1,122 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Quaternion and rotation matrix attitude
+ *
+ * All rotations are body to local (navigation) frame with the Euler
+ * convention of global_data.attitude and body2navi(): R = Rz(yaw) *
+ * Ry(pitch) * Rx(roll). The attitude filter integrates the quaternion
+ * from its rate estimate every tick and publishes it with its matrix,
+ * consumers rotate with the matrix and need no trigonometry.
+ *
+ * @author Lorenz Meier <mavteam@student.ethz.ch>
+ * @author Laurens Mackay <mavteam@student.ethz.ch>
+ */
+
+#ifndef QUATERNION_H_
+#define QUATERNION_H_
+
+#include "mav_vect.h"
+
+typedef struct
+{
+	float w;
+	float x;
+	float y;
+	float z;
+} float_quat;
+
+typedef struct
+{
+	float m[3][3];                    ///< Row major, m[row][col]
+} float_mat3;
+
+void quat_identity(float_quat* q);
+
+void quat_from_euler(const float_vect3* euler, float_quat* q);
+
+void quat_to_euler(const float_quat* q, float_vect3* euler);
+
+/** @brief Rotation matrix of a unit quaternion, no trigonometry */
+void quat_to_dcm(const float_quat* q, float_mat3* dcm);
+
+void quat_from_dcm(const float_mat3* dcm, float_quat* q);
+
+/** @brief c = a * b, rotation b followed by a */
+void quat_mult(const float_quat* a, const float_quat* b, float_quat* c);
+
+/** @brief Normalize with sqrt, for initialization */
+void quat_normalize(float_quat* q);
+
+/**
+ * @brief Integrate body rates over dt
+ *
+ * First order q += 0.5 * q * (0, rate) * dt, then renormalized with
+ * the first order approximation of 1/|q|, which needs no sqrt and keeps
+ * the norm at 1 as long as the step is small.
+ *
+ * @param rate Body rates in rad/s
+ * @param dt Time step in s
+ */
+void quat_integrate(float_quat* q, const float_vect3* rate, float dt);
+
+/**
+ * @brief Move q the fraction t towards target on the shorter arc
+ *
+ * Normalized linear interpolation, q and -q are the same rotation.
+ */
+void quat_nlerp(float_quat* q, const float_quat* target, float t);
+
+/** @brief result = dcm * vector, body to local frame */
+void dcm_body2navi(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result);
+
+/** @brief result = dcm' * vector, local to body frame */
+void dcm_navi2body(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result);
+
+/**
+ * @brief Cosine and sine of the yaw angle
+ *
+ * Taken from the projection of the body x axis on the horizontal plane,
+ * so yaw needs no wrapping. Yaw is undefined at +-90 degree pitch, then
+ * 0 is returned.
+ */
+void dcm_yaw(const float_mat3* dcm, float* cos_yaw, float* sin_yaw);
+
+/**
+ * @brief Rotate a local frame vector to the body frame in the xy-plane
+ *
+ * Same as navi2body_xy_plane() with the yaw of the matrix.
+ */
+void dcm_navi2body_xy_plane(const float_mat3* dcm, const float_vect3* vector,
+		float_vect3* result);
+
+/**
+ * @brief Yaw minus setpoint, in [-pi, pi] for any yaw and setpoint
+ */
+float dcm_yaw_error(const float_mat3* dcm, float yaw_setpoint);
+
+#endif /* QUATERNION_H_ */
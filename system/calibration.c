@@ -30,7 +30,9 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include <math.h>
 #include "calibration.h"
+#include "mag_calibration.h"
 #include "comm.h"
 #include "mavlink.h"
 #include "communication.h"
@@ -142,8 +144,8 @@ void start_rc_calibration(void)
 
 void start_mag_calibration(void)
 {
-	// not done here
-
+	// Runs online in the main loop, see mag_calibration.h
+	mag_calibration_start();
 }
 
 void start_pressure_calibration(void)
@@ -165,3 +167,96 @@ void start_gyro_calibration(void)
 		calibration_exit();
 	}
 }
+
+static uint64_t gyro_refine_end = 0;
+static float gyro_refine_mean[3];
+static uint16_t gyro_refine_count;
+static uint16_t gyro_refine_still;
+
+void gyro_fast_boot(void)
+{
+	// Current temperature and the first samples
+	gyro_read();
+
+	float raw[3] = { global_data.gyros_raw.x, global_data.gyros_raw.y, global_data.gyros_raw.z };
+	float t = global_data.temperature_gyros;
+	for (int i = 0; i < 3; i++)
+	{
+		if (global_data.param[PARAM_CAL_GYRO_TEMP_FIT_ACTIVE] == 1)
+		{
+			global_data.param[PARAM_GYRO_OFFSET_X + i] = global_data.param[PARAM_CAL_GYRO_TEMP_SLOPE_X + i]
+					* t + global_data.param[PARAM_CAL_GYRO_TEMP_FIT_X + i];
+		}
+		gyro_refine_mean[i] = raw[i];
+	}
+	global_data.param[PARAM_CAL_TEMP] = t;
+
+	gyro_refine_count = 0;
+	gyro_refine_still = 0;
+	gyro_refine_end = sys_time_clock_get_time_usec() + GYRO_REFINE_TIME;
+	debug_message_buffer("Fast boot: gyro bias from parameters");
+}
+
+void gyro_refine_bias(void)
+{
+	if (!gyro_refine_end)
+	{
+		return;
+	}
+	if (sys_time_clock_get_time_usec() > gyro_refine_end || sys_state_is_flying())
+	{
+		gyro_refine_end = 0;
+		if (gyro_refine_count < GYRO_REFINE_SAMPLES)
+		{
+			debug_message_buffer("Fast boot: not still, gyro bias not refined");
+			return;
+		}
+		// Move the model through the refined bias, the slope is kept
+		float t = global_data.temperature_gyros;
+		for (int i = 0; i < 3; i++)
+		{
+			global_data.param[PARAM_CAL_GYRO_TEMP_FIT_X + i] = global_data.param[PARAM_GYRO_OFFSET_X + i]
+					- global_data.param[PARAM_CAL_GYRO_TEMP_SLOPE_X + i] * t;
+		}
+		global_data.param[PARAM_CAL_TEMP] = t;
+		debug_message_buffer("Fast boot: gyro bias refined");
+		return;
+	}
+
+	float raw[3] = { global_data.gyros_raw.x, global_data.gyros_raw.y, global_data.gyros_raw.z };
+	float acc = sqrtf(global_data.accel_si.x * global_data.accel_si.x
+			+ global_data.accel_si.y * global_data.accel_si.y
+			+ global_data.accel_si.z * global_data.accel_si.z);
+	uint8_t still = fabsf(acc - 9.81f) < GYRO_STILL_ACC;
+
+	for (int i = 0; i < 3; i++)
+	{
+		gyro_refine_mean[i] += 0.1f * (raw[i] - gyro_refine_mean[i]);
+		if (fabsf(raw[i] - gyro_refine_mean[i]) > GYRO_STILL_NOISE)
+		{
+			still = 0;
+		}
+	}
+	// Short still moments, e.g. at the turning points of a motion, are no bias
+	if (!still)
+	{
+		gyro_refine_still = 0;
+		return;
+	}
+	if (gyro_refine_still < GYRO_STILL_SAMPLES)
+	{
+		gyro_refine_still++;
+		return;
+	}
+
+	// Average of the model bias, weighted as GYRO_REFINE_PRIOR samples, and the still samples
+	if (gyro_refine_count < GYRO_REFINE_SAMPLES)
+	{
+		gyro_refine_count++;
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		global_data.param[PARAM_GYRO_OFFSET_X + i] += (raw[i]
+				- global_data.param[PARAM_GYRO_OFFSET_X + i]) / (GYRO_REFINE_PRIOR + gyro_refine_count);
+	}
+}
@@ -38,4 +38,38 @@ void start_mag_calibration(void);
 void start_pressure_calibration(void);
 void start_gyro_calibration(void);
 
+/** Time after boot in usecs the gyro bias is refined while standing still */
+#define GYRO_REFINE_TIME 10000000
+/** Largest deviation in raw counts from the short term mean that counts as still */
+#define GYRO_STILL_NOISE 20
+/** Largest deviation in m/s^2 of the acceleration norm from g that counts as still */
+#define GYRO_STILL_ACC 1.0f
+/** Samples in a row that have to be still before they are used */
+#define GYRO_STILL_SAMPLES 100
+/** Still samples averaged into the bias, the average becomes a low pass after that */
+#define GYRO_REFINE_SAMPLES 400
+/** Weight of the stored bias in still samples, it is the first term of the average */
+#define GYRO_REFINE_PRIOR 20
+
+/**
+ * @brief Set the gyro bias from the stored temperature model
+ *
+ * Fast boot replacement of the 2 s wait and gyro_init(). With
+ * CAL_FIT_ACTIVE the bias is CAL_FIT_SLP * temperature + CAL_FIT_GYRO,
+ * else the last CAL_GYRO calibration is kept. gyro_refine_bias() then
+ * improves it during the first GYRO_REFINE_TIME.
+ */
+void gyro_fast_boot(void);
+
+/**
+ * @brief Average the gyros into CAL_GYRO while the vehicle stands still
+ *
+ * Called after every gyro_read(), does nothing outside of the window
+ * started by gyro_fast_boot(). The bias set there counts as
+ * GYRO_REFINE_PRIOR samples of the average, so single samples do not
+ * replace it. At the end of the window the temperature model is moved
+ * to the refined bias, store the parameters to keep it.
+ */
+void gyro_refine_bias(void);
+
 #endif /* CALIBRATION_H_ */
@@ -50,10 +50,16 @@
 
 #include "control_quadrotor_position.h"
 #include "params.h"
+#include "param_lookup.h"
+#include "mavlink_router.h"
+#include "log_stream.h"
 #include "gps_transformations.h"
 #include "outdoor_position_kalman.h"
+#include "measurement_queue.h"
 
 static uint32_t m_parameter_i = 0;
+static uint32_t m_time_sync_seq = 0;
+static uint64_t m_time_sync_sent = 0;
 
 static void send_system_state(void)
 {
@@ -100,6 +106,10 @@ void execute_command(mavlink_command_long_t* cmd)
 			start_gyro_calibration();
 			m_parameter_i = 0;
 		}
+		if (cmd->param2 == 1)
+		{
+			start_mag_calibration();
+		}
 	}
 	break;
 	default:
@@ -117,41 +127,8 @@ void execute_command(mavlink_command_long_t* cmd)
 void handle_mavlink_message(mavlink_channel_t chan,
 		mavlink_message_t* msg)
 {
-	uint8_t buf[MAVLINK_MAX_PACKET_LEN];
-	uint32_t len;
-	switch (chan)
-	{
-	case MAVLINK_COMM_0:
-	{
-		if (msg->msgid != MAVLINK_MSG_ID_VISION_POSITION_ESTIMATE && msg->msgid != MAVLINK_MSG_ID_VICON_POSITION_ESTIMATE && msg->msgid != MAVLINK_MSG_ID_IMAGE_TRIGGER_CONTROL && msg->msgid != MAVLINK_MSG_ID_OPTICAL_FLOW)
-		{
-			// Copy to COMM 1
-			len = mavlink_msg_to_send_buffer(buf, msg);
-			for (int i = 0; i < len; i++)
-			{
-				uart1_transmit(buf[i]);
-			}
-		}
-	}
-	break;
-	case MAVLINK_COMM_1:
-	{
-		if (msg->msgid != MAVLINK_MSG_ID_VISION_POSITION_ESTIMATE && msg->msgid != MAVLINK_MSG_ID_VICON_POSITION_ESTIMATE && msg->msgid != MAVLINK_MSG_ID_IMAGE_TRIGGER_CONTROL)
-		{
-			// Copy to COMM 0
-			len = mavlink_msg_to_send_buffer(buf, msg);
-			for (int i = 0; i < len; i++)
-			{
-				uart0_transmit(buf[i]);
-			}
-			break;
-		}
-	}
-	break;
-	default:
-		break;
-	}
-
+	// Copy to the other links that need this message
+	mavlink_router_forward(chan, msg);
 
 	switch (msg->msgid)
 	{
@@ -179,19 +156,16 @@ void handle_mavlink_message(mavlink_channel_t chan,
 	break;
 	case MAVLINK_MSG_ID_SYSTEM_TIME:
 	{
-		if (!sys_time_clock_get_unix_offset())
+		// One-way timestamp, only starts the clock synchronization
+		if (!sys_time_clock_get_sync()->synced)
 		{
+			uint64_t now = sys_time_clock_get_time_usec();
 			int64_t offset = ((int64_t) mavlink_msg_system_time_get_time_unix_usec(
-					msg)) - (int64_t) sys_time_clock_get_time_usec();
-			sys_time_clock_set_unix_offset(offset);
+					msg)) - (int64_t) now;
+			sys_time_clock_sync_update(now, offset, 0);
 
 			debug_message_buffer("UNIX offset updated");
 		}
-		else
-		{
-
-			//			debug_message_buffer("UNIX offset REFUSED");
-		}
 	}
 	break;
 	case MAVLINK_MSG_ID_REQUEST_DATA_STREAM:
@@ -260,39 +234,21 @@ void handle_mavlink_message(mavlink_channel_t chan,
 				{
 					// Report back value
 					mavlink_msg_param_value_send(chan,
-							(int8_t*) global_data.param_name[set.param_index],
+							(int8_t*) param_table[set.param_index].name,
 							global_data.param[set.param_index], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, set.param_index);
 				}
 			}
 			else
 			{
-				for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
-				{
-					bool match = true;
-					for (int j = 0; j < ONBOARD_PARAM_NAME_LENGTH; j++)
-					{
-						// Compare
-						if (((char) (global_data.param_name[i][j]))
-								!= (char) (key[j]))
-						{
-							match = false;
-						}
-
-						// End matching if null termination is reached
-						if (((char) global_data.param_name[i][j]) == '\0')
-						{
-							break;
-						}
-					}
+				int16_t i = param_lookup(key);
 
-					// Check if matched
-					if (match)
-					{
-						// Report back value
-						mavlink_msg_param_value_send(chan,
-								(int8_t*) global_data.param_name[i],
-								global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, m_parameter_i);
-					}
+				// Check if matched
+				if (i >= 0)
+				{
+					// Report back value
+					mavlink_msg_param_value_send(chan,
+							(int8_t*) param_table[i].name,
+							global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, i);
 				}
 			}
 		}
@@ -317,46 +273,30 @@ void handle_mavlink_message(mavlink_channel_t chan,
 		{
 			char* key = (char*) set.param_id;
 
-			for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
-			{
-				bool match = true;
-				for (int j = 0; j < ONBOARD_PARAM_NAME_LENGTH; j++)
-				{
-					// Compare
-					if (((char) (global_data.param_name[i][j]))
-							!= (char) (key[j]))
-					{
-						match = false;
-					}
+			int16_t i = param_lookup(key);
 
-					// End matching if null termination is reached
-					if (((char) global_data.param_name[i][j]) == '\0')
-					{
-						break;
-					}
-				}
+			// Check if matched
+			if (i >= 0)
+			{
+				float value = set.param_value;
 
-				// Check if matched
-				if (match)
+				// Only write and emit changes if there is actually a difference
+				// AND only write if new value is a number within the
+				// range and type given in param_table
+				if (param_value_valid(i, &value)
+						&& global_data.param[i] != value)
 				{
-					// Only write and emit changes if there is actually a difference
-					// AND only write if new value is NOT "not-a-number"
-					// AND is NOT infy
-					if (global_data.param[i] != set.param_value
-							&& !isnan(set.param_value)
-							&& !isinf(set.param_value))
-					{
-						global_data.param[i] = set.param_value;
-						// Report back new value
-						mavlink_msg_param_value_send(MAVLINK_COMM_0,
-								(int8_t*) global_data.param_name[i],
-								global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, m_parameter_i);
-						mavlink_msg_param_value_send(MAVLINK_COMM_1,
-								(int8_t*) global_data.param_name[i],
-								global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, m_parameter_i);
-
-						debug_message_buffer_sprintf("Parameter received param id=%i",i);
-					}
+					global_data.param[i] = value;
+					param_set_dirty(i);
+					// Report back new value
+					mavlink_msg_param_value_send(MAVLINK_COMM_0,
+							(int8_t*) param_table[i].name,
+							global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, i);
+					mavlink_msg_param_value_send(MAVLINK_COMM_1,
+							(int8_t*) param_table[i].name,
+							global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, i);
+
+					debug_message_buffer_sprintf("Parameter received param id=%i",i);
 				}
 			}
 		}
@@ -431,7 +371,9 @@ void handle_mavlink_message(mavlink_channel_t chan,
 		global_data.vicon_data.x = pos.x;
 		global_data.vicon_data.y = pos.y;
 		global_data.vicon_data.z = pos.z;
-		global_data.state.vicon_new_data=1;
+		measurement_queue_push(MEASUREMENT_VICON_POSITION,
+				sys_time_clock_get_time_usec(), pos.x, pos.y, pos.z,
+				MEASUREMENT_AXIS_XYZ, MEASUREMENT_VICON_VARIANCE);
 		// Update validity time
 		global_data.vicon_last_valid = sys_time_clock_get_time_usec();
 		global_data.state.vicon_ok=1;
@@ -518,7 +460,18 @@ void handle_mavlink_message(mavlink_channel_t chan,
 		{
 			// Respond to ping
 			uint64_t r_timestamp = sys_time_clock_get_unix_time();
-			mavlink_msg_ping_send(chan, ping.seq, msg->sysid, msg->compid, r_timestamp);
+			mavlink_msg_ping_send(chan, r_timestamp, ping.seq, msg->sysid, msg->compid);
+		}
+		else if (ping.target_system == (uint8_t) global_data.param[PARAM_SYSTEM_ID]
+				&& ping.target_component == (uint8_t) global_data.param[PARAM_COMPONENT_ID]
+				&& chan == MAVLINK_COMM_0 && ping.seq == m_time_sync_seq && m_time_sync_sent != 0)
+		{
+			// Response to our time sync request, stamped with the remote UNIX time
+			uint64_t now = sys_time_clock_get_time_usec();
+			uint32_t rtt = now - m_time_sync_sent;
+			uint64_t midpoint = m_time_sync_sent + rtt / 2;
+			sys_time_clock_sync_update(midpoint, (int64_t) ping.time_usec - (int64_t) midpoint, rtt);
+			m_time_sync_sent = 0;
 		}
 	}
 	break;
@@ -619,15 +572,23 @@ void communication_queued_send(void)
 	if (m_parameter_i < ONBOARD_PARAM_COUNT)
 	{
 		mavlink_msg_param_value_send(MAVLINK_COMM_0,
-				(int8_t*) global_data.param_name[m_parameter_i],
+				(int8_t*) param_table[m_parameter_i].name,
 				global_data.param[m_parameter_i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, m_parameter_i);
 		mavlink_msg_param_value_send(MAVLINK_COMM_1,
-				(int8_t*) global_data.param_name[m_parameter_i],
+				(int8_t*) param_table[m_parameter_i].name,
 				global_data.param[m_parameter_i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, m_parameter_i);
 		m_parameter_i++;
 	}
 }
 
+void communication_send_time_sync(void)
+{
+	// The onboard computer answers with its UNIX time, see MAVLINK_MSG_ID_PING
+	m_time_sync_seq++;
+	m_time_sync_sent = sys_time_clock_get_time_usec();
+	mavlink_msg_ping_send(MAVLINK_COMM_0, m_time_sync_sent, m_time_sync_seq, 0, 0);
+}
+
 uint32_t communication_get_uart_drop_rate(void)
 {
 	return ((global_data.comm.uart0_rx_drop_count*1000+1)/(global_data.comm.uart0_rx_success_count+1)) + ((global_data.comm.uart1_rx_drop_count*1000+1)/(global_data.comm.uart1_rx_success_count+1));
@@ -644,6 +605,18 @@ void communication_init(void)
 	{
 		global_data.state.uart1mode = UART_MODE_MAVLINK;
 	}
+
+	// The log stream takes the whole UART
+	if (global_data.param[PARAM_LOG_UART] == LOG_STREAM_UART0)
+	{
+		global_data.state.uart0mode = UART_MODE_LOG;
+	}
+	else if (global_data.param[PARAM_LOG_UART] == LOG_STREAM_UART1)
+	{
+		global_data.state.uart1mode = UART_MODE_LOG;
+	}
+	log_stream_init();
+	mavlink_router_init();
 }
 
 /**
@@ -726,7 +699,7 @@ void communication_receive(void)
 			{
 				// New GPS data received
 				//debug_message_buffer("RECEIVED NEW GPS DATA");
-				parse_gps_msg();
+				gps_msg_parse();
 
 				if (gps_lat == 0)
 				{
@@ -737,6 +710,19 @@ void communication_receive(void)
 				{
 					global_data.state.gps_ok = 1;
 
+					// A new GGA position fix, hand it to the position filter
+					if (global_data.state.gps_new_data)
+					{
+						global_data.state.gps_new_data = 0;
+						float_vect3 gps_local;
+						gps_get_local_position(&gps_local);
+						measurement_queue_push(MEASUREMENT_GPS_POSITION,
+								sys_time_clock_get_time_usec(), gps_local.x,
+								gps_local.y, 0, MEASUREMENT_AXIS_X
+										| MEASUREMENT_AXIS_Y,
+								MEASUREMENT_GPS_VARIANCE);
+					}
+
 //					mavlink_msg_gps_raw_send(
 //							global_data.param[PARAM_SEND_DEBUGCHAN],
 //							sys_time_clock_get_unix_loop_start_time(), gps_mode, gps_lat
@@ -54,6 +54,13 @@ void handle_mavlink_message(mavlink_channel_t chan, mavlink_message_t* msg);
 */
 void communication_queued_send(void);
 
+/**
+* @brief Start one two-way clock synchronization exchange with the onboard computer
+*
+* Sends a ping with the local time, the response feeds sys_time_clock_sync_update().
+*/
+void communication_send_time_sync(void);
+
 uint32_t communication_get_uart_drop_rate(void);
 
 void communication_init(void);
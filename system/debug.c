@@ -33,6 +33,7 @@
 #include "sys_time.h"
 #include <mavlink.h>
 #include <stdio.h>
+#include <string.h>
 #include "sys_time.h"
 
 //static char m_debug_buf[DEBUG_COUNT][DEBUG_MAX_LEN]; //old copy buffer
@@ -43,6 +44,46 @@ static uint8_t m_debug_index_write = 0;
 static uint8_t m_debug_index_read = 0;
 static uint16_t m_debug_count = 0;
 static uint8_t m_debug_was_full=0;
+
+/**
+ * Debug events, one ring per context. Each ring has one producer, the
+ * main loop, the IRQs (they do not nest) or the FIQ, which preempts the
+ * IRQs, and one consumer, debug_event_send() in the main loop. The
+ * producer only writes head, the consumer only tail, so neither needs to
+ * lock the other out.
+ */
+enum debug_event_ring_ids
+{
+	DEBUG_EVENT_RING_MAIN = 0,
+	DEBUG_EVENT_RING_IRQ,
+	DEBUG_EVENT_RING_FIQ,
+	DEBUG_EVENT_RINGS
+};
+
+typedef struct
+{
+	uint32_t time;                    ///< Low 32 bits of the onboard time in usecs
+	int32_t arg[3];
+	uint16_t id;
+	uint8_t argc;
+} debug_event_t;
+
+typedef struct
+{
+	debug_event_t event[DEBUG_EVENT_COUNT];
+	volatile uint8_t head;            ///< Next free entry, written by the producer
+	volatile uint8_t tail;            ///< Oldest entry, written by debug_event_send()
+	volatile uint32_t dropped;        ///< Events lost to a full ring, written by the producer
+} debug_event_ring_t;
+
+static debug_event_ring_t debug_event_rings[DEBUG_EVENT_RINGS];
+static uint32_t debug_event_dropped_sent[DEBUG_EVENT_RINGS];
+static uint16_t debug_event_seqnr = 0;
+
+#if (DEBUG_EVENT_COUNT & (DEBUG_EVENT_COUNT - 1)) || DEBUG_EVENT_COUNT > 128
+#error "DEBUG_EVENT_COUNT must be a power of 2 up to 128"
+#endif
+
 void debug_message_init()
 {
 //	for (int i = 0; i < DEBUG_COUNT; i++)
@@ -183,6 +224,187 @@ void debug_message_send_one(void)
 	mavlink_msg_statustext_send(MAVLINK_COMM_1, 0, (int8_t*) msg);
 }
 
+static inline unsigned debug_event_get_cpsr(void)
+{
+	unsigned retval;
+	asm volatile (" mrs  %0, cpsr" : "=r" (retval) : /* no inputs */  );
+	return retval;
+}
+
+/**
+ * @note This function is interrupt service routine (ISR) SAFE. The ring is
+ * picked by the processor mode, IRQ and FIQ handlers each write to their own.
+ */
+uint8_t debug_event_put(uint16_t id, uint8_t argc, int32_t a, int32_t b, int32_t c)
+{
+	unsigned mode = debug_event_get_cpsr() & 0x1F;
+	debug_event_ring_t* r = &debug_event_rings[(mode == 0x11) ? DEBUG_EVENT_RING_FIQ :
+			(mode == 0x12) ? DEBUG_EVENT_RING_IRQ : DEBUG_EVENT_RING_MAIN];
+	uint8_t head = r->head;
+
+	if ((uint8_t) (head - r->tail) >= DEBUG_EVENT_COUNT)
+	{
+		r->dropped++;
+		return 0;
+	}
+
+	debug_event_t* e = &r->event[head & (DEBUG_EVENT_COUNT - 1)];
+	e->time = (uint32_t) sys_time_clock_get_time_usec();
+	e->id = id;
+	e->argc = argc;
+	e->arg[0] = a;
+	e->arg[1] = b;
+	e->arg[2] = c;
+	// The entry has to be complete before the consumer sees the new head
+	asm volatile ("" ::: "memory");
+	r->head = head + 1;
+	return 1;
+}
+
+/** @brief Append v varint encoded, at most 5 bytes */
+static uint8_t debug_event_varint(uint8_t* buf, uint32_t v)
+{
+	uint8_t len = 0;
+
+	while (v >= 0x80)
+	{
+		buf[len++] = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	buf[len++] = v;
+	return len;
+}
+
+/** @brief Append v zigzag and varint encoded, at most 5 bytes */
+static uint8_t debug_event_zigzag(uint8_t* buf, int32_t v)
+{
+	return debug_event_varint(buf, ((uint32_t) v << 1) ^ (uint32_t) (v >> 31));
+}
+
+/** @brief Oldest buffered event of all rings, NULL if there is none */
+static debug_event_ring_t* debug_event_oldest(void)
+{
+	debug_event_ring_t* oldest = NULL;
+	uint32_t oldest_time = 0;
+
+	for (uint8_t i = 0; i < DEBUG_EVENT_RINGS; i++)
+	{
+		debug_event_ring_t* r = &debug_event_rings[i];
+		if (r->tail == r->head)
+		{
+			continue;
+		}
+		uint32_t time = r->event[r->tail & (DEBUG_EVENT_COUNT - 1)].time;
+		// Wraps after 71 minutes, compare the difference
+		if (oldest == NULL || (int32_t) (time - oldest_time) < 0)
+		{
+			oldest = r;
+			oldest_time = time;
+		}
+	}
+	return oldest;
+}
+
+static void debug_event_put32(uint8_t* p, uint32_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = v >> 24;
+}
+
+/**
+ * @brief Fill one packet with the oldest events
+ *
+ * Packet (little endian): DEBUG_EVENT_MAGIC (uint8), events dropped since
+ * the last packet (uint8, saturated), DEBUG_EVENT_TABLE_HASH (uint32),
+ * time of the first event (uint32), then per event the varints
+ * id << 2 | argc, the zigzag time difference to the event before and the
+ * zigzag arguments. The rest is 0, which is no valid event.
+ *
+ * @return events in the packet
+ */
+static uint8_t debug_event_pack(uint8_t* data)
+{
+	uint8_t record[3 + 4 * 5];
+	uint16_t pos = 10;
+	uint8_t count = 0;
+	uint32_t dropped = 0;
+	uint32_t last_time = 0;
+	debug_event_ring_t* r;
+
+	memset(data, 0, MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN);
+	for (uint8_t i = 0; i < DEBUG_EVENT_RINGS; i++)
+	{
+		uint32_t d = debug_event_rings[i].dropped;
+		dropped += d - debug_event_dropped_sent[i];
+		debug_event_dropped_sent[i] = d;
+	}
+
+	while ((r = debug_event_oldest()) != NULL)
+	{
+		const debug_event_t* e = &r->event[r->tail & (DEBUG_EVENT_COUNT - 1)];
+		uint8_t len;
+
+		if (count == 0)
+		{
+			last_time = e->time;
+		}
+		len = debug_event_varint(record, ((uint32_t) e->id << 2) | e->argc);
+		len += debug_event_zigzag(&record[len], (int32_t) (e->time - last_time));
+		for (uint8_t i = 0; i < e->argc; i++)
+		{
+			len += debug_event_zigzag(&record[len], e->arg[i]);
+		}
+		if (pos + len > MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN)
+		{
+			break;
+		}
+
+		if (count == 0)
+		{
+			debug_event_put32(&data[6], e->time);
+		}
+		memcpy(&data[pos], record, len);
+		pos += len;
+		last_time = e->time;
+		count++;
+		r->tail++;
+	}
+
+	data[0] = DEBUG_EVENT_MAGIC;
+	data[1] = (dropped > 255) ? 255 : dropped;
+	debug_event_put32(&data[2], DEBUG_EVENT_TABLE_HASH);
+	return count;
+}
+
+void debug_event_send(void)
+{
+	const uint16_t len = MAVLINK_MSG_ID_ENCAPSULATED_DATA_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+	uint8_t data[MAVLINK_MSG_ENCAPSULATED_DATA_FIELD_DATA_LEN];
+
+	for (uint8_t n = 0; n < DEBUG_EVENT_PACKETS; n++)
+	{
+		uint8_t space0 = comm_check_free_space(MAVLINK_COMM_0, len);
+		uint8_t space1 = comm_check_free_space(MAVLINK_COMM_1, len);
+
+		if (debug_event_oldest() == NULL || !(space0 || space1))
+		{
+			return;
+		}
+		debug_event_pack(data);
+		if (space0)
+		{
+			mavlink_msg_encapsulated_data_send(MAVLINK_COMM_0, debug_event_seqnr, data);
+		}
+		if (space1)
+		{
+			mavlink_msg_encapsulated_data_send(MAVLINK_COMM_1, debug_event_seqnr, data);
+		}
+		debug_event_seqnr++;
+	}
+}
+
 void debug_vect(const char* string, const float_vect3 vect)
 {
 	char name[DEBUG_VECT_NAME_MAX_LEN];
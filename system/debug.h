@@ -34,10 +34,18 @@ This file is part of the PIXHAWK project
 #include <comm.h>
 #include <mavlink.h>
 #include "mav_vect.h"
+#include "generated/debug_events.h"
 
 #define DEBUG_COUNT 16
 #define DEBUG_MAX_LEN MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN
 
+/** Buffered events per context (main loop, IRQ, FIQ), a power of 2 */
+#define DEBUG_EVENT_COUNT 64
+/** First byte of an event packet */
+#define DEBUG_EVENT_MAGIC 0xE7
+/** Event packets sent per debug_event_send() call at most */
+#define DEBUG_EVENT_PACKETS 2
+
 #define DEBUG_VECT_NAME_MAX_LEN MAVLINK_MSG_DEBUG_VECT_FIELD_NAME_LEN
 
 void debug_message_init(void);
@@ -56,5 +64,43 @@ void debug_message_send_one(void);
 
 void debug_vect(const char* string,const float_vect3 vect);
 
+/**
+ * @brief Buffer one debug event with up to three integer arguments
+ *
+ * Takes a few usecs and never blocks, call it from interrupts and the
+ * main loop. The text is not compiled in: tools/gen-debug-events.py
+ * collects the texts of all calls, assigns the DEBUG_EVENT_* ids and
+ * writes the string table the events are formatted with on the ground
+ * (tools/debug-event-decode.py). The id and the text have to be
+ * literals, the text is a printf format with one integer conversion per
+ * argument.
+ *
+ * Example: debug_event(DEBUG_EVENT_I2C_NACK, "I2C%u data not acknowledged, dest 0x%02X", 1, addr);
+ */
+#define debug_event(id, text, ...) \
+	debug_event_put((id), DEBUG_EVENT_ARGC(__VA_ARGS__), DEBUG_EVENT_ARGS(__VA_ARGS__))
+
+/* Argument count and the three arguments, missing ones are 0 */
+#define DEBUG_EVENT_ARGC(...) DEBUG_EVENT_ARGC_(_, ##__VA_ARGS__, DEBUG_EVENT_TOO_MANY_ARGUMENTS, 3, 2, 1, 0)
+#define DEBUG_EVENT_ARGC_(_, a, b, c, d, n, ...) n
+#define DEBUG_EVENT_ARGS(...) DEBUG_EVENT_ARGS_(_, ##__VA_ARGS__, 0, 0, 0)
+#define DEBUG_EVENT_ARGS_(_, a, b, c, ...) (int32_t) (a), (int32_t) (b), (int32_t) (c)
+
+/**
+ * @brief Buffer one debug event, use debug_event() instead
+ * @return 0 if the buffer of the calling context is full, the event is counted as dropped
+ */
+uint8_t debug_event_put(uint16_t id, uint8_t argc, int32_t a, int32_t b, int32_t c);
+
+/**
+ * @brief Send the buffered events, call from the main loop
+ *
+ * The events of all contexts are merged in time order into
+ * ENCAPSULATED_DATA packets on both channels, at most
+ * DEBUG_EVENT_PACKETS per call. Events stay buffered while neither
+ * channel has space.
+ */
+void debug_event_send(void);
+
 
 #endif /* DEBUG_H_ */
@@ -40,6 +40,7 @@ extern "C"
 #define _GLOBAL_DATA_H_
 #include "conf.h"
 #include "mav_vect.h"
+#include "quaternion.h"
 #include "pid.h"
 #include "string.h"
 
@@ -194,22 +195,51 @@ enum
 	PARAM_SONAR_SCALE,
 	PARAM_POSITION_HOVER_THRUST,
 	PARAM_I2C_ERR_REPORTING_ENABLED,
+	PARAM_LOG_UART,
+	PARAM_GPS_PROTOCOL,
+	PARAM_CAL_MAG_SCALE_X,
+	PARAM_CAL_MAG_SCALE_Y,
+	PARAM_CAL_MAG_SCALE_Z,
+	PARAM_CAL_MAG_MOTOR_X,
+	PARAM_CAL_MAG_MOTOR_Y,
+	PARAM_CAL_MAG_MOTOR_Z,
+	PARAM_CAL_MAG_AUTO,
+	PARAM_SYS_FAST_BOOT,
+	PARAM_CAL_GYRO_TEMP_SLOPE_X,
+	PARAM_CAL_GYRO_TEMP_SLOPE_Y,
+	PARAM_CAL_GYRO_TEMP_SLOPE_Z,
+	PARAM_LOG_SD,
 
 	ONBOARD_PARAM_COUNT
 ///< Store parameters in EEPROM and expose them over MAVLink paramter interface
 } global_param_id;
 
-// Testing new approach to save 1500 Bytes of RAM if we have 100 parameters.
-// can we let the global_data.param_name pointer point to this array in flash?
-static const char param_name[ONBOARD_PARAM_COUNT][ONBOARD_PARAM_NAME_LENGTH] =
+enum
 {
-	[PARAM_SYSTEM_ID] = "SYS_ID",
-	[PARAM_COMPONENT_ID] = "SYS_COMP_ID",
-	[PARAM_SYSTEM_TYPE] = "SYS_TYPE",
-	[PARAM_SW_VERSION] = "SYS_SW_VER",
-	[PARAM_IMU_RESET] = "SYS_IMU_RESET",
-	[PARAM_GPS_MODE] = "GPS_MODE"
-};
+	PARAM_TYPE_FLOAT = 0,   ///< Any value in [min, max]
+	PARAM_TYPE_INT = 1      ///< Integral value in [min, max], rounded when set
+} param_type_id;
+
+#define PARAM_FLAG_VOLATILE 0x01   ///< Never stored in or loaded from EEPROM
+
+/**
+ * @brief Metadata of one onboard parameter
+ *
+ * Values are always transmitted and stored as float, type only restricts
+ * which values are accepted.
+ */
+typedef struct
+{
+	char name[ONBOARD_PARAM_NAME_LENGTH];   ///< MAVLink parameter name
+	float def;                              ///< Default value
+	float min;                              ///< Smallest accepted value
+	float max;                              ///< Largest accepted value
+	uint8_t type;                           ///< PARAM_TYPE_*
+	uint8_t flags;                          ///< PARAM_FLAG_*
+} param_info_t;
+
+/// Parameter metadata in flash, defined in param_table.c
+extern const param_info_t param_table[ONBOARD_PARAM_COUNT];
 
 enum
 {
@@ -229,7 +259,8 @@ enum uartmodes
 {
 	UART_MODE_MAVLINK = 0,
 	UART_MODE_GPS = 1,
-	UART_MODE_BYTE_FORWARD = 2
+	UART_MODE_BYTE_FORWARD = 2,
+	UART_MODE_LOG = 3
 };
 
 enum YAW_ESTIMATION_MODE
@@ -318,6 +349,10 @@ typedef struct
 	uint32_t uart0_rx_success_count;  /// UART0 Receive successes
 	uint32_t uart1_rx_drop_count;     /// UART0 Receive drops
 	uint32_t uart1_rx_success_count;  /// UART0 Receive successes
+	uint32_t route_tx_bytes[MAVLINK_COMM_NUM_BUFFERS];   ///< Bytes forwarded onto each link
+	uint32_t route_drop_bytes[MAVLINK_COMM_NUM_BUFFERS]; ///< Bytes of targeted messages received on each link without a route
+	uint32_t log_drop_count;          ///< Log stream frames the UART could not take
+	uint32_t sd_log_drop_count;       ///< Log stream frames the SD card buffers could not take
 
 } comm_state_t;
 
@@ -351,6 +386,8 @@ struct global_struct
 	/// System state representation
 	float_vect3 attitude;                     ///< Angular position / attitude in Tait-Bryan angles (http://en.wikipedia.org/wiki/Yaw,_pitch,_and_roll)
 	float_vect3 attitude_rate;				  ///< Angular speed
+	float_quat attitude_q;                    ///< Attitude as unit quaternion, body to local frame
+	float_mat3 attitude_dcm;                  ///< Rotation matrix of attitude_q, use it instead of trigonometry on attitude
 	float_vect3 velocity;                        ///< Current speed of MAV in m/s
 	float_vect3 position;                     ///< vector from origin to mav in body coordinates
 	float_vect3 position_setpoint;            ///<
@@ -391,8 +428,7 @@ struct global_struct
 	PID_t pid_fx, pid_fy, pid_fz, pid_yaw, pid_yawspeed;
 	/* Global position setpoint*/
 	float_vect3 reference_world;
-	float param[ONBOARD_PARAM_COUNT];         ///< EEPROM parameter values
-	char param_name[ONBOARD_PARAM_COUNT][ONBOARD_PARAM_NAME_LENGTH];  ///< EEPROM parameter names
+	float param[ONBOARD_PARAM_COUNT];         ///< EEPROM parameter values, names are in param_table
 	float ground_distance;
 	float ground_distance_unfiltered;
 	float sonar_distance;
@@ -437,314 +473,14 @@ struct global_struct global_data;
  */
 static inline void global_data_reset_param_defaults(void){
 
-	global_data.param[PARAM_SYSTEM_ID] = 42;
-	strcpy(global_data.param_name[PARAM_SYSTEM_ID], "SYS_ID");
-
-	global_data.param[PARAM_COMPONENT_ID] = 200;
-	strcpy(global_data.param_name[PARAM_COMPONENT_ID], "SYS_COMP_ID");
-
-	global_data.param[PARAM_SYSTEM_TYPE] = MAV_TYPE_GENERIC;
-	strcpy(global_data.param_name[PARAM_SYSTEM_TYPE], "SYS_TYPE");
-
-	global_data.param[PARAM_SW_VERSION] = 2000;
-	strcpy(global_data.param_name[PARAM_SW_VERSION], "SYS_SW_VER");
-
-	global_data.param[PARAM_PPM_SAFETY_SWITCH_CHANNEL] = 5;
-	strcpy(global_data.param_name[PARAM_PPM_SAFETY_SWITCH_CHANNEL],
-			"RC_SAFETY_CHAN");
-
-	global_data.param[PARAM_UART0_BAUD] = 115200;//57600;//
-	strcpy(global_data.param_name[PARAM_UART0_BAUD], "UART_0_BAUD");
-
-	global_data.param[PARAM_UART1_BAUD] = 57600;//57600
-	strcpy(global_data.param_name[PARAM_UART1_BAUD], "UART_1_BAUD");
-
-	global_data.param[PARAM_PPM_TUNE1_CHANNEL] = 7;
-	strcpy(global_data.param_name[PARAM_PPM_TUNE1_CHANNEL], "RC_TUNE_CHAN1");
-	global_data.param[PARAM_PPM_TUNE2_CHANNEL] = 5;
-	strcpy(global_data.param_name[PARAM_PPM_TUNE2_CHANNEL], "RC_TUNE_CHAN2");
-	global_data.param[PARAM_PPM_TUNE3_CHANNEL] = 6;
-	strcpy(global_data.param_name[PARAM_PPM_TUNE3_CHANNEL], "RC_TUNE_CHAN3");
-	global_data.param[PARAM_PPM_TUNE4_CHANNEL] = 8;
-	strcpy(global_data.param_name[PARAM_PPM_TUNE4_CHANNEL], "RC_TUNE_CHAN4");
-
-	global_data.param[PARAM_PPM_THROTTLE_CHANNEL] = 3;
-	strcpy(global_data.param_name[PARAM_PPM_THROTTLE_CHANNEL], "RC_THRUST_CHAN");
-
-	global_data.param[PARAM_PPM_YAW_CHANNEL] = 4;
-	strcpy(global_data.param_name[PARAM_PPM_YAW_CHANNEL], "RC_YAW_CHAN");
-
-	global_data.param[PARAM_PPM_ROLL_CHANNEL] = 2;
-	strcpy(global_data.param_name[PARAM_PPM_ROLL_CHANNEL], "RC_ROLL_CHAN");
-
-	global_data.param[PARAM_TRIMCHAN] = 0;
-	strcpy(global_data.param_name[PARAM_TRIMCHAN], "RC_TRIM_CHAN");
-
-	global_data.param[PARAM_PPM_NICK_CHANNEL] = 1;
-	strcpy(global_data.param_name[PARAM_PPM_NICK_CHANNEL], "RC_NICK_CHAN");
-
-	global_data.param[PARAM_CAM_INTERVAL] = 36000;//32000;
-	strcpy(global_data.param_name[PARAM_CAM_INTERVAL], "CAM_INTERVAL");
-	global_data.param[PARAM_CAM_EXP] = 1000;
-	strcpy(global_data.param_name[PARAM_CAM_EXP], "CAM_EXP");
-
-	global_data.param[PARAM_POSITIONSETPOINT_ACCEPT] = 0;
-	strcpy(global_data.param_name[PARAM_POSITIONSETPOINT_ACCEPT],
-			"POS_SP_ACCEPT");
-
-	global_data.param[PARAM_POSITION_TIMEOUT] = 2000000;
-	strcpy(global_data.param_name[PARAM_POSITION_TIMEOUT],
-				"POS_TIMEOUT");
-
-
-
-	global_data.param[PARAM_POSITION_SETPOINT_X] =1.1f;//0.21;// 0.5;
-	global_data.param[PARAM_POSITION_SETPOINT_Y] =1.1f;//0.145;// 0.44;
-	global_data.param[PARAM_POSITION_SETPOINT_Z] = -0.8f;//-1.0;
-	global_data.param[PARAM_POSITION_SETPOINT_YAW] = 0.0f;
-
-	global_data.param[PARAM_POSITION_YAW_TRACKING]=0;
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		global_data.param[i] = param_table[i].def;
+	}
 
 	global_data.attitude_setpoint_pos_body_offset.x = 0.0f;
 	global_data.attitude_setpoint_pos_body_offset.y = 0.0f;
 	global_data.attitude_setpoint_pos_body_offset.z = 0.0f;
-
-
-
-	strcpy(global_data.param_name[PARAM_POSITION_SETPOINT_X],
-			"POS_SP_X");
-	strcpy(global_data.param_name[PARAM_POSITION_SETPOINT_Y],
-			"POS_SP_Y");
-	strcpy(global_data.param_name[PARAM_POSITION_SETPOINT_Z],
-			"POS_SP_Z");
-	strcpy(global_data.param_name[PARAM_POSITION_SETPOINT_YAW],
-			"POS_SP_YAW");
-	strcpy(global_data.param_name[PARAM_POSITION_YAW_TRACKING],
-			"POS_YAW_TRACK");
-
-
-//	// FOR FLYING WITHOUT CABLE
-//		global_data.param[PARAM_PID_ATT_P] = 45.3;
-//		strcpy(global_data.param_name[PARAM_PID_ATT_P], "PID_ATT_P");
-//		global_data.param[PARAM_PID_ATT_I] = 0;//0
-//		strcpy(global_data.param_name[PARAM_PID_ATT_I], "PID_ATT_I");
-//		global_data.param[PARAM_PID_ATT_D] = 14.9;
-//		strcpy(global_data.param_name[PARAM_PID_ATT_D], "PID_ATT_D");
-//		global_data.param[PARAM_PID_ATT_AWU] = 1;//1
-//		strcpy(global_data.param_name[PARAM_PID_ATT_AWU], "PID_ATT_AWU");
-
-// FOR FLYING WITH CABLE
-	global_data.param[PARAM_PID_ATT_P] = 90; // 45 Bravo
-	strcpy(global_data.param_name[PARAM_PID_ATT_P], "PID_ATT_P");
-	global_data.param[PARAM_PID_ATT_I] = 60; // 15 Bravo
-	strcpy(global_data.param_name[PARAM_PID_ATT_I], "PID_ATT_I");
-	global_data.param[PARAM_PID_ATT_D] = 30; // 15 Bravo
-	strcpy(global_data.param_name[PARAM_PID_ATT_D], "PID_ATT_D");
-	global_data.param[PARAM_PID_ATT_LIM] = 100;//not yet used!!!!
-	strcpy(global_data.param_name[PARAM_PID_ATT_LIM], "PID_ATT_LIM");
-	global_data.param[PARAM_PID_ATT_AWU] = 0.3;//1
-	strcpy(global_data.param_name[PARAM_PID_ATT_AWU], "PID_ATT_AWU");
-
-	global_data.param[PARAM_PID_YAWPOS_P] = 5;//1;
-	strcpy(global_data.param_name[PARAM_PID_YAWPOS_P], "PID_YAWPOS_P");
-	global_data.param[PARAM_PID_YAWPOS_I] = 0.1;//0
-	strcpy(global_data.param_name[PARAM_PID_YAWPOS_I], "PID_YAWPOS_I");
-	global_data.param[PARAM_PID_YAWPOS_D] = 1;//0.5;
-	strcpy(global_data.param_name[PARAM_PID_YAWPOS_D], "PID_YAWPOS_D");
-	global_data.param[PARAM_PID_YAWPOS_LIM] = 3;
-	strcpy(global_data.param_name[PARAM_PID_YAWPOS_LIM], "PID_YAWPOS_LIM");
-	global_data.param[PARAM_PID_YAWPOS_AWU] = 1;//1
-	strcpy(global_data.param_name[PARAM_PID_YAWPOS_AWU], "PID_YAWPOS_AWU");
-
-	global_data.param[PARAM_PID_YAWSPEED_P] = 15;
-	strcpy(global_data.param_name[PARAM_PID_YAWSPEED_P], "PID_YAWSPEED_P");
-	global_data.param[PARAM_PID_YAWSPEED_I] = 5;//0
-	strcpy(global_data.param_name[PARAM_PID_YAWSPEED_I], "PID_YAWSPEED_I");
-	global_data.param[PARAM_PID_YAWSPEED_D] = 0;
-	strcpy(global_data.param_name[PARAM_PID_YAWSPEED_D], "PID_YAWSPEED_D");
-	global_data.param[PARAM_PID_YAWSPEED_LIM] = 50;//not yet used!!!!
-	strcpy(global_data.param_name[PARAM_PID_YAWSPEED_LIM], "PID_YAWSPE_LIM");
-	global_data.param[PARAM_PID_YAWSPEED_AWU] = 1;//1
-	strcpy(global_data.param_name[PARAM_PID_YAWSPEED_AWU], "PID_YAWSPE_AWU");
-
-	// Position
-	global_data.param[PARAM_PID_POS_P] =1.8;// 1.6f;  //0.5; //2.4;//5
-	strcpy(global_data.param_name[PARAM_PID_POS_P], "PID_POS_P");
-	global_data.param[PARAM_PID_POS_I] =0.2;// 0.35f; //0.3;//0.1
-	strcpy(global_data.param_name[PARAM_PID_POS_I], "PID_POS_I");
-	global_data.param[PARAM_PID_POS_D] = 2.0f;  //0.5;//1.6;//1
-	strcpy(global_data.param_name[PARAM_PID_POS_D], "PID_POS_D");
-	global_data.param[PARAM_PID_POS_LIM] = 0.2;
-	strcpy(global_data.param_name[PARAM_PID_POS_LIM], "PID_POS_LIM");
-	global_data.param[PARAM_PID_POS_AWU] = 5;//1
-	strcpy(global_data.param_name[PARAM_PID_POS_AWU], "PID_POS_AWU");
-
-	global_data.param[PARAM_PID_POS_Z_P] = 0.5;
-	strcpy(global_data.param_name[PARAM_PID_POS_Z_P], "PID_POS_Z_P");
-	global_data.param[PARAM_PID_POS_Z_I] = 0.3;//0
-	strcpy(global_data.param_name[PARAM_PID_POS_Z_I], "PID_POS_Z_I");
-	global_data.param[PARAM_PID_POS_Z_D] = 0.2;
-	strcpy(global_data.param_name[PARAM_PID_POS_Z_D], "PID_POS_Z_D");
-	global_data.param[PARAM_PID_POS_Z_LIM] = 0.30;//1
-	strcpy(global_data.param_name[PARAM_PID_POS_Z_LIM], "PID_POS_Z_LIM");
-	global_data.param[PARAM_PID_POS_Z_AWU] = 3;//1
-	strcpy(global_data.param_name[PARAM_PID_POS_Z_AWU], "PID_POS_Z_AWU");
-
-
-	global_data.param[PARAM_GYRO_OFFSET_X] = 29760;//29777;//80
-	strcpy(global_data.param_name[PARAM_GYRO_OFFSET_X], "CAL_GYRO_X");
-	global_data.param[PARAM_GYRO_OFFSET_Y] = 29860;//29835;//29849;
-	strcpy(global_data.param_name[PARAM_GYRO_OFFSET_Y], "CAL_GYRO_Y");
-	global_data.param[PARAM_GYRO_OFFSET_Z] = 29877;//29880;//29898;
-	strcpy(global_data.param_name[PARAM_GYRO_OFFSET_Z], "CAL_GYRO_Z");
-	global_data.param[PARAM_CAL_TEMP] = 32.0f;//29880;//29898;
-	strcpy(global_data.param_name[PARAM_CAL_TEMP], "CAL_TEMP");
-
-	/** Magnetometer offset calibration */
-	strcpy(global_data.param_name[PARAM_CAL_MAG_OFFSET_X], "CAL_MAG_X");
-	global_data.param[PARAM_CAL_MAG_OFFSET_X] = 0;
-	strcpy(global_data.param_name[PARAM_CAL_MAG_OFFSET_Y], "CAL_MAG_Y");
-	global_data.param[PARAM_CAL_MAG_OFFSET_Y] = 0;
-	strcpy(global_data.param_name[PARAM_CAL_MAG_OFFSET_Z], "CAL_MAG_Z");
-	global_data.param[PARAM_CAL_MAG_OFFSET_Z] = 0;
-
-
-	global_data.param[PARAM_CAL_GYRO_TEMP_FIT_X] =  3.149677908834623E+04;
-	global_data.param[PARAM_CAL_GYRO_TEMP_FIT_Y] =  2.938336621296374e+04;
-	global_data.param[PARAM_CAL_GYRO_TEMP_FIT_Z] = 3.015110968108719e+04;
-	global_data.param[PARAM_CAL_GYRO_TEMP_FIT_ACTIVE] = 0;
-
-	strcpy(global_data.param_name[PARAM_CAL_GYRO_TEMP_FIT_X], "CAL_FIT_GYRO_X");
-	strcpy(global_data.param_name[PARAM_CAL_GYRO_TEMP_FIT_Y], "CAL_FIT_GYRO_Y");
-	strcpy(global_data.param_name[PARAM_CAL_GYRO_TEMP_FIT_Z], "CAL_FIT_GYRO_Z");
-	strcpy(global_data.param_name[PARAM_CAL_GYRO_TEMP_FIT_ACTIVE], "CAL_FIT_ACTIVE");
-
-	global_data.param[PARAM_CAL_PRES_DIFF_OFFSET] = 10000;
-	strcpy(global_data.param_name[PARAM_CAL_PRES_DIFF_OFFSET], "CAL_PRES_DIFF");
-
-	global_data.param[PARAM_ACC_OFFSET_X] = 0;//-13;
-	strcpy(global_data.param_name[PARAM_ACC_OFFSET_X], "CAL_ACC_X");
-	global_data.param[PARAM_ACC_OFFSET_Y] = 0;//13;
-	strcpy(global_data.param_name[PARAM_ACC_OFFSET_Y], "CAL_ACC_Y");
-	global_data.param[PARAM_ACC_OFFSET_Z] = 0;
-	strcpy(global_data.param_name[PARAM_ACC_OFFSET_Z], "CAL_ACC_Z");
-
-	global_data.param[PARAM_ACC_NAVI_OFFSET_X] = 0;//-8;
-	strcpy(global_data.param_name[PARAM_ACC_NAVI_OFFSET_X], "ACC_NAV_OFFS_X");
-	global_data.param[PARAM_ACC_NAVI_OFFSET_Y] = 0;// 12;
-	strcpy(global_data.param_name[PARAM_ACC_NAVI_OFFSET_Y], "ACC_NAV_OFFS_Y");
-	global_data.param[PARAM_ACC_NAVI_OFFSET_Z] = -1000;
-	strcpy(global_data.param_name[PARAM_ACC_NAVI_OFFSET_Z], "ACC_NAV_OFFS_Z");
-
-	global_data.param[PARAM_VEL_OFFSET_X] = 0;//-0.015;
-	strcpy(global_data.param_name[PARAM_VEL_OFFSET_X], "VEL_OFFSET_X");
-	global_data.param[PARAM_VEL_OFFSET_Y] = 0;//0.011;
-	strcpy(global_data.param_name[PARAM_VEL_OFFSET_Y], "VEL_OFFSET_Y");
-	global_data.param[PARAM_VEL_OFFSET_Z] = 0;
-	strcpy(global_data.param_name[PARAM_VEL_OFFSET_Z], "VEL_OFFSET_Z");
-
-	global_data.param[PARAM_VEL_DAMP] = 0.95;
-	strcpy(global_data.param_name[PARAM_VEL_DAMP], "VEL_DAMP");
-
-	global_data.param[PARAM_ATT_KAL_KACC] = 0.0033;
-	strcpy(global_data.param_name[PARAM_ATT_KAL_KACC], "ATT_KAL_KACC");
-
-	global_data.param[PARAM_ATT_KAL_YAW_ESTIMATION_MODE] = YAW_ESTIMATION_MODE_MAGNETOMETER;
-	strcpy(global_data.param_name[PARAM_ATT_KAL_YAW_ESTIMATION_MODE], "ATT_KAL_YAWMOD");
-
-	global_data.param[PARAM_ATT_OFFSET_X] =0;// -0.08;//-0.11;
-	strcpy(global_data.param_name[PARAM_ATT_OFFSET_X], "ATT_OFFSET_X");
-	global_data.param[PARAM_ATT_OFFSET_Y] =0;// -0.080;//0.085;
-	strcpy(global_data.param_name[PARAM_ATT_OFFSET_Y], "ATT_OFFSET_Y");
-	global_data.param[PARAM_ATT_OFFSET_Z] = -0.080;//-0.08;
-	strcpy(global_data.param_name[PARAM_ATT_OFFSET_Z], "ATT_OFFSET_Z");
-
-	global_data.param[PARAM_SEND_DEBUGCHAN] = MAVLINK_COMM_0;
-	strcpy(global_data.param_name[PARAM_SEND_DEBUGCHAN], "SEND_DEBUGCHAN");
-
-	// Always send attitude - this is a core system information
-	global_data.param[PARAM_SEND_SLOT_ATTITUDE] = 1;
-	global_data.param[PARAM_SEND_SLOT_RAW_IMU] = 0;
-	global_data.param[PARAM_SEND_SLOT_REMOTE_CONTROL] = 0;
-	global_data.param[PARAM_SEND_SLOT_CONTROLLER_OUTPUT] = 0;
-	global_data.param[PARAM_SEND_SLOT_DEBUG_1] = 0;
-	global_data.param[PARAM_SEND_SLOT_DEBUG_2] = 0;//1
-	global_data.param[PARAM_SEND_SLOT_DEBUG_3] = 0;
-	global_data.param[PARAM_SEND_SLOT_DEBUG_4] = 0;//1
-	global_data.param[PARAM_SEND_SLOT_DEBUG_5] = 0;
-	global_data.param[PARAM_SEND_SLOT_DEBUG_6] = 0;
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_ATTITUDE], "SLOT_ATTITUDE");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_RAW_IMU], "SLOT_RAW_IMU");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_REMOTE_CONTROL], "SLOT_RC");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_CONTROLLER_OUTPUT], "SLOT_CONTROL");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_1], "DEBUG_1");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_2], "DEBUG_2");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_3], "DEBUG_3");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_4], "DEBUG_4");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_5], "DEBUG_5");
-	strcpy(global_data.param_name[PARAM_SEND_SLOT_DEBUG_6], "DEBUG_6");
-
-	global_data.param[PARAM_MIX_REMOTE_WEIGHT] = 1;
-	strcpy(global_data.param_name[PARAM_MIX_REMOTE_WEIGHT], "MIX_REMOTE");
-	global_data.param[PARAM_MIX_POSITION_WEIGHT] = 1;
-	strcpy(global_data.param_name[PARAM_MIX_POSITION_WEIGHT], "MIX_POSITION");
-	global_data.param[PARAM_MIX_POSITION_Z_WEIGHT] = 1;
-		strcpy(global_data.param_name[PARAM_MIX_POSITION_Z_WEIGHT], "MIX_Z_POSITION");
-	global_data.param[PARAM_MIX_POSITION_YAW_WEIGHT] = 1;
-	strcpy(global_data.param_name[PARAM_MIX_POSITION_YAW_WEIGHT], "MIX_POS_YAW");
-	global_data.param[PARAM_MIX_OFFSET_WEIGHT] = 1;
-	strcpy(global_data.param_name[PARAM_MIX_OFFSET_WEIGHT], "MIX_OFFSET");
-
-	global_data.param[PARAM_VISION_ANG_OUTLAYER_TRESHOLD] = 0.2;
-	strcpy(global_data.param_name[PARAM_VISION_ANG_OUTLAYER_TRESHOLD], "VIS_OUTL_TRESH");
-
-	global_data.param[PARAM_POSITION_ESTIMATION_MODE] = POSITION_ESTIMATION_MODE_VICON_ONLY;
-	global_data.param[PARAM_VICON_TAKEOVER_DISTANCE] = 0.5;
-	global_data.param[PARAM_VICON_TAKEOVER_TIMEOUT] = 2;
-	strcpy(global_data.param_name[PARAM_POSITION_ESTIMATION_MODE], "POS_ESTIM_MODE");
-	strcpy(global_data.param_name[PARAM_VICON_TAKEOVER_DISTANCE],
-			"VICON_TKO_DIST");
-	strcpy(global_data.param_name[PARAM_VICON_TAKEOVER_TIMEOUT],
-			"VICON_TKO_TIME");
-
-
-	strcpy(global_data.param_name[PARAM_GPS_MODE], "GPS_MODE");
-	global_data.param[PARAM_GPS_MODE] = 0; //0: MAVLINK, 960010: GPS; // 9600 1 0: 9600 baud, mode 1 = U-Blox binary, on UART 0
-
-
-
-	strcpy(global_data.param_name[PARAM_CAM_ANGLE_X_OFFSET], "CAM_ANG_X_OFF");
-	strcpy(global_data.param_name[PARAM_CAM_ANGLE_X_FACTOR], "CAM_ANG_X_FAC");
-	strcpy(global_data.param_name[PARAM_CAM_ANGLE_Y_OFFSET], "CAM_ANG_Y_OFF");
-	strcpy(global_data.param_name[PARAM_CAM_ANGLE_Y_FACTOR], "CAM_ANG_Y_FAC");
-
-	global_data.param[PARAM_CAM_ANGLE_X_OFFSET] = 0;
-	global_data.param[PARAM_CAM_ANGLE_X_FACTOR] = 0;
-	global_data.param[PARAM_CAM_ANGLE_Y_OFFSET] = 0;
-	global_data.param[PARAM_CAM_ANGLE_Y_FACTOR] = 0;
-
-	global_data.param[PARAM_KAL_VEL_AX] = 0;
-	global_data.param[PARAM_KAL_VEL_BX] = 0;
-	global_data.param[PARAM_KAL_VEL_AY] = 0;
-	global_data.param[PARAM_KAL_VEL_BY] = 0;
-	strcpy(global_data.param_name[PARAM_KAL_VEL_AX], "KAL_VEL_AX");
-	strcpy(global_data.param_name[PARAM_KAL_VEL_BX], "KAL_VEL_BX");
-	strcpy(global_data.param_name[PARAM_KAL_VEL_AY], "KAL_VEL_AY");
-	strcpy(global_data.param_name[PARAM_KAL_VEL_BY], "KAL_VEL_BY");
-
-	global_data.param[PARAM_SONAR_MODE] = 0;
-	global_data.param[PARAM_SONAR_SCALE] = 1;
-	global_data.param[PARAM_POSITION_HOVER_THRUST] = 0.3;
-	strcpy(global_data.param_name[PARAM_SONAR_MODE], "POS_SON_MODE");
-	strcpy(global_data.param_name[PARAM_SONAR_SCALE], "POS_SON_SCALE");
-	strcpy(global_data.param_name[PARAM_POSITION_HOVER_THRUST], "POS_HOV_TRUST");
-
-	global_data.param[PARAM_I2C_ERR_REPORTING_ENABLED] = 0;
-	strcpy(global_data.param_name[PARAM_I2C_ERR_REPORTING_ENABLED], "REP_I2C_ERR");
-
-	global_data.param[PARAM_IMU_RESET] = 0;
-	strcpy(global_data.param_name[PARAM_IMU_RESET], "SYS_IMU_RESET");
-
 }
 /**
  * @brief resets the global data struct to all-zero values
@@ -775,6 +511,8 @@ static inline void global_data_reset(void)
 	global_data.comm.uart0_rx_success_count = 0;
 	global_data.comm.uart1_rx_drop_count = 0;
 	global_data.comm.uart1_rx_success_count = 0;
+	global_data.comm.log_drop_count = 0;
+	global_data.comm.sd_log_drop_count = 0;
 
 	global_data.ground_distance=0;
 	global_data.ground_distance_unfiltered = 0;
@@ -795,6 +533,9 @@ static inline void global_data_reset(void)
 	global_data.yaw_pos_setpoint = 0.f;
 	global_data.yaw_lowpass = 0.f;
 
+	quat_identity(&global_data.attitude_q);
+	quat_to_dcm(&global_data.attitude_q, &global_data.attitude_dcm);
+
 	global_data.position_control_output.x = 0.0f;
 	global_data.position_control_output.y = 0.0f;
 	global_data.position_control_output.z = 0.0f;
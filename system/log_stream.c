@@ -0,0 +1,400 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Binary full-rate log stream on a UART and the SD card
+ *   @author Lorenz Meier
+ *   @author Laurens MacKay
+ */
+
+#include <string.h>
+#include <mavlink.h>
+
+#include "log_stream.h"
+#include "global_data.h"
+#include "sys_time.h"
+#include "uart.h"
+#include "sd_log.h"
+
+typedef struct
+{
+	const char* name;
+	const void* src;
+	uint8_t type;
+	float scale;
+} log_field_t;
+
+/* Logged values, append new fields at the end to keep old logs decodable */
+#define LOG_FIELDS(LOG_FIELD) \
+	LOG_FIELD("t_us", 0, LOG_TYPE_UINT32, 1) \
+	LOG_FIELD("gyro_raw_x", &global_data.gyros_raw.x, LOG_TYPE_UINT16, 1) \
+	LOG_FIELD("gyro_raw_y", &global_data.gyros_raw.y, LOG_TYPE_UINT16, 1) \
+	LOG_FIELD("gyro_raw_z", &global_data.gyros_raw.z, LOG_TYPE_UINT16, 1) \
+	LOG_FIELD("acc_raw_x", &global_data.accel_raw.x, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("acc_raw_y", &global_data.accel_raw.y, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("acc_raw_z", &global_data.accel_raw.z, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("mag_raw_x", &global_data.magnet_raw.x, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("mag_raw_y", &global_data.magnet_raw.y, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("mag_raw_z", &global_data.magnet_raw.z, LOG_TYPE_INT16, 1) \
+	LOG_FIELD("pres_raw", &global_data.pressure_raw, LOG_TYPE_UINT32, 1) \
+	LOG_FIELD("gyro_x", &global_data.gyros_si.x, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("gyro_y", &global_data.gyros_si.y, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("gyro_z", &global_data.gyros_si.z, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("acc_x", &global_data.accel_si.x, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("acc_y", &global_data.accel_si.y, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("acc_z", &global_data.accel_si.z, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("roll", &global_data.attitude.x, LOG_TYPE_FLOAT, 10000) \
+	LOG_FIELD("pitch", &global_data.attitude.y, LOG_TYPE_FLOAT, 10000) \
+	LOG_FIELD("yaw", &global_data.attitude.z, LOG_TYPE_FLOAT, 10000) \
+	LOG_FIELD("pos_x", &global_data.position.x, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("pos_y", &global_data.position.y, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("pos_z", &global_data.position.z, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("vel_x", &global_data.velocity.x, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("vel_y", &global_data.velocity.y, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("vel_z", &global_data.velocity.z, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("att_out_x", &global_data.attitude_control_output.x, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("att_out_y", &global_data.attitude_control_output.y, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("att_out_z", &global_data.attitude_control_output.z, LOG_TYPE_FLOAT, 1000) \
+	LOG_FIELD("thrust_out", &global_data.thrust_control_output, LOG_TYPE_FLOAT, 1000)
+
+#define LOG_FIELD_ENTRY(name, src, type, scale) { name, src, type, scale },
+
+static const log_field_t log_fields[] =
+{
+	LOG_FIELDS(LOG_FIELD_ENTRY)
+};
+
+#define LOG_FIELD_COUNT (sizeof(log_fields) / sizeof(log_fields[0]))
+
+/* Schema payload: type, scale and name per field, larger than a key
+ * frame with one 5 byte varint per field */
+#define LOG_SCHEMA_MAX_LEN (LOG_FIELD_COUNT * 16)
+
+/* Exact schema length, the names are literals so sizeof counts them
+ * with their terminating null */
+#define LOG_FIELD_SCHEMA_LEN(name, src, type, scale) + 1 + sizeof(float) + sizeof(name)
+#define LOG_SCHEMA_LEN (0 LOG_FIELDS(LOG_FIELD_SCHEMA_LEN))
+
+/* A cut schema would make the decoder misread every record, so the
+ * schema and the index frame have to fit the frame buffer */
+typedef char log_schema_size_check[(LOG_SCHEMA_LEN <= LOG_SCHEMA_MAX_LEN
+		&& 4 + LOG_STREAM_INDEX_INTERVAL * 8 <= LOG_SCHEMA_MAX_LEN) ? 1 : -1];
+
+/* Every sink has its own seq and deltas, a frame it could not take
+ * only restarts the deltas of that sink */
+typedef struct
+{
+	uint8_t active;
+	uint16_t seq;
+	uint16_t frames_to_key;
+	uint16_t frames_to_schema;
+	int32_t last[LOG_FIELD_COUNT];
+	uint32_t* drop_count;
+} log_sink_t;
+
+enum
+{
+	LOG_SINK_UART = 0,
+	LOG_SINK_SD,
+	LOG_SINK_COUNT
+};
+
+/* Key frames of the SD log since the last index frame */
+typedef struct
+{
+	uint32_t time[LOG_STREAM_INDEX_INTERVAL];
+	uint32_t offset[LOG_STREAM_INDEX_INTERVAL];
+	uint8_t count;
+	uint32_t last;                    ///< File offset of the last index frame
+} log_index_t;
+
+static uint8_t log_uart;
+static log_sink_t log_sinks[LOG_SINK_COUNT];
+static log_index_t log_index;
+static uint8_t log_frame[7 + LOG_SCHEMA_MAX_LEN + 2];
+
+void log_stream_init(void)
+{
+	log_uart = (uint8_t) global_data.param[PARAM_LOG_UART];
+
+	for (uint8_t i = 0; i < LOG_SINK_COUNT; i++)
+	{
+		log_sinks[i].seq = 0;
+		log_sinks[i].frames_to_key = 0;
+		log_sinks[i].frames_to_schema = 0;
+	}
+	log_sinks[LOG_SINK_UART].active = (log_uart == LOG_STREAM_UART0 || log_uart == LOG_STREAM_UART1);
+	log_sinks[LOG_SINK_UART].drop_count = &global_data.comm.log_drop_count;
+	log_sinks[LOG_SINK_SD].active = sd_log_active();
+	log_sinks[LOG_SINK_SD].drop_count = &global_data.comm.sd_log_drop_count;
+	log_index.count = 0;
+	log_index.last = 0xFFFFFFFF;
+}
+
+static uint8_t log_stream_free_space(uint8_t sink, uint16_t len)
+{
+	if (sink == LOG_SINK_SD)
+	{
+		return sd_log_free_space(len);
+	}
+	if (log_uart == LOG_STREAM_UART0)
+	{
+		return uart0_check_free_space(len);
+	}
+	return uart1_check_free_space(len);
+}
+
+static void log_stream_write(uint8_t sink, const uint8_t* frame, uint16_t len)
+{
+	if (sink == LOG_SINK_SD)
+	{
+		sd_log_write(frame, len);
+		return;
+	}
+	for (uint16_t i = 0; i < len; i++)
+	{
+		if (log_uart == LOG_STREAM_UART0)
+		{
+			uart0_transmit(frame[i]);
+		}
+		else
+		{
+			uart1_transmit(frame[i]);
+		}
+	}
+}
+
+/**
+ * @brief Send one frame if the sink can take all of it
+ *
+ * The payload is at log_frame[7], the header and CRC are added here.
+ * @return 0 if the frame was dropped
+ */
+static uint8_t log_stream_send(uint8_t sink, uint8_t type, uint16_t len)
+{
+	log_sink_t* s = &log_sinks[sink];
+	uint16_t crc;
+
+	// Count dropped frames in seq too, so the receiver sees the gap
+	if (!log_stream_free_space(sink, len + 9))
+	{
+		s->seq++;
+		return 0;
+	}
+
+	log_frame[0] = LOG_STREAM_SYNC1;
+	log_frame[1] = LOG_STREAM_SYNC2;
+	log_frame[2] = type;
+	log_frame[3] = s->seq & 0xFF;
+	log_frame[4] = s->seq >> 8;
+	log_frame[5] = len & 0xFF;
+	log_frame[6] = len >> 8;
+
+	crc_init(&crc);
+	for (uint16_t i = 2; i < len + 7; i++)
+	{
+		crc_accumulate(log_frame[i], &crc);
+	}
+	log_frame[len + 7] = crc & 0xFF;
+	log_frame[len + 8] = crc >> 8;
+
+	log_stream_write(sink, log_frame, len + 9);
+	s->seq++;
+	return 1;
+}
+
+static uint8_t log_stream_send_schema(uint8_t sink)
+{
+	uint8_t* buf = &log_frame[7];
+	uint16_t len = 0;
+
+	for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++)
+	{
+		uint16_t name_len = strlen(log_fields[i].name) + 1;
+		buf[len++] = log_fields[i].type;
+		memcpy(&buf[len], &log_fields[i].scale, sizeof(float));
+		len += sizeof(float);
+		memcpy(&buf[len], log_fields[i].name, name_len);
+		len += name_len;
+	}
+	return log_stream_send(sink, LOG_FRAME_SCHEMA, len);
+}
+
+static void log_stream_put32(uint8_t* p, uint32_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = v >> 24;
+}
+
+/** @brief Send the collected key frames of the SD log, keeps them if it fails */
+static void log_stream_send_index(void)
+{
+	uint8_t* buf = &log_frame[7];
+	uint32_t position = sd_log_position();
+
+	log_stream_put32(buf, log_index.last);
+	for (uint8_t i = 0; i < log_index.count; i++)
+	{
+		log_stream_put32(&buf[4 + i * 8], log_index.time[i]);
+		log_stream_put32(&buf[8 + i * 8], log_index.offset[i]);
+	}
+	if (log_stream_send(LOG_SINK_SD, LOG_FRAME_INDEX, 4 + log_index.count * 8))
+	{
+		log_index.last = position;
+		log_index.count = 0;
+	}
+	else
+	{
+		log_sinks[LOG_SINK_SD].frames_to_key = 0;
+	}
+}
+
+static int32_t log_stream_value(uint8_t i, uint32_t now)
+{
+	const log_field_t* f = &log_fields[i];
+
+	switch (f->type)
+	{
+	case LOG_TYPE_FLOAT:
+	{
+		float v = *(const float*) f->src * f->scale;
+		// Saturate instead of wrapping on out of range values
+		if (v > 2147483520.0f)
+		{
+			return 0x7FFFFFFF;
+		}
+		if (v < -2147483520.0f)
+		{
+			return -0x7FFFFFFF - 1;
+		}
+		return (int32_t) (v < 0 ? v - 0.5f : v + 0.5f);
+	}
+	case LOG_TYPE_INT16:
+		return *(const int16_t*) f->src;
+	case LOG_TYPE_UINT16:
+		return *(const uint16_t*) f->src;
+	case LOG_TYPE_UINT32:
+		return f->src ? (int32_t) *(const uint32_t*) f->src : (int32_t) now;
+	default:
+		return 0;
+	}
+}
+
+/** @brief Append v zigzag and varint encoded, at most 5 bytes */
+static uint16_t log_stream_varint(uint8_t* buf, int32_t v)
+{
+	uint32_t z = ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+	uint16_t len = 0;
+
+	while (z >= 0x80)
+	{
+		buf[len++] = (z & 0x7F) | 0x80;
+		z >>= 7;
+	}
+	buf[len++] = z;
+	return len;
+}
+
+/** @brief Send a schema, key or delta frame of one sample to one sink */
+static void log_stream_sample_sink(uint8_t sink, const int32_t values[LOG_FIELD_COUNT])
+{
+	log_sink_t* s = &log_sinks[sink];
+	uint8_t* buf = &log_frame[7];
+	uint16_t len = 0;
+	uint8_t key;
+
+	if (s->frames_to_schema == 0)
+	{
+		// Skip samples until the sink has room for the schema
+		if (!log_stream_send_schema(sink))
+		{
+			(*s->drop_count)++;
+			return;
+		}
+		s->frames_to_schema = LOG_STREAM_SCHEMA_INTERVAL;
+		s->frames_to_key = 0;
+	}
+	s->frames_to_schema--;
+
+	key = (s->frames_to_key == 0);
+
+	for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++)
+	{
+		len += log_stream_varint(&buf[len], key ? values[i] : (int32_t) ((uint32_t) values[i] - (uint32_t) s->last[i]));
+	}
+
+	uint32_t position = (sink == LOG_SINK_SD) ? sd_log_position() : 0;
+	if (log_stream_send(sink, key ? LOG_FRAME_KEY : LOG_FRAME_DELTA, len))
+	{
+		memcpy(s->last, values, sizeof(s->last));
+		s->frames_to_key = key ? LOG_STREAM_KEY_INTERVAL - 1 : s->frames_to_key - 1;
+
+		// Key frames while an index frame is pending are not indexed, a
+		// reader finds them from the previous one
+		if (sink == LOG_SINK_SD && key && log_index.count < LOG_STREAM_INDEX_INTERVAL)
+		{
+			log_index.time[log_index.count] = values[0];
+			log_index.offset[log_index.count] = position;
+			log_index.count++;
+		}
+	}
+	else
+	{
+		// The receiver sees a gap in seq, resynchronize it with a key frame
+		s->frames_to_key = 0;
+		(*s->drop_count)++;
+	}
+
+	if (sink == LOG_SINK_SD && log_index.count == LOG_STREAM_INDEX_INTERVAL)
+	{
+		log_stream_send_index();
+	}
+}
+
+void log_stream_sample(void)
+{
+	int32_t values[LOG_FIELD_COUNT];
+
+	if (!log_sinks[LOG_SINK_UART].active && !log_sinks[LOG_SINK_SD].active)
+	{
+		return;
+	}
+
+	uint32_t now = (uint32_t) sys_time_clock_get_time_usec();
+	for (uint8_t i = 0; i < LOG_FIELD_COUNT; i++)
+	{
+		values[i] = log_stream_value(i, now);
+	}
+
+	for (uint8_t sink = 0; sink < LOG_SINK_COUNT; sink++)
+	{
+		// The SD log stops itself on a full file or card errors
+		if (log_sinks[sink].active && (sink != LOG_SINK_SD || sd_log_active()))
+		{
+			log_stream_sample_sink(sink, values);
+		}
+	}
+}
@@ -0,0 +1,103 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Binary full-rate log stream on a UART and the SD card
+ *
+ * Enabled with the SYS_LOG_UART parameter (1: UART0, 2: UART1), the
+ * UART then carries only log frames. Decode with tools/log-stream-decode.py.
+ * With the SYS_LOG_SD parameter the same frames are written to the SD
+ * card, see sd_log.h. Each sink has its own seq and deltas.
+ *
+ * Frame: 0xA5 0x5A, type, seq (uint16), payload length (uint16), payload,
+ * CRC-16/X.25 over type to payload (as MAVLink). All multi-byte values
+ * are little endian.
+ *
+ * - LOG_FRAME_SCHEMA: per field the type, scale (float) and a null
+ *   terminated name
+ * - LOG_FRAME_KEY: per field the zigzag varint encoded value
+ * - LOG_FRAME_DELTA: per field the zigzag varint encoded difference to
+ *   the previous frame
+ *
+ * - LOG_FRAME_INDEX: SD card only, the file offset of the previous index
+ *   frame (uint32, 0xFFFFFFFF for none), then per key frame since it the
+ *   t_us value (uint32) and the file offset of the frame (uint32)
+ *
+ * Values are fixed point, the physical value is the integer divided by
+ * the field scale. A gap in seq invalidates deltas until the next key
+ * frame, which is sent right after every frame the sink could not take.
+ *
+ * The index frames are a chain back from the end of an SD log, so a
+ * reader finds the key frame of any time without decoding the file.
+ */
+
+#ifndef LOG_STREAM_H_
+#define LOG_STREAM_H_
+
+#include "inttypes.h"
+
+#define LOG_STREAM_SYNC1 0xA5
+#define LOG_STREAM_SYNC2 0x5A
+
+/** Key frame every n frames, so a receiver can join the stream */
+#define LOG_STREAM_KEY_INTERVAL 200
+/** Schema every n frames */
+#define LOG_STREAM_SCHEMA_INTERVAL 1000
+/** Key frames per index frame on the SD card */
+#define LOG_STREAM_INDEX_INTERVAL 16
+
+enum
+{
+	LOG_FRAME_SCHEMA = 0,
+	LOG_FRAME_KEY = 1,
+	LOG_FRAME_DELTA = 2,
+	LOG_FRAME_INDEX = 3
+} log_frame_id;
+
+enum
+{
+	LOG_TYPE_FLOAT = 0,
+	LOG_TYPE_INT16 = 1,
+	LOG_TYPE_UINT16 = 2,
+	LOG_TYPE_UINT32 = 3
+} log_type_id;
+
+enum
+{
+	LOG_STREAM_OFF = 0,
+	LOG_STREAM_UART0 = 1,
+	LOG_STREAM_UART1 = 2
+} log_stream_uart_id;
+
+void log_stream_init(void);
+
+/**
+ * @brief Send one sample of all logged values
+ *
+ * Call at the rate of the attitude loop. Returns immediately if the log
+ * stream is disabled.
+ */
+void log_stream_sample(void);
+
+#endif /* LOG_STREAM_H_ */
@@ -0,0 +1,301 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Online magnetometer hard and soft iron calibration
+ *   @author Lorenz Meier
+ *   @author Laurens MacKay
+ */
+
+#include <math.h>
+#include <mavlink.h>
+
+#include "mag_calibration.h"
+#include "global_data.h"
+#include "debug.h"
+#include "params.h"
+
+/** Fitted terms: m_i^2, m_i, then with the motor term m_i * t, t, t^2 */
+#define MAG_CAL_TERMS 6
+#define MAG_CAL_TERMS_MOTOR 11
+
+typedef struct
+{
+	uint8_t terms;                    ///< 0 if not running
+	uint8_t once;                     ///< Stop after the first published result
+	uint8_t sample_new;
+	int16_vect3 sample;
+	float sample_thrust;
+	float theta[MAG_CAL_TERMS_MOTOR];
+	float p[MAG_CAL_TERMS_MOTOR][MAG_CAL_TERMS_MOTOR];
+	float last[3];                    ///< Last used sample in counts
+	float min[3];
+	float max[3];
+	float residual;                   ///< Low passed |fit - 1|
+	float check_offset[3];            ///< Offset at the last convergence check
+	uint32_t count;                   ///< Used samples
+} mag_calibration_t;
+
+static mag_calibration_t mag_cal;
+
+static void mag_calibration_reset(uint8_t mode, uint8_t once)
+{
+	mag_cal.terms = 0;
+	if (mode == MAG_CAL_ELLIPSOID)
+	{
+		mag_cal.terms = MAG_CAL_TERMS;
+	}
+	else if (mode == MAG_CAL_ELLIPSOID_MOTOR)
+	{
+		mag_cal.terms = MAG_CAL_TERMS_MOTOR;
+	}
+	mag_cal.once = once;
+	mag_cal.sample_new = 0;
+	mag_cal.count = 0;
+	mag_cal.residual = 1;
+
+	for (int i = 0; i < MAG_CAL_TERMS_MOTOR; i++)
+	{
+		mag_cal.theta[i] = 0;
+		for (int j = 0; j < MAG_CAL_TERMS_MOTOR; j++)
+		{
+			mag_cal.p[i][j] = (i == j) ? MAG_CAL_P_INIT : 0;
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		mag_cal.last[i] = 0;
+		mag_cal.min[i] = 32767;
+		mag_cal.max[i] = -32768;
+		mag_cal.check_offset[i] = 0;
+	}
+}
+
+void mag_calibration_init(void)
+{
+	mag_calibration_reset((uint8_t) global_data.param[PARAM_CAL_MAG_AUTO], 0);
+}
+
+void mag_calibration_start(void)
+{
+	uint8_t mode = (uint8_t) global_data.param[PARAM_CAL_MAG_AUTO];
+	mag_calibration_reset((mode == MAG_CAL_OFF) ? MAG_CAL_ELLIPSOID : mode, 1);
+	debug_message_buffer("Mag calibration started, rotate about all axes");
+}
+
+void mag_calibration_sample(const int16_vect3* mag, float thrust)
+{
+	mag_cal.sample = *mag;
+	mag_cal.sample_thrust = thrust;
+	mag_cal.sample_new = 1;
+}
+
+uint8_t mag_calibration_solve(mag_calibration_result_t* result)
+{
+	float o[3];
+	float k[3];
+	float r[3];
+	// Constant term of the ellipsoid, the fit is normalized to 1
+	float c = 1;
+
+	for (int i = 0; i < 3; i++)
+	{
+		float a = mag_cal.theta[i];
+		if (!(a > 0))
+		{
+			return 0;
+		}
+		o[i] = -mag_cal.theta[3 + i] / (2 * a);
+		k[i] = (mag_cal.terms == MAG_CAL_TERMS_MOTOR) ? -mag_cal.theta[6 + i] / (2 * a) : 0;
+		c += a * o[i] * o[i];
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		r[i] = sqrtf(c / mag_cal.theta[i]);
+	}
+	float radius = (r[0] + r[1] + r[2]) / 3;
+
+	result->offset.x = o[0] * MAG_CAL_NORM;
+	result->offset.y = o[1] * MAG_CAL_NORM;
+	result->offset.z = o[2] * MAG_CAL_NORM;
+	result->scale.x = radius / r[0];
+	result->scale.y = radius / r[1];
+	result->scale.z = radius / r[2];
+	result->motor.x = k[0] * MAG_CAL_NORM;
+	result->motor.y = k[1] * MAG_CAL_NORM;
+	result->motor.z = k[2] * MAG_CAL_NORM;
+	result->radius = radius * MAG_CAL_NORM;
+	return 1;
+}
+
+/** @brief One recursive least squares step of the fit against 1 */
+static void mag_calibration_fit(const float phi[MAG_CAL_TERMS_MOTOR])
+{
+	int n = mag_cal.terms;
+	float g[MAG_CAL_TERMS_MOTOR];
+	float d = 1;
+	float e = 1;
+
+	for (int i = 0; i < n; i++)
+	{
+		float sum = 0;
+		for (int j = 0; j < n; j++)
+		{
+			sum += mag_cal.p[i][j] * phi[j];
+		}
+		g[i] = sum;
+		d += phi[i] * sum;
+		e -= mag_cal.theta[i] * phi[i];
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		mag_cal.theta[i] += g[i] * e / d;
+		for (int j = i; j < n; j++)
+		{
+			mag_cal.p[i][j] -= g[i] * g[j] / d;
+			mag_cal.p[j][i] = mag_cal.p[i][j];
+		}
+		// Random walk in continuous mode, bounded so unexcited terms do not wind up
+		if (!mag_cal.once && mag_cal.p[i][i] < MAG_CAL_P_INIT)
+		{
+			mag_cal.p[i][i] += MAG_CAL_DRIFT;
+		}
+	}
+
+	mag_cal.residual += 0.02f * (fabsf(e) - mag_cal.residual);
+}
+
+static void mag_calibration_send_param(uint16_t i, float value)
+{
+	global_data.param[i] = value;
+	param_set_dirty(i);
+	mavlink_msg_param_value_send(MAVLINK_COMM_0, (int8_t*) param_table[i].name,
+			global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, i);
+	mavlink_msg_param_value_send(MAVLINK_COMM_1, (int8_t*) param_table[i].name,
+			global_data.param[i], MAVLINK_TYPE_FLOAT, ONBOARD_PARAM_COUNT, i);
+}
+
+static void mag_calibration_publish(const mag_calibration_result_t* cal)
+{
+	mag_calibration_send_param(PARAM_CAL_MAG_OFFSET_X, cal->offset.x);
+	mag_calibration_send_param(PARAM_CAL_MAG_OFFSET_Y, cal->offset.y);
+	mag_calibration_send_param(PARAM_CAL_MAG_OFFSET_Z, cal->offset.z);
+	mag_calibration_send_param(PARAM_CAL_MAG_SCALE_X, cal->scale.x);
+	mag_calibration_send_param(PARAM_CAL_MAG_SCALE_Y, cal->scale.y);
+	mag_calibration_send_param(PARAM_CAL_MAG_SCALE_Z, cal->scale.z);
+	if (mag_cal.terms == MAG_CAL_TERMS_MOTOR)
+	{
+		mag_calibration_send_param(PARAM_CAL_MAG_MOTOR_X, cal->motor.x);
+		mag_calibration_send_param(PARAM_CAL_MAG_MOTOR_Y, cal->motor.y);
+		mag_calibration_send_param(PARAM_CAL_MAG_MOTOR_Z, cal->motor.z);
+	}
+}
+
+/** @brief Publish the fit if it covers all axes and did not move since the last check */
+static void mag_calibration_check(void)
+{
+	mag_calibration_result_t cal;
+	if (!mag_calibration_solve(&cal))
+	{
+		return;
+	}
+
+	float o[3] = { cal.offset.x, cal.offset.y, cal.offset.z };
+	float s[3] = { cal.scale.x, cal.scale.y, cal.scale.z };
+	uint8_t converged = (mag_cal.count >= MAG_CAL_MIN_SAMPLES)
+			&& (mag_cal.residual < MAG_CAL_MAX_RESIDUAL);
+	float moved = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (mag_cal.max[i] - mag_cal.min[i] < MAG_CAL_COVERAGE * cal.radius
+				|| fabsf(o[i] - mag_cal.check_offset[i]) > MAG_CAL_MAX_CHANGE
+				|| s[i] < 0.5f || s[i] > 2.0f)
+		{
+			converged = 0;
+		}
+		mag_cal.check_offset[i] = o[i];
+		moved = fmaxf(moved, fabsf(o[i] - global_data.param[PARAM_CAL_MAG_OFFSET_X + i]));
+		moved = fmaxf(moved, fabsf(s[i] - global_data.param[PARAM_CAL_MAG_SCALE_X + i]) * cal.radius);
+	}
+
+	if (!converged || (!mag_cal.once && moved < MAG_CAL_REPUBLISH))
+	{
+		return;
+	}
+
+	mag_calibration_publish(&cal);
+	debug_message_buffer_sprintf("Mag calibration published, field %u counts",
+			(uint32_t) cal.radius);
+	if (mag_cal.once)
+	{
+		// Back to the configured mode
+		mag_calibration_init();
+	}
+}
+
+void mag_calibration_update(void)
+{
+	if (!mag_cal.terms || !mag_cal.sample_new)
+	{
+		return;
+	}
+	mag_cal.sample_new = 0;
+
+	float m[3] = { mag_cal.sample.x, mag_cal.sample.y, mag_cal.sample.z };
+	float step = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		step = fmaxf(step, fabsf(m[i] - mag_cal.last[i]));
+	}
+	if (step < MAG_CAL_MIN_STEP)
+	{
+		return;
+	}
+
+	float t = mag_cal.sample_thrust;
+	float phi[MAG_CAL_TERMS_MOTOR];
+	for (int i = 0; i < 3; i++)
+	{
+		mag_cal.last[i] = m[i];
+		mag_cal.min[i] = fminf(mag_cal.min[i], m[i]);
+		mag_cal.max[i] = fmaxf(mag_cal.max[i], m[i]);
+
+		float u = m[i] / MAG_CAL_NORM;
+		phi[i] = u * u;
+		phi[3 + i] = u;
+		phi[6 + i] = u * t;
+	}
+	phi[9] = t;
+	phi[10] = t * t;
+
+	mag_calibration_fit(phi);
+
+	mag_cal.count++;
+	if (mag_cal.count % MAG_CAL_CHECK_INTERVAL == 0)
+	{
+		mag_calibration_check();
+	}
+}
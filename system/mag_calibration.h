@@ -0,0 +1,116 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Online magnetometer hard and soft iron calibration
+ *
+ * Recursive least squares fit of an axis aligned ellipsoid to the raw
+ * HMC5843 samples, one O(1) update per sample with constant memory:
+ *
+ *   sum_i s_i * (m_i - o_i - k_i * t)^2 = 1
+ *
+ * m the raw sample, o the hard iron offset, s the soft iron scales,
+ * t the thrust (0 - 1) and k the offset the motor currents add at full
+ * thrust. The fit is linear in the expanded terms m_i^2, m_i, m_i * t,
+ * t and t^2, the thrust terms are only fitted with CAL_MAG_AUTO 2.
+ *
+ * Enabled with the CAL_MAG_AUTO parameter (0: off, 1: offsets and scales,
+ * 2: also the motor term) or for one run with MAV_CMD_PREFLIGHT_CALIBRATION
+ * (param2 = 1). Once the vehicle was rotated about all axes and the fit
+ * is stable, the result is written to the CAL_MAG_* parameters and sent
+ * to the ground station, it is applied by sensors_read_mag():
+ *
+ *   corrected_i = (m_i - CAL_MAG_i - CAL_MAG_MOT_i * t) * CAL_MAG_SCL_i
+ *
+ * The parameters are only marked as changed, like by PARAM_SET. They go
+ * to the EEPROM with the next MAV_CMD_PREFLIGHT_STORAGE write request, so
+ * the republished results of CAL_MAG_AUTO do not wear it.
+ */
+
+#ifndef MAG_CALIBRATION_H_
+#define MAG_CALIBRATION_H_
+
+#include "inttypes.h"
+#include "mav_vect.h"
+
+/** Samples are divided by this to keep the float fit well conditioned */
+#define MAG_CAL_NORM 1024.0f
+/** Initial covariance of the fit */
+#define MAG_CAL_P_INIT 1e4f
+/** Covariance added per sample in continuous mode, lets the fit follow slow changes */
+#define MAG_CAL_DRIFT 1e-4f
+/** Minimum distance in counts to the last used sample, skips samples while not rotating */
+#define MAG_CAL_MIN_STEP 16
+/** Minimum number of used samples before the fit is published */
+#define MAG_CAL_MIN_SAMPLES 300
+/** Used samples between two convergence checks */
+#define MAG_CAL_CHECK_INTERVAL 50
+/** Minimum span of the samples on each axis, in mean radii (2 is the full sphere) */
+#define MAG_CAL_COVERAGE 1.4f
+/** Maximum mean equation error |fit - 1| */
+#define MAG_CAL_MAX_RESIDUAL 0.05f
+/** Maximum offset change in counts between two checks */
+#define MAG_CAL_MAX_CHANGE 1.0f
+/** Offset change in counts that is published again in continuous mode */
+#define MAG_CAL_REPUBLISH 5.0f
+
+enum
+{
+	MAG_CAL_OFF = 0,
+	MAG_CAL_ELLIPSOID = 1,
+	MAG_CAL_ELLIPSOID_MOTOR = 2
+} mag_cal_auto_id;
+
+typedef struct
+{
+	float_vect3 offset;               ///< Hard iron offset in counts
+	float_vect3 scale;                ///< Soft iron scale, the mean radius is kept
+	float_vect3 motor;                ///< Offset change at full thrust in counts
+	float radius;                     ///< Mean field strength in counts
+} mag_calibration_result_t;
+
+/** @brief Start the continuous fit if the CAL_MAG_AUTO parameter is set */
+void mag_calibration_init(void);
+
+/** @brief Restart the fit, it stops after the result is published once */
+void mag_calibration_start(void);
+
+/**
+ * @brief Store a raw sample for the next mag_calibration_update()
+ *
+ * Cheap, called at the sensor rate. Samples arriving faster than the
+ * update rate replace each other.
+ */
+void mag_calibration_sample(const int16_vect3* mag, float thrust);
+
+/** @brief Fit the stored sample and publish a converged result, low priority */
+void mag_calibration_update(void);
+
+/**
+ * @brief Offsets, scales and motor term of the current fit
+ * @return 0 if the fit is not an ellipsoid (yet)
+ */
+uint8_t mag_calibration_solve(mag_calibration_result_t* result);
+
+#endif /* MAG_CALIBRATION_H_ */
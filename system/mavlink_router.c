@@ -0,0 +1,263 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief MAVLink routing between the communication links
+ *   @author Lorenz Meier
+ *   @author Laurens MacKay
+ */
+
+#include <stdbool.h>
+
+#include "mavlink_router.h"
+#include "global_data.h"
+#include "sys_time.h"
+
+typedef struct
+{
+	uint8_t sysid;
+	uint8_t compid;
+	uint8_t chan;
+	uint8_t used;
+	uint32_t last_seen_ms;
+} mavlink_route_t;
+
+static mavlink_route_t routes[MAVLINK_ROUTE_COUNT];
+
+#if COMM_NUM_CHANNELS > MAVLINK_COMM_NUM_BUFFERS
+#error "The route counters in global_data.comm need one entry per comm channel"
+#endif
+
+void mavlink_router_init(void)
+{
+	for (uint8_t i = 0; i < MAVLINK_ROUTE_COUNT; i++)
+	{
+		routes[i].used = 0;
+	}
+	for (uint8_t i = 0; i < COMM_NUM_CHANNELS; i++)
+	{
+		global_data.comm.route_tx_bytes[i] = 0;
+		global_data.comm.route_drop_bytes[i] = 0;
+	}
+}
+
+/**
+ * @brief Remember that sysid/compid is reachable over chan
+ *
+ * A system moving to another link takes over its entry, a full table
+ * replaces the entry that was heard from longest ago.
+ */
+static void mavlink_router_learn(mavlink_channel_t chan, uint8_t sysid, uint8_t compid)
+{
+	// Boot time, the UNIX offset steps when the clock is synchronized
+	uint32_t now = (uint32_t) (sys_time_clock_get_time_usec() / 1000);
+	uint8_t slot = 0;
+
+	for (uint8_t i = 0; i < MAVLINK_ROUTE_COUNT; i++)
+	{
+		if (routes[i].used && routes[i].sysid == sysid && routes[i].compid == compid)
+		{
+			slot = i;
+			break;
+		}
+		if (!routes[i].used)
+		{
+			slot = i;
+		}
+		else if (routes[slot].used && (now - routes[i].last_seen_ms) > (now - routes[slot].last_seen_ms))
+		{
+			slot = i;
+		}
+	}
+
+	routes[slot].sysid = sysid;
+	routes[slot].compid = compid;
+	routes[slot].chan = chan;
+	routes[slot].used = 1;
+	routes[slot].last_seen_ms = now;
+}
+
+/**
+ * @brief Extract the target of a message
+ *
+ * @return false if the message has no target, it is then a broadcast
+ */
+static bool mavlink_router_target(const mavlink_message_t* msg, uint8_t* sysid, uint8_t* compid)
+{
+	switch (msg->msgid)
+	{
+	case MAVLINK_MSG_ID_SET_MODE:
+		*sysid = mavlink_msg_set_mode_get_target_system(msg);
+		*compid = 0;
+		return true;
+	case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+		*sysid = mavlink_msg_param_request_read_get_target_system(msg);
+		*compid = mavlink_msg_param_request_read_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+		*sysid = mavlink_msg_param_request_list_get_target_system(msg);
+		*compid = mavlink_msg_param_request_list_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_PARAM_SET:
+		*sysid = mavlink_msg_param_set_get_target_system(msg);
+		*compid = mavlink_msg_param_set_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_COMMAND_LONG:
+		*sysid = mavlink_msg_command_long_get_target_system(msg);
+		*compid = mavlink_msg_command_long_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_REQUEST_DATA_STREAM:
+		*sysid = mavlink_msg_request_data_stream_get_target_system(msg);
+		*compid = mavlink_msg_request_data_stream_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_SET_LOCAL_POSITION_SETPOINT:
+		*sysid = mavlink_msg_set_local_position_setpoint_get_target_system(msg);
+		*compid = mavlink_msg_set_local_position_setpoint_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_SET_POSITION_CONTROL_OFFSET:
+		*sysid = mavlink_msg_set_position_control_offset_get_target_system(msg);
+		*compid = mavlink_msg_set_position_control_offset_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+		*sysid = mavlink_msg_mission_request_list_get_target_system(msg);
+		*compid = mavlink_msg_mission_request_list_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_MISSION_REQUEST:
+		*sysid = mavlink_msg_mission_request_get_target_system(msg);
+		*compid = mavlink_msg_mission_request_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_MISSION_COUNT:
+		*sysid = mavlink_msg_mission_count_get_target_system(msg);
+		*compid = mavlink_msg_mission_count_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_MISSION_ITEM:
+		*sysid = mavlink_msg_mission_item_get_target_system(msg);
+		*compid = mavlink_msg_mission_item_get_target_component(msg);
+		return true;
+	case MAVLINK_MSG_ID_MISSION_ACK:
+		*sysid = mavlink_msg_mission_ack_get_target_system(msg);
+		*compid = mavlink_msg_mission_ack_get_target_component(msg);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Messages consumed by this autopilot that are never forwarded
+ */
+static bool mavlink_router_local_only(mavlink_channel_t chan, const mavlink_message_t* msg)
+{
+	switch (msg->msgid)
+	{
+	case MAVLINK_MSG_ID_VISION_POSITION_ESTIMATE:
+	case MAVLINK_MSG_ID_VICON_POSITION_ESTIMATE:
+	case MAVLINK_MSG_ID_IMAGE_TRIGGER_CONTROL:
+		return true;
+	case MAVLINK_MSG_ID_OPTICAL_FLOW:
+		return chan == MAVLINK_COMM_0;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Queue a frame on a link, whole or not at all
+ *
+ * A cut frame would only corrupt the stream, so nothing is sent if the
+ * UART buffer has no room for all of it. Only queued bytes are counted.
+ */
+static void mavlink_router_send(mavlink_channel_t chan, const uint8_t* buf, uint16_t len)
+{
+	if (!comm_check_free_space(chan, len))
+	{
+		return;
+	}
+	for (uint16_t i = 0; i < len; i++)
+	{
+		comm_send_ch(chan, buf[i]);
+	}
+	global_data.comm.route_tx_bytes[chan] += len;
+}
+
+void mavlink_router_forward(mavlink_channel_t chan, const mavlink_message_t* msg)
+{
+	uint8_t own_sysid = (uint8_t) global_data.param[PARAM_SYSTEM_ID];
+	uint8_t target_sysid;
+	uint8_t target_compid;
+	uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+	uint16_t len;
+	bool forwarded = false;
+
+	// Our own messages echoed back by a link must not become a route
+	if (msg->sysid != own_sysid || msg->compid != (uint8_t) global_data.param[PARAM_COMPONENT_ID])
+	{
+		mavlink_router_learn(chan, msg->sysid, msg->compid);
+	}
+
+	if (mavlink_router_local_only(chan, msg))
+	{
+		return;
+	}
+
+	len = mavlink_msg_to_send_buffer(buf, msg);
+
+	if (!mavlink_router_target(msg, &target_sysid, &target_compid) || target_sysid == 0)
+	{
+		// Broadcast, copy once to every other MAVLink link
+		for (uint8_t out = 0; out < COMM_NUM_CHANNELS; out++)
+		{
+			if (out != chan && comm_ch_is_mavlink(out))
+			{
+				mavlink_router_send(out, buf, len);
+			}
+		}
+		return;
+	}
+
+	// Targeted, copy once to each other MAVLink link that has a matching system
+	for (uint8_t out = 0; out < COMM_NUM_CHANNELS; out++)
+	{
+		if (out == chan || !comm_ch_is_mavlink(out))
+		{
+			continue;
+		}
+		for (uint8_t i = 0; i < MAVLINK_ROUTE_COUNT; i++)
+		{
+			if (routes[i].used && routes[i].chan == out && routes[i].sysid == target_sysid
+					&& (target_compid == 0 || routes[i].compid == target_compid))
+			{
+				mavlink_router_send(out, buf, len);
+				forwarded = true;
+				break;
+			}
+		}
+	}
+
+	// Messages for this system are handled locally, everything else is dropped
+	if (!forwarded && target_sysid != own_sysid)
+	{
+		global_data.comm.route_drop_bytes[chan] += len;
+	}
+}
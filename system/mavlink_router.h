@@ -0,0 +1,57 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief MAVLink routing between the communication links
+ *
+ * Learns from received traffic behind which link each (sysid, compid)
+ * lives. Targeted messages are only copied to the link that owns the
+ * target, broadcasts are copied once to every other link.
+ */
+
+#ifndef MAVLINK_ROUTER_H_
+#define MAVLINK_ROUTER_H_
+
+#include "inttypes.h"
+#include "comm.h"
+
+#define MAVLINK_ROUTE_COUNT 8
+
+void mavlink_router_init(void);
+
+/**
+ * @brief Learn the route of a received message and forward it
+ *
+ * Only UARTs in MAVLink mode are links. Bytes queued on a link are
+ * counted in global_data.comm.route_tx_bytes of the outgoing link, a
+ * frame the UART buffer has no room for is not sent. Bytes of targeted
+ * messages without a route are counted in global_data.comm.route_drop_bytes
+ * of the receiving link.
+ *
+ * @param chan link the message was received on
+ * @param msg the received message
+ */
+void mavlink_router_forward(mavlink_channel_t chan, const mavlink_message_t* msg);
+
+#endif /* MAVLINK_ROUTER_H_ */
@@ -0,0 +1,59 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Parameter name to index lookup
+ */
+
+#include "param_lookup.h"
+#include "global_data.h"
+#include "generated/param_hash.h"
+
+/** FNV-1a over at most ONBOARD_PARAM_NAME_LENGTH chars, same as the generator */
+static inline uint32_t param_hash(uint32_t seed, const char* key)
+{
+	uint32_t h = PARAM_HASH_FNV_OFFSET ^ seed;
+	for (int i = 0; i < ONBOARD_PARAM_NAME_LENGTH && key[i] != '\0'; i++)
+	{
+		h ^= (uint8_t) key[i];
+		h *= PARAM_HASH_FNV_PRIME;
+	}
+	return h;
+}
+
+int16_t param_lookup(const char* key)
+{
+	uint32_t bucket = param_hash(0, key) & ((1 << PARAM_HASH_BUCKET_BITS) - 1);
+	// Multiply-shift instead of modulo, there is no hardware divide
+	uint32_t slot = ((uint64_t) param_hash(param_hash_seed[bucket], key)
+			* PARAM_HASH_COUNT) >> 32;
+	uint8_t id = param_hash_slot[slot];
+
+	// Every string hashes to some slot, reject names that are not ours
+	if (strncmp(param_table[id].name, key, ONBOARD_PARAM_NAME_LENGTH) == 0)
+	{
+		return id;
+	}
+	return -1;
+}
@@ -0,0 +1,46 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Parameter name to index lookup
+ *
+ * Uses the minimal perfect hash generated by tools/gen-param-hash.py
+ * from the parameter names in param_table.c (make generated).
+ */
+
+#ifndef PARAM_LOOKUP_H_
+#define PARAM_LOOKUP_H_
+
+#include "inttypes.h"
+
+/**
+ * @brief Find the PARAM_* index of a parameter name
+ *
+ * @param key MAVLink param_id, does not need to be null terminated if it
+ *            is ONBOARD_PARAM_NAME_LENGTH chars long
+ * @return index into global_data.param, -1 if the name is unknown
+ */
+int16_t param_lookup(const char* key);
+
+#endif /* PARAM_LOOKUP_H_ */
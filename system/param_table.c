@@ -0,0 +1,170 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Onboard parameter metadata
+ *
+ * Name, default, range and type of every onboard parameter. The table is
+ * const and stays in flash, only global_data.param lives in RAM.
+ * The ranges only reject what the code cannot use: out of range indices,
+ * modes and ids, negative limits and fractions outside 0..1. Gains,
+ * weights, offsets and setpoints are not bounded.
+ * tools/gen-param-hash.py reads the names from this file.
+ *
+ *   @author Lorenz Meier
+ *   @author Laurens MacKay
+ */
+
+#include <float.h>
+#include "global_data.h"
+
+const param_info_t param_table[ONBOARD_PARAM_COUNT] =
+{
+	[PARAM_SYSTEM_ID] = { "SYS_ID", 42, 1, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_COMPONENT_ID] = { "SYS_COMP_ID", 200, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SYSTEM_TYPE] = { "SYS_TYPE", MAV_TYPE_GENERIC, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SW_VERSION] = { "SYS_SW_VER", 2000, 0, 65535, PARAM_TYPE_INT, 0 },
+	[PARAM_IMU_RESET] = { "SYS_IMU_RESET", 0, 0, 255, PARAM_TYPE_INT, PARAM_FLAG_VOLATILE },
+	[PARAM_UART0_BAUD] = { "UART_0_BAUD", 115200, 1200, 921600, PARAM_TYPE_INT, 0 }, //57600;//
+	[PARAM_UART1_BAUD] = { "UART_1_BAUD", 57600, 1200, 921600, PARAM_TYPE_INT, 0 }, //57600
+	[PARAM_MIX_REMOTE_WEIGHT] = { "MIX_REMOTE", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_MIX_POSITION_WEIGHT] = { "MIX_POSITION", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_MIX_POSITION_Z_WEIGHT] = { "MIX_Z_POSITION", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_MIX_POSITION_YAW_WEIGHT] = { "MIX_POS_YAW", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_MIX_OFFSET_WEIGHT] = { "MIX_OFFSET", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_TRIMCHAN] = { "RC_TRIM_CHAN", 0, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	// Tuned for flying with cable, without cable: P 45.3, I 0, D 14.9, AWU 1
+	[PARAM_PID_ATT_P] = { "PID_ATT_P", 90, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 45 Bravo
+	[PARAM_PID_ATT_I] = { "PID_ATT_I", 60, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 15 Bravo
+	[PARAM_PID_ATT_D] = { "PID_ATT_D", 30, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 15 Bravo
+	[PARAM_PID_ATT_LIM] = { "PID_ATT_LIM", 100, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //not yet used!!!!
+	[PARAM_PID_ATT_AWU] = { "PID_ATT_AWU", 0.3, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_PID_POS_P] = { "PID_POS_P", 1.8, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 1.6f;  //0.5; //2.4;//5
+	[PARAM_PID_POS_I] = { "PID_POS_I", 0.2, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 0.35f; //0.3;//0.1
+	[PARAM_PID_POS_D] = { "PID_POS_D", 2.0f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0.5;//1.6;//1
+	[PARAM_PID_POS_LIM] = { "PID_POS_LIM", 0.2, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_POS_AWU] = { "PID_POS_AWU", 5, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_PID_POS_Z_P] = { "PID_POS_Z_P", 0.5, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_POS_Z_I] = { "PID_POS_Z_I", 0.3, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0
+	[PARAM_PID_POS_Z_D] = { "PID_POS_Z_D", 0.2, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_POS_Z_LIM] = { "PID_POS_Z_LIM", 0.30, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_PID_POS_Z_AWU] = { "PID_POS_Z_AWU", 3, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_PID_YAWPOS_P] = { "PID_YAWPOS_P", 5, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1;
+	[PARAM_PID_YAWPOS_I] = { "PID_YAWPOS_I", 0.1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0
+	[PARAM_PID_YAWPOS_D] = { "PID_YAWPOS_D", 1, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0.5;
+	[PARAM_PID_YAWPOS_LIM] = { "PID_YAWPOS_LIM", 3, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_YAWPOS_AWU] = { "PID_YAWPOS_AWU", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_PID_YAWSPEED_P] = { "PID_YAWSPEED_P", 15, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_YAWSPEED_I] = { "PID_YAWSPEED_I", 5, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0
+	[PARAM_PID_YAWSPEED_D] = { "PID_YAWSPEED_D", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_PID_YAWSPEED_LIM] = { "PID_YAWSPE_LIM", 50, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //not yet used!!!!
+	[PARAM_PID_YAWSPEED_AWU] = { "PID_YAWSPE_AWU", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //1
+	[PARAM_POSITIONSETPOINT_ACCEPT] = { "POS_SP_ACCEPT", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_POSITION_TIMEOUT] = { "POS_TIMEOUT", 2000000, 0, FLT_MAX, PARAM_TYPE_INT, 0 },
+	[PARAM_POSITION_SETPOINT_X] = { "POS_SP_X", 1.1f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0.21;// 0.5;
+	[PARAM_POSITION_SETPOINT_Y] = { "POS_SP_Y", 1.1f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0.145;// 0.44;
+	[PARAM_POSITION_SETPOINT_Z] = { "POS_SP_Z", -0.8f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //-1.0;
+	[PARAM_POSITION_SETPOINT_YAW] = { "POS_SP_YAW", 0.0f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_POSITION_YAW_TRACKING] = { "POS_YAW_TRACK", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_ATT_OFFSET_X] = { "ATT_OFFSET_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // -0.08;//-0.11;
+	[PARAM_ATT_OFFSET_Y] = { "ATT_OFFSET_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // -0.080;//0.085;
+	[PARAM_ATT_OFFSET_Z] = { "ATT_OFFSET_Z", -0.080, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //-0.08;
+	[PARAM_VEL_OFFSET_X] = { "VEL_OFFSET_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //-0.015;
+	[PARAM_VEL_OFFSET_Y] = { "VEL_OFFSET_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //0.011;
+	[PARAM_VEL_OFFSET_Z] = { "VEL_OFFSET_Z", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_VEL_DAMP] = { "VEL_DAMP", 0.95, 0, 1, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_ATT_KAL_KACC] = { "ATT_KAL_KACC", 0.0033, 0, 1, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_ATT_KAL_YAW_ESTIMATION_MODE] = { "ATT_KAL_YAWMOD", YAW_ESTIMATION_MODE_MAGNETOMETER, 0, YAW_ESTIMATION_MODE_GLOBAL_VISION, PARAM_TYPE_INT, 0 },
+	[PARAM_GYRO_OFFSET_X] = { "CAL_GYRO_X", 29760, 0, 65535, PARAM_TYPE_FLOAT, 0 }, //29777;//80
+	[PARAM_GYRO_OFFSET_Y] = { "CAL_GYRO_Y", 29860, 0, 65535, PARAM_TYPE_FLOAT, 0 }, //29835;//29849;
+	[PARAM_GYRO_OFFSET_Z] = { "CAL_GYRO_Z", 29877, 0, 65535, PARAM_TYPE_FLOAT, 0 }, //29880;//29898;
+	[PARAM_CAL_TEMP] = { "CAL_TEMP", 32.0f, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //29880;//29898;
+	[PARAM_CAL_GYRO_TEMP_FIT_X] = { "CAL_FIT_GYRO_X", 3.149677908834623E+04, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_GYRO_TEMP_FIT_Y] = { "CAL_FIT_GYRO_Y", 2.938336621296374e+04, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_GYRO_TEMP_FIT_Z] = { "CAL_FIT_GYRO_Z", 3.015110968108719e+04, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_GYRO_TEMP_FIT_ACTIVE] = { "CAL_FIT_ACTIVE", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_CAL_MAG_OFFSET_X] = { "CAL_MAG_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_OFFSET_Y] = { "CAL_MAG_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_OFFSET_Z] = { "CAL_MAG_Z", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_PRES_DIFF_OFFSET] = { "CAL_PRES_DIFF", 10000, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_ACC_OFFSET_X] = { "CAL_ACC_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //-13;
+	[PARAM_ACC_OFFSET_Y] = { "CAL_ACC_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //13;
+	[PARAM_ACC_OFFSET_Z] = { "CAL_ACC_Z", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_ACC_NAVI_OFFSET_X] = { "ACC_NAV_OFFS_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, //-8;
+	[PARAM_ACC_NAVI_OFFSET_Y] = { "ACC_NAV_OFFS_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 }, // 12;
+	[PARAM_ACC_NAVI_OFFSET_Z] = { "ACC_NAV_OFFS_Z", -1000, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_VISION_ANG_OUTLAYER_TRESHOLD] = { "VIS_OUTL_TRESH", 0.2, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_POSITION_ESTIMATION_MODE] = { "POS_ESTIM_MODE", POSITION_ESTIMATION_MODE_VICON_ONLY, 0, POSITION_ESTIMATION_MODE_OPTICAL_FLOW_ULTRASONIC_VISUAL_ODOMETRY_GLOBAL_VISION, PARAM_TYPE_INT, 0 },
+	[PARAM_VICON_TAKEOVER_DISTANCE] = { "VICON_TKO_DIST", 0.5, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_VICON_TAKEOVER_TIMEOUT] = { "VICON_TKO_TIME", 2, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_SEND_DEBUGCHAN] = { "SEND_DEBUGCHAN", MAVLINK_COMM_0, 0, MAVLINK_COMM_NUM_BUFFERS - 1, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_ATTITUDE] = { "SLOT_ATTITUDE", 1, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_RAW_IMU] = { "SLOT_RAW_IMU", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_REMOTE_CONTROL] = { "SLOT_RC", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_CONTROLLER_OUTPUT] = { "SLOT_CONTROL", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_DEBUG_1] = { "DEBUG_1", 0, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_DEBUG_2] = { "DEBUG_2", 0, 0, 255, PARAM_TYPE_INT, 0 }, //1
+	[PARAM_SEND_SLOT_DEBUG_3] = { "DEBUG_3", 0, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_DEBUG_4] = { "DEBUG_4", 0, 0, 255, PARAM_TYPE_INT, 0 }, //1
+	[PARAM_SEND_SLOT_DEBUG_5] = { "DEBUG_5", 0, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SEND_SLOT_DEBUG_6] = { "DEBUG_6", 0, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_SAFETY_SWITCH_CHANNEL] = { "RC_SAFETY_CHAN", 5, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_TUNE1_CHANNEL] = { "RC_TUNE_CHAN1", 7, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_TUNE2_CHANNEL] = { "RC_TUNE_CHAN2", 5, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_TUNE3_CHANNEL] = { "RC_TUNE_CHAN3", 6, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_TUNE4_CHANNEL] = { "RC_TUNE_CHAN4", 8, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_THROTTLE_CHANNEL] = { "RC_THRUST_CHAN", 3, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_YAW_CHANNEL] = { "RC_YAW_CHAN", 4, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_ROLL_CHANNEL] = { "RC_ROLL_CHAN", 2, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_PPM_NICK_CHANNEL] = { "RC_NICK_CHAN", 1, 0, PPM_NB_CHANNEL, PARAM_TYPE_INT, 0 },
+	[PARAM_GPS_MODE] = { "GPS_MODE", 0, 0, 999999, PARAM_TYPE_INT, 0 }, // 0: MAVLINK, 960010: GPS; // 9600 1 0: 9600 baud, mode 1 = U-Blox binary, on UART 0
+	[PARAM_CAM_INTERVAL] = { "CAM_INTERVAL", 36000, 0, FLT_MAX, PARAM_TYPE_INT, 0 }, //32000;
+	[PARAM_CAM_EXP] = { "CAM_EXP", 1000, 0, FLT_MAX, PARAM_TYPE_INT, 0 },
+	[PARAM_CAM_ANGLE_X_OFFSET] = { "CAM_ANG_X_OFF", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAM_ANGLE_X_FACTOR] = { "CAM_ANG_X_FAC", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAM_ANGLE_Y_OFFSET] = { "CAM_ANG_Y_OFF", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAM_ANGLE_Y_FACTOR] = { "CAM_ANG_Y_FAC", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_KAL_VEL_AX] = { "KAL_VEL_AX", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_KAL_VEL_AY] = { "KAL_VEL_AY", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_KAL_VEL_BX] = { "KAL_VEL_BX", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_KAL_VEL_BY] = { "KAL_VEL_BY", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_SONAR_MODE] = { "POS_SON_MODE", 0, 0, 255, PARAM_TYPE_INT, 0 },
+	[PARAM_SONAR_SCALE] = { "POS_SON_SCALE", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_POSITION_HOVER_THRUST] = { "POS_HOV_TRUST", 0.3, 0, 1, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_I2C_ERR_REPORTING_ENABLED] = { "REP_I2C_ERR", 0, 0, 1, PARAM_TYPE_INT, 0 },
+	[PARAM_LOG_UART] = { "SYS_LOG_UART", 0, 0, 2, PARAM_TYPE_INT, 0 }, // 0: off, 1: UART0, 2: UART1, see log_stream.h
+	[PARAM_GPS_PROTOCOL] = { "GPS_PROTOCOL", 0, 0, 1, PARAM_TYPE_INT, 0 }, // 0: NMEA, 1: U-Blox binary, see gps.h
+	[PARAM_CAL_MAG_SCALE_X] = { "CAL_MAG_SCL_X", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_SCALE_Y] = { "CAL_MAG_SCL_Y", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_SCALE_Z] = { "CAL_MAG_SCL_Z", 1, 0, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_MOTOR_X] = { "CAL_MAG_MOT_X", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_MOTOR_Y] = { "CAL_MAG_MOT_Y", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_MOTOR_Z] = { "CAL_MAG_MOT_Z", 0, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_MAG_AUTO] = { "CAL_MAG_AUTO", 0, 0, 2, PARAM_TYPE_INT, 0 }, // 0: off, 1: offsets and scales, 2: also motor term, see mag_calibration.h
+	[PARAM_SYS_FAST_BOOT] = { "SYS_FAST_BOOT", 0, 0, 1, PARAM_TYPE_INT, 0 }, // 1: no 2 s wait and gyro averaging at boot, see gyro_fast_boot()
+	[PARAM_CAL_GYRO_TEMP_SLOPE_X] = { "CAL_FIT_SLP_X", -0.060333834627133, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_GYRO_TEMP_SLOPE_Y] = { "CAL_FIT_SLP_Y", 0.020519379344279, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_CAL_GYRO_TEMP_SLOPE_Z] = { "CAL_FIT_SLP_Z", -0.024202371781532, -FLT_MAX, FLT_MAX, PARAM_TYPE_FLOAT, 0 },
+	[PARAM_LOG_SD] = { "SYS_LOG_SD", 0, 0, 1, PARAM_TYPE_INT, 0 }, // 1: log stream to LOGnnn.BIN on the SD card, read at boot, see sd_log.h
+};
@@ -9,6 +9,11 @@
 #include "debug.h"
 #include "eeprom.h"
 #include "global_data.h"
+#include "param_lookup.h"
+#include <math.h>
+#include <string.h>
+#include <stddef.h>
+#include <mavlink.h>
 
 //typedef union __generic_32bit
 //	{
@@ -18,157 +23,879 @@
 //		int16_t s;
 //	} generic_32bit;
 
-#define EEPROM_PARAM_CHECK_VALUE 1123456789
+/*
+ * Parameter log in the EEPROM
+ *
+ * The parameters are split into groups of PARAM_LOG_VALUES, each stored
+ * as one page sized record. Records are appended to a ring of
+ * PARAM_LOG_PAGES pages, the record of a group with the highest sequence
+ * number is the live one. Only groups with changed parameters are
+ * written, spread over the whole ring, and only once param_write_all()
+ * asked for it. Changes by PARAM_SET stay in RAM until then.
+ *
+ * The page after the write position is kept free of live records: if it
+ * holds one, that record is copied to the write position first. A write
+ * interrupted by a power loss thus only ever destroys a stale page.
+ *
+ * Every page write is followed by a read back of the page that verifies
+ * it. The read is only started once the write cycle is over
+ * (eeprom_write_ready()), the EEPROM does not answer before and the I2C
+ * driver gives up on a package after I2C_PERMANENT_ERROR_LIMIT errors.
+ */
+#define PARAM_LOG_START 0                         ///< EEPROM address of the ring
+#define PARAM_LOG_PAGES 64                        ///< Ring size, the boot scan reads all of it
+#define PARAM_LOG_MAGIC 0x4C50                    ///< "PL"
+#define PARAM_LOG_VERSION 1                       ///< Record format, part of the schema
+#define PARAM_LOG_VALUES 12
+#define PARAM_LOG_GROUPS ((ONBOARD_PARAM_COUNT + PARAM_LOG_VALUES - 1) / PARAM_LOG_VALUES)
+#define PARAM_LOG_NONE 0xFF                       ///< Group without a record
+#define PARAM_WRITE_RETRIES 3
+
+/*
+ * Parameter directory in the EEPROM, after the ring
+ *
+ * A header page with the schema and the count, then the names of the
+ * table the log was written with, PARAM_DIR_NAMES names per page. When
+ * the table changes, records of the old one are migrated by name: every
+ * parameter still in the table keeps its value, the groups are written
+ * again as records of the new table. The directory is only replaced once
+ * every group has such a record, so a power loss never leaves records
+ * that can no longer be mapped.
+ *
+ * Firmware before the log stored the PARAM_BASELINE_COUNT parameters of
+ * its table as one float each at 4 * id from address 0, followed by the
+ * int32 PARAM_BASELINE_CHECK_VALUE, without a CRC. param_baseline_id
+ * lists the parameters of that table in their old order. That block is
+ * read for the groups without a record if there are no records to
+ * migrate.
+ *
+ * Until the directory lists the current table, the writer skips the
+ * pages of the records and the block the values are taken from.
+ */
+#define PARAM_DIR_START (PARAM_LOG_START + PARAM_LOG_PAGES * EEPROM_PAGE_SIZE)
+#define PARAM_DIR_MAGIC 0x4450                    ///< "PD"
+#define PARAM_DIR_NAMES (EEPROM_PAGE_SIZE / 16)   ///< Names per page, 16 bytes each
+#define PARAM_DIR_MAX 192                         ///< Largest table a directory may list
+#define PARAM_DIR_PAGES(count) (1 + ((count) + PARAM_DIR_NAMES - 1) / PARAM_DIR_NAMES)
+#define PARAM_BASELINE_COUNT 111                  ///< ONBOARD_PARAM_COUNT of the firmware before the log
+#define PARAM_BASELINE_CHECK_VALUE 1123456789     ///< Its EEPROM_PARAM_CHECK_VALUE, at 4 * PARAM_BASELINE_COUNT
+#define PARAM_BASELINE_PAGES ((4 * PARAM_BASELINE_COUNT + 4 + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE)
+#define PARAM_MIGRATE_GROUPS ((PARAM_DIR_MAX + PARAM_LOG_VALUES - 1) / PARAM_LOG_VALUES)
+
+typedef struct
+{
+	uint16_t magic;
+	uint16_t schema;                              ///< CRC of the format version and all parameter names
+	uint32_t sequence;                            ///< Incremented per record, the highest is the newest
+	uint8_t group;                                ///< Holds parameters group * PARAM_LOG_VALUES ...
+	uint8_t reserved[3];
+	float value[PARAM_LOG_VALUES];
+	uint16_t crc;                                 ///< CRC-16/X.25 over all bytes before
+	uint16_t reserved2;
+} param_record_t;
+
+typedef struct
+{
+	uint16_t magic;
+	uint16_t schema;                              ///< Schema of the listed names, checked against them
+	uint16_t count;                               ///< Names in the directory
+} param_dir_header_t;
+
+/** @brief Current id of each parameter of the firmware before the log, in its EEPROM order */
+static const uint8_t param_baseline_id[] =
+{
+	PARAM_SYSTEM_ID, PARAM_COMPONENT_ID, PARAM_SYSTEM_TYPE, PARAM_SW_VERSION, PARAM_IMU_RESET,
+	PARAM_UART0_BAUD, PARAM_UART1_BAUD,
+	PARAM_MIX_REMOTE_WEIGHT, PARAM_MIX_POSITION_WEIGHT, PARAM_MIX_POSITION_Z_WEIGHT,
+	PARAM_MIX_POSITION_YAW_WEIGHT, PARAM_MIX_OFFSET_WEIGHT, PARAM_TRIMCHAN,
+	PARAM_PID_ATT_P, PARAM_PID_ATT_I, PARAM_PID_ATT_D, PARAM_PID_ATT_LIM, PARAM_PID_ATT_AWU,
+	PARAM_PID_POS_P, PARAM_PID_POS_I, PARAM_PID_POS_D, PARAM_PID_POS_LIM, PARAM_PID_POS_AWU,
+	PARAM_PID_POS_Z_P, PARAM_PID_POS_Z_I, PARAM_PID_POS_Z_D, PARAM_PID_POS_Z_LIM,
+	PARAM_PID_POS_Z_AWU,
+	PARAM_PID_YAWPOS_P, PARAM_PID_YAWPOS_I, PARAM_PID_YAWPOS_D, PARAM_PID_YAWPOS_LIM,
+	PARAM_PID_YAWPOS_AWU,
+	PARAM_PID_YAWSPEED_P, PARAM_PID_YAWSPEED_I, PARAM_PID_YAWSPEED_D, PARAM_PID_YAWSPEED_LIM,
+	PARAM_PID_YAWSPEED_AWU,
+	PARAM_POSITIONSETPOINT_ACCEPT, PARAM_POSITION_TIMEOUT, PARAM_POSITION_SETPOINT_X,
+	PARAM_POSITION_SETPOINT_Y, PARAM_POSITION_SETPOINT_Z, PARAM_POSITION_SETPOINT_YAW,
+	PARAM_POSITION_YAW_TRACKING,
+	PARAM_ATT_OFFSET_X, PARAM_ATT_OFFSET_Y, PARAM_ATT_OFFSET_Z,
+	PARAM_VEL_OFFSET_X, PARAM_VEL_OFFSET_Y, PARAM_VEL_OFFSET_Z,
+	PARAM_VEL_DAMP, PARAM_ATT_KAL_KACC, PARAM_ATT_KAL_YAW_ESTIMATION_MODE,
+	PARAM_GYRO_OFFSET_X, PARAM_GYRO_OFFSET_Y, PARAM_GYRO_OFFSET_Z, PARAM_CAL_TEMP,
+	PARAM_CAL_GYRO_TEMP_FIT_X, PARAM_CAL_GYRO_TEMP_FIT_Y, PARAM_CAL_GYRO_TEMP_FIT_Z,
+	PARAM_CAL_GYRO_TEMP_FIT_ACTIVE,
+	PARAM_CAL_MAG_OFFSET_X, PARAM_CAL_MAG_OFFSET_Y, PARAM_CAL_MAG_OFFSET_Z,
+	PARAM_CAL_PRES_DIFF_OFFSET,
+	PARAM_ACC_OFFSET_X, PARAM_ACC_OFFSET_Y, PARAM_ACC_OFFSET_Z,
+	PARAM_ACC_NAVI_OFFSET_X, PARAM_ACC_NAVI_OFFSET_Y, PARAM_ACC_NAVI_OFFSET_Z,
+	PARAM_VISION_ANG_OUTLAYER_TRESHOLD,
+	PARAM_POSITION_ESTIMATION_MODE, PARAM_VICON_TAKEOVER_DISTANCE,
+	PARAM_VICON_TAKEOVER_TIMEOUT,
+	PARAM_SEND_DEBUGCHAN,
+	PARAM_SEND_SLOT_ATTITUDE, PARAM_SEND_SLOT_RAW_IMU, PARAM_SEND_SLOT_REMOTE_CONTROL,
+	PARAM_SEND_SLOT_CONTROLLER_OUTPUT,
+	PARAM_SEND_SLOT_DEBUG_1, PARAM_SEND_SLOT_DEBUG_2, PARAM_SEND_SLOT_DEBUG_3,
+	PARAM_SEND_SLOT_DEBUG_4, PARAM_SEND_SLOT_DEBUG_5, PARAM_SEND_SLOT_DEBUG_6,
+	PARAM_PPM_SAFETY_SWITCH_CHANNEL, PARAM_PPM_TUNE1_CHANNEL, PARAM_PPM_TUNE2_CHANNEL,
+	PARAM_PPM_TUNE3_CHANNEL, PARAM_PPM_TUNE4_CHANNEL, PARAM_PPM_THROTTLE_CHANNEL,
+	PARAM_PPM_YAW_CHANNEL, PARAM_PPM_ROLL_CHANNEL, PARAM_PPM_NICK_CHANNEL,
+	PARAM_GPS_MODE, PARAM_CAM_INTERVAL, PARAM_CAM_EXP, PARAM_CAM_ANGLE_X_OFFSET,
+	PARAM_CAM_ANGLE_X_FACTOR, PARAM_CAM_ANGLE_Y_OFFSET, PARAM_CAM_ANGLE_Y_FACTOR,
+	PARAM_KAL_VEL_AX, PARAM_KAL_VEL_AY, PARAM_KAL_VEL_BX, PARAM_KAL_VEL_BY,
+	PARAM_SONAR_MODE, PARAM_SONAR_SCALE, PARAM_POSITION_HOVER_THRUST,
+	PARAM_I2C_ERR_REPORTING_ENABLED
+};
+
+typedef char param_baseline_size_check[(sizeof(param_baseline_id) == PARAM_BASELINE_COUNT) ? 1 : -1];
+typedef char param_record_size_check[(sizeof(param_record_t) == EEPROM_PAGE_SIZE) ? 1 : -1];
+typedef char param_log_size_check[(PARAM_LOG_PAGES > PARAM_LOG_GROUPS + 1 + PARAM_MIGRATE_GROUPS
+		&& PARAM_LOG_PAGES > PARAM_LOG_GROUPS + 1 + PARAM_BASELINE_PAGES) ? 1 : -1];
+typedef char param_dir_size_check[(ONBOARD_PARAM_COUNT <= PARAM_DIR_MAX
+		&& ONBOARD_PARAM_NAME_LENGTH < EEPROM_PAGE_SIZE / PARAM_DIR_NAMES) ? 1 : -1];
+
 static uint8_t param_handler_step = 0;
-static int32_t param_handler_counter = 0;
+static uint8_t param_log_loaded = 0;              ///< Ring scanned, writes allowed
+static uint8_t param_log_scan_request = 0;
+static uint8_t param_log_page;                    ///< Page read by the scan or written
+static uint8_t param_log_head;                    ///< Next page to write, never live
+static uint32_t param_log_sequence;
+static uint16_t param_log_schema;
+static uint8_t param_log_live[PARAM_LOG_GROUPS];  ///< Page of the live record of each group
+static uint32_t param_log_live_sequence[PARAM_LOG_GROUPS]; ///< Only used by the scan
+static float param_stored[ONBOARD_PARAM_COUNT];   ///< Values of the live records
+static uint32_t param_dirty[(ONBOARD_PARAM_COUNT + 31) / 32];
+static uint8_t param_log_flush;                   ///< Write requested, cleared once nothing is left to write
+static param_record_t param_record;               ///< Page being written
+static uint16_t param_page_address;               ///< EEPROM address of param_record
+static uint8_t param_page_retries;
+static uint8_t param_log_migrate;                 ///< Scan pass that maps records of param_dir_schema
+static uint8_t param_log_foreign;                 ///< Records of another table were found
+static uint16_t param_log_foreign_schema;         ///< Schema of the newest of them
+static uint32_t param_log_foreign_sequence;
+static uint16_t param_dir_schema;                 ///< Schema of the directory, or the one being mapped
+static uint16_t param_dir_count;
+static uint16_t param_read_crc;                   ///< CRC of the directory being read
+static uint8_t param_dir_page;                    ///< Page read or written
+static uint8_t param_dir_current;                 ///< The directory lists the current table
+static uint8_t param_dir_writing;
+static uint8_t param_dir_failed;                  ///< Not written again before the next read
+static uint8_t param_dir_map[PARAM_DIR_MAX];      ///< Current index of each listed name, PARAM_LOG_NONE if gone
+static uint8_t param_dir_live[PARAM_MIGRATE_GROUPS]; ///< Page of the record migrated from, per old group
+static uint32_t param_dir_sequence[PARAM_MIGRATE_GROUPS];
+static uint8_t param_baseline_found;              ///< Values taken from the block of the firmware before the log
 uint8_t param_sizecheck = 255;
-float_vect3 debug;
-void param_write(uint32_t param_id)
+
+static uint16_t param_record_crc(const param_record_t* record)
 {
-	mavlink_param_union_t param;
-	switch (param_id)
+	const uint8_t* bytes = (const uint8_t*) record;
+	uint16_t crc;
+
+	crc_init(&crc);
+	for (uint16_t i = 0; i < offsetof(param_record_t, crc); i++)
 	{
-	case PARAM_IMU_RESET:
-		param.param_float = 0;
-		debug_message_buffer("eeprom param: param IMU_RESET set to 0");
-		break;
-	case ONBOARD_PARAM_COUNT:
-		param.param_int32 = EEPROM_PARAM_CHECK_VALUE;// if this value will be changed count of parameters has changed
-		debug_message_buffer("eeprom param: security check written");
-		break;
-	default:
-		param.param_float = global_data.param[param_id];
-		break;
+		crc_accumulate(bytes[i], &crc);
 	}
-	eeprom_write(4 * param_id, 4, param.bytes);
+	return crc;
+}
 
-	debug.y = param.param_float;
+/** @brief Add one name to a schema CRC */
+static void param_name_crc(const char* name, uint16_t* crc)
+{
+	for (int j = 0; j < ONBOARD_PARAM_NAME_LENGTH && name[j]; j++)
+	{
+		crc_accumulate(name[j], crc);
+	}
+	crc_accumulate(0, crc);
 }
 
-void param_start_read(uint32_t param_id)
+/** @brief CRC over the first count parameter names, changes whenever the table changes */
+static uint16_t param_log_schema_crc(uint16_t count)
 {
-	eeprom_start_read(4 * param_id, 4);
+	uint16_t crc;
+
+	crc_init(&crc);
+	crc_accumulate(PARAM_LOG_VERSION, &crc);
+	for (int i = 0; i < count; i++)
+	{
+		param_name_crc(param_table[i].name, &crc);
+	}
+	return crc;
 }
-void param_read_update(uint32_t param_id)
+
+static uint16_t param_log_address(uint8_t page)
 {
-	mavlink_param_union_t param;
-	eeprom_read_data(param.bytes);
-	switch (param_id)
+	return PARAM_LOG_START + (uint16_t) page * EEPROM_PAGE_SIZE;
+}
+
+static uint16_t param_dir_address(uint8_t page)
+{
+	return PARAM_DIR_START + (uint16_t) page * EEPROM_PAGE_SIZE;
+}
+
+bool param_value_valid(uint32_t param_id, float* value)
+{
+	const param_info_t* info = &param_table[param_id];
+
+	if (isnan(*value) || isinf(*value))
 	{
-	case PARAM_IMU_RESET:
-		debug_message_buffer("eeprom param: param IMU_RESET not overridden");
-		break;
-	case ONBOARD_PARAM_COUNT:
+		return false;
+	}
+	if (info->type == PARAM_TYPE_INT)
+	{
+		*value = roundf(*value);
+	}
+	return *value >= info->min && *value <= info->max;
+}
+
+void param_set_dirty(uint16_t param_id)
+{
+	if (param_id < ONBOARD_PARAM_COUNT)
+	{
+		param_dirty[param_id / 32] |= 1UL << (param_id % 32);
+	}
+}
+
+static uint8_t param_is_dirty(uint16_t param_id)
+{
+	return (param_dirty[param_id / 32] >> (param_id % 32)) & 1;
+}
+
+/** @brief Test and clear the dirty flags of a group */
+static uint8_t param_group_take_dirty(uint8_t group)
+{
+	uint8_t dirty = 0;
+	for (uint16_t i = group * PARAM_LOG_VALUES; i < (group + 1) * PARAM_LOG_VALUES
+			&& i < ONBOARD_PARAM_COUNT; i++)
+	{
+		if (param_is_dirty(i))
+		{
+			param_dirty[i / 32] &= ~(1UL << (i % 32));
+			dirty = 1;
+		}
+	}
+	return dirty;
+}
+
+/** @brief The next page from page on that holds nothing values are migrated from */
+static uint8_t param_log_skip(uint8_t page)
+{
+	for (;;)
+	{
+		uint8_t source = 0;
+		if (!param_dir_current)
+		{
+			source = param_baseline_found && page < PARAM_BASELINE_PAGES;
+			for (uint8_t g = 0; g < PARAM_MIGRATE_GROUPS; g++)
+			{
+				source |= (param_dir_live[g] == page);
+			}
+		}
+		if (!source)
+		{
+			return page;
+		}
+		page = (page + 1) % PARAM_LOG_PAGES;
+	}
+}
+
+/**
+ * @brief Fill param_record with the next record to write
+ * @return 0 if there is nothing to write
+ */
+static uint8_t param_log_next_record(void)
+{
+	uint8_t next;
+	uint8_t group = PARAM_LOG_NONE;
+	uint8_t copy = 0;
+
+	if (!param_log_flush)
+	{
+		return 0;
+	}
+	param_log_head = param_log_skip(param_log_head);
+	next = param_log_skip((param_log_head + 1) % PARAM_LOG_PAGES);
+
+	for (uint8_t g = 0; g < PARAM_LOG_GROUPS; g++)
+	{
+		if (param_log_live[g] == next)
+		{
+			// Keep the next page free, the stored values move along
+			group = g;
+			copy = 1;
+			break;
+		}
+	}
+	for (uint8_t g = 0; group == PARAM_LOG_NONE && g < PARAM_LOG_GROUPS; g++)
+	{
+		if (param_group_take_dirty(g))
+		{
+			group = g;
+		}
+	}
+	if (group == PARAM_LOG_NONE)
+	{
+		param_log_flush = 0;
+		return 0;
+	}
 
-		if (param.param_int32 == EEPROM_PARAM_CHECK_VALUE)// if this value will be changed count of parameters has changed
+	memset(&param_record, 0, sizeof(param_record));
+	param_record.magic = PARAM_LOG_MAGIC;
+	param_record.schema = param_log_schema;
+	param_record.sequence = ++param_log_sequence;
+	param_record.group = group;
+	for (uint8_t j = 0; j < PARAM_LOG_VALUES; j++)
+	{
+		uint16_t i = group * PARAM_LOG_VALUES + j;
+		if (i >= ONBOARD_PARAM_COUNT)
+		{
+			break;
+		}
+		if (copy)
 		{
-			debug_message_buffer("eeprom param: security check OK");
-			param_sizecheck = 1;
+			param_record.value[j] = param_stored[i];
+		}
+		else if (param_table[i].flags & PARAM_FLAG_VOLATILE)
+		{
+			// Keep the slot, but never store the live value
+			param_record.value[j] = param_table[i].def;
 		}
 		else
 		{
-			debug_message_buffer("eeprom param: security check FALSE read abborted");
-			debug_message_buffer("YOU SHOULD LOAD PARAMS from your file, set, and write them.");
-			param_sizecheck = 0;
+			param_record.value[j] = global_data.param[i];
 		}
-		break;
-	default:
-		global_data.param[param_id] = param.param_float;
-		break;
 	}
+	param_record.crc = param_record_crc(&param_record);
+	param_page_address = param_log_address(param_log_head);
+	return 1;
+}
+
+/**
+ * @brief Fill param_record with the next directory page to write
+ *
+ * The names first, the header last: a directory torn by a power loss
+ * does not match its schema and is not used.
+ * @return 0 if the directory is complete
+ */
+static uint8_t param_dir_next_page(void)
+{
+	uint8_t* bytes = (uint8_t*) &param_record;
 
-	debug.z = param.param_float;
+	if (param_dir_page == 0)
+	{
+		return 0;
+	}
+	memset(&param_record, 0, sizeof(param_record));
+	if (param_dir_page < PARAM_DIR_PAGES(ONBOARD_PARAM_COUNT))
+	{
+		for (uint8_t k = 0; k < PARAM_DIR_NAMES; k++)
+		{
+			uint16_t i = (param_dir_page - 1) * PARAM_DIR_NAMES + k;
+			if (i < ONBOARD_PARAM_COUNT)
+			{
+				strncpy((char*) &bytes[k * EEPROM_PAGE_SIZE / PARAM_DIR_NAMES], param_table[i].name,
+						ONBOARD_PARAM_NAME_LENGTH);
+			}
+		}
+		param_page_address = param_dir_address(param_dir_page);
+		param_dir_page++;
+	}
+	else
+	{
+		param_dir_header_t header = { PARAM_DIR_MAGIC, param_log_schema, ONBOARD_PARAM_COUNT };
+		memcpy(bytes, &header, sizeof(header));
+		param_page_address = param_dir_address(0);
+		param_dir_page = 0;
+	}
+	return 1;
 }
-void param_handler()
+
+/** @brief 1 if every group has a record of the current table */
+static uint8_t param_log_complete(void)
 {
-	//	uint16_t address=1;
-	//	uint8_t length=4;
-	//	static generic_32bit param;
-	//	static uint8_t data = 0;
-	//	static generic_32bit rdata;
-	//	debug_message_buffer_sprintf("param test: param_handler_counter=%u", param_handler_counter);
+	for (uint8_t g = 0; g < PARAM_LOG_GROUPS; g++)
+	{
+		if (param_log_live[g] == PARAM_LOG_NONE)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
 
-	switch (param_handler_step)
+static void param_write_page(void)
+{
+	eeprom_write(param_page_address, EEPROM_PAGE_SIZE, (uint8_t*) &param_record);
+}
+
+/** @brief Check the read back of the written page, 1 if it is done */
+static uint8_t param_verify_page(void)
+{
+	param_record_t data;
+	uint8_t ok = eeprom_read_data((uint8_t*) &data)
+			&& memcmp(&data, &param_record, sizeof(data)) == 0;
+
+	if (!ok && param_page_retries++ < PARAM_WRITE_RETRIES)
 	{
-	case 0://do nothing
-		break;
-	case 10://Write one parameter to eeprom
-		//		eeprom_write(address, length, param.b);
-		//		debug_message_buffer_sprintf("param test: wrote data/1000=%u", (uint32_t)(param.f/1000.f));
-		//		param_handler_step++;
-		if (param_handler_counter <= ONBOARD_PARAM_COUNT)//as last value we write a security check
+		param_write_page();
+		return 0;
+	}
+	if (param_dir_writing)
+	{
+		if (!ok)
+		{
+			// Not tried again before the next read, the records stay readable
+			debug_message_buffer_sprintf("eeprom param: directory write failed at %u", param_page_address);
+			param_dir_writing = 0;
+			param_dir_failed = 1;
+		}
+		else if (param_dir_page == 0)
+		{
+			param_dir_writing = 0;
+			param_dir_current = 1;
+			param_dir_schema = param_log_schema;
+		}
+		return 1;
+	}
+	if (ok)
+	{
+		param_log_live[param_record.group] = param_log_head;
+		for (uint8_t j = 0; j < PARAM_LOG_VALUES
+				&& param_record.group * PARAM_LOG_VALUES + j < ONBOARD_PARAM_COUNT; j++)
+		{
+			param_stored[param_record.group * PARAM_LOG_VALUES + j] = param_record.value[j];
+		}
+	}
+	else
+	{
+		debug_message_buffer_sprintf("eeprom param: write failed on page %u", param_log_head);
+	}
+	// A failed page is skipped, the next one is free as well
+	param_log_head = (param_log_head + 1) % PARAM_LOG_PAGES;
+	return 1;
+}
+
+/** @brief Stage the values of a record of the mapped table for the groups without a record */
+static void param_log_migrate_page(const param_record_t* record)
+{
+	uint8_t group = record->group;
+
+	if (group >= PARAM_MIGRATE_GROUPS || (param_dir_live[group] != PARAM_LOG_NONE
+			&& record->sequence < param_dir_sequence[group]))
+	{
+		return;
+	}
+	param_dir_sequence[group] = record->sequence;
+	param_dir_live[group] = param_log_page;
+	for (uint8_t j = 0; j < PARAM_LOG_VALUES && group * PARAM_LOG_VALUES + j < param_dir_count; j++)
+	{
+		uint8_t i = param_dir_map[group * PARAM_LOG_VALUES + j];
+		if (i != PARAM_LOG_NONE && param_log_live[i / PARAM_LOG_VALUES] == PARAM_LOG_NONE
+				&& !(param_table[i].flags & PARAM_FLAG_VOLATILE))
+		{
+			// Marked dirty, param_log_apply() takes it and the writer stores it
+			param_stored[i] = record->value[j];
+			param_set_dirty(i);
+		}
+	}
+}
+
+/** @brief Take a record read by the scan if it is newer than the known one */
+static void param_log_scan_page(const param_record_t* record)
+{
+	if (record->magic != PARAM_LOG_MAGIC || record->crc != param_record_crc(record))
+	{
+		return;
+	}
+	if (param_log_migrate)
+	{
+		if (record->schema == param_dir_schema)
+		{
+			param_log_migrate_page(record);
+		}
+		return;
+	}
+	if (record->sequence > param_log_sequence)
+	{
+		param_log_sequence = record->sequence;
+		param_log_head = (param_log_page + 1) % PARAM_LOG_PAGES;
+	}
+	if (record->schema != param_log_schema)
+	{
+		// Written for another parameter table, migrated by name if the directory lists it
+		if (!param_log_foreign || record->sequence > param_log_foreign_sequence)
+		{
+			param_log_foreign = 1;
+			param_log_foreign_schema = record->schema;
+			param_log_foreign_sequence = record->sequence;
+		}
+		return;
+	}
+	if (record->group >= PARAM_LOG_GROUPS)
+	{
+		return;
+	}
+
+	uint8_t group = record->group;
+	if (param_log_live[group] != PARAM_LOG_NONE && record->sequence < param_log_live_sequence[group])
+	{
+		return;
+	}
+	param_log_live_sequence[group] = record->sequence;
+	param_log_live[group] = param_log_page;
+	for (uint8_t j = 0; j < PARAM_LOG_VALUES && group * PARAM_LOG_VALUES + j < ONBOARD_PARAM_COUNT; j++)
+	{
+		param_stored[group * PARAM_LOG_VALUES + j] = record->value[j];
+	}
+}
+
+/**
+ * @brief Take the directory page read before
+ *
+ * Sets param_dir_count if records of another table are to be migrated.
+ * @return 1 if the next page of the directory has to be read
+ */
+static uint8_t param_dir_read_page(const uint8_t* page)
+{
+	uint8_t migrate = param_log_foreign && !param_log_complete();
+
+	if (param_dir_page == 0)
+	{
+		param_dir_header_t header;
+		memcpy(&header, page, sizeof(header));
+		param_dir_current = (header.magic == PARAM_DIR_MAGIC && header.schema == param_log_schema
+				&& header.count == ONBOARD_PARAM_COUNT);
+		if (migrate && header.magic == PARAM_DIR_MAGIC && header.schema == param_log_foreign_schema
+				&& header.count > 0 && header.count <= PARAM_DIR_MAX)
+		{
+			// The names follow, they have to match the schema
+			param_dir_schema = header.schema;
+			param_dir_count = header.count;
+			crc_init(&param_read_crc);
+			crc_accumulate(PARAM_LOG_VERSION, &param_read_crc);
+			return 1;
+		}
+	}
+	else
+	{
+		for (uint8_t k = 0; k < PARAM_DIR_NAMES; k++)
+		{
+			uint16_t i = (param_dir_page - 1) * PARAM_DIR_NAMES + k;
+			if (i < param_dir_count)
+			{
+				char name[ONBOARD_PARAM_NAME_LENGTH + 1];
+				memcpy(name, &page[k * EEPROM_PAGE_SIZE / PARAM_DIR_NAMES], ONBOARD_PARAM_NAME_LENGTH);
+				name[ONBOARD_PARAM_NAME_LENGTH] = '\0';
+				param_name_crc(name, &param_read_crc);
+				int16_t id = param_lookup(name);
+				param_dir_map[i] = (id < 0) ? PARAM_LOG_NONE : id;
+			}
+		}
+		if (param_dir_page + 1 < PARAM_DIR_PAGES(param_dir_count))
+		{
+			return 1;
+		}
+		if (param_read_crc == param_dir_schema)
+		{
+			return 0;
+		}
+	}
+
+	// No directory of that table, its records cannot be mapped
+	param_dir_count = 0;
+	return 0;
+}
+
+/**
+ * @brief Take a page of the block of the firmware before the log
+ *
+ * The values go to param_stored of the groups without a record and are
+ * marked once the check value after them matched.
+ * @return 1 if the next page of the block has to be read
+ */
+static uint8_t param_baseline_read_page(const uint8_t* page)
+{
+	for (uint8_t k = 0; k < EEPROM_PAGE_SIZE / 4; k++)
+	{
+		uint16_t i = param_log_page * (EEPROM_PAGE_SIZE / 4) + k;
+
+		if (i < PARAM_BASELINE_COUNT)
+		{
+			uint8_t id = param_baseline_id[i];
+			if (param_log_live[id / PARAM_LOG_VALUES] == PARAM_LOG_NONE)
+			{
+				memcpy(&param_stored[id], &page[4 * k], 4);
+			}
+		}
+		else if (i == PARAM_BASELINE_COUNT)
+		{
+			int32_t check;
+			memcpy(&check, &page[4 * k], 4);
+			if (check != PARAM_BASELINE_CHECK_VALUE)
+			{
+				return 0;
+			}
+			for (i = 0; i < PARAM_BASELINE_COUNT; i++)
+			{
+				uint8_t id = param_baseline_id[i];
+				if (param_log_live[id / PARAM_LOG_VALUES] == PARAM_LOG_NONE
+						&& !(param_table[id].flags & PARAM_FLAG_VOLATILE))
+				{
+					param_set_dirty(id);
+				}
+			}
+			param_baseline_found = 1;
+			debug_message_buffer("eeprom param: found the parameters of the firmware before the log");
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/** @brief Apply the live records and the migrated values after the scan */
+static void param_log_apply(void)
+{
+	uint8_t found = 0;
+	uint16_t migrated = 0;
+
+	for (uint8_t g = 0; g < PARAM_LOG_GROUPS; g++)
+	{
+		found |= (param_log_live[g] != PARAM_LOG_NONE);
+	}
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		migrated += (param_log_live[i / PARAM_LOG_VALUES] == PARAM_LOG_NONE && param_is_dirty(i));
+	}
+	param_sizecheck = found || migrated;
+	if (!param_sizecheck)
+	{
+		memset(param_dirty, 0, sizeof(param_dirty));
+		debug_message_buffer("eeprom param: no records for this parameter table");
+		debug_message_buffer("YOU SHOULD LOAD PARAMS from your file, set, and write them.");
+		return;
+	}
+
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		float value = param_stored[i];
+		if ((param_table[i].flags & PARAM_FLAG_VOLATILE)
+				|| (param_log_live[i / PARAM_LOG_VALUES] == PARAM_LOG_NONE && !param_is_dirty(i)))
 		{
-			param_write(param_handler_counter++);
+			continue;
+		}
+		// Keep the default if the stored value is out of range
+		if (param_value_valid(i, &value))
+		{
+			global_data.param[i] = value;
 		}
 		else
 		{
-			param_handler_counter = 0;
-			param_handler_step = 11;
+			debug_message_buffer_sprintf("eeprom param: invalid value for param id=%i", i);
+		}
+	}
+	if (migrated)
+	{
+		debug_message_buffer_sprintf("eeprom param: %u values of the old table kept, writing them", migrated);
+	}
+	debug_message_buffer("eeprom param: read all finished");
+}
+
+/** @brief End of the read, writes start from here */
+static void param_read_done(void)
+{
+	param_log_apply();
+	param_log_loaded = 1;
+	if (param_sizecheck && !param_log_complete())
+	{
+		// Migrated values and the groups without a record become records of this table
+		param_write_all();
+	}
+	param_handler_step = 0;
+}
 
-			debug_message_buffer("eeprom param: write all finished");
+void param_handler()
+{
+	switch (param_handler_step)
+	{
+	case 0://write changed groups and the directory in the background
+		if (param_log_scan_request)
+		{
+			param_log_scan_request = 0;
+			param_log_schema = param_log_schema_crc(ONBOARD_PARAM_COUNT);
+			param_log_sequence = 0;
+			param_log_head = 0;
+			param_log_page = 0;
+			param_log_migrate = 0;
+			param_log_foreign = 0;
+			param_dir_current = 0;
+			param_dir_writing = 0;
+			param_dir_failed = 0;
+			param_dir_count = 0;
+			param_baseline_found = 0;
+			param_log_flush = 0;
+			memset(param_log_live, PARAM_LOG_NONE, sizeof(param_log_live));
+			memset(param_dir_live, PARAM_LOG_NONE, sizeof(param_dir_live));
+			memset(param_dirty, 0, sizeof(param_dirty));
+			param_handler_step = 20;
+		}
+		else if (param_log_loaded && param_log_next_record())
+		{
+			param_page_retries = 0;
+			param_write_page();
+			param_handler_step = 11;
+		}
+		else if (param_log_loaded && !param_dir_current && !param_dir_writing && !param_dir_failed
+				&& param_log_complete())
+		{
+			param_dir_writing = 1;
+			param_dir_page = 1;
+		}
+		if (param_handler_step == 0 && param_dir_writing && param_dir_next_page())
+		{
+			param_page_retries = 0;
+			param_write_page();
+			param_handler_step = 11;
 		}
 		break;
-	case 11://write finished
+	case 11://wait for the write cycle, then read the page back
+		if (eeprom_write_ready())
+		{
+			eeprom_start_read(param_page_address, EEPROM_PAGE_SIZE);
+			param_handler_step = 12;
+		}
 		break;
-	case 20://start read one parameter from eeprom
-		//		eeprom_start_read(address, length);
-		param_start_read(param_handler_counter);
-		//		debug_message_buffer("param test: start read");
-		if(param_sizecheck){
-			//continue read
-			param_handler_step = 21;
-		}else{
-			//abbort read
-			param_handler_step = 0;
-			debug_message_buffer("eeprom param: read aborted (!param_sizecheck)");
+	case 12://verify the page, a failed one is written again
+		if (eeprom_read_ready())
+		{
+			param_handler_step = param_verify_page() ? 0 : 11;
 		}
 		break;
-	case 21: //save the parameter read before
-		//		eeprom_read_data(rdata.b);
-		param_read_update(param_handler_counter--);
-		//		debug_message_buffer_sprintf("param test: read data*1000=%u",
-		//				(uint32_t) (rdata.f * 1000.f));
-		if (param_handler_counter >=0 )// security check should have been read before, but we check it anyway and dont write it to ram
+	case 20://start reading the next page of the ring
+		if (param_log_page < PARAM_LOG_PAGES)
 		{
-			param_handler_step = 20;
+			eeprom_start_read(param_log_address(param_log_page), EEPROM_PAGE_SIZE);
+			param_handler_step = 21;
+		}
+		else if (!param_log_migrate)
+		{
+			param_dir_page = 0;
+			param_handler_step = 30;
 		}
 		else
 		{
-			param_handler_counter = 0;
-			debug_message_buffer("eeprom param: read all finished");
-			param_handler_step = 23;
+			param_log_migrate = 0;
+			param_read_done();
 		}
 		break;
-	case 23://read all finished
+	case 21: //check the page read before
+		if (eeprom_read_ready())
+		{
+			param_record_t record;
+			if (!eeprom_read_data((uint8_t*) &record))
+			{
+				debug_message_buffer("eeprom param: read failed");
+				param_handler_step = 0;
+				break;
+			}
+			param_log_scan_page(&record);
+			param_log_page++;
+			param_handler_step = 20;
+		}
+		break;
+	case 30://read the next page of the directory
+		eeprom_start_read(param_dir_address(param_dir_page), EEPROM_PAGE_SIZE);
+		param_handler_step = 31;
 		break;
-	case 30://size check
+	case 31://map the names, then scan the ring again for the records of the old table
+		if (eeprom_read_ready())
+		{
+			uint8_t page[EEPROM_PAGE_SIZE];
+
+			if (!eeprom_read_data(page))
+			{
+				param_dir_count = 0;
+			}
+			else if (param_dir_read_page(page))
+			{
+				param_dir_page++;
+				param_handler_step = 30;
+			}
+			else if (param_dir_count)
+			{
+				param_log_migrate = 1;
+				param_log_page = 0;
+				param_handler_step = 20;
+			}
+			else if (!param_log_complete())
+			{
+				param_log_page = 0;
+				param_handler_step = 40;
+			}
+			else
+			{
+				param_read_done();
+			}
+		}
 		break;
-	case 31://size check
+	case 40://read the next page of the block of the firmware before the log
+		eeprom_start_read(param_log_address(param_log_page), EEPROM_PAGE_SIZE);
+		param_handler_step = 41;
+		break;
+	case 41:
+		if (eeprom_read_ready())
+		{
+			uint8_t page[EEPROM_PAGE_SIZE];
+
+			if (eeprom_read_data(page) && param_baseline_read_page(page))
+			{
+				param_log_page++;
+				param_handler_step = 40;
+			}
+			else
+			{
+				param_read_done();
+			}
+		}
 		break;
 	default:
 		param_handler_step = 0;
 		break;
 	}
-
-	debug.x = param_handler_counter;
-//	debug_vect("param c,w,r", debug);
-	//	debug_message_buffer_sprintf("param test: param.i=%i", param.i);
-	//	data++;
 }
+
 void param_write_all()
 {
-
-	debug_message_buffer("eeprom param: starting write all");
-	param_handler_counter = 0;
-	param_handler_step = 10;
+	if (!param_log_loaded)
+	{
+		debug_message_buffer("eeprom param: not read yet, write skipped");
+		return;
+	}
+	// Everything not matching its stored value, changed by PARAM_SET or not
+	uint16_t changed = 0;
+	for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		if (param_log_live[i / PARAM_LOG_VALUES] == PARAM_LOG_NONE
+				|| (!(param_table[i].flags & PARAM_FLAG_VOLATILE)
+						&& global_data.param[i] != param_stored[i]))
+		{
+			param_set_dirty(i);
+		}
+		changed += param_is_dirty(i);
+	}
+	param_log_flush = 1;
+	debug_message_buffer_sprintf("eeprom param: %u changed values are written in the background", changed);
 }
 
 void param_read_all()
 {
-
 	debug_message_buffer("eeprom param: starting read all");
-	param_handler_counter = ONBOARD_PARAM_COUNT;
-	param_handler_step = 20;
+	// A running write finishes first, the scan starts from step 0
+	param_log_scan_request = 1;
+}
+
+uint8_t param_read_busy()
+{
+	return param_log_scan_request || param_handler_step >= 20;
 }
 uint8_t param_size_check()
 {
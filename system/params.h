@@ -9,17 +9,58 @@
 #define PARAMS_H_
 
 #include "inttypes.h"
+#include <stdbool.h>
 
-void param_write(uint32_t param_id);
-void param_start_read(uint32_t param_id);
-void param_read_update(uint32_t param_id);
+/**
+ * @brief Check a new value against the range and type in param_table
+ *
+ * Integer parameters are rounded in place.
+ * @return true if the value may be assigned to global_data.param[param_id]
+ */
+bool param_value_valid(uint32_t param_id, float* value);
 
+/**
+ * @brief Mark a parameter as changed since the last EEPROM write
+ *
+ * Called by the parameter set path. Nothing is written until
+ * param_write_all(), the background writer in param_handler() then
+ * stores the groups of the marked parameters.
+ */
+void param_set_dirty(uint16_t param_id);
+
+/**
+ * @brief Advance the EEPROM read or the background writer by one transfer
+ *
+ * Never waits for the EEPROM, a call with the transfer still running
+ * returns immediately. Call it from idle slots, writes only start once
+ * param_read_all() has finished.
+ */
 void param_handler(void);
 
+/**
+ * @brief Write all parameters that differ from the EEPROM
+ *
+ * The write request of MAV_CMD_PREFLIGHT_STORAGE, the groups are written
+ * in the background by param_handler().
+ */
 void param_write_all(void);
 
+/**
+ * @brief Scan the EEPROM log and apply the newest record of each group
+ *
+ * Values stored for another parameter table, or in the block format
+ * before the log, are taken by name and written again in the background.
+ */
 void param_read_all(void);
 
+/**
+ * @brief 1 while param_read_all() is not finished
+ *
+ * Each param_handler() call of a read waits for its EEPROM transfer, so
+ * the handler can be called back to back until this returns 0.
+ */
+uint8_t param_read_busy(void);
+
 //return 1 if number of parameter has not changed else 0
 //function will block for some ms
 //TODO make sure that this works also if we go up to a parameter we already had once before
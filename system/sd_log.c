@@ -0,0 +1,338 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Flight log on the SD card
+ *   @author Lorenz Meier
+ */
+
+#include <string.h>
+
+#include "sd_log.h"
+#include "sdcard.h"
+#include "global_data.h"
+#include "sys_time.h"
+#include "debug.h"
+#include "mmc_spi.h"
+#include "dos.h"
+
+#if SD_LOG_BATCH >= SD_LOG_BUFFERS || SD_LOG_BUFFERS - 1 > SDCARD_MAX_BLOCKS
+#error "SD_LOG_BATCH or SD_LOG_BUFFERS out of range"
+#endif
+
+typedef struct
+{
+	uint8_t active;
+	uint16_t session;
+	uint32_t first_sector;            ///< Card sector of the file start, the file is contiguous
+	uint32_t sectors;                 ///< Reserved sectors
+
+	uint8_t buf[SD_LOG_BUFFERS][SDCARD_SECTOR_SIZE];
+	uint8_t fill;                     ///< Buffer being filled
+	uint16_t fill_pos;                ///< Next byte in the filled buffer
+	uint8_t full;                     ///< Full buffers, the oldest is fill - full
+	uint32_t index;                   ///< Sector index of the filled buffer
+
+	uint8_t writing;                  ///< Oldest full buffers being written
+	uint8_t retries;
+	uint8_t errors;                   ///< Sectors failed in a row
+	uint64_t write_start;
+
+	uint32_t stat_sectors;            ///< Statistics since the last report
+	uint32_t stat_card_time;          ///< Time from write start to done, in usecs
+	uint32_t stat_max_time;
+	uint32_t stat_failed;
+	uint64_t stat_start;
+} sd_log_t;
+
+static sd_log_t sd_log;
+
+static void sd_log_put16(uint8_t* p, uint16_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+/** @brief Start filling the next buffer, the caller made sure it is free */
+static void sd_log_begin_sector(void)
+{
+	uint8_t* p = sd_log.buf[sd_log.fill];
+
+	sd_log_put16(&p[0], SD_LOG_MAGIC);
+	sd_log_put16(&p[2], sd_log.session);
+	sd_log_put16(&p[4], sd_log.index & 0xFFFF);
+	sd_log_put16(&p[6], sd_log.index >> 16);
+	sd_log_put16(&p[8], 0);
+	sd_log_put16(&p[10], 0);
+	sd_log.fill_pos = SD_LOG_HEADER_SIZE;
+}
+
+/**
+ * @brief Create LOGnnn.BIN and reserve its clusters
+ * @return 0 if there is no card, no free name or no space
+ */
+static uint8_t sd_log_create(void)
+{
+	char name[] = "LOG000.BIN";
+	uint16_t n;
+
+	MMC_IO_Init();
+	if (GetDriveInformation() != F_OK)
+	{
+		debug_message_buffer("SD log: no card");
+		return 0;
+	}
+
+	for (n = 0; n < 1000; n++)
+	{
+		name[3] = '0' + n / 100;
+		name[4] = '0' + (n / 10) % 10;
+		name[5] = '0' + n % 10;
+		if (FindName(name) != FULL_MATCH)
+		{
+			break;
+		}
+	}
+
+	FileID file = (n < 1000) ? Fopen(name, F_WRITE) : -1;
+	if (file < 0)
+	{
+		debug_message_buffer("SD log: could not create file");
+		return 0;
+	}
+
+	// One contiguous cluster run, in flight the sectors are written
+	// without FAT access
+	U32 clusters = Fpreallocate(SD_LOG_RESERVE_SECTORS / secPerCluster, file);
+	sd_log.first_sector = GetFirstSectorOfCluster(FileDescriptors[file].FileFirstCluster);
+	sd_log.sectors = clusters * secPerCluster;
+	Fclose(file);
+	if (clusters == 0)
+	{
+		debug_message_buffer("SD log: card full");
+		return 0;
+	}
+
+	debug_message_buffer_sprintf("SD log: log file %u created", n);
+	debug_message_buffer_sprintf("SD log: %u kB reserved", sd_log.sectors / 2);
+#ifdef USE_FATBUFFER
+	debug_message_buffer_sprintf("SD log: %u FAT cache hits", SectorCacheHits);
+	debug_message_buffer_sprintf("SD log: %u FAT cache misses", SectorCacheMisses);
+#endif
+	return 1;
+}
+
+void sd_log_init(void)
+{
+	sd_log.active = 0;
+	if (global_data.param[PARAM_LOG_SD] != 1)
+	{
+		return;
+	}
+
+	sdcard_bus_lock();
+	uint8_t ok = sd_log_create();
+	sdcard_bus_unlock();
+	if (!ok)
+	{
+		return;
+	}
+
+	// Sectors of earlier logs may follow in the reserved space, the time
+	// the card init took differs on every boot
+	sd_log.session = (uint16_t) sys_time_clock_get_time_usec();
+	sd_log.fill = 0;
+	sd_log.full = 0;
+	sd_log.index = 0;
+	sd_log.writing = 0;
+	sd_log.retries = 0;
+	sd_log.errors = 0;
+	sd_log.stat_sectors = 0;
+	sd_log.stat_card_time = 0;
+	sd_log.stat_max_time = 0;
+	sd_log.stat_failed = 0;
+	sd_log.stat_start = sys_time_clock_get_time_usec();
+	sd_log_begin_sector();
+	sd_log.active = 1;
+}
+
+uint8_t sd_log_active(void)
+{
+	return sd_log.active;
+}
+
+uint8_t sd_log_free_space(uint16_t len)
+{
+	uint32_t space = SDCARD_SECTOR_SIZE - sd_log.fill_pos;
+
+	if (!sd_log.active)
+	{
+		return 0;
+	}
+	// Buffers neither full nor being filled. The last one must not get
+	// full, sd_log_write() starts the next sector right away.
+	space += (uint32_t) (SD_LOG_BUFFERS - 1 - sd_log.full) * (SDCARD_SECTOR_SIZE - SD_LOG_HEADER_SIZE);
+	return len < space;
+}
+
+void sd_log_write(const uint8_t* data, uint16_t len)
+{
+	uint8_t* p = sd_log.buf[sd_log.fill];
+
+	// Offset of the first frame in the sector, frames are written whole
+	if (p[8] == 0 && p[9] == 0)
+	{
+		sd_log_put16(&p[8], sd_log.fill_pos);
+	}
+
+	while (len > 0)
+	{
+		uint16_t n = SDCARD_SECTOR_SIZE - sd_log.fill_pos;
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(&sd_log.buf[sd_log.fill][sd_log.fill_pos], data, n);
+		sd_log.fill_pos += n;
+		data += n;
+		len -= n;
+
+		if (sd_log.fill_pos == SDCARD_SECTOR_SIZE)
+		{
+			sd_log.full++;
+			sd_log.fill = (sd_log.fill + 1) % SD_LOG_BUFFERS;
+			sd_log.index++;
+			sd_log_begin_sector();
+		}
+	}
+}
+
+uint32_t sd_log_position(void)
+{
+	return sd_log.index * SDCARD_SECTOR_SIZE + sd_log.fill_pos;
+}
+
+static void sd_log_report(uint64_t now)
+{
+	uint32_t elapsed = (now - sd_log.stat_start) / 1000;
+
+	debug_message_buffer_sprintf("SD log: %u B/s logged",
+			sd_log.stat_sectors * SDCARD_SECTOR_SIZE * 1000 / elapsed);
+	if (sd_log.stat_card_time > 0)
+	{
+		// While writing, includes the time the card is busy
+		debug_message_buffer_sprintf("SD log: %u kB/s card",
+				(uint32_t) ((uint64_t) sd_log.stat_sectors * SDCARD_SECTOR_SIZE * 1000 / sd_log.stat_card_time));
+	}
+	debug_message_buffer_sprintf("SD log: %u us max write", sd_log.stat_max_time);
+	debug_message_buffer_sprintf("SD log: %u frames dropped", global_data.comm.sd_log_drop_count);
+	if (sd_log.stat_failed > 0)
+	{
+		debug_message_buffer_sprintf("SD log: %u sectors failed", sd_log.stat_failed);
+	}
+
+	sd_log.stat_sectors = 0;
+	sd_log.stat_card_time = 0;
+	sd_log.stat_max_time = 0;
+	sd_log.stat_failed = 0;
+	sd_log.stat_start = now;
+}
+
+void sd_log_update(void)
+{
+	if (!sd_log.active)
+	{
+		return;
+	}
+
+	sdcard_update();
+
+	uint64_t now = sys_time_clock_get_time_usec();
+
+	if (sd_log.writing && !sdcard_busy())
+	{
+		uint8_t written = sdcard_blocks_written();
+		uint32_t time = now - sd_log.write_start;
+
+		sd_log.writing = 0;
+		sd_log.full -= written;
+		sd_log.stat_sectors += written;
+		sd_log.stat_card_time += time;
+		if (time > sd_log.stat_max_time)
+		{
+			sd_log.stat_max_time = time;
+		}
+		if (written > 0)
+		{
+			sd_log.retries = 0;
+			sd_log.errors = 0;
+		}
+		if (sdcard_write_failed() && ++sd_log.retries >= SD_LOG_RETRIES)
+		{
+			// Leave a gap in the sector index and go on
+			sd_log.stat_failed++;
+			sd_log.retries = 0;
+			sd_log.full--;
+			if (++sd_log.errors >= SD_LOG_MAX_ERRORS)
+			{
+				debug_message_buffer("SD log: card failed, log stopped");
+				sd_log.active = 0;
+				return;
+			}
+		}
+	}
+
+	// A failed write starts again with the first buffer the card did not take
+	if (!sd_log.writing && sd_log.full >= ((sd_log.retries > 0) ? 1 : SD_LOG_BATCH))
+	{
+		const uint8_t* bufs[SD_LOG_BUFFERS];
+		uint8_t oldest = (sd_log.fill + SD_LOG_BUFFERS - sd_log.full) % SD_LOG_BUFFERS;
+		uint32_t index = sd_log.index - sd_log.full;
+		uint8_t count = sd_log.full;
+
+		if (index >= sd_log.sectors)
+		{
+			debug_message_buffer("SD log: file full, log stopped");
+			sd_log.active = 0;
+			return;
+		}
+		if (count > sd_log.sectors - index)
+		{
+			count = sd_log.sectors - index;
+		}
+		for (uint8_t i = 0; i < count; i++)
+		{
+			bufs[i] = sd_log.buf[(oldest + i) % SD_LOG_BUFFERS];
+		}
+		sdcard_write_start(sd_log.first_sector + index, bufs, count);
+		sd_log.write_start = now;
+		sd_log.writing = count;
+		sdcard_update();
+	}
+
+	if (now - sd_log.stat_start > SD_LOG_REPORT_INTERVAL)
+	{
+		sd_log_report(now);
+	}
+}
@@ -0,0 +1,105 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ * @brief Flight log on the SD card
+ *
+ * Enabled with the SYS_LOG_SD parameter, read at boot. The log stream
+ * frames (see log_stream.h) are written to a new file LOGnnn.BIN.
+ *
+ * The file is created at boot with the blocking FAT functions and gets
+ * one contiguous cluster run (Fpreallocate()). In flight only its data
+ * sectors are written, one after the other, with sdcard_write_start().
+ * The frames are collected in SD_LOG_BUFFERS sector buffers, as soon as
+ * SD_LOG_BATCH are full they are written with one multiple block write
+ * while the others fill.
+ *
+ * Every sector starts with a header (little endian):
+ * magic (uint16), session (uint16), index (uint32), offset of the first
+ * frame starting in the sector (uint16, 0 if none) and a reserved uint16.
+ * Frames continue over sector boundaries. The file is reserved at its
+ * full size, a reader takes the session of the first sector and skips
+ * sectors with another session or a smaller index, they are left over
+ * from earlier files. Sectors that could not be written leave a gap in
+ * index, the next frame starts at the offset in the header.
+ *
+ * Throughput: a sector takes about 2.5 ms of bus time at the 1.875 MHz
+ * SPI clock. tools/host-tests/sdcard-test runs the driver against a card
+ * model in the quadrotor main loop (200 Hz slot of 1 ms assumed) and
+ * measures about 94 kB/s sustained with 1 ms card busy time per sector,
+ * 68 kB/s with 3 ms, far above the log stream rate. These are model
+ * figures, the effect on the sensor timing needs a check on the board. The card figures
+ * sd_log_update() reports every SD_LOG_REPORT_INTERVAL are the ones of
+ * the real card.
+ */
+
+#ifndef SD_LOG_H_
+#define SD_LOG_H_
+
+#include "inttypes.h"
+
+#define SD_LOG_MAGIC 0x4C53
+#define SD_LOG_HEADER_SIZE 12
+/** Sector buffers, the ones not in a write cover ~60 ms card stalls each */
+#define SD_LOG_BUFFERS 6
+/** Full buffers written together, at most SD_LOG_BUFFERS - 1 */
+#define SD_LOG_BATCH 4
+/** Reserved file size in sectors (32 MB, about 45 min at 200 Hz), less on a fragmented card */
+#define SD_LOG_RESERVE_SECTORS 65536UL
+/** Write attempts per sector */
+#define SD_LOG_RETRIES 3
+/** Sectors failing in a row until the log is stopped */
+#define SD_LOG_MAX_ERRORS 5
+/** Statistics report interval in usecs */
+#define SD_LOG_REPORT_INTERVAL 10000000
+
+/**
+ * @brief Create the log file if SYS_LOG_SD is set
+ *
+ * Blocks the SPI bus for the card init and the cluster reservation,
+ * call at boot after the parameters are read.
+ */
+void sd_log_init(void);
+
+/** @brief 1 if the log file is open */
+uint8_t sd_log_active(void);
+
+/** @brief 1 if len bytes fit into the free buffers */
+uint8_t sd_log_free_space(uint16_t len);
+
+/** @brief Append bytes, check sd_log_free_space() first */
+void sd_log_write(const uint8_t* data, uint16_t len);
+
+/** @brief File offset the next byte is written to */
+uint32_t sd_log_position(void);
+
+/**
+ * @brief Write full buffers to the card, call from the main loop
+ *
+ * Never waits for the card, the SPI transfers of one call take up to
+ * about 150 usecs, see sdcard_update().
+ */
+void sd_log_update(void);
+
+#endif /* SD_LOG_H_ */
@@ -29,6 +29,7 @@
 #include "comm.h"
 #include "led.h"
 #include "debug.h"
+#include "mag_calibration.h"
 
 #define BURST_TIMES		1
 
@@ -157,6 +158,20 @@ static inline void sensors_read_mag(void)
 
 	if (abs(mag.x) < 3000 && abs(mag.y) < 3000 && abs(mag.z) < 3000)
 	{
+		// Offsets, scales and motor term fitted by mag_calibration.c
+		float thrust = global_data.thrust_control_output;
+		float_vect3 cal;
+		cal.x = (mag.x - global_data.param[PARAM_CAL_MAG_OFFSET_X]
+				- global_data.param[PARAM_CAL_MAG_MOTOR_X] * thrust)
+				* global_data.param[PARAM_CAL_MAG_SCALE_X];
+		cal.y = (mag.y - global_data.param[PARAM_CAL_MAG_OFFSET_Y]
+				- global_data.param[PARAM_CAL_MAG_MOTOR_Y] * thrust)
+				* global_data.param[PARAM_CAL_MAG_SCALE_Y];
+		cal.z = (mag.z - global_data.param[PARAM_CAL_MAG_OFFSET_Z]
+				- global_data.param[PARAM_CAL_MAG_MOTOR_Z] * thrust)
+				* global_data.param[PARAM_CAL_MAG_SCALE_Z];
+		mag_calibration_sample(&mag, thrust);
+
 #if HMC5843_I2C_BUS == 0 //external mag
 		global_data.magnet_raw.x = (mag.x - (int16_t)global_data.param[PARAM_CAL_MAG_OFFSET_X]);
 		global_data.magnet_raw.y = -(mag.y - (int16_t)global_data.param[PARAM_CAL_MAG_OFFSET_Y]);
@@ -167,9 +182,15 @@ static inline void sensors_read_mag(void)
 		global_data.magnet_raw.z = -(mag.z - (int16_t)global_data.param[PARAM_CAL_MAG_OFFSET_Z]);
 #endif
 
-		global_data.magnet_corrected.x = global_data.magnet_raw.x;
-		global_data.magnet_corrected.y = global_data.magnet_raw.y;
-		global_data.magnet_corrected.z = global_data.magnet_raw.z;
+#if HMC5843_I2C_BUS == 0 //external mag
+		global_data.magnet_corrected.x = cal.x;
+		global_data.magnet_corrected.y = -cal.y;
+		global_data.magnet_corrected.z = -cal.z;
+#else	//this is the imu mag
+		global_data.magnet_corrected.x = -cal.x;
+		global_data.magnet_corrected.y = cal.y;
+		global_data.magnet_corrected.z = -cal.z;
+#endif
 	}
 }
 
@@ -0,0 +1,187 @@
+#!/usr/bin/env python
+#
+# Decodes the binary debug events of system/debug.c.
+#
+# The events are sent in MAVLink ENCAPSULATED_DATA packets, they are
+# picked out of a MAVLink byte stream read from a file (or - for stdin),
+# e.g. a QGroundControl .tlog or a capture of the serial link. The texts
+# come from the string table tools/gen-debug-events.py wrote with the
+# firmware, generated/debug_events.json. Packets of a firmware built
+# from other sources have another table hash and are skipped.
+#
+# One line per event: onboard time in seconds and the formatted text. The
+# packets carry the low 32 bits of the usec clock, so the time starts
+# over every 71 minutes of uptime.
+# Lost packets and events dropped onboard are reported in between.
+
+from __future__ import print_function
+
+import getopt
+import json
+import os
+import re
+import struct
+import sys
+
+USAGE = """Usage: %s [options] stream.tlog|-
+  --table file    string table, default generated/debug_events.json""" % sys.argv[0]
+
+STX = 0xFE
+MSG_ENCAPSULATED_DATA = 131
+CRC_EXTRA = 223
+PAYLOAD_LEN = 255
+
+MAGIC = 0xE7
+HEADER = struct.Struct("<BBII")
+
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|l)?([%a-zA-Z])")
+
+
+def crc_x25(data):
+    crc = 0xFFFF
+    for b in bytearray(data):
+        tmp = (b ^ (crc & 0xFF)) & 0xFF
+        tmp = (tmp ^ (tmp << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4)) & 0xFFFF
+    return crc
+
+
+def packets(data):
+    """Yield (seqnr, data) of every ENCAPSULATED_DATA packet with a valid CRC"""
+    i = 0
+    while True:
+        i = data.find(bytearray([STX, PAYLOAD_LEN]), i)
+        if i < 0 or i + 6 + PAYLOAD_LEN + 2 > len(data):
+            return
+        if bytearray(data[i + 5:i + 6])[0] != MSG_ENCAPSULATED_DATA:
+            i += 1
+            continue
+        end = i + 6 + PAYLOAD_LEN
+        crc, = struct.unpack_from("<H", data, end)
+        if crc != crc_x25(bytes(data[i + 1:end]) + bytearray([CRC_EXTRA])):
+            i += 1
+            continue
+        seqnr, = struct.unpack_from("<H", data, i + 6)
+        yield seqnr, bytes(data[i + 8:end])
+        i = end + 2
+
+
+def varint(data, i):
+    v = 0
+    shift = 0
+    while True:
+        b = data[i]
+        i += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, i
+
+
+def zigzag(data, i):
+    v, i = varint(data, i)
+    return (v >> 1) ^ -(v & 1), i
+
+
+def events(payload):
+    """Yield (time, id, args) of the events in one packet, time is the low 32 bits"""
+    data = bytearray(payload)
+    i = HEADER.size
+    time = HEADER.unpack_from(payload, 0)[3]
+    while i < len(data) and data[i] != 0:
+        try:
+            key, i = varint(data, i)
+            dt, i = zigzag(data, i)
+            args = []
+            for _ in range(key & 3):
+                a, i = zigzag(data, i)
+                args.append(a)
+        except IndexError:
+            sys.stderr.write("truncated event\n")
+            return
+        time = (time + dt) & 0xFFFFFFFF
+        yield time, key >> 2, args
+
+
+def c_format(text, args):
+    """Format a C printf text with int32 arguments"""
+    out = []
+    pos = 0
+    n = 0
+    for m in CONVERSION.finditer(text):
+        out.append(text[pos:m.start()])
+        pos = m.end()
+        flags, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        v = args[n] if n < len(args) else 0
+        n += 1
+        if conv in "uxXo":
+            v &= 0xFFFFFFFF
+        if conv in "iu":
+            conv = "d"
+        out.append(("%" + flags + conv) % v)
+    out.append(text[pos:])
+    return "".join(out)
+
+
+def unwrap_time(base, t):
+    """Return t as the value closest to base, base is unwrapped"""
+    return base + ((t - base + (1 << 31)) & 0xFFFFFFFF) - (1 << 31)
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "", ["table="])
+    except getopt.GetoptError:
+        opts, args = [], []
+    if len(args) != 1:
+        print(USAGE, file=sys.stderr)
+        sys.exit(1)
+    opts = dict(opts)
+    default = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "generated", "debug_events.json")
+    table = json.load(open(opts.get("--table", default)))
+    texts = dict((e["id"], e["text"]) for e in table["events"])
+
+    if args[0] == "-":
+        data = getattr(sys.stdin, "buffer", sys.stdin).read()
+    else:
+        data = open(args[0], "rb").read()
+
+    base = None
+    last_seqnr = None
+    skipped = 0
+    for seqnr, payload in packets(data):
+        magic, dropped, table_hash, first = HEADER.unpack_from(payload, 0)
+        if magic != MAGIC:
+            continue
+        if table_hash != table["hash"]:
+            skipped += 1
+            continue
+        # Both channels carry the same packets, keep the first copy
+        if last_seqnr is not None:
+            gap = (seqnr - last_seqnr) & 0xFFFF
+            if gap == 0:
+                continue
+            if gap > 0x8000:
+                print("-- packet sequence restarted")
+            elif gap > 1:
+                print("-- %d packets lost" % (gap - 1))
+        last_seqnr = seqnr
+        if dropped:
+            print("-- %s%d events dropped onboard" % ("at least " if dropped == 255 else "", dropped))
+        for time, id, values in events(payload):
+            base = time if base is None else unwrap_time(base, time)
+            text = texts.get(id)
+            if text is None:
+                print("%12.6f  unknown event %d %s" % (base / 1e6, id, values))
+            else:
+                print("%12.6f  %s" % (base / 1e6, c_format(text, values)))
+
+    if skipped:
+        sys.stderr.write("%d packets of another string table skipped\n" % skipped)
+
+
+if __name__ == "__main__":
+    main()
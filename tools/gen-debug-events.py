@@ -0,0 +1,173 @@
+#!/usr/bin/env python
+#
+# Generates the debug event ids and their string table.
+#
+# The sources are scanned for debug_event(DEBUG_EVENT_NAME, "text", ...)
+# calls (system/debug.h). Every name gets an id, in the order of the
+# sorted names so that adding an event only moves the ones after it. The
+# text is not compiled into the firmware, it goes into the JSON table
+# tools/debug-event-decode.py formats the events with on the ground. Both
+# carry a hash over the table, the decoder refuses packets of another
+# firmware build.
+#
+# The text is a printf format with up to three integer conversions, one
+# for each argument of the call. The same name may be used in several
+# places with the same text.
+#
+# The outputs are only written if they changed, so the objects that
+# include the header are not rebuilt on every run.
+
+from __future__ import print_function
+
+import getopt
+import json
+import os
+import re
+import sys
+
+USAGE = "Usage: %s -o debug_events.h [-t debug_events.json] file.c ..." % sys.argv[0]
+H = "DEBUG_EVENTS_H"
+
+MAX_ARGS = 3
+MAX_ID = (1 << 14) - 1      # id << 2 | argc fits into a 2 byte varint
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+# Comments are removed, string and character literals are kept
+TOKEN = re.compile(r"(\"(?:[^\"\\\n]|\\.)*\"|'(?:[^'\\\n]|\\.)*')|/\*.*?\*/|//[^\n]*", re.S)
+CALL = re.compile(r"\bdebug_event\s*\(\s*(DEBUG_EVENT_\w+)\s*,\s*((?:\"(?:[^\"\\\n]|\\.)*\"\s*)+)")
+LITERAL = re.compile(r"\"((?:[^\"\\\n]|\\.)*)\"")
+CONVERSION = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(hh|h|l)?([%a-zA-Z])")
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "\\": "\\", "\"": "\"", "'": "'", "0": "\0"}
+
+
+def strip_comments(src):
+    return TOKEN.sub(lambda m: m.group(1) or " ", src)
+
+
+def unescape(text):
+    return re.sub(r"\\(.)", lambda m: ESCAPES.get(m.group(1), m.group(1)), text)
+
+
+def count_args(src, pos):
+    """Return the number of arguments after the text, pos is just after it"""
+    depth = 0
+    args = 0
+    i = pos
+    while i < len(src):
+        c = src[i]
+        if c in "\"'":
+            i = TOKEN.match(src, i).end()
+            continue
+        if c in "([{":
+            depth += 1
+        elif c in ")]}":
+            if depth == 0:
+                return args
+            depth -= 1
+        elif c == "," and depth == 0:
+            args += 1
+        i += 1
+    raise Exception("unterminated debug_event() call")
+
+
+def conversions(where, text):
+    count = 0
+    for flags, length, conv in CONVERSION.findall(text):
+        if conv == "%":
+            continue
+        if conv not in "diuxXoc":
+            raise Exception("%s: only integer conversions are allowed: \"%s\"" % (where, text))
+        count += 1
+    return count
+
+
+def parse(filenames):
+    events = {}
+    for filename in filenames:
+        src = strip_comments(open(filename, "rb").read().decode("latin-1"))
+        for m in CALL.finditer(src):
+            name = m.group(1)
+            text = "".join(LITERAL.findall(m.group(2)))
+            where = "%s:%d" % (filename, src.count("\n", 0, m.start()) + 1)
+            args = count_args(src, m.end())
+            if args > MAX_ARGS:
+                raise Exception("%s: %s has more than %d arguments" % (where, name, MAX_ARGS))
+            if conversions(where, text) != args:
+                raise Exception("%s: %s has %d arguments for \"%s\"" % (where, name, args, text))
+            if name in events and events[name] != text:
+                raise Exception("%s: %s has two texts: \"%s\", \"%s\"" % (where, name, events[name], text))
+            events[name] = text
+    if len(events) > MAX_ID:
+        raise Exception("too many debug events")
+    return sorted(events.items())
+
+
+def table_hash(events):
+    h = FNV_OFFSET
+    for name, text in events:
+        for c in name + "\0" + text + "\0":
+            h ^= ord(c)
+            h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def header(filenames, events):
+    lines = []
+    lines.append("/* This file has been generated from the debug_event() calls in %d source files */" % len(filenames))
+    lines.append("/* This file has been generated by %s */" % sys.argv[0])
+    lines.append("/* Please DO NOT EDIT */")
+    lines.append("")
+    lines.append("#ifndef %s" % H)
+    lines.append("#define %s" % H)
+    lines.append("")
+    lines.append("/* Hash over the string table, sent with every event packet */")
+    lines.append("#define DEBUG_EVENT_TABLE_HASH 0x%08Xu" % table_hash(events))
+    lines.append("")
+    lines.append("enum debug_event_ids")
+    lines.append("{")
+    lines.append("\tDEBUG_EVENT_NONE = 0,")
+    for i, (name, text) in enumerate(events):
+        lines.append("\t%s = %d, /* %s */" % (name, i + 1, text.replace("*/", "* /")))
+    lines.append("\tDEBUG_EVENT_ID_COUNT")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif /* %s */" % H)
+    return "\n".join(lines) + "\n"
+
+
+def table(events):
+    return json.dumps({
+        "hash": table_hash(events),
+        "events": [{"id": i + 1, "name": name, "text": unescape(text)}
+                   for i, (name, text) in enumerate(events)],
+    }, indent=1, separators=(",", ": "), sort_keys=True) + "\n"
+
+
+def write_if_changed(filename, content):
+    if os.path.exists(filename) and open(filename).read() == content:
+        return
+    d = os.path.dirname(filename)
+    if d and not os.path.isdir(d):
+        os.makedirs(d)
+    open(filename, "w").write(content)
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "o:t:")
+    except getopt.GetoptError:
+        opts, args = [], []
+    opts = dict(opts)
+    if "-o" not in opts or not args:
+        print(USAGE, file=sys.stderr)
+        sys.exit(1)
+    events = parse(args)
+    write_if_changed(opts["-o"], header(args, events))
+    if "-t" in opts:
+        write_if_changed(opts["-t"], table(events))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+#
+# Generates a minimal perfect hash over the onboard parameter names.
+#
+# The enum is taken from system/global_data.h, the names from param_table
+# in system/param_table.c. The output header maps a MAVLink param_id
+# string to its PARAM_* index with two table lookups and one string
+# compare instead of scanning all ONBOARD_PARAM_COUNT names.
+#
+# Hash: 32 bit FNV-1a, seeded. The first level picks a bucket with the
+# seed 0 hash, the second level rehashes with a per-bucket seed (the
+# displacement) found by this script so that every name lands in its own
+# slot. Slots are reduced with a multiply-shift, which avoids the software
+# division of a modulo on the ARM7.
+
+from __future__ import print_function
+
+import re
+import sys
+
+USAGE = "Usage: %s system/global_data.h system/param_table.c" % sys.argv[0]
+H = "PARAM_HASH_H"
+
+NAME_LENGTH = 15            # ONBOARD_PARAM_NAME_LENGTH in conf/conf.h
+BUCKET_BITS = 6
+MAX_SEED = 0xFFFF
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+
+ENUM = re.compile(r"enum\s*\{(.*?)\}\s*global_param_id", re.S)
+ENUM_ENTRY = re.compile(r"^\s*(PARAM_\w+)", re.M)
+NAME = re.compile(r"\[(PARAM_\w+)\]\s*=\s*\{\s*\"([^\"]*)\"")
+LINE_COMMENT = re.compile(r"//[^\n]*")
+
+
+def fnv1a(seed, key):
+    h = (FNV_OFFSET ^ seed) & 0xFFFFFFFF
+    for c in key[:NAME_LENGTH]:
+        h ^= ord(c)
+        h = (h * FNV_PRIME) & 0xFFFFFFFF
+    return h
+
+
+def bucket_of(key):
+    return fnv1a(0, key) & ((1 << BUCKET_BITS) - 1)
+
+
+def slot_of(seed, key, count):
+    return (fnv1a(seed, key) * count) >> 32
+
+
+def parse(enum_file, table_file):
+    src = LINE_COMMENT.sub("", open(enum_file).read())
+    m = ENUM.search(src)
+    if not m:
+        raise Exception("global_param_id enum not found in %s" % enum_file)
+    ids = ENUM_ENTRY.findall(m.group(1))
+    names = {}
+    for param, name in NAME.findall(LINE_COMMENT.sub("", open(table_file).read())):
+        if param in names and names[param] != name:
+            raise Exception("%s has two names: %s, %s" % (param, names[param], name))
+        if len(name) >= NAME_LENGTH:
+            raise Exception("%s name too long: %s" % (param, name))
+        names[param] = name
+    missing = [p for p in ids if p not in names]
+    if missing:
+        raise Exception("parameters without name: %s" % ", ".join(missing))
+    if len(set(names.values())) != len(names):
+        raise Exception("duplicate parameter names")
+    return [(p, names[p]) for p in ids]
+
+
+def build(params):
+    count = len(params)
+    buckets = [[] for _ in range(1 << BUCKET_BITS)]
+    for i, (param, name) in enumerate(params):
+        buckets[bucket_of(name)].append(i)
+
+    seeds = [0] * len(buckets)
+    slots = [None] * count
+    # Place the largest buckets first while the table is still empty
+    for b in sorted(range(len(buckets)), key=lambda b: -len(buckets[b])):
+        members = buckets[b]
+        if not members:
+            continue
+        for seed in range(MAX_SEED + 1):
+            wanted = [slot_of(seed, params[i][1], count) for i in members]
+            if len(set(wanted)) == len(wanted) and all(slots[s] is None for s in wanted):
+                for s, i in zip(wanted, members):
+                    slots[s] = i
+                seeds[b] = seed
+                break
+        else:
+            raise Exception("no displacement found for bucket %d" % b)
+    return seeds, slots
+
+
+def verify(params, seeds, slots):
+    count = len(params)
+    for i, (param, name) in enumerate(params):
+        s = slot_of(seeds[bucket_of(name)], name, count)
+        if slots[s] != i:
+            raise Exception("%s does not hash to its own slot" % name)
+
+
+def emit(filenames, params, seeds, slots):
+    print("/* This file has been generated from %s */" % " ".join(filenames))
+    print("/* This file has been generated by %s */" % sys.argv[0])
+    print("/* Please DO NOT EDIT */")
+    print()
+    print("#ifndef %s" % H)
+    print("#define %s" % H)
+    print()
+    print("#define PARAM_HASH_COUNT %d" % len(params))
+    print("#define PARAM_HASH_BUCKET_BITS %d" % BUCKET_BITS)
+    print("#define PARAM_HASH_FNV_OFFSET %uu" % FNV_OFFSET)
+    print("#define PARAM_HASH_FNV_PRIME %uu" % FNV_PRIME)
+    print()
+    print("/* Fails to compile if the enum changed and this file is stale */")
+    print("typedef char param_hash_count_check[(PARAM_HASH_COUNT == ONBOARD_PARAM_COUNT) ? 1 : -1];")
+    print()
+    print("/* Second level seed per first level bucket */")
+    print("static const uint16_t param_hash_seed[1 << PARAM_HASH_BUCKET_BITS] =")
+    print("{")
+    for i in range(0, len(seeds), 8):
+        print("\t" + ", ".join("%5d" % s for s in seeds[i:i + 8]) + ",")
+    print("};")
+    print()
+    print("/* Parameter index stored in each slot */")
+    print("static const uint8_t param_hash_slot[PARAM_HASH_COUNT] =")
+    print("{")
+    for s, i in enumerate(slots):
+        print("\t%s, /* %3d: %s */" % (params[i][0], s, params[i][1]))
+    print("};")
+    print()
+    print("#endif /* %s */" % H)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(USAGE, file=sys.stderr)
+        sys.exit(1)
+    params = parse(sys.argv[1], sys.argv[2])
+    if len(params) > 255:
+        raise Exception("slot table is uint8_t, too many parameters")
+    seeds, slots = build(params)
+    verify(params, seeds, slots)
+    emit(sys.argv[1:], params, seeds, slots)
+
+
+if __name__ == "__main__":
+    main()
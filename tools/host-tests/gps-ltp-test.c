@@ -0,0 +1,192 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the GPS tangent plane projection
+ *
+ *   gps_get_local_position() projects fixes within 10 km of the origin
+ *   on its tangent plane. Random fixes around origins from the equator
+ *   to 80 deg latitude and next to the date line are checked against
+ *   the exact north and east offsets from WGS84 ECEF in double, and
+ *   against the UTM path of latlong.c with the grid convergence and
+ *   scale of the origin taken out.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "global_data.h"
+#include "gps.h"
+#include "gps_transformations.h"
+#include "latlong.h"
+
+#define POINTS 50000
+#define RADIUS 10000.0              ///< m
+
+#define WGS84_A 6378137.0
+#define WGS84_E2 0.00669437999014
+#define RAD_PER_UNIT (M_PI / 180 / 1e7)
+
+/* Error bounds in m */
+#define LTP_BOUND 0.1               ///< Up to 65 deg latitude
+#define LTP_BOUND_POLAR 0.2         ///< Above
+#define UTM_BOUND 5.0               ///< Float UTM against the tangent plane
+
+typedef struct
+{
+	double lat;                     ///< deg
+	double lon;                     ///< deg
+	int utm;                        ///< Compare with UTM
+} origin_t;
+
+static double random_uniform(double min, double max)
+{
+	return min + (max - min) * rand() / (double) RAND_MAX;
+}
+
+static void ecef(int32_t lat, int32_t lon, double* p)
+{
+	double phi = lat * RAD_PER_UNIT, lambda = lon * RAD_PER_UNIT;
+	double n = WGS84_A / sqrt(1 - WGS84_E2 * sin(phi) * sin(phi));
+	p[0] = n * cos(phi) * cos(lambda);
+	p[1] = n * cos(phi) * sin(lambda);
+	p[2] = n * (1 - WGS84_E2) * sin(phi);
+}
+
+/** @brief Exact north and east of a point on the ellipsoid, tangent plane at the origin */
+static void exact_ne(int32_t lat0, int32_t lon0, int32_t lat, int32_t lon, double* north, double* east)
+{
+	double p0[3], p[3], d[3];
+	ecef(lat0, lon0, p0);
+	ecef(lat, lon, p);
+	for (int i = 0; i < 3; i++)
+	{
+		d[i] = p[i] - p0[i];
+	}
+	double phi = lat0 * RAD_PER_UNIT, lambda = lon0 * RAD_PER_UNIT;
+	*north = -sin(phi) * cos(lambda) * d[0] - sin(phi) * sin(lambda) * d[1] + cos(phi) * d[2];
+	*east = -sin(lambda) * d[0] + cos(lambda) * d[1];
+}
+
+static int32_t wrap_lon(double lon_units)
+{
+	if (lon_units > 1800000000.0)
+		lon_units -= 3600000000.0;
+	else if (lon_units < -1800000000.0)
+		lon_units += 3600000000.0;
+	return (int32_t) llround(lon_units);
+}
+
+static void utm(int32_t lat, int32_t lon, uint8_t zone, double* north, double* east)
+{
+	latlong_utm_of(lat * RAD_PER_UNIT, lon * RAD_PER_UNIT, zone);
+	*north = latlong_utm_y;
+	*east = latlong_utm_x;
+}
+
+static void check_origin(const origin_t* o)
+{
+	int32_t lat0 = llround(o->lat * 1e7), lon0 = llround(o->lon * 1e7);
+	uint8_t zone = (uint8_t) ((o->lon + 180) / 6) + 1;
+	double bound = fabs(o->lat) > 65 ? LTP_BOUND_POLAR : LTP_BOUND;
+	double max_ltp = 0, max_utm = 0;
+
+	gps_lat = lat0;
+	gps_lon = lon0;
+	gps_alt = 40000;
+	gps_set_local_origin();
+
+	// Grid convergence and scale at the origin, central difference over
+	// 10 km north and south, float UTM has about 0.5 m resolution
+	double un0, ue0, un1, ue1, un2, ue2, n1, n2, e;
+	utm(lat0, lon0, zone, &un0, &ue0);
+	utm(lat0 + 900000, lon0, zone, &un1, &ue1);
+	utm(lat0 - 900000, lon0, zone, &un2, &ue2);
+	exact_ne(lat0, lon0, lat0 + 900000, lon0, &n1, &e);
+	exact_ne(lat0, lon0, lat0 - 900000, lon0, &n2, &e);
+	double convergence = atan2(ue1 - ue2, un1 - un2);
+	double scale = hypot(un1 - un2, ue1 - ue2) / (n1 - n2);
+
+	double m = WGS84_A * (1 - WGS84_E2) / pow(1 - WGS84_E2 * sin(o->lat * M_PI / 180)
+			* sin(o->lat * M_PI / 180), 1.5);
+	double n = WGS84_A / sqrt(1 - WGS84_E2 * sin(o->lat * M_PI / 180) * sin(o->lat * M_PI / 180));
+
+	for (int i = 0; i < POINTS; i++)
+	{
+		// Uniform in the disk
+		double r = RADIUS * sqrt(random_uniform(0, 1));
+		double a = random_uniform(-M_PI, M_PI);
+		gps_lat = lat0 + llround(r * cos(a) / m / RAD_PER_UNIT);
+		gps_lon = wrap_lon(lon0 + r * sin(a) / (n * cos(o->lat * M_PI / 180)) / RAD_PER_UNIT);
+		gps_alt = 40000 + rand() % 10000;
+
+		float_vect3 local;
+		gps_get_local_position(&local);
+		double north, east;
+		exact_ne(lat0, lon0, gps_lat, gps_lon, &north, &east);
+		e = hypot(local.x - north, local.y - east);
+		CHECK(e <= bound, "origin %.2f %.2f, fix %d %d: %g m off", o->lat, o->lon, gps_lat, gps_lon, e);
+		CHECK_NEAR(local.z, -(gps_alt - 40000) / 100.0, 1e-3, "z");
+		max_ltp = fmax(max_ltp, e);
+
+		if (o->utm)
+		{
+			double un, ue;
+			utm(gps_lat, gps_lon, zone, &un, &ue);
+			double dn = (un - un0) / scale, de = (ue - ue0) / scale;
+			double utm_north = cos(convergence) * dn + sin(convergence) * de;
+			double utm_east = -sin(convergence) * dn + cos(convergence) * de;
+			e = hypot(local.x - utm_north, local.y - utm_east);
+			CHECK(e <= UTM_BOUND, "origin %.2f %.2f, fix %d %d: %g m from UTM", o->lat, o->lon, gps_lat, gps_lon, e);
+			max_utm = fmax(max_utm, e);
+		}
+	}
+	printf("origin %7.2f %8.2f: max error %.3f m, %s %.2f m\n", o->lat, o->lon, max_ltp,
+			o->utm ? "from UTM" : "no UTM", max_utm);
+}
+
+int main(void)
+{
+	static const origin_t origins[] =
+	{
+		{ 0.5, 10.3, 1 },
+		{ 47.38, 8.54, 1 },
+		{ -33.9, 151.2, 1 },
+		{ 65.0, -18.0, 1 },
+		{ 80.0, 15.6, 1 },
+		// UTM zones end at the date line
+		{ 10.0, 179.99, 0 },
+		{ -10.0, -179.99, 0 },
+	};
+
+	srand(1);
+	for (unsigned int i = 0; i < sizeof(origins) / sizeof(origins[0]); i++)
+	{
+		check_origin(&origins[i]);
+	}
+
+	return host_test_done("gps-ltp-test");
+}
@@ -0,0 +1,73 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Checks shared by the host tests
+ *
+ *   A failed check prints its location and the values and is counted,
+ *   the test goes on. host_test_done() prints the summary and gives the
+ *   exit code for main().
+ *
+ *   @author Lorenz Meier
+ */
+
+#ifndef HOST_TEST_H_
+#define HOST_TEST_H_
+
+#include <stdio.h>
+#include <math.h>
+
+static unsigned int host_test_checks = 0;
+static unsigned int host_test_failed = 0;
+
+/** @brief Check a condition, the message is a printf format */
+#define CHECK(cond, ...) \
+	do \
+	{ \
+		host_test_checks++; \
+		if (!(cond)) \
+		{ \
+			host_test_failed++; \
+			if (host_test_failed <= 20) \
+			{ \
+				printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+				printf(__VA_ARGS__); \
+				printf("\n"); \
+			} \
+		} \
+	} while (0)
+
+/** @brief Check that |a - b| <= tol */
+#define CHECK_NEAR(a, b, tol, what) \
+	CHECK(fabs((double) (a) - (double) (b)) <= (tol), "%s: %g, expected %g +- %g", \
+			(what), (double) (a), (double) (b), (double) (tol))
+
+/** @brief Print the summary, returns the exit code */
+static inline int host_test_done(const char* name)
+{
+	printf("%s: %u checks, %u failed\n", name, host_test_checks, host_test_failed);
+	return host_test_failed ? 1 : 0;
+}
+
+#endif /* HOST_TEST_H_ */
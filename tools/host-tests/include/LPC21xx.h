@@ -0,0 +1,16 @@
+/* Host test stand-in for the LPC21xx registers, only what the tested code uses */
+
+#ifndef LPC21xx_H_
+#define LPC21xx_H_
+
+#include <stdint.h>
+
+/* Defined by the test */
+extern uint32_t IO0DIR, IO0SET, IO0CLR;
+extern uint32_t SSPCR0, SSPCR1, SSPCPSR;
+
+/* Reads the receive FIFO */
+uint16_t host_spi_read(void);
+#define SSPDR host_spi_read()
+
+#endif /* LPC21xx_H_ */
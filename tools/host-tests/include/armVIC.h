@@ -0,0 +1,10 @@
+/* Host test stand-in for armVIC.h, the test knows when the interrupts are off */
+
+#ifndef ARMVIC_H_
+#define ARMVIC_H_
+
+/* Defined by the test, return the previous state like the firmware */
+unsigned disableIRQ(void);
+unsigned restoreIRQ(unsigned oldCPSR);
+
+#endif /* ARMVIC_H_ */
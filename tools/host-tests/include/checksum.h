@@ -0,0 +1,24 @@
+/* Host test stand-in for the MAVLink checksum.h, CRC-16/X.25 as in the firmware */
+
+#ifndef CHECKSUM_H_
+#define CHECKSUM_H_
+
+#include <stdint.h>
+
+#define X25_INIT_CRC 0xffff
+
+static inline void crc_accumulate(uint8_t data, uint16_t* crcAccum)
+{
+	uint8_t tmp;
+
+	tmp = data ^ (uint8_t) (*crcAccum & 0xff);
+	tmp ^= (tmp << 4);
+	*crcAccum = (*crcAccum >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4);
+}
+
+static inline void crc_init(uint16_t* crcAccum)
+{
+	*crcAccum = X25_INIT_CRC;
+}
+
+#endif /* CHECKSUM_H_ */
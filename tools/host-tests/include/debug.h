@@ -0,0 +1,31 @@
+/* Host stand-in for system/debug.h, the messages are printed */
+
+#ifndef DEBUG_H_
+#define DEBUG_H_
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "mav_vect.h"
+
+#define debug_event(id, text, ...) ((void) 0)
+
+static inline uint8_t debug_message_buffer(const char* string)
+{
+	printf("debug: %s\n", string);
+	return 1;
+}
+
+static inline uint8_t debug_message_buffer_sprintf(const char* string, const uint32_t num)
+{
+	printf("debug: ");
+	printf(string, num);
+	printf("\n");
+	return 1;
+}
+
+static inline void debug_vect(const char* string, const float_vect3 vect)
+{
+	printf("debug: %s %g %g %g\n", string, vect.x, vect.y, vect.z);
+}
+
+#endif /* DEBUG_H_ */
@@ -0,0 +1,4 @@
+/* Host test stand-in for mavlink.h, the firmware takes it from the pixhawk dialect */
+
+#include "checksum.h"
+#include "pixhawk/mavlink.h"
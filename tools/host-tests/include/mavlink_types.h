@@ -0,0 +1,43 @@
+/* Host test stand-in for the MAVLink v1.0 types, only what the tested code uses */
+
+#ifndef MAVLINK_TYPES_H_
+#define MAVLINK_TYPES_H_
+
+#include <stdint.h>
+#include <inttypes.h>
+
+#ifndef MAVLINK_COMM_NUM_BUFFERS
+#define MAVLINK_COMM_NUM_BUFFERS 2
+#endif
+
+typedef struct
+{
+	uint8_t sysid;
+	uint8_t compid;
+	uint8_t type;
+} mavlink_system_t;
+
+typedef enum
+{
+	MAVLINK_COMM_0,
+	MAVLINK_COMM_1,
+	MAVLINK_COMM_2,
+	MAVLINK_COMM_3
+} mavlink_channel_t;
+
+typedef enum
+{
+	MAVLINK_TYPE_CHAR,
+	MAVLINK_TYPE_UINT8_T,
+	MAVLINK_TYPE_INT8_T,
+	MAVLINK_TYPE_UINT16_T,
+	MAVLINK_TYPE_INT16_T,
+	MAVLINK_TYPE_UINT32_T,
+	MAVLINK_TYPE_INT32_T,
+	MAVLINK_TYPE_UINT64_T,
+	MAVLINK_TYPE_INT64_T,
+	MAVLINK_TYPE_FLOAT,
+	MAVLINK_TYPE_DOUBLE
+} mavlink_message_type_t;
+
+#endif /* MAVLINK_TYPES_H_ */
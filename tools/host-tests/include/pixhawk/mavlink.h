@@ -0,0 +1,46 @@
+/* Host test stand-in for the pixhawk MAVLink v1.0 dialect, only what the tested code uses */
+
+#ifndef PIXHAWK_MAVLINK_H_
+#define PIXHAWK_MAVLINK_H_
+
+#include "mavlink_types.h"
+
+enum MAV_TYPE
+{
+	MAV_TYPE_GENERIC = 0,
+	MAV_TYPE_FIXED_WING = 1,
+	MAV_TYPE_QUADROTOR = 2,
+	MAV_TYPE_COAXIAL = 3,
+	MAV_TYPE_HELICOPTER = 4,
+	MAV_TYPE_GROUND_ROVER = 10
+};
+
+enum MAV_STATE
+{
+	MAV_STATE_UNINIT = 0,
+	MAV_STATE_BOOT,
+	MAV_STATE_CALIBRATING,
+	MAV_STATE_STANDBY,
+	MAV_STATE_ACTIVE,
+	MAV_STATE_CRITICAL,
+	MAV_STATE_EMERGENCY,
+	MAV_STATE_POWEROFF
+};
+
+enum MAV_MODE_FLAG
+{
+	MAV_MODE_FLAG_CUSTOM_MODE_ENABLED = 1,
+	MAV_MODE_FLAG_TEST_ENABLED = 2,
+	MAV_MODE_FLAG_AUTO_ENABLED = 4,
+	MAV_MODE_FLAG_GUIDED_ENABLED = 8,
+	MAV_MODE_FLAG_STABILIZE_ENABLED = 16,
+	MAV_MODE_FLAG_HIL_ENABLED = 32,
+	MAV_MODE_FLAG_MANUAL_INPUT_ENABLED = 64,
+	MAV_MODE_FLAG_SAFETY_ARMED = 128
+};
+
+/* Defined by the test */
+void mavlink_msg_param_value_send(mavlink_channel_t chan, const int8_t* param_id, float param_value,
+		uint8_t param_type, uint16_t param_count, uint16_t param_index);
+
+#endif /* PIXHAWK_MAVLINK_H_ */
@@ -0,0 +1,28 @@
+/* Host test stand-in for spi.h, the transfers are simulated by the test */
+
+#ifndef SPI_H_
+#define SPI_H_
+
+/* The boards use SPI_USE_POLLING, a second build tests the interrupt driven queue */
+#ifdef HOST_SPI_QUEUE
+#undef SPI_USE_POLLING
+#endif
+
+#define SPI_8_BIT_MODE  0x07 << 0
+#define SPI_16_BIT_MODE 0x0F << 0
+
+typedef struct
+{
+	unsigned short data[8];
+	unsigned char length;
+	unsigned char bit_mode;
+	void (*slave_select)(void);
+	void (*slave_unselect)(void);
+	void (*spi_interrupt_handler)(void);
+} spi_package;
+
+void spi_transmit(spi_package* package);
+int spi_running(void);
+int spi_number_of_packages_in_buffer(void);
+
+#endif /* SPI_H_ */
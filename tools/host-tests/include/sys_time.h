@@ -0,0 +1,10 @@
+/* Host test stand-in for sys_time.h, the clock is simulated by the test */
+
+#ifndef SYS_TIME_H_
+#define SYS_TIME_H_
+
+#include <stdint.h>
+
+uint64_t sys_time_clock_get_time_usec(void);
+
+#endif /* SYS_TIME_H_ */
@@ -0,0 +1,16 @@
+/* Host test configuration, see conf/user_conf.h.dist */
+
+#ifndef _USER_CONF_H_
+#define _USER_CONF_H_
+
+#define PX_GENERIC              1
+#define PX_AIRFRAME_FIXED_WING  2
+#define PX_AIRFRAME_QUADROTOR   3
+#define PX_AIRFRAME_HELICOPTER  4
+#define PX_AIRFRAME_COAXIAL     5
+#define PX_GROUND_CAR           6
+
+#define PX_VEHICLE_TYPE PX_AIRFRAME_QUADROTOR
+#define IMU_PIXHAWK_V260
+
+#endif /* _USER_CONF_H_ */
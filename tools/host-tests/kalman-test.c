@@ -0,0 +1,189 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the Kalman correction
+ *
+ *   kalman_correct() only applies the measurements with a non-zero mask.
+ *   It is run against the dense update it replaced, the full gain times
+ *   the masked error with the matrix functions, on random stable models
+ *   of the attitude (12x9) and position (4x2) filter size. Masks are
+ *   random 0, 1 and fractional weights, plus the fixed attitude filter
+ *   mask. The states have to be equal bit for bit.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "kalman.h"
+
+#define TICKS 20000
+
+/** @brief Dense correction as kalman_correct() did it before */
+static void dense_correct(kalman_t *kalman, m_elem measurement_a[], m_elem mask_a[])
+{
+	m_elem estimate_a[KALMAN_MAX_MEASUREMENTS];
+	m_elem error_a[KALMAN_MAX_MEASUREMENTS];
+	m_elem gain_part_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS];
+	m_elem gain_start_part_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS];
+	m_elem gain_sum_a[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS];
+	m_elem x_update_a[KALMAN_MAX_STATES];
+	int n = kalman->states;
+	int m = kalman->measurements;
+
+	matrix_t measurement = matrix_create(m, 1, measurement_a);
+	matrix_t mask = matrix_create(m, 1, mask_a);
+	matrix_t estimate = matrix_create(m, 1, estimate_a);
+	matrix_t error = matrix_create(m, 1, error_a);
+	matrix_t gain_part = matrix_create(n, m, gain_part_a);
+	matrix_t gain_start_part = matrix_create(n, m, gain_start_part_a);
+	matrix_t gain_sum = matrix_create(n, m, gain_sum_a);
+	matrix_t x_update = matrix_create(n, 1, x_update_a);
+
+	matrix_mult(kalman->c, kalman->x_apriori, estimate);
+	matrix_sub(measurement, estimate, error);
+	matrix_mult_element(error, mask, error);
+
+	kalman->gainfactor = kalman->gainfactor * (1.0f - 1.0f
+			/ kalman->gainfactorsteps) + 1.0f * 1.0f / kalman->gainfactorsteps;
+
+	matrix_mult_scalar(kalman->gainfactor, kalman->gain, gain_part);
+	matrix_mult_scalar(1.0f - kalman->gainfactor, kalman->gain_start,
+			gain_start_part);
+	matrix_add(gain_start_part, gain_part, gain_sum);
+	matrix_mult(gain_sum, error, x_update);
+	matrix_add(kalman->x_apriori, x_update, kalman->x_aposteriori);
+}
+
+static m_elem random_uniform(m_elem min, m_elem max)
+{
+	return min + (max - min) * (m_elem) rand() / (m_elem) RAND_MAX;
+}
+
+/** @brief Filter with its own copy of the model */
+typedef struct
+{
+	kalman_t kalman;
+	m_elem a[KALMAN_MAX_STATES * KALMAN_MAX_STATES];
+	m_elem c[KALMAN_MAX_MEASUREMENTS * KALMAN_MAX_STATES];
+	m_elem gain_start[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS];
+	m_elem gain[KALMAN_MAX_STATES * KALMAN_MAX_MEASUREMENTS];
+	m_elem x_apriori[KALMAN_MAX_STATES];
+	m_elem x_aposteriori[KALMAN_MAX_STATES];
+} filter_t;
+
+static void filter_init(filter_t* f, const filter_t* model, int n, int m)
+{
+	memcpy(f, model, sizeof(*f));
+	kalman_init(&f->kalman, n, m, f->a, f->c, f->gain_start, f->gain,
+			f->x_apriori, f->x_aposteriori, 1000);
+}
+
+/**
+ * @brief Run both corrections on the same model and measurements
+ * @param fixed_mask mask of every tick, 0 for random masks
+ */
+static void check_model(const char* name, int n, int m, const m_elem* fixed_mask)
+{
+	static filter_t model;
+	filter_t sparse, dense;
+	unsigned int mismatches = 0;
+
+	// A near 0.99 I and a gain of C' / |C|^2 keep (I - gain C) A contracting
+	memset(&model, 0, sizeof(model));
+	m_elem c_norm = 0;
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			model.a[i * n + j] = (i == j ? 0.99f : 0) + random_uniform(-0.001f, 0.001f);
+		}
+		for (int k = 0; k < m; k++)
+		{
+			model.c[k * n + i] = random_uniform(-1, 1);
+			c_norm += model.c[k * n + i] * model.c[k * n + i];
+		}
+		model.x_aposteriori[i] = random_uniform(-10, 10);
+	}
+	for (int i = 0; i < n; i++)
+	{
+		for (int k = 0; k < m; k++)
+		{
+			model.gain_start[i * m + k] = 0.2f * model.c[k * n + i] / c_norm
+					* random_uniform(0.9f, 1.1f);
+			model.gain[i * m + k] = 0.8f * model.c[k * n + i] / c_norm
+					* random_uniform(0.9f, 1.1f);
+		}
+	}
+	filter_init(&sparse, &model, n, m);
+	filter_init(&dense, &model, n, m);
+
+	for (int t = 0; t < TICKS; t++)
+	{
+		m_elem measurement[KALMAN_MAX_MEASUREMENTS];
+		m_elem mask[KALMAN_MAX_MEASUREMENTS];
+		for (int k = 0; k < m; k++)
+		{
+			static const m_elem weights[] = { 0, 1, 0.37f };
+			measurement[k] = random_uniform(-10, 10);
+			mask[k] = fixed_mask ? fixed_mask[k] : weights[rand() % 3];
+		}
+
+		kalman_predict(&sparse.kalman);
+		kalman_predict(&dense.kalman);
+		kalman_correct(&sparse.kalman, measurement, mask);
+		dense_correct(&dense.kalman, measurement, mask);
+
+		CHECK(sparse.kalman.gainfactor == dense.kalman.gainfactor,
+				"%s tick %d gainfactor %g, dense %g", name, t,
+				sparse.kalman.gainfactor, dense.kalman.gainfactor);
+		for (int i = 0; i < n; i++)
+		{
+			m_elem s = kalman_get_state(&sparse.kalman, i);
+			m_elem d = kalman_get_state(&dense.kalman, i);
+			CHECK(s == d, "%s tick %d state %d: %.9g, dense %.9g", name, t, i, s, d);
+			CHECK(fabsf(s) < 1000, "%s tick %d state %d diverged: %g", name, t, i, s);
+			mismatches += (s != d);
+		}
+	}
+	printf("%s: %d ticks, %u state mismatches, last x0 %g\n", name, TICKS,
+			mismatches, kalman_get_state(&sparse.kalman, 0));
+}
+
+int main(void)
+{
+	// Default mask of the attitude filter in attitude_tobi_laurens.c
+	static const m_elem attitude_mask[9] = { 1, 1, 1, 0, 0, 0, 1, 1, 1 };
+
+	srand(1);
+	check_model("12x9 random masks", 12, 9, 0);
+	check_model("12x9 attitude mask", 12, 9, attitude_mask);
+	check_model("4x2 random masks", 4, 2, 0);
+	check_model("2x2 vision only", 2, 2, (const m_elem[]) { 0, 1 });
+
+	return host_test_done("kalman-test");
+}
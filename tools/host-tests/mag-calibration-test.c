@@ -0,0 +1,344 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the online magnetometer calibration
+ *
+ *   Synthetic samples of a field of known strength, rotated about all
+ *   axes, are distorted by a hard iron offset, soft iron scales per axis
+ *   and a thrust dependent motor offset, then rounded to counts with
+ *   sensor noise. They are fed to system/mag_calibration.c like
+ *   sensors_read_mag() and the main loop do, and the parameters the fit
+ *   publishes are checked against the distortion:
+ *   - One run recovers offsets and scales, with CAL_MAG_AUTO 2 also the
+ *     motor term, and the corrected field norm is flat.
+ *   - Samples of level turns that do not span the z axis are never
+ *     published.
+ *   - The continuous mode follows a step of the offset, samples while
+ *     not rotating do not move the fit.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "global_data.h"
+#include "mag_calibration.h"
+
+#define RUNS 200
+#define MAX_SAMPLES 5000            ///< Samples fed until a run has to publish
+#define FIELD 500.0                 ///< Field strength in counts
+#define NOISE 2.0                   ///< Sensor noise in counts, standard deviation
+
+/* Error bounds */
+#define OFFSET_BOUND 3.0            ///< counts
+#define SCALE_BOUND 0.01
+#define MOTOR_BOUND 4.0             ///< counts
+#define NORM_BOUND 0.02             ///< Corrected norm, relative to the mean
+#define STEP 40.0                   ///< Offset step in counts in continuous mode
+
+/** @brief Distortion of one run */
+typedef struct
+{
+	double offset[3];               ///< counts
+	double axis[3];                 ///< Soft iron semi axes, counts
+	double motor[3];                ///< Offset at full thrust, counts
+} distortion_t;
+
+static uint32_t published = 0;
+
+void mavlink_msg_param_value_send(mavlink_channel_t chan, const int8_t* param_id, float param_value,
+		uint8_t param_type, uint16_t param_count, uint16_t param_index)
+{
+	(void) param_id;
+	(void) param_value;
+	(void) param_type;
+	(void) param_count;
+	if (chan == MAVLINK_COMM_0 && param_index == PARAM_CAL_MAG_OFFSET_X)
+	{
+		published++;
+	}
+}
+
+void param_set_dirty(uint16_t param_id)
+{
+	(void) param_id;
+}
+
+static double random_uniform(double min, double max)
+{
+	return min + (max - min) * rand() / (double) RAND_MAX;
+}
+
+static double random_normal(void)
+{
+	double u = random_uniform(1e-12, 1), v = random_uniform(0, 1);
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void random_distortion(distortion_t* d, uint8_t motor)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		d->offset[i] = random_uniform(-200, 200);
+		d->axis[i] = FIELD * random_uniform(0.8, 1.25);
+		d->motor[i] = motor ? random_uniform(-60, 60) : 0;
+	}
+}
+
+/** @brief Feed one raw sample of a field direction u, returns it in counts */
+static void feed(const distortion_t* d, const double* u, double thrust, double* m)
+{
+	int16_vect3 raw;
+	for (int i = 0; i < 3; i++)
+	{
+		m[i] = d->offset[i] + d->motor[i] * thrust + d->axis[i] * u[i];
+		m[i] = floor(m[i] + NOISE * random_normal() + 0.5);
+	}
+	raw.x = (int16_t) m[0];
+	raw.y = (int16_t) m[1];
+	raw.z = (int16_t) m[2];
+	mag_calibration_sample(&raw, (float) thrust);
+	mag_calibration_update();
+}
+
+static void random_direction(double* u)
+{
+	double n;
+	do
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			u[i] = random_uniform(-1, 1);
+		}
+		n = sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+	} while (n > 1 || n < 0.1);
+	for (int i = 0; i < 3; i++)
+	{
+		u[i] /= n;
+	}
+}
+
+/** @brief Feed samples about all axes until a result is published, returns the samples used */
+static int feed_until_published(const distortion_t* d, uint8_t motor)
+{
+	uint32_t before = published;
+	for (int n = 1; n <= MAX_SAMPLES; n++)
+	{
+		double u[3], m[3];
+		random_direction(u);
+		feed(d, u, motor ? random_uniform(0, 1) : 0, m);
+		if (published != before)
+		{
+			return n;
+		}
+	}
+	return 0;
+}
+
+/** @brief Check the published parameters against the distortion */
+static void check_published(const distortion_t* d, uint8_t motor)
+{
+	double mean = (d->axis[0] + d->axis[1] + d->axis[2]) / 3;
+	for (int i = 0; i < 3; i++)
+	{
+		CHECK_NEAR(global_data.param[PARAM_CAL_MAG_OFFSET_X + i], d->offset[i], OFFSET_BOUND, "offset");
+		CHECK_NEAR(global_data.param[PARAM_CAL_MAG_SCALE_X + i], mean / d->axis[i], SCALE_BOUND, "scale");
+		if (motor)
+		{
+			CHECK_NEAR(global_data.param[PARAM_CAL_MAG_MOTOR_X + i], d->motor[i], MOTOR_BOUND, "motor");
+		}
+	}
+
+	// Norm of the corrected field as sensors_read_mag() computes it, noise free
+	double min = 1e9, max = 0;
+	for (int n = 0; n < 1000; n++)
+	{
+		double u[3], norm = 0, t = motor ? random_uniform(0, 1) : 0;
+		random_direction(u);
+		for (int i = 0; i < 3; i++)
+		{
+			double m = d->offset[i] + d->motor[i] * t + d->axis[i] * u[i];
+			double c = (m - global_data.param[PARAM_CAL_MAG_OFFSET_X + i]
+					- global_data.param[PARAM_CAL_MAG_MOTOR_X + i] * t)
+					* global_data.param[PARAM_CAL_MAG_SCALE_X + i];
+			norm += c * c;
+		}
+		norm = sqrt(norm);
+		min = fmin(min, norm);
+		max = fmax(max, norm);
+	}
+	CHECK((max - min) / mean <= 2 * NORM_BOUND, "corrected norm %g - %g, mean field %g", min, max, mean);
+}
+
+static void reset_params(uint8_t mode)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		global_data.param[PARAM_CAL_MAG_OFFSET_X + i] = 0;
+		global_data.param[PARAM_CAL_MAG_SCALE_X + i] = 1;
+		global_data.param[PARAM_CAL_MAG_MOTOR_X + i] = 0;
+	}
+	global_data.param[PARAM_CAL_MAG_AUTO] = mode;
+	mag_calibration_init();
+}
+
+/** @brief Single runs started with MAV_CMD_PREFLIGHT_CALIBRATION */
+static void test_once(uint8_t mode)
+{
+	uint8_t motor = (mode == MAG_CAL_ELLIPSOID_MOTOR);
+	int worst = 0;
+	for (int run = 0; run < RUNS; run++)
+	{
+		distortion_t d;
+		random_distortion(&d, motor);
+		reset_params(mode);
+		mag_calibration_start();
+
+		int n = feed_until_published(&d, motor);
+		CHECK(n >= MAG_CAL_MIN_SAMPLES, "mode %u run %d: published after %d samples", mode, run, n);
+		if (n == 0)
+		{
+			continue;
+		}
+		worst = (n > worst) ? n : worst;
+		check_published(&d, motor);
+
+		// A single run stops after publishing
+		uint32_t before = published;
+		feed_until_published(&d, motor);
+		CHECK(published == before || mode != MAG_CAL_OFF, "mode %u run %d: published twice", mode, run);
+	}
+	printf("CAL_MAG_AUTO %u: published after %d samples at most\n", mode, worst);
+}
+
+/** @brief Level turns with up to 30 deg of tilt do not span z far enough, nothing is published */
+static void test_one_axis(void)
+{
+	for (int run = 0; run < RUNS / 10; run++)
+	{
+		distortion_t d;
+		random_distortion(&d, 0);
+		reset_params(MAG_CAL_OFF);
+		mag_calibration_start();
+
+		uint32_t before = published;
+		for (int n = 0; n < MAX_SAMPLES; n++)
+		{
+			double a = random_uniform(0, 2 * M_PI), tilt = random_uniform(-M_PI / 6, M_PI / 6), m[3];
+			double u[3] = { cos(a) * cos(tilt), sin(a) * cos(tilt), sin(tilt) };
+			feed(&d, u, 0, m);
+		}
+		CHECK(published == before, "run %d: published without z coverage", run);
+	}
+}
+
+/** @brief Continuous mode republishes after the offset changed */
+static void test_continuous(void)
+{
+	for (int run = 0; run < RUNS / 10; run++)
+	{
+		distortion_t d;
+		random_distortion(&d, 0);
+		reset_params(MAG_CAL_ELLIPSOID);
+
+		CHECK(feed_until_published(&d, 0) > 0, "run %d: not published", run);
+		check_published(&d, 0);
+		for (int n = 0; n < MAX_SAMPLES; n++)
+		{
+			double u[3], m[3];
+			random_direction(u);
+			feed(&d, u, 0, m);
+		}
+
+		// The old samples are forgotten
+		int axis = rand() % 3;
+		d.offset[axis] += (rand() & 1) ? STEP : -STEP;
+		uint32_t before = published;
+		for (int n = 0; n < MAX_SAMPLES; n++)
+		{
+			double u[3], m[3];
+			random_direction(u);
+			feed(&d, u, 0, m);
+		}
+		CHECK(published != before, "run %d: step not published", run);
+
+		// The fit follows the step, a change below MAG_CAL_REPUBLISH is not sent again
+		mag_calibration_result_t result;
+		CHECK(mag_calibration_solve(&result), "run %d: no fit", run);
+		float o[3] = { result.offset.x, result.offset.y, result.offset.z };
+		for (int i = 0; i < 3; i++)
+		{
+			CHECK_NEAR(o[i], d.offset[i], OFFSET_BOUND, "fitted offset after step");
+			CHECK_NEAR(global_data.param[PARAM_CAL_MAG_OFFSET_X + i], d.offset[i],
+					MAG_CAL_REPUBLISH + OFFSET_BOUND, "published offset after step");
+		}
+	}
+}
+
+/** @brief Samples of a vehicle that is not rotating are skipped, the fit stays */
+static void test_still(void)
+{
+	for (int run = 0; run < RUNS / 10; run++)
+	{
+		distortion_t d;
+		random_distortion(&d, 0);
+		reset_params(MAG_CAL_ELLIPSOID);
+		CHECK(feed_until_published(&d, 0) > 0, "run %d: not published", run);
+
+		double u[3];
+		random_direction(u);
+		uint32_t before = published;
+		for (int n = 0; n < 4 * MAX_SAMPLES; n++)
+		{
+			double m[3];
+			feed(&d, u, 0, m);
+		}
+		CHECK(published == before, "run %d: published while not rotating", run);
+		check_published(&d, 0);
+	}
+}
+
+int main(void)
+{
+	srand(1);
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		global_data.param[i] = param_table[i].def;
+	}
+
+	mag_calibration_result_t result;
+	reset_params(MAG_CAL_OFF);
+	mag_calibration_start();
+	CHECK(!mag_calibration_solve(&result), "solved without samples");
+
+	test_once(MAG_CAL_OFF);
+	test_once(MAG_CAL_ELLIPSOID_MOTOR);
+	test_one_axis();
+	test_continuous();
+	test_still();
+
+	return host_test_done("mag-calibration-test");
+}
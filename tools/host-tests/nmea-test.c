@@ -0,0 +1,342 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test and replay of the NMEA parser
+ *
+ *   Without arguments the parser of hal/gps/gps_nmea.c is checked:
+ *   - Known sentences give the documented values.
+ *   - Random GGA, RMC and GSA epochs with noise between the sentences
+ *     give their lat, lon, altitude, satellites, fix, speed and mode.
+ *   - A sentence with one mutation (bit flip, byte replaced, deleted or
+ *     inserted) is never accepted with other values.
+ *   - Random binary input is never accepted.
+ *
+ *   With a file argument the file is replayed byte by byte, e.g. a
+ *   capture of the GPS UART, and every accepted sentence is printed
+ *   with the resulting gps_* values. The drop counters of the parser
+ *   are printed at the end.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "global_data.h"
+#include "gps.h"
+
+#define EPOCHS 20000
+#define MUTATIONS 200000
+#define RANDOM_BYTES 4000000
+
+/** @brief Values of one epoch, in the units of the gps_* variables */
+typedef struct
+{
+	int32_t lat;      ///< degrees * 1e7
+	int32_t lon;      ///< degrees * 1e7
+	int32_t alt;      ///< cm
+	uint16_t gspeed;  ///< cm/s
+	uint8_t numSV;
+	uint8_t fix;
+	uint8_t mode;     ///< gps_mode, 0 for no fix
+} epoch_t;
+
+/** @brief Feed bytes, returns the number of accepted sentences */
+static int feed(const char* data, size_t len)
+{
+	int accepted = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		if (parse_nmea((uint8_t) data[i]))
+		{
+			parse_gps_msg();
+			accepted++;
+		}
+	}
+	return accepted;
+}
+
+static int feed_string(const char* s)
+{
+	return feed(s, strlen(s));
+}
+
+/** @brief Append the checksum and line end to a sentence starting with '$' */
+static void finish_sentence(char* s)
+{
+	uint8_t checksum = 0;
+	for (const char* p = s + 1; *p; p++)
+	{
+		checksum ^= (uint8_t) *p;
+	}
+	sprintf(s + strlen(s), "*%02X\r\n", checksum);
+}
+
+static void clear_gps(void)
+{
+	gps_lat = gps_lon = gps_alt = -1;
+	gps_gspeed = 0xFFFF;
+	gps_numSV = gps_mode = 0xFF;
+	gps_pos_available = FALSE;
+}
+
+static int same_gps(const epoch_t* e)
+{
+	return gps_lat == e->lat && gps_lon == e->lon && gps_alt == e->alt
+			&& gps_gspeed == e->gspeed && gps_numSV == e->numSV
+			&& gps_pos_available == e->fix && gps_mode == e->mode;
+}
+
+/** @brief Write the sentences of a random epoch, the expected values are rounded */
+static void random_epoch(char sentences[3][128], epoch_t* e)
+{
+	const char* talker = rand() % 2 ? "GP" : "GN";
+	int lat_deg = rand() % 90, lon_deg = rand() % 180;
+	int lat_min = rand() % 6000000, lon_min = rand() % 6000000; // minutes * 1e5
+	int alt = rand() % 900000 - 1000; // cm
+	int speed = rand() % 200000;      // 1/1000 knot
+	int fix = rand() % 3;
+	int mode = 1 + rand() % 3;
+	char south = rand() % 2, west = rand() % 2;
+
+	e->lat = llround((lat_deg + lat_min / 6e6) * 1e7) * (south ? -1 : 1);
+	e->lon = llround((lon_deg + lon_min / 6e6) * 1e7) * (west ? -1 : 1);
+	e->alt = alt;
+	e->gspeed = (uint16_t) (speed * 0.0514444444);
+	e->numSV = rand() % 13;
+	e->fix = fix != 0;
+	e->mode = mode == 1 ? 0 : mode;
+
+	sprintf(sentences[0], "$%sGGA,%02d%02d%02d.00,%02d%02d.%05d,%c,%03d%02d.%05d,%c,%d,%02d,0.9,%s%d.%02d,M,46.9,M,,",
+			talker, rand() % 24, rand() % 60, rand() % 60,
+			lat_deg, lat_min / 100000, lat_min % 100000, south ? 'S' : 'N',
+			lon_deg, lon_min / 100000, lon_min % 100000, west ? 'W' : 'E',
+			fix, e->numSV, alt < 0 ? "-" : "", abs(alt) / 100, abs(alt) % 100);
+	sprintf(sentences[1], "$%sRMC,123519,A,4807.038,N,01131.000,E,%d.%03d,084.4,230394,003.1,W",
+			talker, speed / 1000, speed % 1000);
+	sprintf(sentences[2], "$%sGSA,A,%d,04,05,,09,12,,,24,,,,,2.5,1.3,2.1", talker, mode);
+	for (int i = 0; i < 3; i++)
+	{
+		finish_sentence(sentences[i]);
+	}
+}
+
+/** @brief Bytes between sentences, without '$' */
+static void random_noise(void)
+{
+	char noise[16];
+	int len = rand() % sizeof(noise);
+	for (int i = 0; i < len; i++)
+	{
+		do
+		{
+			noise[i] = rand();
+		} while (noise[i] == '$');
+	}
+	feed(noise, len);
+}
+
+static void check_known(void)
+{
+	clear_gps();
+	CHECK(feed_string("$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n") == 1, "GGA not accepted");
+	CHECK(gps_lat == 481173000, "GGA lat %d", gps_lat);
+	CHECK(gps_lon == 115166667, "GGA lon %d", gps_lon);
+	CHECK(gps_alt == 54540, "GGA alt %d", gps_alt);
+	CHECK(gps_numSV == 8, "GGA numSV %d", gps_numSV);
+	CHECK(gps_pos_available, "GGA fix");
+
+	CHECK(feed_string("$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n") == 1, "RMC not accepted");
+	CHECK(gps_gspeed == 1152, "RMC speed %d cm/s", gps_gspeed);
+
+	CHECK(feed_string("$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39\r\n") == 1, "GSA not accepted");
+	CHECK(gps_mode == 3, "GSA mode %d", gps_mode);
+
+	// Wrong checksum, no checksum, other sentences
+	CHECK(feed_string("$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*48\r\n") == 0, "wrong checksum accepted");
+	CHECK(feed_string("$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,\r\n") == 0, "missing checksum accepted");
+	CHECK(feed_string("$GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75\r\n") == 0, "GSV accepted");
+
+	// A '*' in the altitude with a checksum that matches the part before it
+	char cut[128] = "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545";
+	finish_sentence(cut);
+	strcpy(cut + strlen(cut) - 2, ",M,46.9,M,,*00\r\n");
+	CHECK(feed_string(cut) == 0, "sentence cut by '*' accepted: %s", cut);
+	// The sentence ends before the altitude
+	strcpy(cut, "$GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4");
+	finish_sentence(cut);
+	CHECK(feed_string(cut) == 0, "short sentence accepted: %s", cut);
+	// No line end before the next sentence
+	CHECK(feed_string("$GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39$") == 0, "sentence without line end accepted");
+}
+
+static void check_epochs(char epochs[][3][128], epoch_t* expected)
+{
+	for (int n = 0; n < EPOCHS; n++)
+	{
+		random_epoch(epochs[n], &expected[n]);
+		clear_gps();
+		int accepted = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			random_noise();
+			accepted += feed_string(epochs[n][i]);
+		}
+		CHECK(accepted == 3, "epoch %d: %d sentences accepted", n, accepted);
+		CHECK(gps_lat == expected[n].lat, "%s lat %d, expected %d", epochs[n][0], gps_lat, expected[n].lat);
+		CHECK(gps_lon == expected[n].lon, "%s lon %d, expected %d", epochs[n][0], gps_lon, expected[n].lon);
+		CHECK(gps_alt == expected[n].alt, "%s alt %d, expected %d", epochs[n][0], gps_alt, expected[n].alt);
+		CHECK(gps_numSV == expected[n].numSV, "%s numSV %d", epochs[n][0], gps_numSV);
+		CHECK(gps_pos_available == expected[n].fix, "%s fix %d", epochs[n][0], gps_pos_available);
+		CHECK(abs(gps_gspeed - expected[n].gspeed) <= 1, "%s speed %d, expected %d",
+				epochs[n][1], gps_gspeed, expected[n].gspeed);
+		expected[n].gspeed = gps_gspeed;
+		CHECK(gps_mode == expected[n].mode, "%s mode %d", epochs[n][2], gps_mode);
+	}
+}
+
+/** @brief One random mutation of a sentence, returns the new length */
+static size_t mutate(char* s, size_t len)
+{
+	size_t pos = rand() % len;
+	switch (rand() % 4)
+	{
+	case 0:
+		s[pos] ^= 1 << (rand() % 8);
+		break;
+	case 1:
+		s[pos] = rand();
+		break;
+	case 2:
+		memmove(s + pos, s + pos + 1, len - pos);
+		return len - 1;
+	default:
+		memmove(s + pos + 1, s + pos, len - pos + 1);
+		s[pos] = rand();
+		return len + 1;
+	}
+	return len;
+}
+
+static void check_mutations(char epochs[][3][128], const epoch_t* expected)
+{
+	unsigned int accepted = 0;
+	for (int m = 0; m < MUTATIONS; m++)
+	{
+		int n = rand() % EPOCHS;
+		char s[3][130];
+		size_t len[3];
+
+		// The two other sentences of the epoch are intact
+		for (int i = 0; i < 3; i++)
+		{
+			strcpy(s[i], epochs[n][i]);
+			len[i] = strlen(s[i]);
+		}
+		int mutated = rand() % 3;
+		len[mutated] = mutate(s[mutated], len[mutated]);
+
+		clear_gps();
+		feed("\r\n", 2);
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			int a = feed(s[i], len[i]);
+			count += a;
+			if (i == mutated)
+			{
+				accepted += a;
+			}
+		}
+		CHECK(count <= 3, "mutation %d: %d sentences accepted", m, count);
+		// Accepted means unchanged values, e.g. a lower case checksum digit
+		if (count == 3)
+		{
+			CHECK(same_gps(&expected[n]), "mutated sentence accepted with other values: %.*s",
+					(int) len[mutated], s[mutated]);
+		}
+	}
+	printf("%d mutated sentences, %u accepted with the same values\n", MUTATIONS, accepted);
+}
+
+static void check_random_input(void)
+{
+	static char data[RANDOM_BYTES];
+	for (int i = 0; i < RANDOM_BYTES; i++)
+	{
+		data[i] = rand();
+	}
+	CHECK(feed(data, RANDOM_BYTES) == 0, "random input accepted");
+}
+
+/** @brief Replay a file and print what the parser accepted */
+static int replay(const char* filename)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f)
+	{
+		perror(filename);
+		return 1;
+	}
+	unsigned long bytes = 0, sentences = 0;
+	int c;
+	while ((c = fgetc(f)) != EOF)
+	{
+		bytes++;
+		if (parse_nmea(c))
+		{
+			parse_gps_msg();
+			sentences++;
+			printf("%8lu: lat %.7f lon %.7f alt %.2f m, %u sats, fix %d, mode %d, speed %u cm/s\n",
+					bytes, gps_lat * 1e-7, gps_lon * 1e-7, gps_alt * 0.01, gps_numSV,
+					gps_pos_available, gps_mode, gps_gspeed);
+		}
+	}
+	fclose(f);
+	printf("%lu bytes, %lu sentences accepted, %u checksum errors, %u dropped\n",
+			bytes, sentences, gps_nmea_checksum_errors, gps_nmea_dropped);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	static char epochs[EPOCHS][3][128];
+	static epoch_t expected[EPOCHS];
+
+	if (argc > 1)
+	{
+		return replay(argv[1]);
+	}
+
+	srand(1);
+	check_known();
+	check_epochs(epochs, expected);
+	check_mutations(epochs, expected);
+	check_random_input();
+	printf("%u checksum errors, %u dropped\n", gps_nmea_checksum_errors, gps_nmea_dropped);
+
+	return host_test_done("nmea-test");
+}
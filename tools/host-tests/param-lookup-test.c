@@ -0,0 +1,127 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the parameter name lookup
+ *
+ *   Every name of param_table has to resolve to its own index, as a
+ *   null terminated string and as a MAVLink param_id padded to
+ *   ONBOARD_PARAM_NAME_LENGTH chars. Unknown names, prefixes, names with
+ *   one char changed or appended and random strings have to give -1.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "global_data.h"
+#include "param_lookup.h"
+
+#define RANDOM_NAMES 200000
+
+/** @brief -1 for names not in the table, else the index */
+static int16_t table_index(const char* key)
+{
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		if (strncmp(param_table[i].name, key, ONBOARD_PARAM_NAME_LENGTH) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/** @brief Check a name against the linear search */
+static void check_name(const char* key)
+{
+	int16_t expected = table_index(key);
+	int16_t found = param_lookup(key);
+	CHECK(found == expected, "\"%.*s\" found %d, expected %d",
+			ONBOARD_PARAM_NAME_LENGTH, key, found, expected);
+}
+
+int main(void)
+{
+	char key[ONBOARD_PARAM_NAME_LENGTH + 1];
+	unsigned int rejected = 0;
+
+	for (int i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		const char* name = param_table[i].name;
+		size_t len = strlen(name);
+
+		CHECK(len > 0 && len < ONBOARD_PARAM_NAME_LENGTH, "index %d name length %u", i, (unsigned) len);
+		CHECK(param_lookup(name) == i, "\"%s\" found %d, expected %d", name, param_lookup(name), i);
+
+		// MAVLink param_id, padded with zeros
+		memset(key, 0, sizeof(key));
+		memcpy(key, name, len);
+		CHECK(param_lookup(key) == i, "padded \"%s\" found %d", name, param_lookup(key));
+
+		// Prefixes, one char changed and one appended
+		for (size_t n = 0; n < len; n++)
+		{
+			memset(key, 0, sizeof(key));
+			memcpy(key, name, n);
+			check_name(key);
+
+			memcpy(key, name, len);
+			key[n] ^= 0x20;
+			check_name(key);
+		}
+		if (len + 1 < ONBOARD_PARAM_NAME_LENGTH)
+		{
+			memset(key, 0, sizeof(key));
+			memcpy(key, name, len);
+			key[len] = '_';
+			check_name(key);
+		}
+	}
+
+	check_name("");
+	check_name("NOT_A_PARAM");
+	// Full length param_id without terminator
+	memset(key, 'A', ONBOARD_PARAM_NAME_LENGTH);
+	key[ONBOARD_PARAM_NAME_LENGTH] = 'B';
+	check_name(key);
+
+	srand(1);
+	for (int i = 0; i < RANDOM_NAMES; i++)
+	{
+		int len = 1 + rand() % (ONBOARD_PARAM_NAME_LENGTH - 1);
+		memset(key, 0, sizeof(key));
+		for (int k = 0; k < len; k++)
+		{
+			key[k] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789"[rand() % 37];
+		}
+		check_name(key);
+		rejected += (table_index(key) < 0);
+	}
+	printf("%d names, %u random names rejected\n", ONBOARD_PARAM_COUNT, rejected);
+
+	return host_test_done("param-lookup-test");
+}
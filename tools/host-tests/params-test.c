@@ -0,0 +1,464 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the parameter log in the EEPROM
+ *
+ *   system/params.c runs against a simulated 24FC256. The EEPROM contents
+ *   of earlier firmware are written by the test from their formats:
+ *   - Values written and read back, the directory lists the table. A
+ *     set value is only written on the write request.
+ *   - The block of the firmware before the log, a float per parameter at
+ *     4 * id and the check value after the last one, gives the values of
+ *     its 111 parameters. A wrong check value takes nothing.
+ *   - Records of another table are mapped by the names of its
+ *     directory, parameters not in it keep the default.
+ *   Each migration is also cut off after every number of page writes,
+ *   the next boot has to end with the same values.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <float.h>
+
+#include "host_test.h"
+#include "global_data.h"
+#include "params.h"
+#include "checksum.h"
+
+#define EEPROM_SIZE 32768
+#define PAGE 64
+#define DIR_START (64 * PAGE)       ///< After the ring of 64 pages
+#define BASELINE_COUNT 111         ///< Parameters of the firmware before the log, the first ids of the table
+#define VALUES 12                   ///< Values per record
+#define RUNS 20
+#define MAX_CALLS 100000            ///< param_handler() calls until a read or the writes have to be done
+#define IDLE_CALLS 100              ///< Calls without a write after which the writer is done
+
+typedef struct
+{
+	uint16_t magic;
+	uint16_t schema;
+	uint32_t sequence;
+	uint8_t group;
+	uint8_t reserved[3];
+	float value[VALUES];
+	uint16_t crc;
+	uint16_t reserved2;
+} record_t;
+
+static uint8_t eeprom[EEPROM_SIZE];
+static uint16_t read_address;
+static uint8_t read_length;
+static uint32_t writes;
+static uint32_t write_budget;       ///< Writes after it are lost, like after a power loss
+
+void eeprom_write(uint16_t address, uint8_t length, uint8_t* data)
+{
+	CHECK(address / PAGE == (address + length - 1) / PAGE, "write of %u bytes at %u crosses a page", length, address);
+	if (writes++ < write_budget)
+	{
+		memcpy(&eeprom[address], data, length);
+	}
+}
+
+void eeprom_start_read(uint16_t address, uint8_t length)
+{
+	read_address = address;
+	read_length = length;
+}
+
+uint8_t eeprom_read_data(uint8_t* data)
+{
+	memcpy(data, &eeprom[read_address], read_length);
+	return 1;
+}
+
+uint8_t eeprom_read_ready(void)
+{
+	return 1;
+}
+
+uint8_t eeprom_write_ready(void)
+{
+	return 1;
+}
+
+static uint16_t crc(const uint8_t* bytes, uint16_t length)
+{
+	uint16_t c;
+
+	crc_init(&c);
+	for (uint16_t i = 0; i < length; i++)
+	{
+		crc_accumulate(bytes[i], &c);
+	}
+	return c;
+}
+
+/** @brief Schema of a table with the given names */
+static uint16_t schema(const char (*names)[16], uint16_t count)
+{
+	uint16_t c;
+
+	crc_init(&c);
+	crc_accumulate(1, &c);
+	for (uint16_t i = 0; i < count; i++)
+	{
+		for (int j = 0; j < ONBOARD_PARAM_NAME_LENGTH && names[i][j]; j++)
+		{
+			crc_accumulate(names[i][j], &c);
+		}
+		crc_accumulate(0, &c);
+	}
+	return c;
+}
+
+static void put_record(uint8_t page, uint16_t table, uint32_t sequence, uint8_t group, const float* values,
+		uint16_t count)
+{
+	record_t r;
+
+	memset(&r, 0, sizeof(r));
+	r.magic = 0x4C50;
+	r.schema = table;
+	r.sequence = sequence;
+	r.group = group;
+	for (int j = 0; j < VALUES && group * VALUES + j < count; j++)
+	{
+		r.value[j] = values[group * VALUES + j];
+	}
+	r.crc = crc((const uint8_t*) &r, offsetof(record_t, crc));
+	memcpy(&eeprom[page * PAGE], &r, sizeof(r));
+}
+
+static void put_directory(const char (*names)[16], uint16_t count)
+{
+	uint16_t header[3] = { 0x4450, schema(names, count), count };
+
+	memset(&eeprom[DIR_START], 0, PAGE);
+	memcpy(&eeprom[DIR_START], header, sizeof(header));
+	memset(&eeprom[DIR_START + PAGE], 0, (count + 3) / 4 * PAGE);
+	memcpy(&eeprom[DIR_START + PAGE], names, count * 16);
+}
+
+static void table_names(char (*names)[16], uint16_t count)
+{
+	memset(names, 0, count * 16);
+	for (uint16_t i = 0; i < count; i++)
+	{
+		memcpy(names[i], param_table[i].name, ONBOARD_PARAM_NAME_LENGTH);
+	}
+}
+
+static double random_uniform(double min, double max)
+{
+	return min + (max - min) * (rand() / (double) RAND_MAX);
+}
+
+/** @brief A valid value of the parameter other than the default */
+static float random_value(uint16_t i)
+{
+	const param_info_t* info = &param_table[i];
+	double min = info->min < -1000 ? -1000 : info->min;
+	double max = info->max > min + 2000 ? min + 2000 : info->max;
+	float value;
+
+	do
+	{
+		value = random_uniform(min, max);
+		if (info->type == PARAM_TYPE_INT)
+		{
+			value = roundf(value);
+		}
+	} while (min < max && value == info->def);
+	return value;
+}
+
+static void random_values(float* values)
+{
+	for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		values[i] = random_value(i);
+	}
+}
+
+static void erase(void)
+{
+	memset(eeprom, 0xFF, sizeof(eeprom));
+}
+
+/** @brief Reset to the defaults and read the EEPROM like a boot */
+static void boot(void)
+{
+	int calls = 0;
+
+	write_budget = UINT32_MAX;
+	for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		global_data.param[i] = param_table[i].def;
+	}
+	param_read_all();
+	do
+	{
+		param_handler();
+	} while (param_read_busy() && ++calls < MAX_CALLS);
+	CHECK(!param_read_busy(), "read not done after %d calls", calls);
+}
+
+/** @brief Let the background writer run, at most budget page writes reach the EEPROM */
+static void run_writer(uint32_t budget)
+{
+	int idle = 0;
+
+	writes = 0;
+	write_budget = budget;
+	// Done once the writer did not write for a while, the directory follows the records
+	for (int calls = 0; calls < MAX_CALLS && writes <= budget && idle < IDLE_CALLS; calls++)
+	{
+		uint32_t before = writes;
+		param_handler();
+		idle = (writes == before) ? idle + 1 : 0;
+	}
+}
+
+/** @brief Check the values, expected NAN for the default */
+static void check_values(const float* expected, const char* what)
+{
+	for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		float value = isnan(expected[i]) || (param_table[i].flags & PARAM_FLAG_VOLATILE)
+				? param_table[i].def : expected[i];
+		CHECK(global_data.param[i] == value, "%s: %s is %g, expected %g", what, param_table[i].name,
+				global_data.param[i], value);
+	}
+}
+
+static void check_directory_current(void)
+{
+	char names[ONBOARD_PARAM_COUNT][16];
+	uint16_t header[3];
+
+	table_names(names, ONBOARD_PARAM_COUNT);
+	memcpy(header, &eeprom[DIR_START], sizeof(header));
+	CHECK(header[0] == 0x4450 && header[1] == schema(names, ONBOARD_PARAM_COUNT)
+			&& header[2] == ONBOARD_PARAM_COUNT, "directory header %04x %04x %u", header[0], header[1], header[2]);
+	CHECK(memcmp(&eeprom[DIR_START + PAGE], names, sizeof(names)) == 0, "directory names");
+}
+
+/**
+ * @brief Boot with the prepared EEPROM, cut the writes after budget pages, boot again
+ *
+ * In the end the values have to be the expected ones, the directory has
+ * to list the table and a further boot has to write nothing.
+ */
+static void check_migration(const float* expected, uint32_t budget, const char* what)
+{
+	boot();
+	CHECK(param_size_check() == 1, "%s: nothing found", what);
+	check_values(expected, what);
+	run_writer(budget);
+	if (writes <= budget)
+	{
+		return;
+	}
+	boot();
+	check_values(expected, what);
+	run_writer(UINT32_MAX);
+	boot();
+	check_values(expected, what);
+	check_directory_current();
+	run_writer(UINT32_MAX);
+	CHECK(writes == 0, "%s: %u writes after the migration", what, writes);
+}
+
+/** @brief Values written and read back, the directory lists the table */
+static void test_write_read(void)
+{
+	float values[ONBOARD_PARAM_COUNT];
+	float defaults[ONBOARD_PARAM_COUNT];
+
+	for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+	{
+		defaults[i] = NAN;
+	}
+	erase();
+	boot();
+	CHECK(param_size_check() == 0, "empty EEPROM");
+	check_values(defaults, "empty");
+	run_writer(UINT32_MAX);
+	CHECK(writes == 0, "%u writes without a change", writes);
+
+	for (int run = 0; run < RUNS; run++)
+	{
+		random_values(values);
+		memcpy(global_data.param, values, sizeof(values));
+		param_write_all();
+		run_writer(UINT32_MAX);
+		boot();
+		CHECK(param_size_check() == 1, "written values not found");
+		check_values(values, "written");
+		check_directory_current();
+
+		// One changed value is kept in RAM until the write request, then moves one record
+		uint16_t i = rand() % ONBOARD_PARAM_COUNT;
+		values[i] = random_value(i);
+		global_data.param[i] = values[i];
+		param_set_dirty(i);
+		run_writer(UINT32_MAX);
+		CHECK(writes == 0, "%u writes of a set value without a write request", writes);
+		param_write_all();
+		run_writer(UINT32_MAX);
+		CHECK(writes == 1, "%u writes of one value", writes);
+		boot();
+		check_values(values, "one value");
+	}
+}
+
+/** @brief The block of the firmware before the log */
+static void put_baseline(const float* values, int32_t check)
+{
+	for (uint16_t i = 0; i < BASELINE_COUNT; i++)
+	{
+		// It wrote SYS_IMU_RESET as 0
+		float value = (param_table[i].flags & PARAM_FLAG_VOLATILE) ? 0 : values[i];
+		memcpy(&eeprom[4 * i], &value, 4);
+	}
+	memcpy(&eeprom[4 * BASELINE_COUNT], &check, 4);
+}
+
+static void test_baseline(void)
+{
+	float values[ONBOARD_PARAM_COUNT];
+
+	for (int run = 0; run < RUNS; run++)
+	{
+		random_values(values);
+		for (uint16_t i = BASELINE_COUNT; i < ONBOARD_PARAM_COUNT; i++)
+		{
+			values[i] = NAN;
+		}
+
+		for (uint32_t budget = 0; budget < 20; budget++)
+		{
+			erase();
+			put_baseline(values, 1123456789);
+			check_migration(values, budget, "baseline");
+		}
+
+		erase();
+		put_baseline(values, 1123456789 ^ (1 << (rand() % 32)));
+		boot();
+		CHECK(param_size_check() == 0, "block with a wrong check value taken");
+	}
+}
+
+/** @brief Records of another table listed in the directory */
+static void test_directory(void)
+{
+	char names[ONBOARD_PARAM_COUNT + 8][16];
+	float old[ONBOARD_PARAM_COUNT + 8];
+	float expected[ONBOARD_PARAM_COUNT];
+	uint16_t count = ONBOARD_PARAM_COUNT + 8;
+
+	for (int run = 0; run < RUNS; run++)
+	{
+		for (uint32_t budget = 0; budget < 30; budget++)
+		{
+			uint16_t gone[4];
+			uint16_t groups = (count + VALUES - 1) / VALUES;
+
+			// The current names shuffled, the last group and four more missing, eight others
+			table_names(names, ONBOARD_PARAM_COUNT);
+			for (uint16_t i = (ONBOARD_PARAM_COUNT - 1) / VALUES * VALUES; i < count; i++)
+			{
+				snprintf(names[i], 16, "OLD_PARAM_%u", i);
+			}
+			for (uint16_t i = count - 1; i > 0; i--)
+			{
+				uint16_t j = rand() % (i + 1);
+				char t[16];
+				memcpy(t, names[i], 16);
+				memcpy(names[i], names[j], 16);
+				memcpy(names[j], t, 16);
+			}
+			for (int k = 0; k < 4; k++)
+			{
+				gone[k] = rand() % count;
+				if (strncmp(names[gone[k]], "OLD_", 4) != 0)
+				{
+					snprintf(names[gone[k]], 16, "GONE_%u", k);
+				}
+			}
+
+			for (uint16_t i = 0; i < ONBOARD_PARAM_COUNT; i++)
+			{
+				expected[i] = NAN;
+			}
+			for (uint16_t i = 0; i < count; i++)
+			{
+				old[i] = random_uniform(-1000, 1000);
+				for (uint16_t j = 0; j < ONBOARD_PARAM_COUNT; j++)
+				{
+					if (strncmp(names[i], param_table[j].name, ONBOARD_PARAM_NAME_LENGTH) == 0)
+					{
+						old[i] = random_value(j);
+						expected[j] = old[i];
+					}
+				}
+			}
+
+			erase();
+			put_directory(names, count);
+			for (uint16_t g = 0; g < groups; g++)
+			{
+				put_record((g * 5) % 64, schema(names, count), 500 + g, g, old, count);
+			}
+			check_migration(expected, budget, "directory");
+
+			// A changed name does not match the schema, nothing is taken
+			erase();
+			put_directory(names, count);
+			eeprom[DIR_START + PAGE + 16 * (rand() % count)] ^= 0x20;
+			for (uint16_t g = 0; g < groups; g++)
+			{
+				put_record((g * 5) % 64, schema(names, count), 500 + g, g, old, count);
+			}
+			boot();
+			CHECK(param_size_check() == 0, "records of a corrupt directory taken");
+		}
+	}
+}
+
+int main(void)
+{
+	srand(42);
+	test_write_read();
+	test_baseline();
+	test_directory();
+	return host_test_done("params-test");
+}
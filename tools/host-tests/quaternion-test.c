@@ -0,0 +1,272 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the quaternion and rotation matrix attitude
+ *
+ *   math/quaternion.c replaced the Euler angle rotations of
+ *   math/transformation.c on the hot path. On random attitudes the
+ *   matrix rotations have to match body2navi() and navi2body_xy_plane()
+ *   and invert body2navi(), the Euler and matrix conversions have to
+ *   round trip, quat_mult() has to compose the rotations and the yaw
+ *   error has to be the wrapped difference for any turn of the setpoint.
+ *   quat_integrate() at the 200 Hz filter step has to follow the exact
+ *   rotation of constant body rates and stay normalized, quat_nlerp()
+ *   has to move towards either sign of the target.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+
+#include "host_test.h"
+#include "quaternion.h"
+#include "transformation.h"
+
+#define ATTITUDES 100000
+#define INTEGRATIONS 2000
+#define TIME_STEP (1.0f / 200.0f)
+
+/* Rotated vectors are up to 10 long, angles in rad */
+#define TOL_VECT 1e-4
+#define TOL_ANGLE 1e-4
+#define TOL_QUAT 1e-5
+
+static float random_uniform(float min, float max)
+{
+	return min + (max - min) * (float) rand() / (float) RAND_MAX;
+}
+
+static void random_euler(float_vect3* euler)
+{
+	// Pitch away from +-90 degree, roll and yaw are undefined there
+	euler->x = random_uniform(-M_PI, M_PI);
+	euler->y = random_uniform(-1.5f, 1.5f);
+	euler->z = random_uniform(-M_PI, M_PI);
+}
+
+static double wrap_pi(double angle)
+{
+	return atan2(sin(angle), cos(angle));
+}
+
+static void check_vect(const float_vect3* a, const float_vect3* b, const char* what)
+{
+	CHECK_NEAR(a->x, b->x, TOL_VECT, what);
+	CHECK_NEAR(a->y, b->y, TOL_VECT, what);
+	CHECK_NEAR(a->z, b->z, TOL_VECT, what);
+}
+
+static double quat_dot(const float_quat* a, const float_quat* b)
+{
+	return (double) a->w * b->w + (double) a->x * b->x + (double) a->y * b->y
+			+ (double) a->z * b->z;
+}
+
+/** @brief Angle of the rotation between a and b, from the chord as acos loses it near 0 */
+static double quat_angle(const float_quat* a, const float_quat* b)
+{
+	double sign = quat_dot(a, b) < 0 ? -1 : 1;
+	double w = a->w - sign * b->w;
+	double x = a->x - sign * b->x;
+	double y = a->y - sign * b->y;
+	double z = a->z - sign * b->z;
+	return 4 * asin(fmin(1, 0.5 * sqrt(w * w + x * x + y * y + z * z)));
+}
+
+/**
+ * @brief Constant body rates for 1 s against q0 * exp(rate * t / 2)
+ */
+static double check_integrate(void)
+{
+	float_vect3 euler, rate;
+	float_quat q, q0, step, exact;
+
+	random_euler(&euler);
+	quat_from_euler(&euler, &q0);
+	rate.x = random_uniform(-3, 3);
+	rate.y = random_uniform(-3, 3);
+	rate.z = random_uniform(-3, 3);
+
+	q = q0;
+	for (int i = 0; i < 200; i++)
+	{
+		quat_integrate(&q, &rate, TIME_STEP);
+	}
+
+	double norm = sqrt(rate.x * rate.x + rate.y * rate.y + rate.z * rate.z);
+	double s = sin(norm * 0.5) / norm;
+	step.w = cos(norm * 0.5);
+	step.x = rate.x * s;
+	step.y = rate.y * s;
+	step.z = rate.z * s;
+	quat_mult(&q0, &step, &exact);
+
+	double e = quat_angle(&q, &exact);
+	CHECK(e <= 1e-3, "rate %g %g %g for 1 s: error %g rad", rate.x, rate.y, rate.z, e);
+	CHECK_NEAR(quat_dot(&q, &q), 1, 1e-5, "|q|^2 after 1 s");
+	return e;
+}
+
+static void check_nlerp(void)
+{
+	float_vect3 euler;
+	float_quat q, target, neg, a, b;
+
+	random_euler(&euler);
+	quat_from_euler(&euler, &q);
+	random_euler(&euler);
+	quat_from_euler(&euler, &target);
+	neg.w = -target.w;
+	neg.x = -target.x;
+	neg.y = -target.y;
+	neg.z = -target.z;
+
+	float t = random_uniform(0, 1);
+	a = q;
+	quat_nlerp(&a, &target, t);
+	b = q;
+	quat_nlerp(&b, &neg, t);
+	CHECK(quat_angle(&a, &b) <= TOL_ANGLE, "nlerp to -target differs");
+	CHECK_NEAR(quat_dot(&a, &a), 1, 1e-6, "|nlerp|^2");
+	CHECK(quat_angle(&a, &target) <= quat_angle(&q, &target) * (1 - 0.5 * t) + TOL_ANGLE,
+			"nlerp t %g: %g rad left of %g", t, quat_angle(&a, &target),
+			quat_angle(&q, &target));
+
+	a = q;
+	quat_nlerp(&a, &target, 1);
+	CHECK(quat_angle(&a, &target) <= TOL_ANGLE, "nlerp t 1 is not the target");
+	a = q;
+	quat_nlerp(&a, &target, 0);
+	CHECK(quat_angle(&a, &q) <= TOL_ANGLE, "nlerp t 0 moved");
+}
+
+int main(void)
+{
+	float_vect3 euler, euler_b, back, v, a, b;
+	float_quat q, q_b, q_ab, q_dcm;
+	float_mat3 dcm, dcm_b, dcm_ab;
+	double max_vect = 0, max_euler = 0, max_yaw_error = 0;
+
+	srand(1);
+	for (int i = 0; i < ATTITUDES; i++)
+	{
+		random_euler(&euler);
+		v.x = random_uniform(-10, 10);
+		v.y = random_uniform(-10, 10);
+		v.z = random_uniform(-10, 10);
+
+		quat_from_euler(&euler, &q);
+		CHECK_NEAR(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z, 1, 1e-6, "|q|^2");
+		quat_to_dcm(&q, &dcm);
+
+		// Rotations against the Euler code
+		dcm_body2navi(&dcm, &v, &a);
+		body2navi(&v, &euler, &b);
+		check_vect(&a, &b, "dcm_body2navi");
+		max_vect = fmax(max_vect, fabs(a.x - b.x) + fabs(a.y - b.y) + fabs(a.z - b.z));
+
+		// navi2body() is not implemented, check the inverse
+		body2navi(&v, &euler, &b);
+		dcm_navi2body(&dcm, &b, &a);
+		check_vect(&a, &v, "dcm_navi2body");
+
+		dcm_navi2body_xy_plane(&dcm, &v, &a);
+		navi2body_xy_plane(&v, euler.z, &b);
+		check_vect(&a, &b, "dcm_navi2body_xy_plane");
+
+		// Conversions round trip, q and -q are the same rotation
+		quat_to_euler(&q, &back);
+		double e = fmax(fabs(wrap_pi(back.x - euler.x)), fmax(fabs(back.y - euler.y),
+				fabs(wrap_pi(back.z - euler.z))));
+		CHECK(e <= TOL_ANGLE, "euler round trip %g %g %g: error %g", euler.x, euler.y, euler.z, e);
+		max_euler = fmax(max_euler, e);
+
+		quat_from_dcm(&dcm, &q_dcm);
+		float sign = (q_dcm.w * q.w + q_dcm.x * q.x + q_dcm.y * q.y + q_dcm.z * q.z) < 0 ? -1 : 1;
+		CHECK_NEAR(sign * q_dcm.w, q.w, TOL_QUAT, "quat_from_dcm w");
+		CHECK_NEAR(sign * q_dcm.x, q.x, TOL_QUAT, "quat_from_dcm x");
+		CHECK_NEAR(sign * q_dcm.y, q.y, TOL_QUAT, "quat_from_dcm y");
+		CHECK_NEAR(sign * q_dcm.z, q.z, TOL_QUAT, "quat_from_dcm z");
+
+		// a * b rotates with b first
+		random_euler(&euler_b);
+		quat_from_euler(&euler_b, &q_b);
+		quat_to_dcm(&q_b, &dcm_b);
+		quat_mult(&q, &q_b, &q_ab);
+		quat_to_dcm(&q_ab, &dcm_ab);
+		dcm_body2navi(&dcm_ab, &v, &a);
+		dcm_body2navi(&dcm_b, &v, &b);
+		dcm_body2navi(&dcm, &b, &b);
+		check_vect(&a, &b, "quat_mult");
+
+		// Yaw error for the setpoint in any turn
+		float setpoint = random_uniform(-M_PI, M_PI);
+		for (int turn = -2; turn <= 2; turn++)
+		{
+			float yaw_error = dcm_yaw_error(&dcm, setpoint + turn * 2 * M_PI);
+			double expected = wrap_pi(euler.z - setpoint);
+			// +-pi are the same error
+			double diff = fabs(wrap_pi(yaw_error - expected));
+			CHECK(diff <= TOL_ANGLE, "yaw %g setpoint %g turn %d: %g, expected %g",
+					euler.z, setpoint, turn, yaw_error, expected);
+			CHECK(fabsf(yaw_error) <= M_PI + 1e-6, "yaw error %g out of [-pi, pi]", yaw_error);
+			max_yaw_error = fmax(max_yaw_error, diff);
+		}
+	}
+
+	quat_identity(&q);
+	quat_to_dcm(&q, &dcm);
+	v.x = 1;
+	v.y = 2;
+	v.z = 3;
+	dcm_body2navi(&dcm, &v, &a);
+	check_vect(&a, &v, "identity");
+
+	printf("%d attitudes, max errors: rotation %g, euler %g rad, yaw error %g rad\n",
+			ATTITUDES, max_vect, max_euler, max_yaw_error);
+
+	double max_integrate = 0;
+	for (int i = 0; i < INTEGRATIONS; i++)
+	{
+		max_integrate = fmax(max_integrate, check_integrate());
+		check_nlerp();
+	}
+
+	// Cheap renormalization holds the norm over a long flight
+	euler.x = 0.3f;
+	euler.y = -0.2f;
+	euler.z = 2.0f;
+	quat_from_euler(&euler, &q);
+	for (int i = 0; i < 200 * 600; i++)
+	{
+		float_vect3 rate = { random_uniform(-3, 3), random_uniform(-3, 3), random_uniform(-3, 3) };
+		quat_integrate(&q, &rate, TIME_STEP);
+	}
+	CHECK_NEAR(quat_dot(&q, &q), 1, 1e-5, "|q|^2 after 600 s");
+
+	printf("%d integrations of 1 s, max error %g rad\n", INTEGRATIONS, max_integrate);
+
+	return host_test_done("quaternion-test");
+}
@@ -0,0 +1,620 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the non-blocking SD card writes
+ *
+ *   arm7/spi_devices/sdcard.c runs against a byte level model of an SD
+ *   card in SPI mode (commands, response delay, data tokens, data
+ *   response and busy while programming), with a simulated clock. Every
+ *   sector written has to arrive unchanged, the card model flags any
+ *   protocol error. Like SD cards the model keeps driving MISO after the
+ *   deselect until the next clock, a sensor package must not come before.
+ *
+ *   The default build uses SPI_USE_POLLING like the boards. It simulates
+ *   the main loop with sdcard_update() in the idle branch at the SPI
+ *   clock of the flight setup and reports the sustained throughput, the
+ *   longest sdcard_update() call and the delay of the 200 Hz slot.
+ *
+ *   With HOST_SPI_QUEUE the interrupt driven SPI queue is simulated.
+ *   Sensor interrupts fill the queue between the room check of
+ *   sdcard_update() and the package, a package dropped by spi_transmit()
+ *   must not stall the write.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "conf.h"
+#include "LPC21xx.h"
+#include "spi.h"
+#include "sdcard.h"
+#include "mmc_spi.h"
+
+/* SPI timing of the flight setup: SSPCR0 of every package has SSP_SCR 3,
+ * SSPCPSR is 2, PCLK / (2 * (3 + 1)) */
+#define SPI_CLOCK ((PCLK) / 8 / 1e6)     ///< MHz
+#define BYTE_TIME (8 / SPI_CLOCK)         ///< usecs
+#define PACKAGE_OVERHEAD 3.0              ///< CPU time per package in usecs: FIFO, select, read back (estimate)
+
+/* Main loop model */
+#define SLOT_PERIOD 5000.0                ///< 200 Hz slot
+#define SLOT_TIME 1000.0                  ///< Time the 200 Hz functions take (assumed)
+#define IDLE_TIME 20.0                    ///< Idle branch work besides sdcard_update() (assumed)
+#define LOG_RATE 11000.0                  ///< Bytes per second of the log stream
+
+#define STORE_SECTORS 4096
+#define BATCH 4                           ///< Sectors per write, SD_LOG_BATCH
+
+uint32_t IO0DIR, IO0SET, IO0CLR;
+uint32_t SSPCR0, SSPCR1, SSPCPSR;
+unsigned char card_capacity;
+unsigned char card_type;
+
+static double host_time;                  ///< usecs
+static unsigned irq_off;
+
+uint64_t sys_time_clock_get_time_usec(void)
+{
+	return (uint64_t) host_time;
+}
+
+unsigned disableIRQ(void)
+{
+	unsigned old = irq_off;
+	irq_off = 1;
+	return old;
+}
+
+unsigned restoreIRQ(unsigned old)
+{
+	unsigned now = irq_off;
+	irq_off = old;
+	return now;
+}
+
+/*
+ * Card model
+ */
+enum
+{
+	CARD_IDLE, CARD_COMMAND, CARD_RESPONSE, CARD_TOKEN, CARD_DATA, CARD_DATA_RESPONSE, CARD_STOP
+};
+
+typedef struct
+{
+	uint8_t state;
+	uint8_t cmd[6];
+	uint8_t pos;
+	uint8_t ncr;                          ///< 0xFF bytes before the response
+	uint8_t r1;
+	uint8_t next;                         ///< State after the response
+	uint8_t app;                          ///< CMD55 came before
+	uint8_t multi;
+	uint32_t sector;
+	uint16_t data_pos;
+	uint8_t data[SDCARD_SECTOR_SIZE + 2];
+	double busy_until;
+	double program_time;                  ///< Busy time per block and after the stop token
+	double stall_time;                    ///< Busy time of a stall
+	int stall_percent;                    ///< Blocks with a stall
+	uint32_t errors;
+	uint32_t pre_erase;
+} card_t;
+
+static card_t card;
+static uint8_t card_store[STORE_SECTORS][SDCARD_SECTOR_SIZE];
+static uint8_t card_selected;
+static uint8_t card_miso;                 ///< Deselected, still drives MISO until the next clock
+
+static void card_error(const char* what)
+{
+	card.errors++;
+	if (card.errors <= 5)
+	{
+		printf("card: %s in state %u\n", what, card.state);
+	}
+}
+
+static void card_execute(void)
+{
+	uint8_t cmd = card.cmd[0] & 0x3F;
+	uint32_t arg = ((uint32_t) card.cmd[1] << 24) | (card.cmd[2] << 16) | (card.cmd[3] << 8) | card.cmd[4];
+	uint8_t app = card.app;
+
+	card.r1 = 0;
+	card.next = CARD_IDLE;
+	card.ncr = rand() % 4;
+	card.app = 0;
+	if (app && cmd == 23)
+	{
+		card.pre_erase = arg;
+	}
+	else if (cmd == 55)
+	{
+		card.app = 1;
+	}
+	else if (cmd == 24 || cmd == 25)
+	{
+		if (card_capacity != HIGH_CAPACITY && arg % SDCARD_SECTOR_SIZE != 0)
+		{
+			card_error("unaligned address");
+		}
+		card.sector = (card_capacity == HIGH_CAPACITY) ? arg : arg / SDCARD_SECTOR_SIZE;
+		card.multi = (cmd == 25);
+		card.next = CARD_TOKEN;
+	}
+	else
+	{
+		card_error("unexpected command");
+		card.r1 = 0x04;
+	}
+}
+
+/** @brief Shift one byte, returns the byte the card sends */
+static uint8_t card_shift(uint8_t mosi)
+{
+	if (host_time < card.busy_until)
+	{
+		if (mosi != DUMMY_WRITE)
+		{
+			card_error("byte sent while busy");
+		}
+		return 0x00;
+	}
+
+	switch (card.state)
+	{
+	case CARD_IDLE:
+		if ((mosi & 0xC0) == 0x40)
+		{
+			card.cmd[0] = mosi;
+			card.pos = 1;
+			card.state = CARD_COMMAND;
+		}
+		else if (mosi != DUMMY_WRITE)
+		{
+			card_error("byte outside of a command");
+		}
+		return 0xFF;
+	case CARD_COMMAND:
+		card.cmd[card.pos++] = mosi;
+		if (card.pos == 6)
+		{
+			card_execute();
+			card.state = CARD_RESPONSE;
+		}
+		return 0xFF;
+	case CARD_RESPONSE:
+		if (card.ncr > 0)
+		{
+			card.ncr--;
+			return 0xFF;
+		}
+		card.state = card.next;
+		return card.r1;
+	case CARD_TOKEN:
+		if (mosi == (card.multi ? START_MULTI_BLOCK_TOKEN : START_BLOCK_TOKEN))
+		{
+			card.data_pos = 0;
+			card.state = CARD_DATA;
+		}
+		else if (card.multi && mosi == STOP_TRAN_TOKEN)
+		{
+			card.state = CARD_STOP;
+		}
+		else if (mosi != DUMMY_WRITE)
+		{
+			card_error("wrong token");
+		}
+		return 0xFF;
+	case CARD_DATA:
+		card.data[card.data_pos++] = mosi;
+		if (card.data_pos == sizeof(card.data))
+		{
+			if (card.sector < STORE_SECTORS)
+			{
+				memcpy(card_store[card.sector], card.data, SDCARD_SECTOR_SIZE);
+			}
+			else
+			{
+				card_error("sector out of range");
+			}
+			card.sector++;
+			card.state = CARD_DATA_RESPONSE;
+		}
+		return 0xFF;
+	case CARD_DATA_RESPONSE:
+		card.state = card.multi ? CARD_TOKEN : CARD_IDLE;
+		card.busy_until = host_time + BYTE_TIME + card.program_time
+				+ ((rand() % 100 < card.stall_percent) ? card.stall_time : 0);
+		return 0xE5;
+	case CARD_STOP:
+		// Busy starts one byte after the stop token
+		card.state = CARD_IDLE;
+		card.busy_until = host_time + BYTE_TIME + card.program_time;
+		return 0xFF;
+	}
+	return 0xFF;
+}
+
+static void card_reset(double program_time, double stall_time, int stall_percent)
+{
+	memset(&card, 0, sizeof(card));
+	card.program_time = program_time;
+	card.stall_time = stall_time;
+	card.stall_percent = stall_percent;
+	memset(card_store, 0xFF, sizeof(card_store));
+}
+
+/*
+ * SPI
+ */
+static uint16_t rx_fifo[8];
+static uint8_t rx_length;
+static uint8_t rx_pos;
+
+uint16_t host_spi_read(void)
+{
+	CHECK(rx_pos < rx_length, "read of %u frames of %u", rx_pos + 1, rx_length);
+	return rx_fifo[rx_pos++ % 8];
+}
+
+/* A sensor package, it reads MISO of another device */
+static void sensor_select(void)
+{
+}
+
+static void sensor_done(void)
+{
+	for (uint8_t i = 0; i < rx_length; i++)
+	{
+		(void) SSPDR;
+	}
+}
+
+static spi_package sensor_package = { { 0 }, 8, SPI_16_BIT_MODE, sensor_select, sensor_select, sensor_done };
+
+/** @brief Shift the frames of a package, the chip select of the card decides if it listens */
+static void spi_shift(const spi_package* package)
+{
+	uint32_t pin = 1UL << SDCARD_SPI_SS_PIN;
+
+	host_time += PACKAGE_OVERHEAD;
+	IO0CLR = 0;
+	package->slave_select();
+	card_selected = (IO0CLR & pin) != 0;
+	if (!card_selected && card_miso)
+	{
+		CHECK(package->spi_interrupt_handler != sensor_done, "sensor package while the card drives MISO");
+	}
+	for (uint8_t i = 0; i < package->length; i++)
+	{
+		uint16_t frame = package->data[i];
+		if (package->bit_mode == (SPI_16_BIT_MODE))
+		{
+			uint8_t hi = card_selected ? card_shift(frame >> 8) : 0xFF;
+			host_time += BYTE_TIME;
+			uint8_t lo = card_selected ? card_shift(frame & 0xFF) : 0xFF;
+			host_time += BYTE_TIME;
+			rx_fifo[i] = (hi << 8) | lo;
+		}
+		else
+		{
+			rx_fifo[i] = card_selected ? card_shift(frame & 0xFF) : 0xFF;
+			host_time += BYTE_TIME;
+		}
+	}
+	rx_length = package->length;
+	rx_pos = 0;
+	IO0SET = 0;
+	package->slave_unselect();
+	if (card_selected)
+	{
+		CHECK(IO0SET & pin, "card still selected after the package");
+	}
+	card_miso = card_selected || (card_miso && package->length == 0);
+	package->spi_interrupt_handler();
+	CHECK(rx_pos == rx_length, "%u of %u frames read", rx_pos, rx_length);
+}
+
+#ifndef SPI_USE_POLLING
+
+static spi_package queue[SPI_PACKAGE_BUFFER_SIZE];
+static int queue_insert, queue_extract;
+static spi_package running;
+static uint8_t queue_running;
+static uint32_t queue_dropped;
+static uint8_t sensor_irq;                ///< A sensor interrupt fires at one of the next queue checks
+
+static void queue_start(void)
+{
+	running = queue[queue_extract];
+	queue_extract = (queue_extract + 1) % SPI_PACKAGE_BUFFER_SIZE;
+	queue_running = 1;
+}
+
+void spi_transmit(spi_package* package)
+{
+	int next = (queue_insert + 1) % SPI_PACKAGE_BUFFER_SIZE;
+
+	if (next == queue_extract)
+	{
+		queue_dropped++;
+		return;
+	}
+	queue[queue_insert] = *package;
+	queue_insert = next;
+	if (!queue_running)
+	{
+		queue_start();
+	}
+}
+
+int spi_number_of_packages_in_buffer(void)
+{
+	int count = (queue_insert - queue_extract + SPI_PACKAGE_BUFFER_SIZE) % SPI_PACKAGE_BUFFER_SIZE;
+
+	if (sensor_irq && !irq_off && rand() % 2)
+	{
+		// Right after one of the checks, before the caller queues its package
+		sensor_irq = 0;
+		for (int i = 0; i < SPI_PACKAGE_BUFFER_SIZE; i++)
+		{
+			spi_transmit(&sensor_package);
+		}
+	}
+	return count;
+}
+
+/** @brief The SSP interrupt of the running package */
+static void queue_interrupt(void)
+{
+	if (!queue_running)
+	{
+		return;
+	}
+	irq_off = 1;
+	spi_shift(&running);
+	if (queue_insert != queue_extract)
+	{
+		queue_start();
+	}
+	else
+	{
+		queue_running = 0;
+	}
+	irq_off = 0;
+}
+
+#else
+
+void spi_transmit(spi_package* package)
+{
+	spi_shift(package);
+}
+
+int spi_number_of_packages_in_buffer(void)
+{
+	return 0;
+}
+
+#endif
+
+int spi_running(void)
+{
+	return 0;
+}
+
+/*
+ * Writes
+ */
+static uint8_t bufs[SDCARD_MAX_BLOCKS][SDCARD_SECTOR_SIZE];
+static uint32_t write_sector;
+static uint8_t write_count;
+
+static void start_write(uint32_t sector, uint8_t count)
+{
+	const uint8_t* ptrs[SDCARD_MAX_BLOCKS];
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		for (int j = 0; j < SDCARD_SECTOR_SIZE; j++)
+		{
+			bufs[i][j] = rand();
+		}
+		ptrs[i] = bufs[i];
+	}
+	write_sector = sector;
+	write_count = count;
+	CHECK(sdcard_write_start(sector, ptrs, count) == 1, "write not started");
+}
+
+static void check_write(void)
+{
+	CHECK(!sdcard_write_failed(), "write of %u sectors at %u failed", write_count, write_sector);
+	CHECK(sdcard_blocks_written() == write_count, "%u of %u sectors written", sdcard_blocks_written(),
+			write_count);
+	for (uint8_t i = 0; i < write_count; i++)
+	{
+		CHECK(memcmp(card_store[write_sector + i], bufs[i], SDCARD_SECTOR_SIZE) == 0, "sector %u differs",
+				write_sector + i);
+	}
+	CHECK(card.errors == 0, "%u card protocol errors", card.errors);
+	if (write_count > 1 && card_type != MMC_CARD)
+	{
+		CHECK(card.pre_erase == write_count, "ACMD23 with %u", card.pre_erase);
+	}
+}
+
+#ifdef SPI_USE_POLLING
+
+/**
+ * @brief Run the main loop model for some seconds, write batches back to back
+ * @return sustained throughput in bytes per second
+ */
+static double run_main_loop(double seconds, double* max_call, double* max_delay)
+{
+	double next_slot = host_time;
+	double end = host_time + seconds * 1e6;
+	double start = host_time;
+	uint32_t sector = 0;
+	uint32_t sectors = 0;
+
+	*max_call = 0;
+	*max_delay = 0;
+	write_count = 0;
+	while (host_time < end)
+	{
+		if (host_time >= next_slot)
+		{
+			if (host_time - next_slot > *max_delay)
+			{
+				*max_delay = host_time - next_slot;
+			}
+			spi_transmit(&sensor_package);
+			host_time += SLOT_TIME;
+			next_slot += SLOT_PERIOD;
+			continue;
+		}
+
+		// Idle branch like sd_log_update()
+		double before = host_time;
+		sdcard_update();
+		if (!sdcard_busy())
+		{
+			if (write_count)
+			{
+				check_write();
+				sectors += write_count;
+			}
+			start_write(sector, BATCH);
+			sector = (sector + BATCH) % (STORE_SECTORS - BATCH);
+			sdcard_update();
+		}
+		if (host_time - before > *max_call)
+		{
+			*max_call = host_time - before;
+		}
+		host_time += IDLE_TIME;
+	}
+	write_count = 0;
+	while (sdcard_busy())
+	{
+		host_time += IDLE_TIME;
+		sdcard_update();
+	}
+	return sectors * (double) SDCARD_SECTOR_SIZE * 1e6 / (host_time - start);
+}
+
+static void test_throughput(const char* what, double program_time, double stall_time, int stall_percent)
+{
+	double max_call, max_delay;
+
+	card_capacity = HIGH_CAPACITY;
+	card_type = SD_CARD;
+	card_reset(program_time, stall_time, stall_percent);
+	double rate = run_main_loop(10, &max_call, &max_delay);
+	printf("%s: %.1f kB/s, longest sdcard_update() %.0f us, 200 Hz slot delayed by %.0f us at most\n",
+			what, rate / 1000, max_call, max_delay);
+	CHECK(rate > 2 * LOG_RATE, "%s: %.0f B/s", what, rate);
+	// The time limit and one more package of 8 frames of 16 bits with its release byte
+	CHECK(max_call < 100 + 17 * BYTE_TIME + 3 * PACKAGE_OVERHEAD, "%s: sdcard_update() took %.0f us", what,
+			max_call);
+}
+
+#endif
+
+/** @brief Single and multiple block writes of all card types */
+static void test_writes(void)
+{
+	for (int run = 0; run < 300; run++)
+	{
+		uint8_t count = 1 + rand() % SDCARD_MAX_BLOCKS;
+		uint32_t sector = rand() % (STORE_SECTORS - SDCARD_MAX_BLOCKS);
+		int calls = 0;
+
+		card_capacity = (run % 2) ? HIGH_CAPACITY : 0;
+		card_type = (run % 3 == 0) ? MMC_CARD : SD_CARD;
+		card_reset(200 + rand() % 2000, 0, 0);
+		start_write(sector, count);
+		while (sdcard_busy() && calls++ < 1000000)
+		{
+#ifndef SPI_USE_POLLING
+			uint8_t action = rand() % 8;
+			if (action == 0)
+			{
+				sensor_irq = 1;
+			}
+			else if (action == 1)
+			{
+				spi_transmit(&sensor_package);
+			}
+			else if (action < 5)
+			{
+				queue_interrupt();
+			}
+			else
+#else
+			if (rand() % 4 == 0)
+			{
+				// A sensor read of the main loop between two calls
+				spi_transmit(&sensor_package);
+			}
+#endif
+			{
+				sdcard_update();
+			}
+			host_time += 10;
+		}
+		CHECK(!sdcard_busy(), "write of %u sectors at %u stalled", count, sector);
+		check_write();
+	}
+#ifndef SPI_USE_POLLING
+	printf("%u packages dropped by the full queue\n", queue_dropped);
+	CHECK(queue_dropped > 0, "the queue was never full");
+#endif
+}
+
+int main(void)
+{
+	srand(42);
+	sdcard_init();
+	test_writes();
+#ifdef SPI_USE_POLLING
+	// Packages of 16 bytes, each with its release byte
+	printf("SPI %.3f MHz, %.0f us bus time per sector\n", SPI_CLOCK,
+			((SDCARD_SECTOR_SIZE + 4) * BYTE_TIME
+					+ (SDCARD_SECTOR_SIZE + 4) / 16 * (BYTE_TIME + 2 * PACKAGE_OVERHEAD)));
+	test_throughput("card busy 1 ms per sector", 1000, 0, 0);
+	test_throughput("card busy 3 ms per sector", 3000, 0, 0);
+	test_throughput("1 % stalls of 60 ms", 1000, 60000, 1);
+	return host_test_done("sdcard-test");
+#else
+	return host_test_done("sdcard-queue-test");
+#endif
+}
@@ -0,0 +1,326 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Host test of the shared state history
+ *
+ *   Three batch filters of the size of the Vicon (2 states), outdoor
+ *   (4 states) and optical flow (1 state, every 4th tick) filter share
+ *   the ring. A delayed measurement applied with state_history_correct()
+ *   has to give the same current state and recorded entries as a second
+ *   run that applied it at its capture tick. The other filters must not
+ *   change, a full ring must refuse more filters. A scalar correction
+ *   with k times the nominal variance has to move the state 1 / k as far.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "state_history.h"
+
+#define RUNS 2000
+#define TOLERANCE 1e-4f
+
+static m_elem random_uniform(m_elem min, m_elem max)
+{
+	return min + (max - min) * (m_elem) rand() / (m_elem) RAND_MAX;
+}
+
+/** @brief Random stable model, A near 0.99 I as in kalman-test */
+static void random_filter(kalman_batch_t* kalman, int n, int m)
+{
+	kalman_batch_init(kalman, n, m, 100);
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		m_elem a[KALMAN_BATCH_MAX_STATES * KALMAN_BATCH_MAX_STATES];
+		m_elem c[KALMAN_BATCH_MAX_MEASUREMENTS * KALMAN_BATCH_MAX_STATES];
+		m_elem gain_start[KALMAN_BATCH_MAX_STATES * KALMAN_BATCH_MAX_MEASUREMENTS];
+		m_elem gain[KALMAN_BATCH_MAX_STATES * KALMAN_BATCH_MAX_MEASUREMENTS];
+		m_elem x[KALMAN_BATCH_MAX_STATES];
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = 0; j < n; j++)
+			{
+				a[i * n + j] = (i == j ? 0.99f : 0) + random_uniform(-0.01f, 0.01f);
+			}
+			for (int k = 0; k < m; k++)
+			{
+				c[k * n + i] = random_uniform(-1, 1);
+				gain_start[i * m + k] = random_uniform(-0.2f, 0.2f);
+				gain[i * m + k] = random_uniform(-0.2f, 0.2f);
+			}
+			x[i] = random_uniform(-10, 10);
+		}
+		kalman_batch_init_axis(kalman, axis, a, c, gain_start, gain, x);
+	}
+}
+
+typedef struct
+{
+	kalman_batch_t filter[3];
+	uint8_t ticks[3];
+} system_t;
+
+/** @brief One fusion tick: each filter steps on its ticks, then the entry is recorded */
+static void system_tick(system_t* s, int t)
+{
+	for (int f = 0; f < 3; f++)
+	{
+		if (t % s->ticks[f] == 0)
+		{
+			kalman_batch_predict(&s->filter[f]);
+		}
+	}
+	state_history_record((uint64_t) t * STATE_HISTORY_PERIOD);
+}
+
+static void system_register(system_t* s)
+{
+	state_history_init();
+	for (int f = 0; f < 3; f++)
+	{
+		CHECK(state_history_register(&s->filter[f], s->ticks[f]), "filter %d not registered", f);
+	}
+}
+
+/** @brief Correction the filter applies for measurement against x */
+static void correction(kalman_batch_t* kalman,
+		m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS],
+		m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES])
+{
+	kalman_batch_correction(kalman, measurement, mask, kalman->x, dx);
+}
+
+static void copy_entries(m_elem x[STATE_HISTORY_COUNT][STATE_HISTORY_STATES], int16_t count)
+{
+	for (int16_t age = 0; age < count; age++)
+	{
+		memcpy(x[age], state_history_get(age)->x, sizeof(x[age]));
+	}
+}
+
+/**
+ * @brief Delayed correction of filter f equals the correction at its capture tick
+ */
+static void check_delayed(int f, int16_t age, int start)
+{
+	static system_t model;
+	static system_t delayed, direct;
+	static m_elem entries[STATE_HISTORY_COUNT][STATE_HISTORY_STATES];
+	static m_elem corrected[STATE_HISTORY_COUNT][STATE_HISTORY_STATES];
+	static m_elem direct_entries[STATE_HISTORY_COUNT][STATE_HISTORY_STATES];
+	static const int sizes[3][2] = { { 2, 2 }, { 4, 2 }, { 1, 1 } };
+	m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS];
+	m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS];
+
+	for (int i = 0; i < 3; i++)
+	{
+		random_filter(&model.filter[i], sizes[i][0], sizes[i][1]);
+		model.ticks[i] = (i == 2) ? 4 : 1;
+	}
+	for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+	{
+		for (int k = 0; k < KALMAN_BATCH_MAX_MEASUREMENTS; k++)
+		{
+			measurement[axis][k] = random_uniform(-10, 10);
+			mask[axis][k] = rand() % 2;
+		}
+	}
+
+	// Run with the measurement applied age ticks late through the history
+	delayed = model;
+	system_register(&delayed);
+	int capture = start + STATE_HISTORY_COUNT;
+	int now = capture + age + 1;
+	for (int t = start; t < now; t++)
+	{
+		system_tick(&delayed, t);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		kalman_batch_predict(&delayed.filter[i]);
+	}
+	CHECK(state_history_age((uint64_t) capture * STATE_HISTORY_PERIOD + 1000) == age,
+			"capture tick %d has age %d, expected %d", capture,
+			state_history_age((uint64_t) capture * STATE_HISTORY_PERIOD), age);
+	system_t before = delayed;
+	copy_entries(entries, STATE_HISTORY_COUNT);
+	CHECK(state_history_correct(&delayed.filter[f], measurement, mask, age),
+			"filter %d age %d not corrected", f, age);
+	copy_entries(corrected, STATE_HISTORY_COUNT);
+
+	// Run with the correction applied right after the capture tick
+	direct = model;
+	system_register(&direct);
+	for (int t = start; t < now; t++)
+	{
+		system_tick(&direct, t);
+		if (t == capture)
+		{
+			m_elem dx[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_STATES];
+			correction(&direct.filter[f], measurement, mask, dx);
+			for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+			{
+				for (int j = 0; j < direct.filter[f].states; j++)
+				{
+					direct.filter[f].x[axis][j] += dx[axis][j];
+				}
+			}
+			// The entry of the capture tick holds the corrected state
+			state_history_record((uint64_t) t * STATE_HISTORY_PERIOD);
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		kalman_batch_predict(&direct.filter[i]);
+	}
+	copy_entries(direct_entries, age + 1);
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int axis = 0; axis < KALMAN_BATCH_AXES; axis++)
+		{
+			for (int j = 0; j < delayed.filter[i].states; j++)
+			{
+				m_elem d = delayed.filter[i].x[axis][j];
+				if (i != f)
+				{
+					CHECK(d == before.filter[i].x[axis][j], "filter %d changed by a correction of %d", i, f);
+				}
+				else if (delayed.ticks[i] == 1)
+				{
+					m_elem e = direct.filter[i].x[axis][j];
+					CHECK(fabsf(d - e) <= TOLERANCE * (1 + fabsf(e)),
+							"filter %d age %d axis %d state %d: %g, at capture %g", f, age, axis, j, d, e);
+				}
+			}
+		}
+	}
+
+	// Recorded entries: the corrected filter like the direct run, the others unchanged
+	for (int16_t k = 0; k < STATE_HISTORY_COUNT; k++)
+	{
+		const m_elem* x = corrected[k];
+		int offset = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			int n = KALMAN_BATCH_AXES * delayed.filter[i].states;
+			for (int j = offset; j < offset + n; j++)
+			{
+				if (i != f || k > age)
+				{
+					CHECK(x[j] == entries[k][j], "filter %d entry %d changed", i, k);
+				}
+				else if (delayed.ticks[i] == 1)
+				{
+					CHECK(fabsf(x[j] - direct_entries[k][j]) <= TOLERANCE * (1 + fabsf(direct_entries[k][j])),
+							"filter %d age %d entry %d: %g, at capture %g", f, age, k, x[j], direct_entries[k][j]);
+				}
+			}
+			offset += n;
+		}
+	}
+}
+
+static void check_register(void)
+{
+	kalman_batch_t k[4];
+	for (int i = 0; i < 4; i++)
+	{
+		random_filter(&k[i], KALMAN_BATCH_MAX_STATES, 2);
+	}
+
+	// Two 4 state filters fill 24 states
+	state_history_init();
+	CHECK(state_history_register(&k[0], 1), "first filter refused");
+	CHECK(state_history_register(&k[1], 1), "second filter refused");
+	CHECK(!state_history_register(&k[2], 1), "filter beyond STATE_HISTORY_STATES registered");
+	CHECK(state_history_register(&k[0], 1), "registering twice failed");
+
+	m_elem measurement[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] = { };
+	m_elem mask[KALMAN_BATCH_AXES][KALMAN_BATCH_MAX_MEASUREMENTS] = { };
+	state_history_record(0);
+	CHECK(!state_history_correct(&k[2], measurement, mask, 0), "unregistered filter corrected");
+	CHECK(!state_history_correct(&k[0], measurement, mask, 1), "age beyond the ring accepted");
+	CHECK(state_history_correct(&k[0], measurement, mask, 0), "newest entry refused");
+
+	// Filters of one state each, STATE_HISTORY_FILTERS at most
+	state_history_init();
+	for (int i = 0; i < 4; i++)
+	{
+		k[i].states = 1;
+		CHECK(state_history_register(&k[i], 1) == (i < STATE_HISTORY_FILTERS),
+				"filter %d of %d registered wrong", i, STATE_HISTORY_FILTERS);
+	}
+}
+
+/**
+ * @brief Measurement variance weights the fixed gain correction
+ */
+static void check_variance(void)
+{
+	kalman_batch_t a, b;
+	random_filter(&a, 2, 2);
+	int axis = rand() % KALMAN_BATCH_AXES;
+	m_elem nominal = random_uniform(0.01f, 10);
+	m_elem factor = random_uniform(1, 100);
+	m_elem value = random_uniform(-10, 10);
+
+	CHECK(kalman_batch_weight(&a, axis, 0, nominal) == 1, "weight without nominal variance");
+	kalman_batch_set_variance(&a, axis, 0, nominal);
+	CHECK(kalman_batch_weight(&a, axis, 0, 0) == 1, "weight without variance");
+	CHECK(kalman_batch_weight(&a, axis, 0, nominal * 0.5f) == 1, "weight above 1");
+	CHECK(kalman_batch_weight(&a, axis, 1, nominal * factor) == 1, "weight of another measurement");
+
+	// Same as moving the measurement 1 / factor of the way at nominal variance
+	b = a;
+	m_elem estimate = a.c[axis][0][0] * a.x[axis][0] + a.c[axis][0][1] * a.x[axis][1];
+	kalman_batch_correct_scalar(&a, axis, 0, value, nominal * factor);
+	kalman_batch_correct_scalar(&b, axis, 0, estimate + (value - estimate) / factor, nominal);
+	for (int i = 0; i < 2; i++)
+	{
+		CHECK(fabsf(a.x[axis][i] - b.x[axis][i]) <= TOLERANCE,
+				"variance %g times nominal, state %d: %g, expected %g", factor, i,
+				a.x[axis][i], b.x[axis][i]);
+	}
+}
+
+int main(void)
+{
+	srand(1);
+	check_register();
+	for (int run = 0; run < RUNS; run++)
+	{
+		check_variance();
+	}
+	for (int run = 0; run < RUNS; run++)
+	{
+		check_delayed(rand() % 3, rand() % STATE_HISTORY_COUNT, rand() % 1000);
+	}
+	return host_test_done("state-history-test");
+}
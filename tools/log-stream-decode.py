@@ -0,0 +1,397 @@
+#!/usr/bin/env python
+#
+# Decodes the binary log stream of system/log_stream.c.
+#
+# The stream is read from a file (or - for stdin), e.g. captured with
+#   stty -F /dev/ttyUSB0 921600 raw && cat /dev/ttyUSB0 > flight.bin
+# or a LOGnnn.BIN file of the SD card (system/sd_log.c).
+# Samples are written as CSV to stdout, or with --npz as NumPy arrays,
+# one per field, scaled to physical units. Each row also gets the frame
+# sequence number, so dropped frames show up as gaps in "seq".
+#
+# SD card logs are memory mapped. Their index frames give the file offset
+# of the key frames, so with --from/--to only the part of the log in the
+# time range is decoded, in --jobs processes.
+
+from __future__ import print_function
+
+import getopt
+import mmap
+import struct
+import sys
+
+USAGE = """Usage: %s [options] log.bin|-
+  --npz out.npz   write NumPy arrays instead of CSV
+  --fields a,b    only these fields (seq and t_us are always written)
+  --from s        only samples with t_us from s seconds on
+  --to s          only samples with t_us before s seconds
+  --jobs n        decode SD card logs in n processes""" % sys.argv[0]
+
+SYNC = b"\xa5\x5a"
+HEADER = struct.Struct("<BHH")
+
+SD_SECTOR = 512
+SD_MAGIC = 0x4C53
+SD_HEADER = struct.Struct("<HHIHH")
+
+FRAME_SCHEMA = 0
+FRAME_KEY = 1
+FRAME_DELTA = 2
+FRAME_INDEX = 3
+INDEX_ENTRY = struct.Struct("<II")
+NO_INDEX = 0xFFFFFFFF
+
+TYPE_FLOAT = 0
+TYPE_INT16 = 1
+TYPE_UINT16 = 2
+TYPE_UINT32 = 3
+
+
+def crc_x25(data):
+    crc = 0xFFFF
+    for b in bytearray(data):
+        tmp = (b ^ (crc & 0xFF)) & 0xFF
+        tmp = (tmp ^ (tmp << 4)) & 0xFF
+        crc = ((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4)) & 0xFFFF
+    return crc
+
+
+def varints(data):
+    values = []
+    v = 0
+    shift = 0
+    for b in bytearray(data):
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            values.append((v >> 1) ^ -(v & 1))
+            v = 0
+            shift = 0
+    return values
+
+
+def wrap32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def parse_schema(payload):
+    fields = []
+    i = 0
+    while i < len(payload):
+        t, scale = struct.unpack_from("<Bf", payload, i)
+        end = payload.index(b"\x00", i + 5)
+        fields.append((payload[i + 5:end].decode("ascii"), t, scale))
+        i = end + 1
+    return fields
+
+
+def sd_session(data):
+    """Return the session of an SD card log file, or None if it is none"""
+    if len(data) < SD_SECTOR or len(data) % SD_SECTOR:
+        return None
+    magic, session, index, first, _ = SD_HEADER.unpack_from(data, 0)
+    if magic != SD_MAGIC or index != 0:
+        return None
+    return session
+
+
+def sd_valid(data, sector, session):
+    magic, s, index, first, _ = SD_HEADER.unpack_from(data, sector * SD_SECTOR)
+    return magic == SD_MAGIC and s == session and index == sector
+
+
+def sd_end(data, session):
+    """Return the number of sectors written in this session
+
+    The reserved file is written from the start, the rest holds sectors
+    of earlier logs. A failed sector leaves a single gap, so a probe also
+    looks at the following sectors."""
+    def written(sector):
+        for s in range(sector, min(sector + 8, len(data) // SD_SECTOR)):
+            if sd_valid(data, s, session):
+                return True
+        return False
+
+    lo = 0
+    hi = len(data) // SD_SECTOR
+    while hi - lo > 1:
+        mid = (lo + hi) // 2
+        if written(mid):
+            lo = mid
+        else:
+            hi = mid
+    while lo + 1 < len(data) // SD_SECTOR and written(lo + 1):
+        lo += 1
+    return lo + 1
+
+
+def sd_slice(data, start, end, session):
+    """Return the stream between two file offsets, without sector headers
+
+    Sectors not written in this session are left out."""
+    parts = []
+    sector = start // SD_SECTOR
+    while sector * SD_SECTOR < end:
+        if sd_valid(data, sector, session):
+            begin = max(start, sector * SD_SECTOR + SD_HEADER.size)
+            parts.append(data[begin:min(end, (sector + 1) * SD_SECTOR)])
+        sector += 1
+    return b"".join(parts)
+
+
+def sd_stream(data):
+    """Return the stream of an SD card log file, or data if it is none
+
+    Sectors of another session or with a smaller index are left over
+    from earlier files and skipped."""
+    if len(data) < SD_SECTOR or len(data) % SD_SECTOR:
+        return data
+    magic, session, index, first, _ = SD_HEADER.unpack_from(data, 0)
+    if magic != SD_MAGIC:
+        return data
+    parts = []
+    last = -1
+    for i in range(0, len(data), SD_SECTOR):
+        magic, s, index, first, _ = SD_HEADER.unpack_from(data, i)
+        if magic != SD_MAGIC or s != session or index <= last:
+            continue
+        if index != last + 1:
+            sys.stderr.write("sectors %d to %d missing\n" % (last + 1, index - 1))
+        last = index
+        parts.append(data[i + SD_HEADER.size:i + SD_SECTOR])
+    return b"".join(parts)
+
+
+def frames(data):
+    """Yield (type, seq, payload) of every frame with a valid CRC"""
+    i = 0
+    while True:
+        i = data.find(SYNC, i)
+        if i < 0 or i + 2 + HEADER.size > len(data):
+            return
+        t, seq, n = HEADER.unpack_from(data, i + 2)
+        end = i + 2 + HEADER.size + n
+        if t > FRAME_INDEX or end + 2 > len(data):
+            i += 1
+            continue
+        crc, = struct.unpack_from("<H", data, end)
+        if crc != crc_x25(data[i + 2:end]):
+            i += 1
+            continue
+        yield t, seq, data[i + 2 + HEADER.size:end]
+        i = end + 2
+
+
+def decode(data, fields=None):
+    """Return the field schema and the list of (seq, raw values) samples
+
+    Without fields the schema is taken from the first schema frame."""
+    samples = []
+    last = None
+    last_seq = None
+    for t, seq, payload in frames(data):
+        # A lost frame breaks the delta chain until the next key frame
+        if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+            last = None
+        last_seq = seq
+        if t == FRAME_INDEX:
+            continue
+        if t == FRAME_SCHEMA:
+            schema = parse_schema(payload)
+            if fields is not None and schema != fields:
+                sys.stderr.write("schema changed at seq %d, ignoring\n" % seq)
+                continue
+            fields = schema
+            continue
+        if fields is None:
+            continue
+        values = varints(payload)
+        if len(values) != len(fields):
+            last = None
+            continue
+        if t == FRAME_DELTA:
+            if last is None:
+                continue
+            values = [wrap32(a + d) for a, d in zip(last, values)]
+        last = values
+        samples.append((seq, values))
+    return fields, samples
+
+
+def read_index(data, session, end):
+    """Return the sorted (t_us, file offset) of the indexed key frames
+
+    The last index frame is searched back from the end, the others are
+    found through their chain of file offsets."""
+    last = None
+    sectors = 64
+    while last is None:
+        start = max(0, end - sectors)
+        stream = sd_slice(data, start * SD_SECTOR, end * SD_SECTOR, session)
+        for t, seq, payload in frames(stream):
+            if t == FRAME_INDEX:
+                last = payload
+        if start == 0:
+            break
+        sectors *= 2
+    if last is None:
+        return []
+
+    entries = []
+    payload = last
+    here = end * SD_SECTOR
+    while payload is not None:
+        prev, = struct.unpack_from("<I", payload, 0)
+        for i in range(4, len(payload) - INDEX_ENTRY.size + 1, INDEX_ENTRY.size):
+            entries.append(INDEX_ENTRY.unpack_from(payload, i))
+        payload = None
+        # The chain only goes back, a broken one ends here
+        if prev != NO_INDEX and prev < here:
+            here = prev
+            for t, seq, p in frames(sd_slice(data, prev, prev + 2 * SD_SECTOR, session)):
+                if t == FRAME_INDEX:
+                    payload = p
+                break
+    entries.sort(key=lambda e: e[1])
+
+    # t_us wraps after 71 minutes
+    unwrapped = []
+    wrap = 0
+    for t, offset in entries:
+        if unwrapped and t + wrap < unwrapped[-1][0] - (1 << 31):
+            wrap += 1 << 32
+        unwrapped.append((t + wrap, offset))
+    return unwrapped
+
+
+def unwrap_time(base, t):
+    """Return t_us as the value closest to base, base is unwrapped"""
+    return base + (((t & 0xFFFFFFFF) - base + (1 << 31)) & 0xFFFFFFFF) - (1 << 31)
+
+
+def select(fields, samples, columns, base, t_from, t_to):
+    """Return the rows of the selected columns in the time range"""
+    rows = []
+    for seq, values in samples:
+        base = unwrap_time(base, values[0])
+        if base < t_from or base >= t_to:
+            continue
+        values = scaled(fields, values)
+        values[0] = base
+        rows.append([seq] + [values[i] for i in columns])
+    return rows
+
+
+def decode_segment(task):
+    """Decode the stream between two key frames, runs in a worker process"""
+    path, session, start, end, base, fields, columns, t_from, t_to = task
+    with open(path, "rb") as f:
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        fields, samples = decode(sd_slice(data, start, end, session), fields)
+        data.close()
+    return select(fields, samples, columns, base, t_from, t_to)
+
+
+def decode_indexed(path, data, session, columns_of, t_from, t_to, jobs):
+    """Decode the indexed part of an SD card log in the time range
+
+    Return None if the log has no index frame."""
+    end = sd_end(data, session)
+    entries = read_index(data, session, end)
+    if not entries:
+        return None, None
+
+    # The schema is the first frame of the log
+    fields, _ = decode(sd_slice(data, 0, 4 * SD_SECTOR, session))
+    if fields is None:
+        return None, None
+    columns = columns_of(fields)
+
+    # Segments from one key frame to the next, the first one from the
+    # start of the log
+    bounds = [(entries[0][0], SD_HEADER.size)] + entries + [(None, end * SD_SECTOR)]
+    tasks = []
+    for i in range(len(bounds) - 1):
+        (t, start), (t_next, stop) = bounds[i], bounds[i + 1]
+        if start >= stop or (t_next is not None and t_next <= t_from) or t >= t_to:
+            continue
+        tasks.append((path, session, start, stop, t, fields, columns, t_from, t_to))
+
+    if jobs > 1 and len(tasks) > 1:
+        import multiprocessing
+        pool = multiprocessing.Pool(jobs)
+        parts = pool.map(decode_segment, tasks, 1)
+        pool.close()
+    else:
+        parts = [decode_segment(task) for task in tasks]
+    return fields, [row for part in parts for row in part]
+
+
+def scaled(fields, values):
+    out = []
+    for (name, t, scale), v in zip(fields, values):
+        if t == TYPE_UINT32:
+            v &= 0xFFFFFFFF
+        out.append(v / scale if t == TYPE_FLOAT else v)
+    return out
+
+
+def main():
+    try:
+        opts, args = getopt.getopt(sys.argv[1:], "", ["npz=", "fields=", "from=", "to=", "jobs="])
+    except getopt.GetoptError:
+        opts, args = [], []
+    if len(args) != 1:
+        print(USAGE, file=sys.stderr)
+        sys.exit(1)
+    opts = dict(opts)
+    npz = opts.get("--npz")
+    wanted = opts["--fields"].split(",") if "--fields" in opts else None
+    t_from = int(float(opts["--from"]) * 1e6) if "--from" in opts else -(1 << 62)
+    t_to = int(float(opts["--to"]) * 1e6) if "--to" in opts else 1 << 62
+    jobs = int(opts.get("--jobs", 1))
+
+    def columns_of(fields):
+        names = [f[0] for f in fields]
+        if wanted is None:
+            return list(range(len(fields)))
+        missing = [n for n in wanted if n not in names]
+        if missing:
+            sys.stderr.write("unknown fields: %s\n" % ",".join(missing))
+            sys.exit(1)
+        return [0] + [names.index(n) for n in wanted if n != names[0]]
+
+    if args[0] == "-":
+        data = getattr(sys.stdin, "buffer", sys.stdin).read()
+    else:
+        f = open(args[0], "rb")
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    fields = None
+    session = sd_session(data)
+    if session is not None and args[0] != "-":
+        fields, rows = decode_indexed(args[0], data, session, columns_of, t_from, t_to, jobs)
+    if fields is None:
+        # Not indexed, decode all of it
+        fields, samples = decode(sd_stream(data))
+        if fields is None:
+            sys.stderr.write("no schema frame found\n")
+            sys.exit(1)
+        base = samples[0][1][0] & 0xFFFFFFFF if samples else 0
+        rows = select(fields, samples, columns_of(fields), base, t_from, t_to)
+
+    names = ["seq"] + [fields[i][0] for i in columns_of(fields)]
+
+    if npz:
+        import numpy
+        columns = list(zip(*rows)) if rows else [[] for _ in names]
+        numpy.savez(npz, **dict((n, numpy.array(c)) for n, c in zip(names, columns)))
+    else:
+        print(",".join(names))
+        for row in rows:
+            print(",".join("%g" % v if isinstance(v, float) else "%d" % v for v in row))
+
+
+if __name__ == "__main__":
+    main()
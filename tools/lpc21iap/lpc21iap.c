@@ -24,7 +24,7 @@
 
 
 #define LPC21IAP_VER_MAJ    1
-#define LPC21IAP_VER_MIN    1
+#define LPC21IAP_VER_MIN    3
 
 
 #if defined(_WIN32) && !defined(__CYGWIN__)
@@ -56,6 +56,7 @@
 #if defined COMPILE_FOR_LINUX || defined COMPILE_FOR_CYGWIN
 #include <termios.h>
 #include <unistd.h>     // for read and return value of lseek
+#include <sys/time.h>   // for gettimeofday
 #endif // defined COMPILE_FOR_LINUX || defined COMPILE_FOR_CYGWIN
 
 #include <ctype.h>      // isdigit()
@@ -76,6 +77,11 @@
 #define MAX_SECT        0x1000
 /* number of sectors used for bootloader */
 #define BOOTLOAD_SECT   4
+/* LPC214x data sheet time of an erase command, for one sector or the whole
+   chip, and program time of 4k, in ms, for the time estimates when this
+   run did not measure them */
+#define ERASE_MS        400
+#define PROGRAM_MS      16
 
 typedef struct
 {
@@ -83,13 +89,6 @@ typedef struct
     char name[50];
 } LPC_DEVICE;
 
-typedef struct
-{
-    unsigned int start;
-    void * next;
-    unsigned char data[MAX_SECT];
-} tIntermediateBuffer;
-
 static int SectorTable_214x[] = { 4096, 4096, 4096, 4096, 4096, 4096, 4096, 4096,
                                   32768, 32768, 32768, 32768, 32768, 32768, 32768, 32768,
                                   32768, 32768, 32768, 32768, 32768, 32768, 
@@ -113,6 +112,21 @@ void Sleep(unsigned long msec)
 }
 #endif // defined COMPILE_FOR_LINUX
 
+#define SECT_COUNT  (sizeof(SectorTable_214x)/sizeof(SectorTable_214x[0]))
+
+/* 4k pages sent to the RAM buffer with one upload, 2 with -p */
+static int stagePages = 1;
+
+/* time spent in the flash phases, in seconds */
+static struct
+{
+    double upload;          /* write to RAM command and data transfer */
+    double prepare;
+    double copy;
+    double compare;
+    unsigned int bytes;     /* sent to RAM */
+} phaseTime;
+
 /* gives the sector number in which the given address is in */
 int getSec(unsigned int adrFlash)
 {
@@ -132,6 +146,219 @@ int getSec(unsigned int adrFlash)
     return(-1);
 }
 
+/* gives the start address of a sector, the end of flash for SECT_COUNT */
+unsigned int getSecAddr(int sec)
+{
+    int count;
+    unsigned int adr = 0;
+
+    for (count = 0; count < sec; count++)
+    {
+        adr += SectorTable_214x[count];
+    }
+    return(adr);
+}
+
+/* seconds since some start, for the timing report */
+static double secTime(void)
+{
+#if defined COMPILE_FOR_WINDOWS
+    return(GetTickCount() / 1000.0);
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return(tv.tv_sec + tv.tv_usec / 1000000.0);
+#endif
+}
+
+/* 1 if a 4k page of the image is erased flash only */
+static int pageBlank(unsigned char * page)
+{
+    int count;
+
+    for (count = 0; count < MAX_SECT; count++)
+    {
+        if (page[count] != 0xFF) return(0);
+    }
+    return(1);
+}
+
+/* sends data to the RAM buffer */
+static int stageData(usb_dev_handle *udev, unsigned int ramAddr,
+                     unsigned char * data, unsigned int size)
+{
+    double start = secTime();
+
+    if (!writeRAM(udev, ramAddr, size)) return(0);
+    if (!USBReqData(udev, data, size)) return(0);
+
+    phaseTime.upload += secTime() - start;
+    phaseTime.bytes += size;
+    return(1);
+}
+
+/* compares a sector with the image on the device, stagePages*4k at a
+   time through the RAM buffer, stops at the first difference */
+static int sameSector(usb_dev_handle *udev, unsigned char * image,
+                      int sec, unsigned int ramAddr, int * same)
+{
+    unsigned int adr, size, end = getSecAddr(sec+1);
+    double start;
+
+    *same = 1;
+    for (adr = getSecAddr(sec); (adr < end) && *same; adr += size)
+    {
+        size = end - adr;
+        if (size > stagePages*MAX_SECT) size = stagePages*MAX_SECT;
+
+        if (!stageData(udev, ramAddr, image+adr, size)) return(0);
+
+        start = secTime();
+        if (!sameMem(udev, adr, ramAddr, size, same)) return(0);
+        phaseTime.compare += secTime() - start;
+    }
+    return(1);
+}
+
+/* programs the non blank 4k pages of an erased sector, returns the
+   number of pages or -1. Up to stagePages pages in a row are sent with
+   one upload and verified with one compare. */
+static int programSector(usb_dev_handle *udev, unsigned char * image,
+                         int sec, unsigned int ramAddr)
+{
+    unsigned int adr, end = getSecAddr(sec+1);
+    int count, num;
+    int pages = 0;
+    double start;
+
+    for (adr = getSecAddr(sec); adr < end; adr += num*MAX_SECT)
+    {
+        num = 1;
+        if (pageBlank(image+adr)) continue;
+
+        while ((num < stagePages) &&
+               (adr+num*MAX_SECT < end) &&
+               !pageBlank(image+adr+num*MAX_SECT))
+        {
+            num++;
+        }
+
+        if (!stageData(udev, ramAddr, image+adr, num*MAX_SECT)) return(-1);
+
+        for (count = 0; count < num; count++)
+        {
+            printf("#");
+            fflush(stdout);
+
+            start = secTime();
+            if (!prepareSectors(udev, sec, sec)) return(-1);
+            phaseTime.prepare += secTime() - start;
+
+            start = secTime();
+            if (!copyRAMFlash(udev, adr+count*MAX_SECT, ramAddr+count*MAX_SECT, MAX_SECT)) return(-1);
+            phaseTime.copy += secTime() - start;
+        }
+
+        start = secTime();
+        if (!compareMem(udev, adr, ramAddr, num*MAX_SECT)) return(-1);
+        phaseTime.compare += secTime() - start;
+
+        pages += num;
+    }
+    return(pages);
+}
+
+/* brings the sectors startSec to endSec to the content of the image.
+   Unless all is set, the sectors are first compared on the device and
+   only the ones that differ are erased and programmed. */
+static int flashImage(usb_dev_handle *udev, unsigned char * image,
+                      int startSec, int endSec, unsigned int ramAddr, int all)
+{
+    int changed[SECT_COUNT];
+    int sec, last, same, pages;
+    int secCount = 0, secChanged = 0, eraseCmds = 0;
+    int pageCount = 0, pageProgrammed = 0;
+    double start, timeDiff, timeErase, timeProgram, saved;
+
+    /* find the sectors that differ */
+    start = secTime();
+    for (sec = startSec; sec <= endSec; sec++)
+    {
+        unsigned int adr;
+
+        for (adr = getSecAddr(sec); adr < getSecAddr(sec+1); adr += MAX_SECT)
+        {
+            if (!pageBlank(image+adr)) pageCount++;
+        }
+        if (all)
+        {
+            same = 0;
+        }
+        else if (!sameSector(udev, image, sec, ramAddr, &same))
+        {
+            return(0);
+        }
+        changed[sec] = !same;
+        secCount++;
+        secChanged += changed[sec];
+    }
+    timeDiff = secTime() - start;
+
+    /* erase runs of changed sectors with one command each */
+    start = secTime();
+    for (sec = startSec; sec <= endSec; sec = last+1)
+    {
+        last = sec;
+        if (!changed[sec]) continue;
+        while ((last < endSec) && changed[last+1]) last++;
+
+        if (!prepareSectors(udev, sec, last)) return(0);
+        if (!eraseSectors(udev, sec, last)) return(0);
+        eraseCmds++;
+    }
+    timeErase = secTime() - start;
+
+    start = secTime();
+    for (sec = startSec; sec <= endSec; sec++)
+    {
+        if (!changed[sec]) continue;
+
+        pages = programSector(udev, image, sec, ramAddr);
+        if (pages < 0) return(0);
+        pageProgrammed += pages;
+    }
+    timeProgram = secTime() - start;
+
+    printf("\n%d of %d sectors changed, %d of %d pages programmed\n",
+           secChanged, secCount, pageProgrammed, pageCount);
+    printf("compare %.0f ms, erase %.0f ms, program %.0f ms\n",
+           timeDiff*1000, timeErase*1000, timeProgram*1000);
+    printf("upload %.0f ms (%u kB), prepare %.0f ms, copy %.0f ms, compare %.0f ms\n",
+           phaseTime.upload*1000, phaseTime.bytes/1024, phaseTime.prepare*1000,
+           phaseTime.copy*1000, phaseTime.compare*1000);
+
+    if (!all)
+    {
+        /* a full flash erases all sectors with one command and programs
+           every page, with the measured times or the data sheet ones */
+        saved = (1 - eraseCmds) *
+                (eraseCmds ? timeErase / eraseCmds : ERASE_MS / 1000.0) +
+                (pageCount - pageProgrammed) *
+                (pageProgrammed ? timeProgram / pageProgrammed : PROGRAM_MS / 1000.0) -
+                timeDiff;
+        if (saved > 0)
+        {
+            printf("about %.0f ms saved against a full flash\n", saved*1000);
+        }
+        else
+        {
+            printf("the compare took %.0f ms more than it saved, -a skips it\n", -saved*1000);
+        }
+    }
+    return(1);
+}
+
 int main(int argc, char *argv[])
 {
     int fdElf;
@@ -146,24 +373,43 @@ int main(int argc, char *argv[])
     int temp;
     unsigned int utemp;
     int startSec, endSec;
-    unsigned int start, src, size, end, type, flag;
+    unsigned int start, src, size, type, flag;
     unsigned int maxFlash, lowFlash, highFlash;
+    unsigned char * image;
+    int argElf, flashAll;
     usb_dev_handle *udev;
     struct usb_device *dev;
     int found;
     struct usb_bus *bus;
     char cserial[256];
-    tIntermediateBuffer* actBuf = NULL;
-    tIntermediateBuffer* startBuf = NULL;
 
-    if ((argc < 2) || (argc > 3))
+    /* -a erases and programs all sectors, without comparing first,
+       -p stages two 4k pages in RAM per upload */
+    flashAll = 0;
+    for (argElf = 1; (argElf < argc) && (argv[argElf][0] == '-'); argElf++)
+    {
+        if (strcmp(argv[argElf], "-a") == 0)
+        {
+            flashAll = 1;
+        }
+        else if (strcmp(argv[argElf], "-p") == 0)
+        {
+            stagePages = 2;
+        }
+        else
+        {
+            argElf = argc;
+        }
+    }
+
+    if ((argc < argElf+1) || (argc > argElf+2))
     {
         printf("lpc21iap version v%d.%d, ", LPC21IAP_VER_MAJ, LPC21IAP_VER_MIN);
-        printf("usage: %s file.elf [usb_serial_number]\n", argv[0]);
+        printf("usage: %s [-a] [-p] file.elf [usb_serial_number]\n", argv[0]);
         exit(1);
     }
 
-    fdElf = open(argv[1], O_RDONLY | O_BINARY);
+    fdElf = open(argv[argElf], O_RDONLY | O_BINARY);
 
     if(fdElf < 0)
     {
@@ -189,17 +435,6 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
-    startBuf = malloc(sizeof(tIntermediateBuffer));
-    if (startBuf == NULL)
-    {
-        perror("malloc failed");
-        exit(1);
-    }
-    startBuf->start = 0xFFFFFFFF;
-    startBuf->next = NULL;
-
-    memset(startBuf->data, 0xFF, MAX_SECT);
-
     count = 0;
     while (count < lenElf)
     {
@@ -252,13 +487,13 @@ int main(int argc, char *argv[])
                         if (udev)
                         {
                             printf("\nFound USB device\n");
-                            if (argc==3)
+                            if (argc == argElf+2)
                             {
                                 if (dev->descriptor.iSerialNumber)
                                 {
                                     if (usb_get_string_simple(udev, dev->descriptor.iSerialNumber, cserial, sizeof(cserial)) > 0)
                                     {
-                                        if (strncmp(argv[2], cserial, strlen(argv[2])) == 0)
+                                        if (strncmp(argv[argElf+1], cserial, strlen(argv[argElf+1])) == 0)
                                         {
                                             found = 1;
                                         }
@@ -318,9 +553,7 @@ int main(int argc, char *argv[])
 
     /* calc maximum usable flash address */
     maxFlash = 0;
-    for (count=0; 
-         count < sizeof(SectorTable_214x)/sizeof(SectorTable_214x[0]); 
-         count++)
+    for (count=0; count < SECT_COUNT; count++)
     {
             maxFlash += SectorTable_214x[count];
     }
@@ -353,19 +586,69 @@ int main(int argc, char *argv[])
         exit(2);
     }
 
-    /* anything to flash erase? */
+    /* anything to flash? */
     if (lowFlash != maxFlash)
     {
+        /* The LPC214x does not allow pages (4k) to be programmed twice
+           without erasing in between, not even with 0xFF's being filled
+           into the gaps. So all sections are put together into an image
+           of the flash first, unused bytes are 0xFF as after an erase. */
+        image = malloc(maxFlash);
+        if (image == NULL)
+        {
+            perror("malloc failed");
+            exit(1);
+        }
+        memset(image, 0xFF, maxFlash);
+
+        for (count=0; count < secElf; count++)
+        {
+            start = ELFAddrPSection(binElf, count);
+            src   = ELFOffsPSection(binElf, count);
+            size  = ELFSizePSection(binElf, count);
+            type  = ELFTypePSection(binElf, count);
+            flag  = ELFFlagPSection(binElf, count);
+
+            /* adjust size to 32 bit alignment */
+            size = (size + 3) & 0xFFFFFFFC;
+
+            if ((size > 0) &&
+                (src != 0) &&
+                (type & PT_LOAD) &&
+                (flag & (PF_X | PF_W | PF_R)) &&
+                (start+size <= maxFlash))
+            {
+                if (src+size > lenElf) size = lenElf - src;
+                memcpy(image+start, binElf+src, size);
+            }
+        }
+
+        /* do checksum for first block (LE machines) */
+        if (lowFlash == 0)
+        {
+            unsigned int * dat = (unsigned int *) image;
+            unsigned int crc = 0;
+
+            dat[5] = 0;
+
+            for(count = 0; count < 8; count++) {
+                crc += dat[count];
+            }
+
+            dat[5] = (unsigned long) -crc;
+
+            printf("changing vector table\n");
+        }
+
         startSec = getSec(lowFlash);
-        endSec = getSec(highFlash);
+        endSec = getSec(highFlash-1);
 
-        /* prepare sectors for erase */
-        if (!prepareSectors(udev, startSec, endSec)) exit(1);
+        if (!flashImage(udev, image, startSec, endSec, ramAddr, flashAll)) exit(1);
 
-        /* erase sectors */
-        if (!eraseSectors(udev, startSec, endSec)) exit(1);
+        free(image);
     }
 
+    /* RAM sections, after the flash which uses the RAM buffer */
     for (count=0; count < secElf; count++)
     {
         start = ELFAddrPSection(binElf, count);
@@ -380,179 +663,15 @@ int main(int argc, char *argv[])
         if ((size > 0) &&
             (src != 0) &&
             (type & PT_LOAD) &&
-            (flag & (PF_X | PF_W | PF_R)))
-        {
-
-            if (start+size <= maxFlash)
-            {
-                unsigned int cnt;
-                unsigned int startPage, endPage, countPage;
-                unsigned int splitGap, splitCnt;
-
-#if 0
-                /* Flash */
-                printf( "Flash sect  = %02d, start = 0x%08X, src = 0x%08X, size = 0x%08X, type = 0x%08X, flag = 0x%08X\n",
-                count,
-                start,
-                src,
-                size,
-                type,
-                flag);
-#endif
-
-                /* end address in flash */
-                end = start + size;
-
-                cnt = 0;
-
-                /* page address of the first sector */
-                startPage = start & ~(MAX_SECT-1);
-                /* page address of the end sector */
-                endPage  = (end+MAX_SECT) & ~(MAX_SECT-1);
-
-                /* always 4k "blocks" are written */
-                for (countPage = startPage; countPage < endPage; countPage += MAX_SECT)
-                {
-                    /* do checksum for first block (LE machines) */
-                    if (countPage == 0)
-                    {
-                        unsigned int * dat = (unsigned int *) (binElf+src);
-                        unsigned int crc = 0;
-                        int count;
-
-                        dat[5] = 0;
-
-                        for(count = 0; count < 8; count++) {
-                            crc += dat[count];
-                        }
-
-                        dat[5] = (unsigned long) -crc;
-
-                        printf("changing vector table\n");
-                    }
-
-                    printf("#");
-                    fflush(stdout);
-
-                    splitCnt = MAX_SECT;
-
-                    /* The LPC214x does not allow pages (4k) to be
-                       programmed twice without erasing in between, not even
-                       with 0xFF's being filled into the gaps. So we have to
-                       store all the partly filled pages until the end and
-                       flash them in one flush.                              */
-
-                    /* first page, not beginning at page start */
-                    if ((countPage == startPage) && (start != startPage))
-                    {
-                        /* gap of non programmed bytes at the beginning of page */
-                        splitGap = start % MAX_SECT;
-                        /* number of bytes in the first block */
-                        if ((splitGap + size) < MAX_SECT) {
-                            /* data ends within first page */
-                            splitCnt = size;
-                        }
-                        else {
-                            /* data until end of page */
-                            splitCnt = MAX_SECT - splitGap;
-                        }
-                    }
-                    /* last page, not ending at page end */
-                    else  if ((countPage+MAX_SECT == endPage) && (end != endPage))
-                    {
-                        /* no gap at beginning */
-                        splitGap = 0;
-                        /* number of bytes in the last sector */
-                        splitCnt = end % MAX_SECT;
-                    }
-                    if (splitCnt != MAX_SECT)
-                    {
-                        /* keep partly filled pages for later programming */
-                        actBuf = startBuf;
-                        while (1)
-                        {
-                            if (actBuf->start == countPage)
-                            {
-                                break;
-                            }
-                            if (actBuf->next == NULL)
-                            {
-                                actBuf->next = malloc(sizeof(tIntermediateBuffer));
-                                if (actBuf->next == NULL)
-                                {
-                                    perror("malloc failed");
-                                    exit(1);
-                                }
-                                actBuf = actBuf->next;
-                                actBuf->start = countPage;
-                                actBuf->next = NULL;
-                                memset(actBuf->data, 0xFF, MAX_SECT);
-                                break;
-                            }
-                            actBuf = actBuf->next;
-                        }
-
-                        /* copy data to buffer */
-                        // read(startBuf->data + splitGap, splitCnt):
-                        memcpy(actBuf->data + splitGap, binElf+src+cnt, splitCnt);
-                    }
-                    else
-                    {
-                       /* flash full filled 4k block */
-
-                        /* copy data to buffer */
-                        // read(startBuf->data, MAX_SECT):
-                        memcpy(startBuf->data, binElf+src+cnt, MAX_SECT);
-
-                        if (!writeRAM(udev, ramAddr, MAX_SECT)) exit(1);
-                        if (!USBReqData(udev, startBuf->data, MAX_SECT)) exit(1);
-                        if (!prepareSectors(udev, getSec(countPage), getSec(countPage))) exit(1);
-                        if (!copyRAMFlash(udev, countPage, ramAddr, MAX_SECT)) exit(1);
-                        if (!compareMem(udev, countPage, ramAddr, MAX_SECT)) exit(1);
-                    }
-                    cnt += splitCnt;
-                }
-            }
-            else
-            {
-#if 0
-                /* RAM */
-                printf( "RAM sect  = %02d, start = 0x%08X, src = 0x%08X, size = 0x%08X, type = 0x%08X, flag = 0x%08X\n",
-                count,
-                start,
-                src,
-                size,
-                type,
-                flag);
-#endif
-
-                /* copy it in one piece */
-                if (!writeRAM(udev, start, size)) exit(1);
-                if (!USBReqData(udev, (unsigned char*) (binElf+src), size)) exit(1);
-            }
-        }
-    }
-
-    actBuf = startBuf;
-
-    /* go through all the split sectors */
-    while (actBuf != NULL)
-    {
-        if (actBuf->start != 0xFFFFFFFF)
+            (flag & (PF_X | PF_W | PF_R)) &&
+            (start+size > maxFlash))
         {
-            if (!writeRAM(udev, ramAddr, MAX_SECT)) exit(1);
-            if (!USBReqData(udev, actBuf->data, MAX_SECT)) exit(1);
-            if (!prepareSectors(udev, getSec(actBuf->start), getSec(actBuf->start))) exit(1);
-            if (!copyRAMFlash(udev, actBuf->start & ~(MAX_SECT-1), ramAddr, MAX_SECT)) exit(1);
-            if (!compareMem(udev, actBuf->start & ~(MAX_SECT-1), ramAddr, MAX_SECT)) exit(1);
+            /* copy it in one piece */
+            if (!writeRAM(udev, start, size)) exit(1);
+            if (!USBReqData(udev, (unsigned char*) (binElf+src), size)) exit(1);
         }
-        startBuf = actBuf;
-        actBuf = actBuf->next;
-        free(startBuf);
     }
 
-    printf("\n");
-
     free(binElf);
 
     if (EF_ARM_HASENTRY == (flagsElf & EF_ARM_HASENTRY))
@@ -204,7 +204,11 @@ int USBReqISP(usb_dev_handle *udev,
 
     if (result[0] != 0)
     {
-        printf("ISP error (%d:%s)\n", result[0]&0xFF, IspError(result[0]&0xFF));
+        /* a differing compare is an answer, not an error, for sameMem() */
+        if ((command[0] != ISP_COMPARE) || (result[0] != COMPARE_ERROR))
+        {
+            printf("ISP error (%d:%s)\n", result[0]&0xFF, IspError(result[0]&0xFF));
+        }
         return(0);
     }
     if ((cmdret != 20) || 
@@ -477,6 +481,28 @@ int compareMem(usb_dev_handle *udev, unsigned int dst, unsigned int src, unsigne
     command[3] = size;
 
     if (!USBReqISP(udev, command, result))
+    {
+        printf("compare MEM failed at 0x%08X base 0x%08X size 0x%08X (%s)\n", dst, src, size, IspError(result[0]&0xFF));
+        return(0);
+    }
+    return(1);
+}
+
+/* like compareMem, but a difference is not an error: returns 1 if the
+   compare was done and sets *same, 0 on any other failure */
+int sameMem(usb_dev_handle *udev, unsigned int dst, unsigned int src, unsigned int size, int *same)
+{
+    unsigned int command[5];
+    unsigned int result[8];
+
+    command[0] = ISP_COMPARE;
+    command[1] = dst;
+    command[2] = src;
+    command[3] = size;
+
+    *same = USBReqISP(udev, command, result);
+
+    if (!*same && (result[0] != COMPARE_ERROR))
     {
         printf("compare MEM failed at 0x%08X base 0x%08X size 0x%08X\n", dst, src, size);
         return(0);
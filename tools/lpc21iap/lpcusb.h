@@ -36,6 +36,7 @@ int blankCheckSectors(usb_dev_handle *udev, int startSec, int endSec);
 int writeRAM(usb_dev_handle *udev, unsigned int startAdr, unsigned int size);
 int copyRAMFlash(usb_dev_handle *udev, unsigned int startAdr, unsigned int base, unsigned int size);
 int compareMem(usb_dev_handle *udev, unsigned int dst, unsigned int src, unsigned int size);
+int sameMem(usb_dev_handle *udev, unsigned int dst, unsigned int src, unsigned int size, int *same);
 int goSw(usb_dev_handle *udev, unsigned int startAdr);
 int readBootloaderVersion(usb_dev_handle *udev, unsigned int * bootVersion);
 int readBootloaderLocation(usb_dev_handle *udev, unsigned int * bootLocation);
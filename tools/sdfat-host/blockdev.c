@@ -0,0 +1,205 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief File backed block device for the host build of sdfat
+ *   @author Lorenz Meier
+ */
+
+#include <stdio.h>
+
+#include "blockdev.h"
+#include "dos.h"
+
+#define BLOCKDEV_SECTOR_SIZE 512
+
+// Globals of mmc_spi.c used by sdfat
+unsigned char spi_back_byte;
+U32 maxsect;
+unsigned char card_capacity;
+unsigned char card_type;
+
+static FILE* blockdev_file;
+static blockdev_model_t blockdev_model;
+static blockdev_stats_t blockdev_stat;
+static uint32_t blockdev_random_state;
+
+void blockdev_default_model(blockdev_model_t* model)
+{
+	// SSP at 7.5 MHz, the card programs a sector in about 250 usecs
+	model->command_time = 100;
+	model->read_time = 600;
+	model->write_time = 850;
+	model->stall_time = 100000;
+	model->stall_rate = 0;
+	model->read_fail_rate = 0;
+	model->write_fail_rate = 0;
+	model->power_cut = 0;
+	model->seed = 1;
+}
+
+int blockdev_open(const char* path, const blockdev_model_t* model)
+{
+	blockdev_file = fopen(path, "r+b");
+	if (blockdev_file == NULL)
+	{
+		return 0;
+	}
+	blockdev_model = *model;
+	blockdev_random_state = model->seed ? model->seed : 1;
+	blockdev_reset_stats();
+	return 1;
+}
+
+void blockdev_close(void)
+{
+	if (blockdev_file != NULL)
+	{
+		fclose(blockdev_file);
+		blockdev_file = NULL;
+	}
+}
+
+const blockdev_stats_t* blockdev_stats(void)
+{
+	return &blockdev_stat;
+}
+
+void blockdev_reset_stats(void)
+{
+	blockdev_stats_t zero = { 0 };
+	blockdev_stat = zero;
+}
+
+/** @brief Uniform in [0, 1), xorshift so runs repeat on every host */
+static double blockdev_random(void)
+{
+	blockdev_random_state ^= blockdev_random_state << 13;
+	blockdev_random_state ^= blockdev_random_state >> 17;
+	blockdev_random_state ^= blockdev_random_state << 5;
+	return blockdev_random_state / 4294967296.0;
+}
+
+static void blockdev_account(uint32_t time)
+{
+	blockdev_stat.time += time;
+	if (time > blockdev_stat.max_time)
+	{
+		blockdev_stat.max_time = time;
+	}
+}
+
+static unsigned char blockdev_read(unsigned long sector, unsigned char* buf, U16 count)
+{
+	blockdev_stat.read_commands++;
+	blockdev_account(blockdev_model.command_time + count * blockdev_model.read_time);
+
+	if (blockdev_file == NULL || sector + count > maxsect
+			|| blockdev_random() < blockdev_model.read_fail_rate)
+	{
+		blockdev_stat.failed++;
+		return 1;
+	}
+	fseek(blockdev_file, (long) sector * BLOCKDEV_SECTOR_SIZE, SEEK_SET);
+	if (fread(buf, BLOCKDEV_SECTOR_SIZE, count, blockdev_file) != count)
+	{
+		blockdev_stat.failed++;
+		return 1;
+	}
+	blockdev_stat.sectors_read += count;
+	return 0;
+}
+
+static unsigned char blockdev_write(unsigned long sector, unsigned char* buf, U16 count)
+{
+	uint32_t time = blockdev_model.command_time + count * blockdev_model.write_time;
+
+	blockdev_stat.write_commands++;
+	if (blockdev_random() < blockdev_model.stall_rate)
+	{
+		time += blockdev_model.stall_time;
+	}
+	blockdev_account(time);
+
+	if (blockdev_file == NULL || sector + count > maxsect
+			|| blockdev_random() < blockdev_model.write_fail_rate)
+	{
+		blockdev_stat.failed++;
+		return 1;
+	}
+	for (U16 i = 0; i < count; i++)
+	{
+		// The host does not notice the power cut, the sectors are just not there
+		if (blockdev_model.power_cut > 0 && blockdev_stat.sectors_written >= blockdev_model.power_cut)
+		{
+			blockdev_stat.lost++;
+			continue;
+		}
+		fseek(blockdev_file, (long) (sector + i) * BLOCKDEV_SECTOR_SIZE, SEEK_SET);
+		if (fwrite(buf + i * BLOCKDEV_SECTOR_SIZE, BLOCKDEV_SECTOR_SIZE, 1, blockdev_file) != 1)
+		{
+			blockdev_stat.failed++;
+			return 1;
+		}
+		blockdev_stat.sectors_written++;
+	}
+	return 0;
+}
+
+void MMC_IO_Init(void)
+{
+}
+
+unsigned char MMCIdentify(void)
+{
+	if (blockdev_file == NULL)
+	{
+		return CMD0_TIMEOUT;
+	}
+	fseek(blockdev_file, 0, SEEK_END);
+	maxsect = ftell(blockdev_file) / BLOCKDEV_SECTOR_SIZE;
+	card_type = SD_CARD;
+	card_capacity = HIGH_CAPACITY;
+	return MMC_OK;
+}
+
+unsigned char MMCReadSector(unsigned long sector, unsigned char* buf)
+{
+	return blockdev_read(sector, buf, 1);
+}
+
+unsigned char MMCReadSectors(unsigned long sector, unsigned char* buf, U16 count)
+{
+	return blockdev_read(sector, buf, count);
+}
+
+unsigned char MMCWriteSector(unsigned long sector, unsigned char* buf)
+{
+	return blockdev_write(sector, buf, 1);
+}
+
+unsigned char MMCWriteSectors(unsigned long sector, unsigned char* buf, U16 count)
+{
+	return blockdev_write(sector, buf, count);
+}
@@ -0,0 +1,82 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief File backed block device for the host build of sdfat
+ *
+ *   Implements the MMC sector functions of arm7/sdfat/mmc_spi.c on a raw
+ *   FAT image. Every command takes a modelled card time, which is added
+ *   up instead of waited for, and can fail or be lost at a power cut.
+ *
+ *   @author Lorenz Meier
+ */
+
+#ifndef BLOCKDEV_H_
+#define BLOCKDEV_H_
+
+#include <stdint.h>
+
+/** Card model, all times in usecs */
+typedef struct
+{
+	uint32_t command_time;            ///< Per read or write command
+	uint32_t read_time;               ///< Per sector read
+	uint32_t write_time;              ///< Per sector written
+	uint32_t stall_time;              ///< Extra busy time of a stalled write command
+	double stall_rate;                ///< Probability of a write stall, per command
+	double read_fail_rate;            ///< Probability of a failed read command
+	double write_fail_rate;           ///< Probability of a failed write command
+	uint32_t power_cut;               ///< Sector writes until the power cut, later ones are lost, 0 for none
+	uint32_t seed;                    ///< Random seed of stalls and failures
+} blockdev_model_t;
+
+typedef struct
+{
+	uint64_t read_commands;
+	uint64_t write_commands;
+	uint64_t sectors_read;
+	uint64_t sectors_written;
+	uint64_t failed;                  ///< Failed commands
+	uint64_t lost;                    ///< Sectors not written after the power cut
+	uint64_t time;                    ///< Modelled card time
+	uint32_t max_time;                ///< Longest command
+} blockdev_stats_t;
+
+/** @brief Model of a class 4 SD card in SPI mode, no stalls or failures */
+void blockdev_default_model(blockdev_model_t* model);
+
+/**
+ * @brief Open the image, the sdfat functions then use it as card
+ * @return 0 if the image could not be opened
+ */
+int blockdev_open(const char* path, const blockdev_model_t* model);
+
+void blockdev_close(void);
+
+/** @brief Counters since the open or the last reset */
+const blockdev_stats_t* blockdev_stats(void);
+
+void blockdev_reset_stats(void);
+
+#endif /* BLOCKDEV_H_ */
@@ -0,0 +1,2 @@
+/* Host build of sdfat: mmc_spi.h includes the LPC register definitions,
+ * the registers are not used without mmc_spi.c */
@@ -0,0 +1 @@
+/* Host build of sdfat: no board configuration, see include/LPC21xx.h */
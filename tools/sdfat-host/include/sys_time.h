@@ -0,0 +1,9 @@
+/* Host build of sdfat: system time for the directory entries */
+#ifndef SYS_TIME_H_
+#define SYS_TIME_H_
+
+#include <stdint.h>
+
+uint64_t sys_time_clock_get_unix_time(void);
+
+#endif /* SYS_TIME_H_ */
@@ -0,0 +1,415 @@
+/*=====================================================================
+
+ PIXHAWK Micro Air Vehicle Flying Robotics Toolkit
+
+ (c) 2009, 2010 PIXHAWK PROJECT  <http://pixhawk.ethz.ch>
+
+ This file is part of the PIXHAWK project
+
+ PIXHAWK is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ PIXHAWK is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with PIXHAWK. If not, see <http://www.gnu.org/licenses/>.
+
+ ======================================================================*/
+
+/**
+ * @file
+ *   @brief Benchmark and check of the sdfat FAT layer on a FAT image
+ *
+ *   Runs the sdfat functions of arm7/sdfat on a raw image file through
+ *   blockdev.c and reports host and modelled card throughput for file
+ *   writes and reads, directory operations and the SD logger access
+ *   pattern (system/sd_log.c). At the end the FAT copies of the image are
+ *   compared and the image is checked with fsck.fat. See README.TXT.
+ *
+ *   @author Lorenz Meier
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/wait.h>
+
+#include "blockdev.h"
+#include "dos.h"
+#include "sd_log.h"
+#include "sys_time.h"
+
+#define BENCH_MAX_CHUNK 65535
+
+typedef struct
+{
+	struct timespec start;
+	uint32_t cache_hits;
+	uint32_t cache_misses;
+} bench_t;
+
+uint64_t sys_time_clock_get_unix_time(void)
+{
+	return (uint64_t) time(NULL) * 1000000;
+}
+
+static void bench_start(bench_t* b)
+{
+	blockdev_reset_stats();
+#ifdef USE_FATBUFFER
+	b->cache_hits = SectorCacheHits;
+	b->cache_misses = SectorCacheMisses;
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &b->start);
+}
+
+/** @brief Print one result line, bytes 0 for operations without data */
+static void bench_report(const bench_t* b, const char* name, uint64_t bytes, uint32_t ops)
+{
+	struct timespec now;
+	const blockdev_stats_t* s = blockdev_stats();
+	uint64_t commands = s->read_commands + s->write_commands;
+	double card = s->time / 1e6;
+	double host;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	host = (now.tv_sec - b->start.tv_sec) + (now.tv_nsec - b->start.tv_nsec) / 1e9;
+
+	printf("%-6s", name);
+	if (bytes > 0)
+	{
+		printf(" %7llu kB  host %8.1f MB/s  card %6.3f MB/s",
+				(unsigned long long) bytes / 1024, bytes / 1e6 / host, card > 0 ? bytes / 1e6 / card : 0);
+	}
+	else
+	{
+		printf(" %7u op  host %8.0f op/s  card %6.1f op/s",
+				ops, ops / host, card > 0 ? ops / card : 0);
+	}
+	printf("  cmds %llu (%llu r, %llu w) %.0f IOPS, max %.1f ms",
+			(unsigned long long) commands, (unsigned long long) s->read_commands,
+			(unsigned long long) s->write_commands, card > 0 ? commands / card : 0,
+			s->max_time / 1e3);
+#ifdef USE_FATBUFFER
+	printf(", cache %u hits %u misses", SectorCacheHits - b->cache_hits,
+			SectorCacheMisses - b->cache_misses);
+#endif
+	if (s->failed > 0)
+	{
+		printf(", %llu failed", (unsigned long long) s->failed);
+	}
+	printf("\n");
+}
+
+static void bench_write(uint32_t size, uint16_t chunk)
+{
+	static U8 buf[BENCH_MAX_CHUNK];
+	bench_t b;
+	uint32_t done = 0;
+
+	for (uint32_t i = 0; i < chunk; i++)
+	{
+		buf[i] = i * 7;
+	}
+	Remove("BENCH.BIN");
+
+	bench_start(&b);
+	FileID file = Fopen("BENCH.BIN", F_WRITE);
+	while (file >= 0 && done < size)
+	{
+		uint16_t n = (size - done < chunk) ? size - done : chunk;
+		if (Fwrite(buf, n, file) != n)
+		{
+			printf("write: disk full after %u bytes\n", done);
+			break;
+		}
+		done += n;
+	}
+	Fclose(file);
+	bench_report(&b, "write", done, 0);
+}
+
+static void bench_read(uint16_t chunk)
+{
+	static U8 buf[BENCH_MAX_CHUNK];
+	bench_t b;
+	uint32_t done = 0;
+	uint32_t errors = 0;
+	U16 n;
+
+	bench_start(&b);
+	FileID file = Fopen("BENCH.BIN", F_READ);
+	if (file < 0)
+	{
+		printf("read: BENCH.BIN not found\n");
+		return;
+	}
+	while ((n = Fread(buf, chunk, file)) > 0)
+	{
+		for (U16 i = 0; i < n; i++)
+		{
+			if (buf[i] != (U8) (((done + i) % chunk) * 7))
+			{
+				errors++;
+			}
+		}
+		done += n;
+	}
+	Fclose(file);
+	bench_report(&b, "read", done, 0);
+	if (errors > 0)
+	{
+		printf("read: %u bytes differ\n", errors);
+	}
+}
+
+/** @brief Create, find and remove small files in a subdirectory */
+static void bench_dir(uint16_t files)
+{
+	char name[13];
+	bench_t b;
+	uint32_t ops = 0;
+
+	bench_start(&b);
+	Mkdir("BENCHDIR");
+	Chdir("BENCHDIR");
+	for (uint16_t i = 0; i < files; i++)
+	{
+		sprintf(name, "F%05u.TXT", i);
+		FileID file = Fopen(name, F_WRITE);
+		Fwrite((U8*) name, sizeof(name), file);
+		Fclose(file);
+		ops++;
+	}
+	for (uint16_t i = 0; i < files; i++)
+	{
+		sprintf(name, "F%05u.TXT", i);
+		if (FindName(name) != FULL_MATCH)
+		{
+			printf("dir: %s not found\n", name);
+		}
+		ops++;
+	}
+	for (uint16_t i = 0; i < files; i++)
+	{
+		sprintf(name, "F%05u.TXT", i);
+		Remove(name);
+		ops++;
+	}
+	Chdir("..");
+	bench_report(&b, "dir", 0, ops);
+}
+
+/**
+ * @brief The access pattern of the SD logger
+ *
+ * A preallocated file written in batches of SD_LOG_BATCH sectors with
+ * one multiple block write each. The spare SD_LOG_BUFFERS - SD_LOG_BATCH
+ * buffers have to cover the longest command.
+ */
+static void bench_log(uint32_t size)
+{
+	static U8 buf[SD_LOG_BATCH * 512];
+	bench_t b;
+	uint32_t sectors;
+	uint32_t first;
+	uint32_t done = 0;
+
+	memset(buf, 0x55, sizeof(buf));
+	Remove("BENCHLOG.BIN");
+
+	bench_start(&b);
+	FileID file = Fopen("BENCHLOG.BIN", F_WRITE);
+	if (file < 0)
+	{
+		printf("log: could not create file\n");
+		return;
+	}
+	sectors = Fpreallocate((size / 512 + secPerCluster - 1) / secPerCluster, file) * secPerCluster;
+	first = GetFirstSectorOfCluster(FileDescriptors[file].FileFirstCluster);
+	Fclose(file);
+	bench_report(&b, "alloc", 0, 1);
+
+	bench_start(&b);
+	while (done + SD_LOG_BATCH <= sectors && done * 512 < size)
+	{
+		WriteSectors(first + done, buf, SD_LOG_BATCH);
+		done += SD_LOG_BATCH;
+	}
+	bench_report(&b, "log", (uint64_t) done * 512, 0);
+}
+
+/**
+ * @brief Compare the FAT copies of the image, sdfat writes all of them
+ * @return 0 if a copy differs from the first FAT
+ */
+static int bench_check_fats(const char* image)
+{
+	static U8 first[512];
+	static U8 copy[512];
+	uint32_t differ = 0;
+
+	FILE* f = fopen(image, "rb");
+	if (!f)
+	{
+		perror(image);
+		return 0;
+	}
+	for (uint32_t sector = 0; sector < FATSectors; sector++)
+	{
+		fseek(f, (long) (FATFirstSector + sector) * 512, SEEK_SET);
+		if (fread(first, 512, 1, f) != 1)
+		{
+			break;
+		}
+		for (U8 i = 1; i < FATCopies; i++)
+		{
+			fseek(f, (long) (FATFirstSector + i * FATSectors + sector) * 512, SEEK_SET);
+			if (fread(copy, 512, 1, f) != 1 || memcmp(first, copy, 512) != 0)
+			{
+				if (differ++ == 0)
+				{
+					printf("FAT %u differs from the first FAT in sector %u\n", i + 1, sector);
+				}
+			}
+		}
+	}
+	fclose(f);
+	printf("%u FATs compared, %u sectors differ\n", FATCopies, differ);
+	return differ == 0;
+}
+
+static void usage(void)
+{
+	printf("usage: sdfat-bench [options] image\n"
+			"  -s kB       file size of the write, read and log tests (4096)\n"
+			"  -b bytes    bytes per Fwrite()/Fread() (512)\n"
+			"  -n files    files of the directory test (64)\n"
+			"  -t tests    comma separated: write,read,dir,log (all)\n"
+			"  -l c,r,w    card command, sector read and write time in usecs\n"
+			"  -x rate,us  write stall probability per command and stall time\n"
+			"  -f r,w      read and write failure probability per command\n"
+			"  -p sectors  power cut after this many written sectors\n"
+			"  -r seed     seed of stalls and failures\n"
+			"  -c command  image check, the image is appended (\"fsck.fat -n\", \"\" for none)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	blockdev_model_t model;
+	uint32_t size = 4096 * 1024;
+	uint32_t chunk = 512;
+	uint32_t files = 64;
+	const char* tests = "write,read,dir,log";
+	const char* check = "fsck.fat -n";
+	int opt;
+
+	blockdev_default_model(&model);
+	while ((opt = getopt(argc, argv, "s:b:n:t:l:x:f:p:r:c:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+			size = atol(optarg) * 1024;
+			break;
+		case 'b':
+			chunk = atol(optarg);
+			break;
+		case 'n':
+			files = atol(optarg);
+			break;
+		case 't':
+			tests = optarg;
+			break;
+		case 'l':
+			sscanf(optarg, "%u,%u,%u", &model.command_time, &model.read_time, &model.write_time);
+			break;
+		case 'x':
+			sscanf(optarg, "%lf,%u", &model.stall_rate, &model.stall_time);
+			break;
+		case 'f':
+			sscanf(optarg, "%lf,%lf", &model.read_fail_rate, &model.write_fail_rate);
+			break;
+		case 'p':
+			model.power_cut = atol(optarg);
+			break;
+		case 'r':
+			model.seed = atol(optarg);
+			break;
+		case 'c':
+			check = optarg;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || chunk < 1 || chunk > BENCH_MAX_CHUNK || files > 99999)
+	{
+		usage();
+		return 1;
+	}
+
+	const char* image = argv[optind];
+	if (!blockdev_open(image, &model))
+	{
+		perror(image);
+		return 1;
+	}
+	if (GetDriveInformation() != F_OK)
+	{
+		printf("%s: no FAT file system\n", image);
+		return 1;
+	}
+	printf("FAT%u, %u sectors per cluster, %u clusters\n",
+			FATtype == FAT12 ? 12 : (FATtype == FAT16 ? 16 : 32),
+			secPerCluster, (uint32_t) maxcluster - 2);
+
+	if (strstr(tests, "write"))
+	{
+		bench_write(size, chunk);
+	}
+	if (strstr(tests, "read"))
+	{
+		bench_read(chunk);
+	}
+	if (strstr(tests, "dir"))
+	{
+		bench_dir(files);
+	}
+	if (strstr(tests, "log"))
+	{
+		bench_log(size);
+	}
+
+	if (blockdev_stats()->lost > 0)
+	{
+		printf("power cut, %llu sectors lost\n", (unsigned long long) blockdev_stats()->lost);
+	}
+	blockdev_close();
+
+	int fats_equal = bench_check_fats(image);
+	if (check[0] == '\0')
+	{
+		return !fats_equal;
+	}
+
+	char command[1024];
+	snprintf(command, sizeof(command), "%s '%s'", check, image);
+	printf("%s\n", command);
+	fflush(stdout);
+	int status = system(command);
+	if (status == -1 || WEXITSTATUS(status) == 127)
+	{
+		printf("%s not found, image not checked\n", check);
+		return !fats_equal;
+	}
+	return !fats_equal || WEXITSTATUS(status) != 0;
+}